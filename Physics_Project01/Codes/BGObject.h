@@ -25,6 +25,7 @@ private:
 	virtual ~BGObject();
 
 public:
+	Engine::CMesh* GetMesh()						{ return m_pMesh; }
 	void SetRigidBody(Engine::iRigidBody* pBody);
 	void SetTransperancy();
 	void AddForceToRigidBody(glm::vec3 vPos);
@@ -11,7 +11,17 @@
 #include "Transform.h"
 #include "JsonParser.h"
 #include "XMLParser.h"
+#include "AssetLoader.h"
+#include "ParallelFor.h"
+#include "Mesh.h"
+#include "Octree.h"
+#include "CollisionMaster.h"
+#include "TriangleBVH.h"
+#include "SpatialIndex.h"
+#include "glm\gtc\matrix_transform.hpp"
 #include <sstream>
+#include <chrono>
+#include <random>
 #include <atlconv.h>
 
 #include "Scene.h"
@@ -21,6 +31,33 @@
 USING(Engine)
 USING(std)
 
+// Rolling terrain of about triNum triangles over a 200 x 200 square, used by the collision benchmarks
+static void GenerateTerrain(_uint triNum, vector<TRIANGLE>& vecTriangles)
+{
+	_uint side = glm::max(1u, (_uint)sqrt(triNum / 2.0));
+	_float cell = 200.f / side;
+	auto point = [cell](_uint x, _uint z)
+	{
+		_float fX = -100.f + x * cell;
+		_float fZ = -100.f + z * cell;
+		return glm::vec3(fX, 8.f * sin(fX * 0.05f) * cos(fZ * 0.07f) + 2.f * sin(fX * 0.31f + fZ * 0.17f), fZ);
+	};
+
+	vecTriangles.clear();
+	vecTriangles.reserve((size_t)side * side * 2);
+	for (_uint z = 0; z < side; ++z)
+	{
+		for (_uint x = 0; x < side; ++x)
+		{
+			TRIANGLE tri;
+			tri.p0 = point(x, z); tri.p1 = point(x, z + 1); tri.p2 = point(x + 1, z);
+			vecTriangles.push_back(tri);
+			tri.p0 = point(x + 1, z); tri.p1 = point(x, z + 1); tri.p2 = point(x + 1, z + 1);
+			vecTriangles.push_back(tri);
+		}
+	}
+}
+
 Client::Client()
 {
 	m_pGameMaster = CGameMaster::GetInstance();
@@ -176,9 +213,581 @@ RESULT Client::Ready_BasicComponent()
 		return PK_TRANSFORM_CREATE_FAILED;
 
 	CXMLParser::GetInstance()->LoadSoundData(m_DataPath, m_SoundDataFileName);
-	CXMLParser::GetInstance()->LoadShaderData(m_DataPath, m_ShaderDataFileName);
-	CJsonParser::GetInstance()->LoadTextureData(m_DataPath, m_TextureDataFileName);
-	CJsonParser::GetInstance()->LoadMeshData(m_DataPath, m_MeshDataFileName, true);
+
+	// Files are read and decoded in parallel, GL objects are created here in list order
+	CAssetLoader* pLoader = CAssetLoader::Create();
+	if (nullptr == pLoader)
+		return PK_ERROR;
+
+	QueueAssets(pLoader, true);
+	pLoader->Run();
+	SafeDestroy(pLoader);
+
+	// Map (or build and save) the collision trees of every mesh now rather than on the first query
+	unordered_map<string, CComponent*>* pMap = pMaster->GetComponentMap();
+	unordered_map<string, CComponent*>::iterator iter;
+	for (iter = pMap->begin(); iter != pMap->end(); ++iter)
+	{
+		CMesh* pMesh = dynamic_cast<CMesh*>(iter->second);
+		if (nullptr == pMesh)
+			continue;
+
+		pMesh->GetTriangleBVH();
+		pMesh->GetOctree();
+	}
+
+	return PK_NOERROR;
+}
+
+// Queue shaders, textures and meshes on the loader
+// Streamed textures do not wait for the loader, the level starts with placeholders
+void Client::QueueAssets(CAssetLoader* pLoader, _bool streamTextures)
+{
+	CXMLParser::GetInstance()->LoadShaderData(m_DataPath, m_ShaderDataFileName, pLoader);
+	CJsonParser::GetInstance()->LoadTextureData(m_DataPath, m_TextureDataFileName, streamTextures ? nullptr : pLoader);
+	CJsonParser::GetInstance()->LoadMeshData(m_DataPath, m_MeshDataFileName, true, pLoader);
+}
+
+// Time full asset loads without a window (null GL backend), once per worker count
+// The first pass also writes the mesh caches, so it is reported separately
+RESULT Client::BenchmarkLoading()
+{
+	vector<_uint> vecWorkers;
+	vecWorkers.push_back(GetParallelWorkerCount());
+	for (_uint count = 1; count < GetParallelWorkerCount(); count *= 2)
+		vecWorkers.push_back(count);
+	vecWorkers.push_back(GetParallelWorkerCount());
+
+	_double fSingle = 0.0;
+	for (size_t i = 0; i < vecWorkers.size(); ++i)
+	{
+		CAssetLoader* pLoader = CAssetLoader::Create();
+		if (nullptr == pLoader)
+			return PK_ERROR;
+
+		pLoader->SetNullBackend(true);
+		pLoader->SetWorkerCount(vecWorkers[i]);
+		QueueAssets(pLoader);
+		_uint jobCount = pLoader->GetJobCount();
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		pLoader->Run();
+		_double fTime = chrono::duration<_double, milli>(chrono::steady_clock::now() - start).count();
+		SafeDestroy(pLoader);
+
+		if (0 == i)
+		{
+			cout << "Warm-up : " << jobCount << " assets, " << fTime << " ms" << endl;
+			continue;
+		}
+
+		if (1 == vecWorkers[i])
+			fSingle = fTime;
+		cout << "Workers " << vecWorkers[i] << " : " << fTime << " ms";
+		if (fSingle > 0.0 && fTime > 0.0)
+			cout << " (x" << fSingle / fTime << ")";
+		cout << endl;
+	}
+
+	return PK_NOERROR;
+}
+
+// Cook the compressed cache of every texture in the list, checksums of the compressed levels are printed for comparison
+RESULT Client::CookTextures()
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	CJsonParser::GetInstance()->CookTextureData(m_DataPath, m_TextureDataFileName);
+	_double fTime = chrono::duration<_double, milli>(chrono::steady_clock::now() - start).count();
+
+	cout << "Cooked in " << fTime << " ms" << endl;
+
+	return PK_NOERROR;
+}
+
+// Write the binary cache of every mesh in the list, the vertex cache miss ratio before and after the reordering is printed
+RESULT Client::ConvertMeshes()
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	CJsonParser::GetInstance()->ConvertMeshData(m_DataPath, m_MeshDataFileName);
+	_double fTime = chrono::duration<_double, milli>(chrono::steady_clock::now() - start).count();
+
+	cout << "Converted in " << fTime << " ms" << endl;
 
 	return PK_NOERROR;
 }
+
+// Count what a crowded scene would draw with and without level of detail selection (no window)
+// Copies of every mesh are spread along the view direction from 2 to 200 bounding radii
+RESULT Client::BenchmarkLOD()
+{
+	vector<CJsonParser::sMeshData> vecMeshes;
+	CJsonParser::GetInstance()->LoadMeshList(m_DataPath, m_MeshDataFileName, vecMeshes);
+
+	// Same projection as the scene camera
+	_float height = (_float)m_pGraphicDevice->GetHeightSize();
+	glm::mat4x4 matProj = glm::perspective(0.6f, m_pGraphicDevice->GetWidthSize() / height, 0.1f, 1000.f);
+	const _uint copyNum = 10000;
+
+	_ulonglong fullTotal = 0;
+	_ulonglong lodTotal = 0;
+	vector<string> vecDone;
+	for (size_t i = 0; i < vecMeshes.size(); ++i)
+	{
+		// Several entries share one file
+		string filePath = m_DataPath + vecMeshes[i].PATH;
+		string sourcePath = filePath + vecMeshes[i].FILENAME;
+		if (find(vecDone.begin(), vecDone.end(), sourcePath) != vecDone.end())
+			continue;
+		vecDone.push_back(sourcePath);
+
+		CMesh::MESHFILEDATA data;
+		if (PK_NOERROR != CMesh::LoadMeshFile((eModelType)vecMeshes[i].DATATYPE, filePath, vecMeshes[i].FILENAME, data))
+			continue;
+
+		glm::vec3 vCenter = (data.vMin + data.vMax) * 0.5f;
+		_float fRadius = glm::length(data.vMax - data.vMin) * 0.5f;
+		_uint histogram[MESH_MAX_LOD] = { 0 };
+		_ulonglong fullTriangles = 0;
+		_ulonglong lodTriangles = 0;
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (_uint copy = 0; copy < copyNum; ++copy)
+		{
+			_float distance = fRadius * (2.f + 198.f * (copy + 0.5f) / copyNum);
+			glm::mat4x4 matWorldView = glm::translate(glm::mat4x4(1.f), glm::vec3(0.f, 0.f, -distance) - vCenter);
+			_uint lod = CMesh::SelectLOD(data.LODs, data.iLODNum, matWorldView, matProj, vCenter, fRadius, height, MESH_LOD_PIXEL_ERROR);
+
+			++histogram[lod];
+			fullTriangles += data.LODs[0].iIndexCount / 3;
+			lodTriangles += data.LODs[lod].iIndexCount / 3;
+		}
+		_double fTime = chrono::duration<_double, nano>(chrono::steady_clock::now() - start).count() / copyNum;
+
+		cout << vecMeshes[i].FILENAME << " :";
+		for (_uint lod = 0; lod < data.iLODNum; ++lod)
+			cout << " LOD" << lod << " " << data.LODs[lod].iIndexCount / 3 << " tris x" << histogram[lod];
+		cout << endl << "    " << fullTriangles << " -> " << lodTriangles << " triangles, " << fTime << " ns per selection" << endl;
+
+		fullTotal += fullTriangles;
+		lodTotal += lodTriangles;
+		CMesh::ReleaseMeshFile(data);
+	}
+
+	cout << "Total : " << fullTotal << " -> " << lodTotal << " triangles";
+	if (0 < lodTotal)
+		cout << " (x" << (_double)fullTotal / lodTotal << ")";
+	cout << endl;
+
+	return PK_NOERROR;
+}
+
+
+// Time COctree::Build over generated terrains on one worker and on every worker
+// Both trees must match, and every leaf must hold the triangles a brute force SAT pass puts in it
+RESULT Client::BenchmarkOctree()
+{
+	const _uint triNums[] = { 10000, 100000, 1000000, 5000000 };
+	const _uint depth = 6;
+	const _uint cellNum = 1 << (depth - 1);
+	glm::vec3 vMin(-101.f, -12.f, -101.f);
+	glm::vec3 vMax(101.f, 12.f, 101.f);
+	glm::vec3 vCell = (vMax - vMin) / (_float)cellNum;
+
+	CCollisionMaster* pCollision = CCollisionMaster::GetInstance();
+	RESULT result = PK_NOERROR;
+	vector<TRIANGLE> vecTriangles;
+	for (_uint t = 0; t < sizeof(triNums) / sizeof(triNums[0]); ++t)
+	{
+		GenerateTerrain(triNums[t], vecTriangles);
+		_uint triCount = (_uint)vecTriangles.size();
+
+		// [0] : one worker, [1] : every worker
+		COctree* pOctrees[2] = { nullptr, nullptr };
+		_double fTimes[2] = { 0.0, 0.0 };
+		_uint missed = 0;
+		for (_uint run = 0; run < 2; ++run)
+		{
+			pOctrees[run] = COctree::Create(vMax, vMin, depth);
+			if (nullptr == pOctrees[run])
+				return PK_ERROR;
+			for (_uint i = 0; i < triCount; ++i)
+				pOctrees[run]->AddTriangle(vecTriangles[i]);
+
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			missed = pOctrees[run]->Build(0 == run ? 1 : GetParallelWorkerCount());
+			fTimes[run] = chrono::duration<_double, milli>(chrono::steady_clock::now() - start).count();
+		}
+
+		COctree* pOctree = pOctrees[1];
+		_uint firstLeaf = pOctree->GetFirstLeaf();
+		_uint leafCount = pOctree->GetNodeCount() - firstLeaf;
+
+		// Candidate leaves of a triangle are the cells its bounds touch, widened a little for triangles on a cell border
+		vector<vector<_uint>> vecCandidates(leafCount);
+		for (_uint i = 0; i < triCount; ++i)
+		{
+			const TRIANGLE& tri = vecTriangles[i];
+			glm::vec3 vLo = (glm::min(glm::min(tri.p0, tri.p1), tri.p2) - vMin) / vCell - 0.001f;
+			glm::vec3 vHi = (glm::max(glm::max(tri.p0, tri.p1), tri.p2) - vMin) / vCell + 0.001f;
+			_uint lo[3], hi[3];
+			for (_uint axis = 0; axis < 3; ++axis)
+			{
+				lo[axis] = (_uint)glm::clamp(floor(vLo[axis]), 0.f, cellNum - 1.f);
+				hi[axis] = (_uint)glm::clamp(floor(vHi[axis]), 0.f, cellNum - 1.f);
+			}
+
+			for (_uint z = lo[2]; z <= hi[2]; ++z)
+			{
+				for (_uint y = lo[1]; y <= hi[1]; ++y)
+				{
+					for (_uint x = lo[0]; x <= hi[0]; ++x)
+					{
+						// Leaf offset in the last level is the Morton code of the cell
+						_uint morton = 0;
+						for (_uint bit = 0; bit < depth - 1; ++bit)
+							morton |= (((x >> bit) & 1) | (((y >> bit) & 1) << 1) | (((z >> bit) & 1) << 2)) << (3 * bit);
+						vecCandidates[morton].push_back(i);
+					}
+				}
+			}
+		}
+
+		// Triangles touching a cell face may land on either side, so a triangle must be in a leaf when it hits a slightly
+		// smaller box and may only be in it when it hits a slightly larger one
+		atomic<_uint> mismatch(0);
+		ParallelFor(leafCount, 64, [&](_uint begin, _uint end, _uint worker)
+		{
+			vector<_uint> vecRequired;
+			vector<_uint> vecAllowed;
+			vector<_uint> vecBuilt;
+			for (_uint leaf = begin; leaf < end; ++leaf)
+			{
+				const COctree::NODE& node = pOctree->GetNode(firstLeaf + leaf);
+				glm::vec3 vNodeMin(node.vMin[0], node.vMin[1], node.vMin[2]);
+				glm::vec3 vNodeMax(node.vMax[0], node.vMax[1], node.vMax[2]);
+				glm::vec3 vCenter = (vNodeMin + vNodeMax) * 0.5f;
+				glm::vec3 vHalf = (vNodeMax - vNodeMin) * 0.5f;
+
+				vecRequired.clear();
+				vecAllowed.clear();
+				for (size_t i = 0; i < vecCandidates[leaf].size(); ++i)
+				{
+					const TRIANGLE& tri = vecTriangles[vecCandidates[leaf][i]];
+					if (pCollision->TestTriangleAABB(tri.p0, tri.p1, tri.p2, vCenter, vHalf * 0.9999f))
+						vecRequired.push_back(vecCandidates[leaf][i]);
+					if (pCollision->TestTriangleAABB(tri.p0, tri.p1, tri.p2, vCenter, vHalf * 1.0001f))
+						vecAllowed.push_back(vecCandidates[leaf][i]);
+				}
+
+				// Leaves are in increasing triangle order, and the single worker tree must be the same
+				const _uint* pBuilt = pOctree->GetTriIndices(node);
+				vecBuilt.assign(pBuilt, pBuilt + node.iTriCount);
+				const COctree::NODE& single = pOctrees[0]->GetNode(firstLeaf + leaf);
+				if (!includes(vecBuilt.begin(), vecBuilt.end(), vecRequired.begin(), vecRequired.end())
+					|| !includes(vecAllowed.begin(), vecAllowed.end(), vecBuilt.begin(), vecBuilt.end())
+					|| single.iTriCount != node.iTriCount
+					|| 0 != memcmp(pOctrees[0]->GetTriIndices(single), pBuilt, node.iTriCount * sizeof(_uint)))
+					++mismatch;
+			}
+		});
+
+		cout << triCount << " triangles : 1 worker " << fTimes[0] << " ms, " << GetParallelWorkerCount() << " workers " << fTimes[1] << " ms";
+		if (fTimes[1] > 0.0)
+			cout << " (x" << fTimes[0] / fTimes[1] << ")";
+		cout << ", " << missed << " outside, ";
+		if (0 == mismatch)
+			cout << "leaves match" << endl;
+		else
+		{
+			cout << mismatch << " of " << leafCount << " leaves DIFFER" << endl;
+			result = PK_ERROR;
+		}
+
+		SafeDestroy(pOctrees[0]);
+		SafeDestroy(pOctrees[1]);
+	}
+
+	return result;
+}
+
+// Line of sight from one point to a grid of targets over a generated terrain, the way an AI checks what it can see
+// Each segment is traced by IntersectAny, by IntersectAnyBatch (packets of 4 neighbouring targets) and by the batched
+// closest hit and line of sight queries of the collision master on every worker count, any disagreement fails
+// Segments straight down through the vertices and edges of the terrain check that no ray leaks through a seam
+RESULT Client::BenchmarkRays()
+{
+	vector<TRIANGLE> vecTriangles;
+	GenerateTerrain(200000, vecTriangles);
+	CTriangleBVH* pBVH = CTriangleBVH::Create(vecTriangles.data(), (_uint)vecTriangles.size());
+	if (nullptr == pBVH)
+		return PK_ERROR;
+
+	// Targets scanned row by row so neighbouring rays stay close, heights above and below the terrain
+	const _uint side = 1024;
+	const _uint rayNum = side * side;
+	glm::vec3 vOrigin(-20.f, 30.f, 10.f);
+	vector<glm::vec3> vecOrigins(rayNum, vOrigin);
+	vector<glm::vec3> vecTargets(rayNum);
+	for (_uint z = 0; z < side; ++z)
+	{
+		for (_uint x = 0; x < side; ++x)
+		{
+			_float fX = -99.f + 198.f * (x + 0.37f) / side;
+			_float fZ = -99.f + 198.f * (z + 0.61f) / side;
+			vecTargets[z * side + x] = glm::vec3(fX, 12.f * sin(fX * 0.11f + fZ * 0.05f), fZ);
+		}
+	}
+
+	vector<_bool> vecScalar(rayNum);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (_uint i = 0; i < rayNum; ++i)
+	{
+		glm::vec3 vDir = vecTargets[i] - vOrigin;
+		_float fDist = glm::length(vDir);
+		vecScalar[i] = pBVH->IntersectAny(vOrigin, vDir / fDist, fDist);
+	}
+	_double fScalar = chrono::duration<_double>(chrono::steady_clock::now() - start).count();
+
+	_bool* pPacket = new _bool[rayNum];
+	start = chrono::steady_clock::now();
+	pBVH->IntersectAnyBatch(vecOrigins.data(), vecTargets.data(), rayNum, pPacket);
+	_double fPacket = chrono::duration<_double>(chrono::steady_clock::now() - start).count();
+
+	_uint blocked = 0;
+	_uint mismatch = 0;
+	for (_uint i = 0; i < rayNum; ++i)
+	{
+		blocked += pPacket[i] ? 1 : 0;
+		mismatch += vecScalar[i] != pPacket[i] ? 1 : 0;
+	}
+
+	cout << rayNum << " segments, " << vecTriangles.size() << " triangles, " << blocked << " blocked" << endl;
+	cout << "IntersectAny : " << rayNum / fScalar / 1000000.0 << " M rays/s" << endl;
+	cout << "IntersectAnyBatch : " << rayNum / fPacket / 1000000.0 << " M rays/s";
+	if (fPacket > 0.0)
+		cout << " (x" << fScalar / fPacket << ")";
+	cout << endl;
+	if (0 != mismatch)
+		cout << mismatch << " segments DIFFER between the scalar and packet paths" << endl;
+
+	// Batched queries, once per worker count like BenchmarkLoading : closest hits and packet line of sight must both agree with the packets above
+	vector<RAYQUERY> vecQueries(rayNum);
+	for (_uint i = 0; i < rayNum; ++i)
+	{
+		vecQueries[i].vOrigin = vOrigin;
+		vecQueries[i].vTarget = vecTargets[i];
+	}
+	vector<RAYRESULT> vecClosest(rayNum);
+	_bool* pBlocked = new _bool[rayNum];
+
+	vector<_uint> vecWorkers;
+	vecWorkers.push_back(GetParallelWorkerCount());
+	for (_uint count = 1; count < GetParallelWorkerCount(); count *= 2)
+		vecWorkers.push_back(count);
+	vecWorkers.push_back(GetParallelWorkerCount());
+
+	CCollisionMaster* pCollision = CCollisionMaster::GetInstance();
+	_double fSingle[2] = { 0.0, 0.0 };
+	_uint batchMismatch = 0;
+	for (size_t i = 0; i < vecWorkers.size(); ++i)
+	{
+		pCollision->SetWorkerCount(vecWorkers[i]);
+
+		start = chrono::steady_clock::now();
+		pCollision->RayClosestBatch(pBVH, vecQueries.data(), rayNum, vecClosest.data());
+		_double fClosest = chrono::duration<_double, milli>(chrono::steady_clock::now() - start).count();
+
+		start = chrono::steady_clock::now();
+		pCollision->SegmentBlockedBatch(pBVH, vecQueries.data(), rayNum, pBlocked);
+		_double fBlocked = chrono::duration<_double, milli>(chrono::steady_clock::now() - start).count();
+
+		for (_uint ray = 0; ray < rayNum; ++ray)
+			batchMismatch += (vecClosest[ray].bHit != pPacket[ray] || pBlocked[ray] != pPacket[ray]) ? 1 : 0;
+
+		if (0 == i)
+		{
+			cout << "Warm-up : RayClosestBatch " << fClosest << " ms, SegmentBlockedBatch " << fBlocked << " ms" << endl;
+			continue;
+		}
+
+		if (1 == vecWorkers[i])
+		{
+			fSingle[0] = fClosest;
+			fSingle[1] = fBlocked;
+		}
+		cout << "Workers " << vecWorkers[i] << " : RayClosestBatch " << fClosest << " ms";
+		if (fSingle[0] > 0.0 && fClosest > 0.0)
+			cout << " (x" << fSingle[0] / fClosest << ")";
+		cout << ", SegmentBlockedBatch " << fBlocked << " ms";
+		if (fSingle[1] > 0.0 && fBlocked > 0.0)
+			cout << " (x" << fSingle[1] / fBlocked << ")";
+		cout << endl;
+	}
+	pCollision->SetWorkerCount(0);
+
+	// Watertightness : vertical segments through the inner vertices, the middle of the shared edges and the middle of
+	// the diagonals of the terrain must all be blocked, a ray through a seam may not slip between the two triangles
+	vector<glm::vec3> vecSeamOrigins;
+	vector<glm::vec3> vecSeamTargets;
+	for (size_t i = 0; i < vecTriangles.size(); i += 2)
+	{
+		const TRIANGLE& tri = vecTriangles[i];
+		if (99.9f <= fabs(tri.p0.x) || 99.9f <= fabs(tri.p0.z))
+			continue;
+
+		glm::vec3 vPoints[3] = { tri.p0, (tri.p0 + tri.p2) * 0.5f, (tri.p1 + tri.p2) * 0.5f };
+		for (_uint p = 0; p < 3; ++p)
+		{
+			vecSeamOrigins.push_back(glm::vec3(vPoints[p].x, 50.f, vPoints[p].z));
+			vecSeamTargets.push_back(glm::vec3(vPoints[p].x, -50.f, vPoints[p].z));
+		}
+	}
+
+	_uint seamNum = (_uint)vecSeamOrigins.size();
+	_bool* pSeam = new _bool[seamNum];
+	pBVH->IntersectAnyBatch(vecSeamOrigins.data(), vecSeamTargets.data(), seamNum, pSeam);
+	_uint leaked = 0;
+	for (_uint i = 0; i < seamNum; ++i)
+	{
+		if (!pSeam[i] || !pBVH->IntersectAny(vecSeamOrigins[i], glm::vec3(0.f, -1.f, 0.f), 100.f))
+			++leaked;
+	}
+	cout << seamNum << " segments through vertices and edges, " << leaked << " not blocked" << endl;
+
+	delete[] pSeam;
+	delete[] pBlocked;
+	delete[] pPacket;
+	SafeDestroy(pBVH);
+
+	if (0 != batchMismatch)
+		cout << batchMismatch << " batched results DIFFER from the packet path" << endl;
+	if (0 != mismatch || 0 != batchMismatch || 0 != leaked)
+		return PK_ERROR;
+	cout << "Scalar, packet and batched results match, no leaks" << endl;
+
+	return PK_NOERROR;
+}
+
+// Neighbour queries of many agents over a k-d tree rebuilt like every frame, batches timed on 1, 2, 4 ... workers
+// A sample of the queries is checked against a brute force scan of every point, any difference fails
+RESULT Client::BenchmarkKNN()
+{
+	const _uint pointNum = 200000;
+	const _uint k = 8;
+	const _float fRadius = 6.f;
+	const _uint sampleStep = 97;
+
+	// Agents spread over a wide, flat area
+	mt19937 rng(7);
+	uniform_real_distribution<_float> spread(-500.f, 500.f);
+	uniform_real_distribution<_float> height(0.f, 20.f);
+	vector<glm::vec3> vecPoints(pointNum);
+	for (_uint i = 0; i < pointNum; ++i)
+		vecPoints[i] = glm::vec3(spread(rng), height(rng), spread(rng));
+
+	CSpatialIndex* pIndex = CSpatialIndex::Create();
+	if (nullptr == pIndex)
+		return PK_ERROR;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	pIndex->Build(vecPoints.data(), pointNum);
+	_double fBuild = chrono::duration<_double, milli>(chrono::steady_clock::now() - start).count();
+	cout << pointNum << " points, build " << fBuild << " ms" << endl;
+
+	// Brute force answers of the sampled queries : every point in the radius, and the k smallest distances
+	vector<vector<_uint>> vecRadiusRef;
+	vector<vector<_float>> vecNearestRef;
+	vector<_float> vecDistSq(pointNum);
+	for (_uint query = 0; query < pointNum; query += sampleStep)
+	{
+		vector<_uint> vecInside;
+		for (_uint i = 0; i < pointNum; ++i)
+		{
+			glm::vec3 vDiff = vecPoints[i] - vecPoints[query];
+			vecDistSq[i] = glm::dot(vDiff, vDiff);
+			if (vecDistSq[i] <= fRadius * fRadius)
+				vecInside.push_back(i);
+		}
+		vecRadiusRef.push_back(vecInside);
+
+		partial_sort(vecDistSq.begin(), vecDistSq.begin() + k, vecDistSq.end());
+		vecNearestRef.push_back(vector<_float>(vecDistSq.begin(), vecDistSq.begin() + k));
+	}
+
+	// Same distances as the brute force, ties may pick either point
+	auto check = [&](const vector<vector<_uint>>& vecRadius, const vector<vector<_uint>>& vecNearest)
+	{
+		_uint mismatch = 0;
+		for (_uint sample = 0; sample < vecRadiusRef.size(); ++sample)
+		{
+			_uint query = sample * sampleStep;
+			vector<_uint> vecFound = vecRadius[query];
+			sort(vecFound.begin(), vecFound.end());
+			if (vecFound != vecRadiusRef[sample])
+				++mismatch;
+
+			vector<_float> vecFoundSq;
+			for (size_t i = 0; i < vecNearest[query].size(); ++i)
+			{
+				glm::vec3 vDiff = vecPoints[vecNearest[query][i]] - vecPoints[query];
+				vecFoundSq.push_back(glm::dot(vDiff, vDiff));
+			}
+			if (vecFoundSq != vecNearestRef[sample])
+				++mismatch;
+		}
+		return mismatch;
+	};
+
+	vector<_uint> vecWorkers;
+	vecWorkers.push_back(GetParallelWorkerCount());
+	for (_uint count = 1; count < GetParallelWorkerCount(); count *= 2)
+		vecWorkers.push_back(count);
+	vecWorkers.push_back(GetParallelWorkerCount());
+
+	vector<vector<_uint>> vecRadius;
+	vector<vector<_uint>> vecNearest;
+	_double fSingle[2] = { 0.0, 0.0 };
+	_uint mismatch = 0;
+	for (size_t i = 0; i < vecWorkers.size(); ++i)
+	{
+		start = chrono::steady_clock::now();
+		pIndex->QueryRadiusBatch(vecPoints.data(), pointNum, fRadius, vecRadius, vecWorkers[i]);
+		_double fRadiusTime = chrono::duration<_double, milli>(chrono::steady_clock::now() - start).count();
+
+		start = chrono::steady_clock::now();
+		pIndex->QueryNearestBatch(vecPoints.data(), pointNum, k, vecNearest, vecWorkers[i]);
+		_double fNearestTime = chrono::duration<_double, milli>(chrono::steady_clock::now() - start).count();
+
+		mismatch += check(vecRadius, vecNearest);
+
+		if (0 == i)
+		{
+			cout << "Warm-up : QueryRadiusBatch " << fRadiusTime << " ms, QueryNearestBatch " << fNearestTime << " ms" << endl;
+			continue;
+		}
+
+		if (1 == vecWorkers[i])
+		{
+			fSingle[0] = fRadiusTime;
+			fSingle[1] = fNearestTime;
+		}
+		cout << "Workers " << vecWorkers[i] << " : QueryRadiusBatch " << fRadiusTime << " ms";
+		if (fSingle[0] > 0.0 && fRadiusTime > 0.0)
+			cout << " (x" << fSingle[0] / fRadiusTime << ")";
+		cout << ", QueryNearestBatch " << fNearestTime << " ms";
+		if (fSingle[1] > 0.0 && fNearestTime > 0.0)
+			cout << " (x" << fSingle[1] / fNearestTime << ")";
+		cout << endl;
+	}
+
+	SafeDestroy(pIndex);
+
+	if (0 != mismatch)
+	{
+		cout << mismatch << " sampled queries DIFFER from the brute force scan" << endl;
+		return PK_ERROR;
+	}
+	cout << vecRadiusRef.size() << " sampled queries match the brute force scan" << endl;
+
+	return PK_NOERROR;
+}
\ No newline at end of file
@@ -9,6 +9,7 @@ namespace Engine
 	class CTimer;
 	class COpenGLDevice;
 	class CInputDevice;
+	class CAssetLoader;
 }
 
 // A client class that runs a core loop
@@ -36,8 +37,25 @@ public:
 	// Core Loop
 	void Loop();
 	RESULT Ready();
+	// Time full asset loads without a window (null GL backend), once per worker count
+	RESULT BenchmarkLoading();
+	// Cook the compressed cache of every texture and time it (no window)
+	RESULT CookTextures();
+	// Write the binary cache of every mesh and time it (no window)
+	RESULT ConvertMeshes();
+	// Triangles drawn by many copies of every mesh with and without level of detail selection (no window)
+	RESULT BenchmarkLOD();
+	// Octree builds over generated meshes on one worker and on every worker, leaves checked by brute force (no window)
+	RESULT BenchmarkOctree();
+	// Segment queries against a generated mesh : one ray at a time, packets of 4 and the batched queries
+	// on 1, 2, 4 ... workers, every path must agree (no window)
+	RESULT BenchmarkRays();
+	// Radius and nearest-K queries of many agents over a k-d tree, batches on 1, 2, 4 ... workers checked by brute force (no window)
+	RESULT BenchmarkKNN();
 private:
 	RESULT Ready_BasicComponent();
+	// Queue shaders, textures and meshes on the loader
+	void QueueAssets(Engine::CAssetLoader* pLoader, _bool streamTextures = false);
 };
 
 #endif //_CLIENT_H_
\ No newline at end of file
@@ -17,6 +17,10 @@
 #include "Renderer.h"
 #include "ObjectFactory.h"
 #include "SoundMaster.h"
+#include "SpatialIndex.h"
+#include "Mesh.h"
+#include "TriangleBVH.h"
+#include "glm\\mat4x4.hpp"
 
 #include "PhysicsDefines.h"
 
@@ -33,10 +37,12 @@ SceneDungeon::SceneDungeon()
 	: m_pSkyBox(nullptr)
 	, m_pDefaultCamera(nullptr), m_vCameraSavedPos(vec3(0.f)), m_vCameraSavedRot(vec3(0.f)), m_vCameraSavedTarget(vec3(0.f))
 	, m_pCharacterLayer(nullptr), m_pPFactory(nullptr), m_pPWorld(nullptr), m_iTargetIndex(0)
+	, m_bShowPhysicsProfile(false), m_pTargetIndex(nullptr)
 {
 	m_pInputDevice = CInputDevice::GetInstance(); m_pInputDevice->AddRefCnt();
 	m_pUIManager = UIManager::GetInstance(); m_pUIManager->AddRefCnt();
 	m_vecTargets.clear();
+	m_vecTargetPos.clear();
 
 	m_ObjListFileName = "physicsMapObjects.json";
 	m_LightListFileName = "lights.xml";
@@ -55,8 +61,10 @@ void SceneDungeon::Destroy()
 	SafeDestroy(m_pPWorld);
 
 	SafeDestroy(m_pSkyBox);
+	SafeDestroy(m_pTargetIndex);
 
 	m_vecTargets.clear();
+	m_vecTargetPos.clear();
 
 	CScene::Destroy();
 }
@@ -70,6 +78,8 @@ void SceneDungeon::Update(const _float& dt)
 	if (nullptr != m_pPWorld)
 		m_pPWorld->Update(dt);
 
+	UpdateTargetIndex();
+
 	KeyCheck();
 
 	CLightMaster::GetInstance()->SetLightInfo();
@@ -107,9 +117,31 @@ string SceneDungeon::GetCurrentTargetName()
 	return target->GetMeshName();
 }
 
+// Return physics statistics of the last step (nullptr when hidden)
+const sPhysicsProfile* SceneDungeon::GetPhysicsProfile()
+{
+	if (!m_bShowPhysicsProfile || nullptr == m_pPWorld)
+		return nullptr;
+
+	return &m_pPWorld->GetProfile();
+}
+
 // Check User input
 void SceneDungeon::KeyCheck()
 {
+	static _bool isF4Down = false;
+	if (m_pInputDevice->IsKeyDown(GLFW_KEY_F4))
+	{
+		if (!isF4Down)
+		{
+			isF4Down = true;
+
+			m_bShowPhysicsProfile = !m_bShowPhysicsProfile;
+		}
+	}
+	else
+		isF4Down = false;
+
 	static _bool isF3Down = false;
 	if (m_pInputDevice->IsKeyDown(GLFW_KEY_F3))
 	{
@@ -152,6 +184,32 @@ void SceneDungeon::KeyCheck()
 	else
 		isF1Down = false;
 
+	static _bool isClickDown = false;
+	if (m_pInputDevice->IsMousePressed(GLFW_MOUSE_BUTTON_1))
+	{
+		if (!isClickDown)
+		{
+			isClickDown = true;
+
+			PickTarget();
+		}
+	}
+	else
+		isClickDown = false;
+
+	static _bool isF5Down = false;
+	if (m_pInputDevice->IsKeyDown(GLFW_KEY_F5))
+	{
+		if (!isF5Down)
+		{
+			isF5Down = true;
+
+			SetNearestTarget();
+		}
+	}
+	else
+		isF5Down = false;
+
 	static _bool isTabDown = false;
 	if (m_pInputDevice->IsKeyDown(GLFW_KEY_TAB))
 	{
@@ -169,6 +227,87 @@ void SceneDungeon::KeyCheck()
 		isTabDown = false;
 }
 
+// The balls move every step, so the index is rebuilt over their current positions
+void SceneDungeon::UpdateTargetIndex()
+{
+	if (nullptr == m_pTargetIndex)
+		return;
+
+	m_vecTargetPos.clear();
+	for (_uint i = 1; i < m_vecTargets.size(); ++i)
+		m_vecTargetPos.push_back(m_vecTargets[i]->GetPosition());
+
+	_uint count = (_uint)m_vecTargetPos.size();
+	m_pTargetIndex->Build(0 == count ? nullptr : &m_vecTargetPos[0], count);
+}
+
+// Follow the ball nearest to the current target
+void SceneDungeon::SetNearestTarget()
+{
+	if (0 == m_iTargetIndex || nullptr == m_pTargetIndex)
+		return;
+
+	// The current ball is its own nearest, so ask for two
+	vector<_uint> vecResult;
+	m_pTargetIndex->QueryNearest(m_vecTargets[m_iTargetIndex]->GetPosition(), 2, vecResult);
+	for (_uint i = 0; i < vecResult.size(); ++i)
+	{
+		_uint index = vecResult[i] + 1;
+		if (index == m_iTargetIndex)
+			continue;
+
+		m_iTargetIndex = index;
+		m_pDefaultCamera->SetTargetObject(m_vecTargets[m_iTargetIndex]);
+		return;
+	}
+}
+
+// Follow the ball under the mouse : the mouse ray is traced against the mesh BVH of every ball, in its local space
+void SceneDungeon::PickTarget()
+{
+	vec3 vOrigin = GetCameraPos();
+	vec3 vDir = m_pInputDevice->GetMouseWorldCoord();
+
+	_float fClosest = FLT_MAX;
+	_uint picked = 0;
+	for (_uint i = 1; i < m_vecTargets.size(); ++i)
+	{
+		CMesh* pMesh = m_vecTargets[i]->GetMesh();
+		const mat4x4* pWorld = m_vecTargets[i]->GetWorldMatrix();
+		if (nullptr == pMesh || nullptr == pWorld)
+			continue;
+
+		CTriangleBVH* pBVH = pMesh->GetTriangleBVH();
+		if (nullptr == pBVH)
+			continue;
+
+		// Distances along the local ray are scaled back to the world
+		mat4x4 matInv = inverse(*pWorld);
+		vec3 vLocalOrigin = vec3(matInv * vec4(vOrigin, 1.f));
+		vec3 vLocalDir = vec3(matInv * vec4(vDir, 0.f));
+		_float fScale = length(vLocalDir);
+		if (fScale <= 0.f)
+			continue;
+
+		CTriangleBVH::RAYHIT hit;
+		if (!pBVH->IntersectClosest(vLocalOrigin, vLocalDir / fScale, FLT_MAX, hit))
+			continue;
+
+		_float fDistance = hit.fDistance / fScale;
+		if (fDistance < fClosest)
+		{
+			fClosest = fDistance;
+			picked = i;
+		}
+	}
+
+	if (0 == picked)
+		return;
+
+	m_iTargetIndex = picked;
+	m_pDefaultCamera->SetTargetObject(m_vecTargets[m_iTargetIndex]);
+}
+
 // Saves camera position
 void SceneDungeon::SetDefaultCameraSavedPosition(vec3 vPos, vec3 vRot, vec3 target)
 {
@@ -314,7 +453,7 @@ void SceneDungeon::LoadObjects()
 			newDesc.rotation = qRot;
 			newDesc.linearVelocity = vec3(0.f);
 
-			iShape* shape = CPlaneShape::Create(eShapeType::Plane, iter->NORMAL, 0.f);
+			iShape* shape = m_pPFactory->CreatePlaneShape(iter->NORMAL, 0.f);
 
 			iRigidBody* rigidBody = m_pPFactory->CreateRigidBody(newDesc, shape);
 			newObject->SetRigidBody(rigidBody);
@@ -335,7 +474,7 @@ void SceneDungeon::LoadObjects()
 			newDesc.position = iter->POSITION;
 			newDesc.linearVelocity = vec3(0.f);
 
-			iShape* shape = CSphereShape::Create(eShapeType::Sphere, iter->SCALE.x);
+			iShape* shape = m_pPFactory->CreateSphereShape(iter->SCALE.x);
 
 			iRigidBody* rigidBody = m_pPFactory->CreateRigidBody(newDesc, shape);
 			newObject->SetRigidBody(rigidBody);
@@ -346,6 +485,10 @@ void SceneDungeon::LoadObjects()
 	}
 	vecObjects.clear();
 
+	if (nullptr == m_pTargetIndex)
+		m_pTargetIndex = CSpatialIndex::Create();
+	UpdateTargetIndex();
+
 	m_iTargetIndex = m_vecTargets.size() - 1;
 	m_pDefaultCamera->SetTargetObject(m_vecTargets[m_iTargetIndex]);
 
@@ -13,6 +13,8 @@ namespace Engine
 	class iPhysicsFactory;
 	class iPhysicsWorld;
 	class CRigidBody;
+	class CSpatialIndex;
+	struct sPhysicsProfile;
 }
 class UIManager;
 class DefaultCamera;
@@ -37,6 +39,9 @@ private:
 
 	std::vector<BGObject*>		m_vecTargets;
 	_uint						m_iTargetIndex;
+	Engine::CSpatialIndex*		m_pTargetIndex;		// Balls (m_vecTargets[1...]), rebuilt every frame
+	std::vector<glm::vec3>		m_vecTargetPos;
+	_bool						m_bShowPhysicsProfile;
 
 
 private:
@@ -51,8 +56,12 @@ public:
 	glm::vec3 GetCameraPos();
 	void CollisionCallback();
 	std::string GetCurrentTargetName();
+	const Engine::sPhysicsProfile* GetPhysicsProfile();
 private:
 	void KeyCheck();
+	void UpdateTargetIndex();
+	void SetNearestTarget();
+	void PickTarget();
 	void SetDefaultCameraSavedPosition(glm::vec3 vPos, glm::vec3 vRot, glm::vec3 target);
 	void ResetDefaultCameraPos();
 
@@ -4,6 +4,7 @@
 #include "OpenGLDevice.h"
 #include "Define.h"
 #include "SceneDungeon.h"
+#include "PhysicsProfile.h"
 
 #include <sstream>
 #include <iomanip>
@@ -48,10 +49,13 @@ void UIManager::RenderUI()
 	{
 		Text("Tab : Next Target");
 		Text("F1 : Remove Target");
+		Text("F5 : Nearest Target");
+		Text("Left Click : Pick Target");
 		Text(" ");
 		Text("WASD / Space : Move Target");
 		Text("F2 : Reset all objects");
 		Text("F3 : Apply random force to all objects");
+		Text("F4 : Show/Hide physics profile");
 		Text(" ");
 		Text("Move Mouse : Rotate Camera");
 		Text("Scroll Mouse Wheel : Zoom In/Out");
@@ -65,6 +69,20 @@ void UIManager::RenderUI()
 			PushStyleColor(ImGuiCol_Text, IM_COL32(0, 255, 0, 255));
 			Text(name.c_str());
 			PopStyleColor();
+
+			const sPhysicsProfile* pProfile = m_pScene->GetPhysicsProfile();
+			if (nullptr != pProfile)
+			{
+				Text(" ");
+				Text(" * Physics (last step)");
+				Text("Bodies : %u (awake %u, swept %u)", pProfile->iBodyCount, pProfile->iBodiesAwake, pProfile->iFastBodies);
+				Text("Pairs : %u tested, %u colliding", pProfile->iPairsTested, pProfile->iPairsColliding);
+				Text("Integrate : %.3f ms", pProfile->fIntegrateTime);
+				Text("Sweep : %.3f ms", pProfile->fSweepTime);
+				Text("Narrowphase : %.3f ms", pProfile->fNarrowphaseTime);
+				Text("Callback : %.3f ms", pProfile->fCallbackTime);
+				Text("Total : %.3f ms", pProfile->fTotalTime);
+			}
 		}
 	}
 	End();
@@ -1,4 +1,5 @@
 #include <crtdbg.h>
+#include <cstring>
 #include "Client.h"
 
 int main(int argc, char** argv)
@@ -11,6 +12,63 @@ int main(int argc, char** argv)
 	srand((unsigned int)time(NULL));
 
 	Client* pClient = new Client();
+
+	// -loadbench : time asset loading only, no window is created
+	if (argc > 1 && !strcmp(argv[1], "-loadbench"))
+	{
+		RESULT result = pClient->BenchmarkLoading();
+		pClient->Destroy();
+		return result;
+	}
+
+	// -lodbench : level of detail selection on many copies of every mesh, no window is created
+	if (argc > 1 && !strcmp(argv[1], "-lodbench"))
+	{
+		RESULT result = pClient->BenchmarkLOD();
+		pClient->Destroy();
+		return result;
+	}
+
+	// -texcook : write the compressed cache of every texture, no window is created
+	if (argc > 1 && !strcmp(argv[1], "-texcook"))
+	{
+		RESULT result = pClient->CookTextures();
+		pClient->Destroy();
+		return result;
+	}
+
+	// -meshconvert : write the binary cache of every mesh, no window is created
+	if (argc > 1 && !strcmp(argv[1], "-meshconvert"))
+	{
+		RESULT result = pClient->ConvertMeshes();
+		pClient->Destroy();
+		return result;
+	}
+
+	// -octreebench : octree builds over generated meshes of 10k to 5M triangles, no window is created
+	if (argc > 1 && !strcmp(argv[1], "-octreebench"))
+	{
+		RESULT result = pClient->BenchmarkOctree();
+		pClient->Destroy();
+		return result;
+	}
+
+	// -raybench : line of sight queries against a generated mesh, scalar and packet paths must agree, no window is created
+	if (argc > 1 && !strcmp(argv[1], "-raybench"))
+	{
+		RESULT result = pClient->BenchmarkRays();
+		pClient->Destroy();
+		return result;
+	}
+
+	// -knnbench : neighbour queries of many agents over a k-d tree, checked by brute force, no window is created
+	if (argc > 1 && !strcmp(argv[1], "-knnbench"))
+	{
+		RESULT result = pClient->BenchmarkKNN();
+		pClient->Destroy();
+		return result;
+	}
+
 	RESULT result = pClient->Ready();
 	if (result != PK_NOERROR) return result;
 
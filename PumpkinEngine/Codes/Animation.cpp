@@ -1,17 +1,123 @@
 #include "pch.h"
 #include "..\Headers\Animation.h"
+#include "..\Headers\MappedFile.h"
 #include "..\Headers\OpenGLDefines.h"
-#include <windows.h>
+#include <fstream>
+#include <algorithm>
+#include <cfloat>
 
 
 USING(Engine)
 USING(std)
 USING(glm)
 
+#define ANIMATION_CLIP_MAGIC        0x50494C43      // "CLIP"
+#define ANIMATION_CLIP_VERSION      2
+#define ANIMATION_CLIP_ALIGN        16
+
+typedef struct sClipTrack
+{
+    _uint           iKeyNum;
+    _uint           iFrameOffset;       // Key frames (_ushort, increasing, the first one is 0)
+    _uint           iValueOffset;       // vec3 for translation and scale, QUANTQUAT for rotation
+}CLIPTRACK;
+
+// Binary clip header, every array starts at a 16 byte aligned offset so it can be used in place when mapped
+typedef struct sAnimationClipHeader
+{
+    _uint           iMagic;
+    _uint           iVersion;
+    _ulonglong      iSourceHash;        // Hash of the .animation file
+    _uint           iDuration;          // Frames
+    _float          fTickPerSec;
+    CLIPTRACK       Tracks[3];          // Translation, rotation, scale
+    _uint           iMatrixOffset;      // Source matrices (one per frame), 0 when the tracks rebuild every frame
+    _uint           iFileSize;
+}CLIPHEADER;
+
+static const size_t s_TrackValueSize[3] = { sizeof(vec3), sizeof(CAnimation::QUANTQUAT), sizeof(vec3) };
+
+static _uint AlignClipOffset(size_t offset)
+{
+    return (_uint)((offset + ANIMATION_CLIP_ALIGN - 1) & ~(size_t)(ANIMATION_CLIP_ALIGN - 1));
+}
+
+// Angle between two rotations
+static _float RotationDistance(const quat& a, const quat& b)
+{
+    quat d = conjugate(a) * b;
+    return 2.f * asin(glm::min(1.f, length(vec3(d.x, d.y, d.z))));
+}
+
+// Keys to keep so that linear interpolation between them rebuilds every frame within the tolerance
+// A segment is extended from its first key for as long as every frame it skips still fits
+template <typename T, typename LERP, typename DISTANCE>
+static void FitKeys(const vector<T>& vecValues, LERP lerp, DISTANCE distance, _float tolerance, vector<_ushort>& vecFrames)
+{
+    _uint count = (_uint)vecValues.size();
+    vecFrames.clear();
+    vecFrames.push_back(0);
+
+    _uint start = 0;
+    while (start + 1 < count)
+    {
+        _uint end = start + 1;
+        while (end + 1 < count)
+        {
+            _uint next = end + 1;
+            _bool fits = true;
+            for (_uint frame = start + 1; fits && frame < next; ++frame)
+            {
+                _float t = (_float)(frame - start) / (next - start);
+                fits = distance(lerp(vecValues[start], vecValues[next], t), vecValues[frame]) <= tolerance;
+            }
+            if (!fits)
+                break;
+            end = next;
+        }
+        vecFrames.push_back((_ushort)end);
+        start = end;
+    }
+
+    // A track that never moves keeps a single key
+    if (2 == vecFrames.size() && distance(vecValues[0], vecValues[count - 1]) <= tolerance)
+        vecFrames.pop_back();
+}
+
+// Copy the source matrices to the end of the clip, for clips the tracks can not rebuild
+static void AppendSourceMatrices(const _uchar* pMatrices, _uint duration, vector<_uchar>& vecClip)
+{
+    _uint offset = AlignClipOffset(vecClip.size());
+    vecClip.resize(offset + sizeof(mat4x4) * (size_t)duration, 0);
+    memcpy(vecClip.data() + offset, pMatrices, sizeof(mat4x4) * (size_t)duration);
+
+    CLIPHEADER* pHeader = reinterpret_cast<CLIPHEADER*>(vecClip.data());
+    pHeader->iMatrixOffset = offset;
+    pHeader->iFileSize = (_uint)vecClip.size();
+}
+
+// Key before the frame and the weight of the one after it
+static _uint FindKey(const _ushort* pFrames, _uint keyNum, _float frame, _float& weight)
+{
+    weight = 0.f;
+    _uint key = (_uint)(upper_bound(pFrames, pFrames + keyNum, frame) - pFrames);
+    if (0 == key)
+        return 0;
+
+    --key;
+    if (key + 1 < keyNum)
+        weight = (frame - pFrames[key]) / (_float)(pFrames[key + 1] - pFrames[key]);
+
+    return key;
+}
+
 CAnimation::CAnimation()
-    : m_tag(""), m_iDuration(0), m_fTickPerSec(0.f)
+    : m_tag(""), m_pClipFile(nullptr), m_iDuration(0), m_fTickPerSec(0.f)
+    , m_pTranslations(nullptr), m_pRotations(nullptr), m_pScales(nullptr), m_pMatrices(nullptr)
 {
-    m_vecMatrix.clear();
+    m_vecClip.clear();
+    memset(m_iKeyNum, 0, sizeof(m_iKeyNum));
+    memset(m_pKeyFrames, 0, sizeof(m_pKeyFrames));
 }
 
 CAnimation::~CAnimation()
@@ -20,7 +126,9 @@ CAnimation::~CAnimation()
 
 void CAnimation::Destroy()
 {
-    m_vecMatrix.clear();
+    SafeDestroy(m_pClipFile);
+    m_pClipFile = nullptr;
+    m_vecClip.clear();
 }
 
 void CAnimation::FrameMove(_float& curTime, _uint& frameIdx, _bool reverse, function<void(void)> callback)
@@ -30,7 +138,7 @@ void CAnimation::FrameMove(_float& curTime, _uint& frameIdx, _bool reverse, func
         curTime = 0.f;
         if (!reverse)
         {
-            if (frameIdx >= m_vecMatrix.size() - 1)
+            if (frameIdx >= m_iDuration - 1)
             {
                 frameIdx = 0;
                 callback();
@@ -42,7 +150,7 @@ void CAnimation::FrameMove(_float& curTime, _uint& frameIdx, _bool reverse, func
         {
             if (0 == frameIdx)
             {
-                frameIdx = m_vecMatrix.size() - 1;
+                frameIdx = m_iDuration - 1;
                 callback();
             }
             else
@@ -51,32 +159,316 @@ void CAnimation::FrameMove(_float& curTime, _uint& frameIdx, _bool reverse, func
     }
 }
 
+// The source matrix when the clip kept them, otherwise rebuilt from the tracks (see ANIMATION_MATRIX_TOLERANCE)
 mat4x4 CAnimation::GetMatrix(_uint iFrameIndex)
 {
-    return m_vecMatrix[iFrameIndex];
+    if (nullptr != m_pMatrices && 0 < m_iDuration)
+        return m_pMatrices[glm::min(iFrameIndex, m_iDuration - 1)];
+
+    return Sample((_float)iFrameIndex);
+}
+
+// Pose at any point of the clip, frame may fall between two frames
+// Clips that kept their source matrices blend the two frames around it
+mat4x4 CAnimation::Sample(_float frame)
+{
+    if (0 == m_iDuration)
+        return mat4x4(1.f);
+    frame = glm::clamp(frame, 0.f, (_float)(m_iDuration - 1));
+
+    if (nullptr != m_pMatrices)
+    {
+        _uint first = (_uint)frame;
+        _float weight = frame - first;
+        if (0.f == weight)
+            return m_pMatrices[first];
+        return m_pMatrices[first] * (1.f - weight) + m_pMatrices[glm::min(first + 1, m_iDuration - 1)] * weight;
+    }
+
+    _float weight = 0.f;
+    _uint key = FindKey(m_pKeyFrames[TRACK_TRANSLATION], m_iKeyNum[TRACK_TRANSLATION], frame, weight);
+    vec3 vPos = 0.f == weight ? m_pTranslations[key] : mix(m_pTranslations[key], m_pTranslations[key + 1], weight);
+
+    key = FindKey(m_pKeyFrames[TRACK_ROTATION], m_iKeyNum[TRACK_ROTATION], frame, weight);
+    quat qRot = DequantizeQuat(m_pRotations[key]);
+    if (0.f != weight)
+        qRot = slerp(qRot, DequantizeQuat(m_pRotations[key + 1]), weight);
+
+    key = FindKey(m_pKeyFrames[TRACK_SCALE], m_iKeyNum[TRACK_SCALE], frame, weight);
+    vec3 vScale = 0.f == weight ? m_pScales[key] : mix(m_pScales[key], m_pScales[key + 1], weight);
+
+    mat4x4 matPose = mat4_cast(qRot);
+    matPose[0] *= vScale.x;
+    matPose[1] *= vScale.y;
+    matPose[2] *= vScale.z;
+    matPose[3] = vec4(vPos, 1.f);
+
+    return matPose;
+}
+
+// Every frame of the tracks against the source matrices (duration matrices), columns may differ by
+// ANIMATION_MATRIX_TOLERANCE relative to their length, shear or a projective row never fits
+_bool CAnimation::RebuildsSource(const _uchar* pMatrices)
+{
+    for (_uint i = 0; i < m_iDuration; ++i)
+    {
+        mat4x4 matSource;
+        memcpy(&matSource, pMatrices + sizeof(mat4x4) * i, sizeof(mat4x4));
+        mat4x4 matPose = Sample((_float)i);
+
+        for (_uint column = 0; column < 4; ++column)
+        {
+            if (distance(matPose[column], matSource[column]) > ANIMATION_MATRIX_TOLERANCE * glm::max(1.f, length(matSource[column])))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+_uint CAnimation::GetKeyNumber()
+{
+    return m_iKeyNum[TRACK_TRANSLATION] + m_iKeyNum[TRACK_ROTATION] + m_iKeyNum[TRACK_SCALE];
 }
 
+// Smallest three quaternion : the largest component is dropped (index in the low 2 bits), the others take 15 bits each
+CAnimation::QUANTQUAT CAnimation::QuantizeQuat(const quat& q)
+{
+    const _float components[4] = { q.x, q.y, q.z, q.w };
+    _uint largest = 0;
+    for (_uint i = 1; i < 4; ++i)
+    {
+        if (abs(components[i]) > abs(components[largest]))
+            largest = i;
+    }
+
+    // q and -q are the same rotation, the dropped component is rebuilt as positive
+    _float sign = components[largest] < 0.f ? -1.f : 1.f;
+    _ulonglong bits = largest;
+    _uint shift = 2;
+    for (_uint i = 0; i < 4; ++i)
+    {
+        if (largest == i)
+            continue;
+
+        // The other components are within +-1/sqrt(2)
+        _float value = glm::clamp(components[i] * sign * 1.41421356f, -1.f, 1.f);
+        bits |= (_ulonglong)(value * 16383.5f + 16383.5f + 0.5f) << shift;
+        shift += 15;
+    }
+
+    QUANTQUAT result;
+    result.iPacked[0] = (_ushort)(bits & 0xFFFF);
+    result.iPacked[1] = (_ushort)((bits >> 16) & 0xFFFF);
+    result.iPacked[2] = (_ushort)((bits >> 32) & 0xFFFF);
+
+    return result;
+}
+
+quat CAnimation::DequantizeQuat(const QUANTQUAT& q)
+{
+    _ulonglong bits = (_ulonglong)q.iPacked[0] | ((_ulonglong)q.iPacked[1] << 16) | ((_ulonglong)q.iPacked[2] << 32);
+    _uint largest = (_uint)(bits & 3);
+
+    _float components[4];
+    _float sum = 0.f;
+    _uint shift = 2;
+    for (_uint i = 0; i < 4; ++i)
+    {
+        if (largest == i)
+            continue;
+
+        components[i] = (((bits >> shift) & 0x7FFF) / 16383.5f - 1.f) * 0.70710678f;
+        sum += components[i] * components[i];
+        shift += 15;
+    }
+    components[largest] = sqrt(glm::max(0.f, 1.f - sum));
+
+    return normalize(quat(components[3], components[0], components[1], components[2]));
+}
+
+// The clip next to the file is mapped when it was converted from the same file, otherwise it is converted and saved there
 RESULT CAnimation::Ready(string tag, string filePath)
 {
-    wstring wstr = wstring(filePath.begin(), filePath.end());
-    HANDLE hFile = CreateFile(wstr.c_str()
-        , GENERIC_READ
-        , 0
-        , NULL
-        , OPEN_EXISTING
-        , FILE_ATTRIBUTE_NORMAL
-        , NULL);
-    unsigned long dwByte;
-
-    bool success = false;
-    success = ReadFile(hFile, &m_iDuration, sizeof(_uint), &dwByte, NULL);
-    success = ReadFile(hFile, &m_fTickPerSec, sizeof(_float), &dwByte, NULL);
-
-    for (int i = 0; i < m_iDuration; ++i)
+    m_tag = tag;
+
+    CMappedFile* pSource = CMappedFile::Create(filePath);
+    if (nullptr == pSource)
+        return PK_ERROR;
+
+    _ulonglong sourceHash = CMappedFile::HashBytes(pSource->GetData(), pSource->GetSize());
+    string clipPath = filePath + ".clip";
+
+    m_pClipFile = CMappedFile::Create(clipPath);
+    if (nullptr != m_pClipFile)
+    {
+        if (PK_NOERROR == BindClip(m_pClipFile->GetData(), m_pClipFile->GetSize(), sourceHash))
+        {
+            SafeDestroy(pSource);
+            return PK_NOERROR;
+        }
+        SafeDestroy(m_pClipFile);
+        m_pClipFile = nullptr;
+    }
+
+    RESULT result = ConvertAnimation(pSource->GetData(), pSource->GetSize(), sourceHash, m_vecClip);
+    if (PK_NOERROR == result)
+        result = BindClip(m_vecClip.data(), m_vecClip.size(), sourceHash);
+
+    // A clip the tracks do not rebuild (shear, or a frame past the tolerance) keeps its source matrices as well
+    const _uchar* pMatrices = pSource->GetData() + sizeof(_uint) + sizeof(_float);
+    if (PK_NOERROR == result && !RebuildsSource(pMatrices))
+    {
+        AppendSourceMatrices(pMatrices, m_iDuration, m_vecClip);
+        result = BindClip(m_vecClip.data(), m_vecClip.size(), sourceHash);
+    }
+    SafeDestroy(pSource);
+    if (PK_NOERROR != result)
+        return result;
+
+    // Saved for the next run, this one keeps the converted copy
+    ofstream file(clipPath, ios::binary | ios::trunc);
+    if (file.is_open())
+        file.write(reinterpret_cast<const char*>(m_vecClip.data()), m_vecClip.size());
+
+    return PK_NOERROR;
+}
+
+// Point the tracks into a clip, fails when it is from another version or converted from another file
+RESULT CAnimation::BindClip(const _uchar* pData, size_t size, _ulonglong sourceHash)
+{
+    const CLIPHEADER* pHeader = reinterpret_cast<const CLIPHEADER*>(pData);
+    _bool valid = size >= sizeof(CLIPHEADER)
+        && ANIMATION_CLIP_MAGIC == pHeader->iMagic && ANIMATION_CLIP_VERSION == pHeader->iVersion
+        && sourceHash == pHeader->iSourceHash && size == pHeader->iFileSize && 0 < pHeader->iDuration;
+
+    // Arrays in bounds and aligned, key frames increasing from 0 and inside the clip
+    for (_uint i = 0; valid && i < TRACK_END; ++i)
     {
-        mat4x4 mat(1.f);
-        success = ReadFile(hFile, &mat, sizeof(mat4x4), &dwByte, NULL);
-        m_vecMatrix.push_back(mat);
+        const CLIPTRACK& track = pHeader->Tracks[i];
+        valid = 0 < track.iKeyNum && pHeader->iDuration >= track.iKeyNum
+            && track.iFrameOffset >= sizeof(CLIPHEADER) && track.iValueOffset >= sizeof(CLIPHEADER)
+            && (size_t)track.iFrameOffset + sizeof(_ushort) * track.iKeyNum <= size
+            && (size_t)track.iValueOffset + s_TrackValueSize[i] * track.iKeyNum <= size
+            && 0 == (track.iFrameOffset | track.iValueOffset) % ANIMATION_CLIP_ALIGN;
+
+        const _ushort* pFrames = reinterpret_cast<const _ushort*>(pData + track.iFrameOffset);
+        for (_uint key = 0; valid && key < track.iKeyNum; ++key)
+            valid = (0 == key ? 0 == pFrames[key] : pFrames[key - 1] < pFrames[key]) && pFrames[key] < pHeader->iDuration;
+    }
+
+    valid = valid && (0 == pHeader->iMatrixOffset
+        || (pHeader->iMatrixOffset >= sizeof(CLIPHEADER) && 0 == pHeader->iMatrixOffset % ANIMATION_CLIP_ALIGN
+            && (size_t)pHeader->iMatrixOffset + sizeof(mat4x4) * pHeader->iDuration <= size));
+
+    if (!valid)
+        return PK_ERROR;
+
+    m_iDuration = pHeader->iDuration;
+    m_fTickPerSec = pHeader->fTickPerSec;
+    for (_uint i = 0; i < TRACK_END; ++i)
+    {
+        m_iKeyNum[i] = pHeader->Tracks[i].iKeyNum;
+        m_pKeyFrames[i] = reinterpret_cast<const _ushort*>(pData + pHeader->Tracks[i].iFrameOffset);
+    }
+    m_pTranslations = reinterpret_cast<const vec3*>(pData + pHeader->Tracks[TRACK_TRANSLATION].iValueOffset);
+    m_pRotations = reinterpret_cast<const QUANTQUAT*>(pData + pHeader->Tracks[TRACK_ROTATION].iValueOffset);
+    m_pScales = reinterpret_cast<const vec3*>(pData + pHeader->Tracks[TRACK_SCALE].iValueOffset);
+    m_pMatrices = 0 == pHeader->iMatrixOffset ? nullptr : reinterpret_cast<const mat4x4*>(pData + pHeader->iMatrixOffset);
+
+    return PK_NOERROR;
+}
+
+// Read the raw frames (duration, tick, one matrix per frame) and build the clip
+// Every matrix is split into translation, rotation and scale (shear is lost, Ready checks the result), then each track
+// keeps the keys it needs
+RESULT CAnimation::ConvertAnimation(const _uchar* pSource, size_t sourceSize, _ulonglong sourceHash, vector<_uchar>& vecClip)
+{
+    if (sourceSize < sizeof(_uint) + sizeof(_float))
+        return PK_ERROR;
+
+    _uint duration = 0;
+    _float tickPerSec = 0.f;
+    memcpy(&duration, pSource, sizeof(_uint));
+    memcpy(&tickPerSec, pSource + sizeof(_uint), sizeof(_float));
+
+    // Key frames are stored in 16 bits
+    const _uchar* pMatrices = pSource + sizeof(_uint) + sizeof(_float);
+    if (0 == duration || 65536 < duration || sourceSize < sizeof(_uint) + sizeof(_float) + sizeof(mat4x4) * (size_t)duration)
+        return PK_ERROR;
+
+    vector<vec3> vecPos(duration);
+    vector<quat> vecRot(duration);
+    vector<vec3> vecScale(duration);
+    for (_uint i = 0; i < duration; ++i)
+    {
+        mat4x4 matFrame;
+        memcpy(&matFrame, pMatrices + sizeof(mat4x4) * i, sizeof(mat4x4));
+
+        vec3 vScale(length(vec3(matFrame[0])), length(vec3(matFrame[1])), length(vec3(matFrame[2])));
+        if (determinant(mat3(matFrame)) < 0.f)
+            vScale.x = -vScale.x;
+
+        quat qRot(1.f, 0.f, 0.f, 0.f);
+        if (FLT_EPSILON < abs(vScale.x) && FLT_EPSILON < vScale.y && FLT_EPSILON < vScale.z)
+            qRot = normalize(quat_cast(mat3(vec3(matFrame[0]) / vScale.x, vec3(matFrame[1]) / vScale.y, vec3(matFrame[2]) / vScale.z)));
+
+        // Neighbouring keys on the same hemisphere so interpolation takes the short way
+        if (0 < i && dot(vecRot[i - 1], qRot) < 0.f)
+            qRot = -qRot;
+
+        vecPos[i] = vec3(matFrame[3]);
+        vecRot[i] = qRot;
+        vecScale[i] = vScale;
+    }
+
+    vector<_ushort> vecFrames[TRACK_END];
+    auto lerpVec3 = [](const vec3& a, const vec3& b, _float t) { return mix(a, b, t); };
+    auto distanceVec3 = [](const vec3& a, const vec3& b) { return distance(a, b); };
+    FitKeys(vecPos, lerpVec3, distanceVec3, ANIMATION_TRANSLATION_TOLERANCE, vecFrames[TRACK_TRANSLATION]);
+    FitKeys(vecRot, [](const quat& a, const quat& b, _float t) { return slerp(a, b, t); }, RotationDistance,
+        ANIMATION_ROTATION_TOLERANCE, vecFrames[TRACK_ROTATION]);
+    FitKeys(vecScale, lerpVec3, distanceVec3, ANIMATION_SCALE_TOLERANCE, vecFrames[TRACK_SCALE]);
+
+    CLIPHEADER header;
+    memset(&header, 0, sizeof(CLIPHEADER));
+    header.iMagic = ANIMATION_CLIP_MAGIC;
+    header.iVersion = ANIMATION_CLIP_VERSION;
+    header.iSourceHash = sourceHash;
+    header.iDuration = duration;
+    header.fTickPerSec = tickPerSec;
+
+    size_t offset = sizeof(CLIPHEADER);
+    for (_uint i = 0; i < TRACK_END; ++i)
+    {
+        CLIPTRACK& track = header.Tracks[i];
+        track.iKeyNum = (_uint)vecFrames[i].size();
+        track.iFrameOffset = AlignClipOffset(offset);
+        track.iValueOffset = AlignClipOffset(track.iFrameOffset + sizeof(_ushort) * track.iKeyNum);
+        offset = track.iValueOffset + s_TrackValueSize[i] * track.iKeyNum;
+    }
+    header.iFileSize = (_uint)offset;
+
+    vecClip.assign(offset, 0);
+    _uchar* pClip = vecClip.data();
+    memcpy(pClip, &header, sizeof(CLIPHEADER));
+    for (_uint i = 0; i < TRACK_END; ++i)
+    {
+        const CLIPTRACK& track = header.Tracks[i];
+        memcpy(pClip + track.iFrameOffset, vecFrames[i].data(), sizeof(_ushort) * track.iKeyNum);
+
+        for (_uint key = 0; key < track.iKeyNum; ++key)
+        {
+            _uint frame = vecFrames[i][key];
+            _uchar* pValue = pClip + track.iValueOffset + s_TrackValueSize[i] * key;
+            if (TRACK_ROTATION == i)
+            {
+                QUANTQUAT q = QuantizeQuat(vecRot[frame]);
+                memcpy(pValue, &q, sizeof(QUANTQUAT));
+            }
+            else
+                memcpy(pValue, TRACK_TRANSLATION == i ? &vecPos[frame] : &vecScale[frame], sizeof(vec3));
+        }
     }
 
     return PK_NOERROR;
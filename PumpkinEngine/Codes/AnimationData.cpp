@@ -1,7 +1,9 @@
 #include "pch.h"
 #include "..\Headers\AnimationData.h"
 #include "..\Headers\Animation.h"
+#include "..\Headers\ParallelFor.h"
 #include <fstream>
+#include <algorithm>
 
 
 USING(Engine)
@@ -40,6 +42,7 @@ CAnimation* CAnimationData::FindAnimation(string tag)
 	return nullptr;
 }
 
+// Load every clip of the list, the clips are read (and converted when needed) in parallel
 void CAnimationData::LoadAnimations(string assetFolderPath)
 {
 	string listFilePath = assetFolderPath + "Animation\\animList.txt";
@@ -50,22 +53,30 @@ void CAnimationData::LoadAnimations(string assetFolderPath)
 
 	const _uint BUFFER_SIZE = 1000;
 	char textBuffer[BUFFER_SIZE];
-	_bool keepReading = true;
+	vector<string> vecTags;
 
-	while (keepReading)
+	while (file.getline(textBuffer, BUFFER_SIZE))
 	{
-		file.getline(textBuffer, BUFFER_SIZE);
-
 		if (!strcmp("EOF", textBuffer))
-		{
-			keepReading = false;
-			continue;
-		}
+			break;
 
+		// A clip listed twice would be converted twice at the same time
 		string tag(textBuffer);
-		string animPath = assetFolderPath + "Animation\\" + tag + ".animation";
-		CAnimation* pAnim = CAnimation::Create(tag, animPath);
-		if (nullptr != pAnim)
-			AddAnimation(tag, pAnim);
+		if (find(vecTags.begin(), vecTags.end(), tag) == vecTags.end())
+			vecTags.push_back(tag);
+	}
+
+	_uint count = (_uint)vecTags.size();
+	vector<CAnimation*> vecAnims(count, nullptr);
+	ParallelFor(count, 1, [&](_uint begin, _uint end, _uint worker)
+	{
+		for (_uint i = begin; i < end; ++i)
+			vecAnims[i] = CAnimation::Create(vecTags[i], assetFolderPath + "Animation\\" + vecTags[i] + ".animation");
+	});
+
+	for (_uint i = 0; i < count; ++i)
+	{
+		if (nullptr != vecAnims[i])
+			AddAnimation(vecTags[i], vecAnims[i]);
 	}
 }
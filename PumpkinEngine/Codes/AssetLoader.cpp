@@ -0,0 +1,125 @@
+#include "pch.h"
+#include "..\Headers\AssetLoader.h"
+#include "..\Headers\ParallelFor.h"
+
+
+USING(Engine)
+USING(std)
+
+CAssetLoader::CAssetLoader()
+	: m_iNextLoad(0), m_iWorkerCount(0), m_bNullBackend(false)
+{
+	m_vecJobs.clear();
+	m_vecLoaded.clear();
+}
+
+CAssetLoader::~CAssetLoader()
+{
+}
+
+// Call instead of destructor to manage class internal data
+void CAssetLoader::Destroy()
+{
+	m_vecJobs.clear();
+	m_vecLoaded.clear();
+}
+
+void CAssetLoader::AddJob(STAGE load, STAGE upload, STAGE release)
+{
+	ASSETJOB job;
+	job.load = load;
+	job.upload = upload;
+	job.release = release;
+	m_vecJobs.push_back(job);
+}
+
+// Load every job on the workers and upload them on the calling thread, returns when all of them are done
+void CAssetLoader::Run()
+{
+	_uint count = (_uint)m_vecJobs.size();
+	if (0 == count)
+		return;
+
+	m_vecLoaded.assign(count, 0);
+	m_iNextLoad = 0;
+
+	_uint workerCount = 0 == m_iWorkerCount ? GetParallelWorkerCount() : m_iWorkerCount;
+	if (workerCount > count)
+		workerCount = count;
+
+	// The calling thread is one of the workers
+	vector<future<void>> tasks;
+	tasks.reserve(workerCount - 1);
+	for (_uint worker = 1; worker < workerCount; ++worker)
+		tasks.push_back(async(launch::async, [this]() { while (LoadNext()); }));
+
+	for (_uint i = 0; i < count; ++i)
+	{
+		// Keep loading until the next job in order is ready, then wait for whoever has it
+		while (!IsLoaded(i) && LoadNext())
+			continue;
+		if (!IsLoaded(i))
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_cvLoaded.wait(lock, [&]() { return 0 != m_vecLoaded[i]; });
+		}
+
+		ASSETJOB& job = m_vecJobs[i];
+		if (!m_bNullBackend && job.upload)
+			job.upload();
+		if (job.release)
+			job.release();
+	}
+
+	for (size_t i = 0; i < tasks.size(); ++i)
+		tasks[i].get();
+
+	m_vecJobs.clear();
+	m_vecLoaded.clear();
+}
+
+// Load the next unclaimed job, false when there is none left
+_bool CAssetLoader::LoadNext()
+{
+	_uint index = m_iNextLoad++;
+	if (index >= m_vecJobs.size())
+		return false;
+
+	if (m_vecJobs[index].load)
+		m_vecJobs[index].load();
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_vecLoaded[index] = 1;
+	}
+	m_cvLoaded.notify_all();
+
+	return true;
+}
+
+_bool CAssetLoader::IsLoaded(_uint index)
+{
+	lock_guard<mutex> lock(m_mutex);
+	return 0 != m_vecLoaded[index];
+}
+
+// Initialize
+RESULT CAssetLoader::Ready()
+{
+	m_vecJobs.reserve(64);
+
+	return PK_NOERROR;
+}
+
+// Create an instance
+CAssetLoader* CAssetLoader::Create()
+{
+	CAssetLoader* pInstance = new CAssetLoader();
+	if (PK_NOERROR != pInstance->Ready())
+	{
+		pInstance->Destroy();
+		pInstance = nullptr;
+	}
+
+	return pInstance;
+}
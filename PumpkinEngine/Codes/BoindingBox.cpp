@@ -13,7 +13,7 @@ USING(glm)
 USING(std)
 
 CBoundingBox::CBoundingBox()
-	: m_pVIBuffer(nullptr), m_pVertices(nullptr)
+	: m_pVIBuffer(nullptr)
 	, m_vCenter(vec3(0.f)), m_vHalfExtents(vec3(0.f))
 	, m_vMin(vec3(0.f)), m_vMax(vec3(0.f)), m_vMinWorld(vec3(0.f)), m_vMaxWorld(vec3(0.f))
 	, m_pOpenGLDevice(COpenGLDevice::GetInstance())
@@ -25,9 +25,12 @@ CBoundingBox::CBoundingBox()
 }
 
 CBoundingBox::CBoundingBox(const CBoundingBox& rhs)
-	: m_pVIBuffer(rhs.m_pVIBuffer), m_pVertices(rhs.m_pVertices)
+	: m_pVIBuffer(rhs.m_pVIBuffer)
 	, m_vCenter(rhs.m_vCenter), m_vHalfExtents(rhs.m_vHalfExtents)
-	, m_vMin(rhs.m_vMin), m_vMax(rhs.m_vMax), m_vMinWorld(rhs.m_vMinWorld), m_vMaxWorld(rhs.m_vMaxWorld)
+	, m_vMin(rhs.m_vMin), m_vMax(rhs.m_vMax)
+	, m_vOriginCenter(rhs.m_vOriginCenter), m_vOriginHalfExtents(rhs.m_vOriginHalfExtents)
+	, m_vOriginMin(rhs.m_vOriginMin), m_vOriginMax(rhs.m_vOriginMax)
+	, m_vMinWorld(rhs.m_vMinWorld), m_vMaxWorld(rhs.m_vMaxWorld)
 	, m_pOpenGLDevice(rhs.m_pOpenGLDevice)
 	, m_pShader(rhs.m_pShader)
 	, m_pParentTransform(nullptr)
@@ -88,10 +91,20 @@ void CBoundingBox::RenderWithParent(CTransform* parent)
 		m_pVIBuffer->Render();
 }
 
+// Render bounding box with the given world matrix
+void CBoundingBox::RenderWithMatrix(const mat4x4& matWorld)
+{
+	const mat4x4 matView = m_pOpenGLDevice->GetViewMatrix();
+	const mat4x4 matProj = m_pOpenGLDevice->GetProjMatrix();
+	m_pShader->SetMatrixInfo(matWorld, matView, matProj);
+
+	if (nullptr != m_pVIBuffer)
+		m_pVIBuffer->Render();
+}
+
 // Call instead of destructor to manage class internal data
 void CBoundingBox::Destroy()
 {
-	delete[] m_pVertices;
 	SafeDestroy(m_pVIBuffer);
 	SafeDestroy(m_pOpenGLDevice);
 	SafeDestroy(m_pShader);
@@ -106,13 +119,13 @@ void CBoundingBox::UpdateBoundingBox(mat4x4& parentWorldMatrix)
 	m_vMax = vec3(-100000.f);
 	m_vMin = vec3(100000.f);
 
+	vec3 corners[8];
+	GetCorners(corners);
+
 	vec3 tempPos;
-	mat4x4 matWorld = mat4x4(1.f);
 	for (int i = 0; i < 8; ++i)
 	{
-		matWorld[3] = m_pVertices[i].vPos;
-		matWorld = parentWorldMatrix * matWorld;
-		tempPos = matWorld[3];
+		tempPos = parentWorldMatrix * vec4(corners[i], 1.f);
 
 		if (tempPos.x > m_vMax.x)
 			m_vMax.x = tempPos.x;
@@ -137,6 +150,32 @@ void CBoundingBox::UpdateBoundingBox(mat4x4& parentWorldMatrix)
 	m_vCenter = m_vMin + m_vHalfExtents;
 }
 
+// The 8 corners of the original box, in the order the box buffer uses
+void CBoundingBox::GetCorners(vec3* pCorners)
+{
+	pCorners[0] = vec3(m_vOriginMin.x, m_vOriginMax.y, m_vOriginMax.z);
+	pCorners[1] = vec3(m_vOriginMin.x, m_vOriginMax.y, m_vOriginMin.z);
+	pCorners[2] = vec3(m_vOriginMax.x, m_vOriginMax.y, m_vOriginMin.z);
+	pCorners[3] = vec3(m_vOriginMax.x, m_vOriginMax.y, m_vOriginMax.z);
+	pCorners[4] = vec3(m_vOriginMin.x, m_vOriginMin.y, m_vOriginMax.z);
+	pCorners[5] = vec3(m_vOriginMin.x, m_vOriginMin.y, m_vOriginMin.z);
+	pCorners[6] = vec3(m_vOriginMax.x, m_vOriginMin.y, m_vOriginMin.z);
+	pCorners[7] = vec3(m_vOriginMax.x, m_vOriginMin.y, m_vOriginMax.z);
+}
+
+// Refresh m_vMinWorld/m_vMaxWorld, the world-space box around the original box
+void CBoundingBox::UpdateWorldBounds(const mat4x4& matWorld)
+{
+	// Transformed center, extents projected onto the world axes
+	vec3 vCenter = vec3(matWorld * vec4(m_vOriginCenter, 1.f));
+	vec3 vHalf(0.f);
+	for (int i = 0; i < 3; ++i)
+		vHalf += abs(vec3(matWorld[i])) * m_vOriginHalfExtents[i];
+
+	m_vMinWorld = vCenter - vHalf;
+	m_vMaxWorld = vCenter + vHalf;
+}
+
 // Set bounding box color
 void CBoundingBox::SetColor(glm::vec3 vColor)
 {
@@ -166,16 +205,13 @@ RESULT CBoundingBox::Ready(vec3 min, vec3 max, string shaderID)
     _uint vertexNum = 8;
     _uint indexNum = 36;
 
-	m_pVertices = new VTX[vertexNum];
-    memset(m_pVertices, 0, sizeof(*m_pVertices));
-	m_pVertices[0].vPos = vec4(m_vMin.x, m_vMax.y, m_vMax.z, 1.f);
-	m_pVertices[1].vPos = vec4(m_vMin.x, m_vMax.y, m_vMin.z, 1.f);
-	m_pVertices[2].vPos = vec4(m_vMax.x, m_vMax.y, m_vMin.z, 1.f);
-	m_pVertices[3].vPos = vec4(m_vMax.x, m_vMax.y, m_vMax.z, 1.f);
-	m_pVertices[4].vPos = vec4(m_vMin.x, m_vMin.y, m_vMax.z, 1.f);
-	m_pVertices[5].vPos = vec4(m_vMin.x, m_vMin.y, m_vMin.z, 1.f);
-	m_pVertices[6].vPos = vec4(m_vMax.x, m_vMin.y, m_vMin.z, 1.f);
-	m_pVertices[7].vPos = vec4(m_vMax.x, m_vMin.y, m_vMax.z, 1.f);
+	vec3 corners[8];
+	GetCorners(corners);
+
+	VTX vertices[8];
+	memset(vertices, 0, sizeof(vertices));
+	for (_uint i = 0; i < vertexNum; ++i)
+		vertices[i].vPos = vec4(corners[i], 1.f);
 
 	_uint* pIndices = new _uint[indexNum]
 	{
@@ -193,7 +229,7 @@ RESULT CBoundingBox::Ready(vec3 min, vec3 max, string shaderID)
 		5, 7, 6
 	};
 
-	m_pVIBuffer = CVIBuffer::Create(vertexNum, m_pVertices, indexNum, pIndices, xyz_index);
+	m_pVIBuffer = CVIBuffer::Create(vertexNum, vertices, indexNum, pIndices, xyz_index);
 	if (nullptr != m_pVIBuffer)
 		m_pVIBuffer->SetWireFrame(true);
 
@@ -5,6 +5,8 @@ USING(Engine)
 USING(std)
 USING(glm)
 
+POOLED_FUNCTION(CBoxShape)
+
 CBoxShape::CBoxShape()
     : m_vHalfExtents(vec3(0.f))
 {
@@ -18,6 +20,12 @@ void CBoxShape::Destroy()
 {
 }
 
+vec3 CBoxShape::GetLocalInertia(_float mass)
+{
+    vec3 sq = m_vHalfExtents * m_vHalfExtents;
+    return vec3(sq.y + sq.z, sq.x + sq.z, sq.x + sq.y) * (mass / 3.f);
+}
+
 RESULT CBoxShape::Ready(eShapeType type, vec3 vHalf)
 {
     m_shapeType = type;
@@ -10,6 +10,7 @@ USING(std)
 USING(glm)
 
 CCollisionHandler::CCollisionHandler()
+	: m_fCCDMotionRatio(0.5f), m_iPairsTested(0), m_iFastBodies(0)
 {
 }
 
@@ -24,6 +25,7 @@ void CCollisionHandler::Destroy()
 void CCollisionHandler::Collide(const _float& dt, std::vector<CRigidBody*>& bodies, std::vector<sColPair>& vecCols)
 {
 	_bool IsCollided = false;
+	m_iPairsTested = 0;
 
 	for (int idxA = 0; idxA < bodies.size(); ++idxA)
 	{
@@ -33,6 +35,7 @@ void CCollisionHandler::Collide(const _float& dt, std::vector<CRigidBody*>& bodi
 		{
 			CRigidBody* bodyB = bodies[idxB];
 			iShape* shapeB = bodyB->GetShape();
+			PHYSICS_PROFILE_COUNT(m_iPairsTested, 1);
 
 			switch (shapeA->GetShapeType())
 			{
@@ -81,6 +84,7 @@ void CCollisionHandler::Collide(const _float& dt, std::vector<CRigidBody*>& bodi
 
 			if (IsCollided)
 				vecCols.push_back(sColPair(bodyA, bodyB));
+			IsCollided = false;
 
 		}// for idxB
 	}// for idxA
@@ -88,7 +92,7 @@ void CCollisionHandler::Collide(const _float& dt, std::vector<CRigidBody*>& bodi
 
 _bool CCollisionHandler::CollideSphereSphere(const _float& dt, CRigidBody* bodyA, CSphereShape* sphereA, CRigidBody* bodyB, CSphereShape* sphereB)
 {
-	if (bodyA->IsStatic() && bodyB->IsStatic())
+	if (!bodyA->IsDynamic() && !bodyB->IsDynamic())
 		return false;
 
 	vec3 posA = bodyA->GetPosition();
@@ -131,6 +135,16 @@ _bool CCollisionHandler::CollideSphereSphere(const _float& dt, CRigidBody* bodyA
 	_float totalMass = massA + massB;
 	_float aFactor = massB / totalMass;
 	_float bFactor = massA / totalMass;
+	if (!bodyA->IsDynamic())
+	{
+		aFactor = 0.f;
+		bFactor = 1.f;
+	}
+	else if (!bodyB->IsDynamic())
+	{
+		aFactor = 1.f;
+		bFactor = 0.f;
+	}
 
 	vec3 aMomentum = linearVelocityA * massA;
 	vec3 bMomentum = linearVelocityB * massB;
@@ -149,12 +163,12 @@ _bool CCollisionHandler::CollideSphereSphere(const _float& dt, CRigidBody* bodyA
 		overlapDir = normalize(overlapDir);
 		overlapDir *= -overlap;
 
-		if (!bodyA->IsStatic())
+		if (bodyA->IsDynamic())
 		{
 			posA -= overlapDir * aFactor;
 			bodyA->SetPosition(posA);
 		}
-		if (!bodyB->IsStatic())
+		if (bodyB->IsDynamic())
 		{
 			posB += overlapDir * bFactor;
 			bodyB->SetPosition(posB);
@@ -165,6 +179,27 @@ _bool CCollisionHandler::CollideSphereSphere(const _float& dt, CRigidBody* bodyA
 	}
 	dir /= len;
 
+	if (!bodyA->IsDynamic() || !bodyB->IsDynamic())
+	{
+		// Static/kinematic side acts as infinite mass and carries its own velocity into the contact
+		CRigidBody* dynamicBody = bodyA->IsDynamic() ? bodyA : bodyB;
+		CRigidBody* drivingBody = bodyA->IsDynamic() ? bodyB : bodyA;
+		vec3 vNormal = (dynamicBody == bodyB) ? dir : -dir;
+
+		vec3 vVelocity = dynamicBody->GetLinearVelocity();
+		_float fApproach = dot(vVelocity - drivingBody->GetLinearVelocity(), vNormal);
+		if (0.f > fApproach)
+		{
+			vVelocity -= vNormal * fApproach * (1.f + dynamicBody->GetRestitution());
+			dynamicBody->SetLinearVelocity(vVelocity);
+		}
+
+		bodyA->VerletStep1(revDT);
+		bodyB->VerletStep1(revDT);
+
+		return true;
+	}
+
 	_float elasticity = 0.4f;
 
 	vec3 aElasticMomentum = dir * (length(aMomentum) * elasticity);
@@ -186,7 +221,7 @@ _bool CCollisionHandler::CollideSphereSphere(const _float& dt, CRigidBody* bodyA
 
 _bool CCollisionHandler::CollideSphereGroundPlane(const _float& dt, CRigidBody* sphereBody, CSphereShape* sphereShape, CRigidBody* planeBody, CPlaneShape* planeShape)
 {
-	if (sphereBody->IsStatic() && planeBody->IsStatic())
+	if (!sphereBody->IsDynamic())
 		return false;
 
 	vec3 vSpherePos = sphereBody->GetPosition();
@@ -284,47 +319,102 @@ _bool CCollisionHandler::CollideSphereGroundPlane(const _float& dt, CRigidBody*
 
 _bool CCollisionHandler::CollideSphereWallPlane(const _float& dt, CRigidBody* sphereBody, CSphereShape* sphereShape, CRigidBody* planeBody, CPlaneShape* planeShape)
 {
-	if (sphereBody->IsStatic() && planeBody->IsStatic())
+	if (!sphereBody->IsDynamic())
 		return false;
 
 	vec3 vSpherePos = sphereBody->GetPosition();
 	vec3 vNormal = planeShape->GetNormal();
 	_float fRadius = sphereShape->GetRadius();
-	vec3 vPlanePos = planeBody->GetPosition();
+	_float fDist = dot(vSpherePos, vNormal) - GetPlaneDotProduct(planeBody, planeShape);
 
-	_bool collision = false;
+	if (fDist >= fRadius)
+		return false;
 
-	if (vNormal.x > 0)
-	{
-		if (vSpherePos.x - fRadius < vPlanePos.x)
-			collision = true;
-	}
-	else if (vNormal.x < 0)
+	// Reflect only while moving into the wall, so a resting contact doesn't flip every step
+	// (relative to the wall, so kinematic walls push the sphere along)
+	vec3 vPlaneVelocity = planeBody->GetLinearVelocity();
+	vec3 vLinearVelocity = sphereBody->GetLinearVelocity() - vPlaneVelocity;
+	if (0.f > dot(vLinearVelocity, vNormal))
 	{
-		if (vSpherePos.x + fRadius > vPlanePos.x)
-			collision = true;
-	}
-	else if (vNormal.z > 0)
-	{
-		if (vSpherePos.z - fRadius < vPlanePos.z)
-			collision = true;
-	}
-	else if (vNormal.z < 0)
-	{
-		if (vSpherePos.z + fRadius > vPlanePos.z)
-			collision = true;
+		vLinearVelocity = reflect(vLinearVelocity, vNormal) + vPlaneVelocity;
+		sphereBody->SetLinearVelocity(vLinearVelocity);
 	}
 
-	if (collision)
+	vSpherePos += vNormal * (fRadius - fDist);
+	sphereBody->SetPosition(vSpherePos);
+
+	return true;
+}
+
+// Conservative advancement: pull fast spheres back to their first contact with a plane
+// so the discrete tests below resolve the hit instead of letting the body tunnel through
+void CCollisionHandler::SweepFastBodies(vector<CRigidBody*>& bodies)
+{
+	m_iFastBodies = 0;
+
+	for (int idxA = 0; idxA < bodies.size(); ++idxA)
 	{
-		vec3 vLinearVelocity = sphereBody->GetLinearVelocity();
-		vec3 ref = reflect(vLinearVelocity, vNormal);
-		vLinearVelocity = ref;
-		sphereBody->SetLinearVelocity(vLinearVelocity);
+		CRigidBody* sphereBody = bodies[idxA];
+		if (!sphereBody->IsDynamic() || eShapeType::Sphere != sphereBody->GetShape()->GetShapeType())
+			continue;
+
+		_float fRadius = static_cast<CSphereShape*>(sphereBody->GetShape())->GetRadius();
+		vec3 vPrevPos = sphereBody->GetPreviousPosition();
+		vec3 vMotion = sphereBody->GetPosition() - vPrevPos;
+		_float fLimit = fRadius * m_fCCDMotionRatio;
+		if (dot(vMotion, vMotion) <= fLimit * fLimit)
+			continue; // Slow body, the discrete test is enough
+		PHYSICS_PROFILE_COUNT(m_iFastBodies, 1);
+
+		_float fFirstTOI = 1.f;
+		for (int idxB = 0; idxB < bodies.size(); ++idxB)
+		{
+			CRigidBody* planeBody = bodies[idxB];
+			if (eShapeType::Plane != planeBody->GetShape()->GetShapeType())
+				continue;
+
+			CPlaneShape* planeShape = static_cast<CPlaneShape*>(planeBody->GetShape());
+			_float toi = 1.f;
+			if (SweepSpherePlane(vPrevPos, vMotion, fRadius, planeShape->GetNormal(),
+				GetPlaneDotProduct(planeBody, planeShape), toi) && toi < fFirstTOI)
+				fFirstTOI = toi;
+		}
+
+		if (1.f > fFirstTOI)
+			sphereBody->SetPosition(vPrevPos + vMotion * fFirstTOI);
 	}
+}
 
-	return false;
+_bool CCollisionHandler::SweepSpherePlane(const vec3& prevPosition, const vec3& motion,
+	_float radius, const vec3& normal, _float dotProduct, _float& toi)
+{
+	const _float fSlop = 0.001f; // Stop slightly inside so the discrete test reports the contact
+
+	_float fDistA = dot(prevPosition, normal) - dotProduct;
+	_float fApproach = dot(motion, normal);
+	if (0.f <= fApproach)
+		return false; // Moving away from (or along) the plane
+
+	if (fDistA < radius)
+		return false; // Already touching, handled by the discrete test
+
+	_float fDistB = fDistA + fApproach;
+	if (fDistB >= radius)
+		return false; // Doesn't reach the plane in this step
+
+	toi = (fDistA - radius + fSlop) / (fDistA - fDistB);
+	toi = glm::clamp(toi, 0.f, 1.f);
+
+	return true;
+}
+
+// Ground planes are defined by their dot product, walls pass through their body position
+_float CCollisionHandler::GetPlaneDotProduct(CRigidBody* planeBody, CPlaneShape* planeShape)
+{
+	if (planeBody->IsGround())
+		return planeShape->GetDotProduct();
 
+	return dot(planeShape->GetNormal(), planeBody->GetPosition());
 }
 
 _bool CCollisionHandler::TestMovingSphereSphere(
@@ -5,9 +5,12 @@
 #include "..\Headers\Transform.h"
 #include "..\Headers\QuadTree.h"
 #include "..\Headers\Octree.h"
+#include "..\Headers\TriangleBVH.h"
+#include "..\Headers\ParallelFor.h"
 #include "..\Headers\EngineStruct.h"
 #include <vector>
 #include <limits>
+#include <xmmintrin.h>
 
 
 USING(Engine)
@@ -16,7 +19,9 @@ USING(std)
 SINGLETON_FUNCTION(CCollisionMaster)
 
 CCollisionMaster::CCollisionMaster()
+	: m_iWorkerCount(0)
 {
+	m_vecContexts.clear();
 }
 
 CCollisionMaster::~CCollisionMaster()
@@ -26,6 +31,9 @@ CCollisionMaster::~CCollisionMaster()
 // Call instead of destructor to manage class internal data
 void CCollisionMaster::Destroy()
 {
+	for (size_t i = 0; i < m_vecContexts.size(); ++i)
+		SafeDestroy(m_vecContexts[i]);
+	m_vecContexts.clear();
 }
 
 _bool CCollisionMaster::IntersectRayToVirtualPlane(_float planeSize, vec3& vOrigin, vec3& vDir, vec3& vDest)
@@ -75,14 +83,11 @@ _bool CCollisionMaster::IntersectRayToBoundingBox(CBoundingBox* pBoundingBox, CT
 	}
 	fAngleY = radians(fAngleY);
 
-	VTX* pVertices = pBoundingBox->GetVertices();
-
 	vec3 point[8];
-	ZeroMemory(point, sizeof(point));
+	pBoundingBox->GetCorners(point);
 	for (int i = 0; i < 8; ++i)
 	{
-		vec3 vPos = vec3(pVertices[i].vPos.x, pVertices[i].vPos.y, pVertices[i].vPos.z);
-		point[i] = vPos * vParentScale;
+		point[i] = point[i] * vParentScale;
 		_float x = point[i].x;
 		_float z = point[i].z;
 		point[i].x = (z * sin(fAngleY)) + (x * cos(fAngleY)); //x = zsin(b) + xcos(b);
@@ -107,27 +112,29 @@ _bool CCollisionMaster::IntersectRayToBoundingBox(CBoundingBox* pBoundingBox, CT
 	return false;
 }
 
+// Line through vOrigin along vDir against the triangle (Moller-Trumbore, hits on both sides of the origin)
 _bool CCollisionMaster::IntersectPointToTriangle(vec3& p0, vec3& p1, vec3& p2, vec3& vOrigin, vec3& vDir, vec3& vDest)
 {
-	vec3 vNormal = cross(p2 - p0, p1 - p0);
-	_float n = dot(p0 - vOrigin, vNormal);
-	_float d = n / dot(vDir, vNormal);
-	vDest = vOrigin + vDir * d;
+	vec3 edge1 = p1 - p0;
+	vec3 edge2 = p2 - p0;
+	vec3 p = cross(vDir, edge2);
+	_float det = dot(edge1, p);
+	if (abs(det) < 1e-7f)
+		return false;
 
-	return PointInTriangle(vDest, p0, p1, p2);
-}
+	_float invDet = 1.f / det;
+	vec3 s = vOrigin - p0;
+	_float u = dot(s, p) * invDet;
+	if (u < 0.f || u > 1.f)
+		return false;
 
-_bool CCollisionMaster::PointInTriangle(vec3 P, vec3 A, vec3 B, vec3 C)
-{
-	return (PointInDotThree(P, A, B, C) && PointInDotThree(P, B, C, A) && PointInDotThree(P, C, A, B))
-		|| (PointInDotThree(P, A, C, B) && PointInDotThree(P, B, A, C) && PointInDotThree(P, C, B, A));
-}
+	vec3 q = cross(s, edge1);
+	_float v = dot(vDir, q) * invDet;
+	if (v < 0.f || u + v > 1.f)
+		return false;
 
-_bool CCollisionMaster::PointInDotThree(vec3 p1, vec3 p2, vec3 pA, vec3 pB)
-{
-	vec3 cp1 = cross(pB - pA, p1 - pA);
-	vec3 cp2 = cross(pB - pA, p2 - pA);
-	return dot(cp1, cp2) >= 0;
+	vDest = vOrigin + vDir * (dot(edge2, q) * invDet);
+	return true;
 }
 
 
@@ -139,10 +146,10 @@ _bool CCollisionMaster::IntersectRayToTriangles(CQuadTree* pQuadTree, vec3& vMai
 	vec3 vDir = vTarget - vMain;
 	vDir = normalize(vDir);
 
-	vector<CQuadTree::CQuadTreeNode*> vecFullList = pQuadTree->GetNodeVector();
+	const vector<CQuadTree::CQuadTreeNode*>& vecFullList = pQuadTree->GetNodeVector();
 	for (int i = 0; i < vecFullList.size(); ++i)
 	{
-		vector<TRIANGLE*> vecTriangles = vecFullList[i]->vecTriangles;
+		const vector<TRIANGLE*>& vecTriangles = vecFullList[i]->vecTriangles;
 		for (int j = 0; j < vecTriangles.size(); ++j)
 		{
 			vec3 p0 = vecTriangles[j]->p0;
@@ -162,9 +169,6 @@ _bool CCollisionMaster::IsRayBlockedByTriangles(CQuadTree* pQuadTree, glm::vec3&
 	if (nullptr == pQuadTree)
 		return false;
 
-	vector<CQuadTree::CQuadTreeNode*> vecNode;
-	pQuadTree->GetLeafNodes(vMain, vTarget, vecNode);
-
 	_float maxX, maxY, maxZ, minX, minY, minZ;
 
 	if (vMain.x > vTarget.x) { maxX = vMain.x; minX = vTarget.x; }
@@ -180,9 +184,10 @@ _bool CCollisionMaster::IsRayBlockedByTriangles(CQuadTree* pQuadTree, glm::vec3&
 	vDir = normalize(vDir);
 	_float fDist = distance(vTarget, vMain);
 
-	for (int i = 0; i < vecNode.size(); ++i)
+	_bool blocked = false;
+	pQuadTree->VisitLeafNodes(vMain, vTarget, [&](const CQuadTree::CQuadTreeNode* pNode)
 	{
-		vector<TRIANGLE*> vecTriangles = vecNode[i]->vecTriangles;
+		const vector<TRIANGLE*>& vecTriangles = pNode->vecTriangles;
 		for (int j = 0; j < vecTriangles.size(); ++j)
 		{
 			vec3 p0 = vecTriangles[j]->p0;
@@ -203,16 +208,18 @@ _bool CCollisionMaster::IsRayBlockedByTriangles(CQuadTree* pQuadTree, glm::vec3&
 				continue;
 			else if (IntersectRaySphere(vMain, vDir, vCenter, radius))
 			{
-				return true;
+				blocked = true;
+				return false;
 				//if (IntersectPointToTriangle(p0, p1, p2, vMain, vDir, vDest))
 				//{
 				//	return true;
 				//}
 			}
 		}
-	}
+		return true;
+	});
 
-	return false;
+	return blocked;
 }
 
 _bool CCollisionMaster::IntersectCheckForProjectiles(CQuadTree* pQuadTree, glm::vec3& vMain, glm::vec3& vTarget, glm::vec3& vDest)
@@ -220,16 +227,14 @@ _bool CCollisionMaster::IntersectCheckForProjectiles(CQuadTree* pQuadTree, glm::
 	if (nullptr == pQuadTree)
 		return false;
 
-	vector<CQuadTree::CQuadTreeNode*> vecNode;
-	pQuadTree->GetLeafNodes(vMain, vTarget, vecNode);
-
 	vec3 vDir = vTarget - vMain;
 	vDir = normalize(vDir);
 	_float fDist = distance(vTarget, vMain);
 
-	for (int i = 0; i < vecNode.size(); ++i)
+	_bool hit = false;
+	pQuadTree->VisitLeafNodes(vMain, vTarget, [&](const CQuadTree::CQuadTreeNode* pNode)
 	{
-		vector<TRIANGLE*> vecTriangles = vecNode[i]->vecTriangles;
+		const vector<TRIANGLE*>& vecTriangles = pNode->vecTriangles;
 		for (int j = 0; j < vecTriangles.size(); ++j)
 		{
 			vec3 p0 = vecTriangles[j]->p0;
@@ -245,13 +250,138 @@ _bool CCollisionMaster::IntersectCheckForProjectiles(CQuadTree* pQuadTree, glm::
 			{
 				if (IntersectPointToTriangle(p0, p1, p2, vMain, vDir, vDest))
 				{
-					return true;
+					hit = true;
+					return false;
 				}
 			}
 		}
-	}
+		return true;
+	});
 
-	return false;
+	return hit;
+}
+
+// Closest triangle along the ray from vMain through vTarget (not limited to the target)
+_bool CCollisionMaster::IntersectRayToTriangles(CTriangleBVH* pBVH, vec3& vMain, vec3& vTarget, vec3& vDest)
+{
+	if (nullptr == pBVH)
+		return false;
+
+	vec3 vDir = normalize(vTarget - vMain);
+	CTriangleBVH::RAYHIT hit;
+	if (!pBVH->IntersectClosest(vMain, vDir, numeric_limits<_float>::max(), hit))
+		return false;
+
+	vDest = hit.vPoint;
+	return true;
+}
+
+// Line of sight : any triangle between vMain and vTarget
+_bool CCollisionMaster::IsRayBlockedByTriangles(CTriangleBVH* pBVH, vec3& vMain, vec3& vTarget)
+{
+	if (nullptr == pBVH)
+		return false;
+
+	_float fDist = distance(vTarget, vMain);
+	if (fDist <= 0.f)
+		return false;
+
+	vec3 vDir = (vTarget - vMain) / fDist;
+	return pBVH->IntersectAny(vMain, vDir, fDist);
+}
+
+// First triangle hit on the segment from vMain to vTarget
+_bool CCollisionMaster::IntersectCheckForProjectiles(CTriangleBVH* pBVH, vec3& vMain, vec3& vTarget, vec3& vDest)
+{
+	if (nullptr == pBVH)
+		return false;
+
+	_float fDist = distance(vTarget, vMain);
+	if (fDist <= 0.f)
+		return false;
+
+	vec3 vDir = (vTarget - vMain) / fDist;
+	CTriangleBVH::RAYHIT hit;
+	if (!pBVH->IntersectClosest(vMain, vDir, fDist, hit))
+		return false;
+
+	vDest = hit.vPoint;
+	return true;
+}
+
+// Line of sight from one point to many targets, traced in packets of 4 rays
+void CCollisionMaster::AreRaysBlockedByTriangles(CTriangleBVH* pBVH, vec3& vMain, const vec3* pTargets, _uint count, _bool* pBlocked)
+{
+	if (nullptr == pBVH || nullptr == pTargets || nullptr == pBlocked || 0 == count)
+		return;
+
+	vector<vec3> vecOrigins(count, vMain);
+	pBVH->IntersectAnyBatch(vecOrigins.data(), pTargets, count, pBlocked);
+}
+
+CCollisionQueryContext* CCollisionMaster::GetQueryContext(_uint worker)
+{
+	ReadyQueryContexts();
+	if (worker >= m_vecContexts.size())
+		return nullptr;
+
+	return m_vecContexts[worker];
+}
+
+// Closest hit for each segment, spread over the workers
+void CCollisionMaster::RayClosestBatch(CTriangleBVH* pBVH, const RAYQUERY* pQueries, _uint count, RAYRESULT* pResults)
+{
+	if (nullptr == pBVH || nullptr == pQueries || nullptr == pResults)
+		return;
+
+	ReadyQueryContexts();
+	ParallelFor(count, 64, [&](_uint begin, _uint end, _uint worker)
+	{
+		CCollisionQueryContext* pContext = m_vecContexts[worker];
+		for (_uint i = begin; i < end; ++i)
+			pContext->RayClosest(pBVH, pQueries[i], pResults[i]);
+	}, m_iWorkerCount);
+}
+
+// Line of sight for each segment, every block is traced as ray packets on the workers
+void CCollisionMaster::SegmentBlockedBatch(CTriangleBVH* pBVH, const RAYQUERY* pQueries, _uint count, _bool* pBlocked)
+{
+	if (nullptr == pBVH || nullptr == pQueries || nullptr == pBlocked)
+		return;
+
+	ReadyQueryContexts();
+	ParallelFor(count, 256, [&](_uint begin, _uint end, _uint worker)
+	{
+		m_vecContexts[worker]->SegmentsBlocked(pBVH, pQueries + begin, end - begin, pBlocked + begin);
+	}, m_iWorkerCount);
+}
+
+// Octree leaves touching each box, the callback runs on the worker threads
+void CCollisionMaster::OverlapOctreeBatch(COctree* pOctree, CBoundingBox** ppBoxes, _uint count, function<void(_uint, const vector<_uint>&)> callback)
+{
+	if (nullptr == pOctree || nullptr == ppBoxes || nullptr == callback)
+		return;
+
+	ReadyQueryContexts();
+	ParallelFor(count, 16, [&](_uint begin, _uint end, _uint worker)
+	{
+		CCollisionQueryContext* pContext = m_vecContexts[worker];
+		for (_uint i = begin; i < end; ++i)
+			callback(i, pContext->OverlapOctree(pOctree, ppBoxes[i]));
+	}, m_iWorkerCount);
+}
+
+// One context per worker, created on the calling thread before any worker starts
+void CCollisionMaster::ReadyQueryContexts()
+{
+	_uint workerCount = GetParallelWorkerCount();
+	while (m_vecContexts.size() < workerCount)
+	{
+		CCollisionQueryContext* pContext = CCollisionQueryContext::Create();
+		if (nullptr == pContext)
+			break;
+		m_vecContexts.push_back(pContext);
+	}
 }
 
 void CCollisionMaster::GetCenter(vec3& p0, vec3& p1, vec3& p2, vec3& center, _float& radius)
@@ -290,115 +420,257 @@ _bool CCollisionMaster::IntersectRaySphere(vec3& vOrigin, vec3& vDir, vec3& cent
 	return true;
 }
 
-//_bool CCollisionMaster::TestTriangleAABB(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, CBoundingBox* aabb)
-//{
-//	_float p0, p1, r;
-//
-//	vec3 vMax = aabb->m_vMax;
-//	vec3 vMin = aabb->m_vMin;
-//	vec3 center = aabb->m_vCenter;
-//	_float e0 = (vMax.x - vMin.x) * 0.5f;
-//	_float e1 = (vMax.y - vMin.y) * 0.5f;
-//	_float e2 = (vMax.z - vMin.z) * 0.5f;
-//
-//	// Translate triangle as conceptually moving AABB to origin
-//	v0 = v0 - center;
-//	v1 = v1 - center;
-//	v2 = v2 - center;
-//
-//	// Compute edge vectors for triangle
-//	vec3 f0 = v1 - v0;
-//	vec3 f1 = v2 - v1;
-//	vec3 f2 = v0 - v2;
-//
-//	// Test axes a00..a22 (category 3)
-//	// a00
-//	p0 = v0.z * v1.y - v0.y * v1.z;
-//	p1 = v2.z * v1.y - v2.z * v0.y + v0.z * v2.y - v1.z * v2.y;
-//	r = e1 * abs(f0.z) + e2 * abs(f0.y);
-//	if (std::max(-std::max(p0, p1), std::min(p0, p1)) > r)
-//		return false; // axis is a separating axis
-//	// a01
-//	p0 = v0.y * v1.z - v0.y * v2.z - v0.z * v1.y + v0.z * v2.y;
-//	p1 = -v1.y * v2.z + v1.z * v2.y;
-//	r = e1 * abs(f1.z) + e2 * abs(f1.y);
-//	if (std::max(-std::max(p0, p1), std::min(p0, p1)) > r)
-//		return false;
-//	// a02
-//	p0 = v0.y * v2.z - v0.z * v2.y;
-//	p1 = v0.y * v1.z - v0.z * v1.y + v1.y * v2.z - v1.z * v2.y;
-//	r = e1 * abs(f2.z) + e2 * abs(f2.y);
-//	if (std::max(-std::max(p0, p1), std::min(p0, p1)) > r)
-//		return false;
-//
-//	// a10
-//	p0 = v0.x * v1.z - v0.z * v1.x;
-//	p1 = v0.x * v2.z - v0.z * v2.x - v1.x * v2.z + v1.z * v2.x;
-//	r = e0 * abs(f0.z) + e2 * abs(f0.x);
-//	if (std::max(-std::max(p0, p1), std::min(p0, p1)) > r)
-//		return false;
-//	// a11
-//	p0 = -v0.x * v1.z + v0.x * v2.z + v0.z * v1.x - v0.z * v2.x;
-//	p1 = v1.x * v2.z - v1.z * v2.x;
-//	r = (e0 * abs(f1.z) + e2 * abs(f1.x));
-//	if (std::max(-std::max(p0, p1), std::min(p0, p1)) > r)
-//		return false;
-//	// a12
-//	p0 = -v0.x * v2.z + v0.z * v2.x;
-//	p1 = -v0.x * v1.z + v0.z * v1.x - v1.x * v2.z + v1.z * v2.x;
-//	r = e0 * abs(f2.z) + e2 * abs(f2.x);
-//	if (std::max(-std::max(p0, p1), std::min(p0, p1)) > r)
-//		return false;
-//
-//	// a20
-//	p0 = -v0.x * v1.y + v0.y * v1.x;
-//	p1 = -v0.x * v2.y + v0.y * v2.x + v1.x * v2.y - v1.y * v2.x;
-//	r = e0 * abs(f0.y) + e1 * abs(f0.x);
-//	if (std::max(-std::max(p0, p1), std::min(p0, p1)) > r)
-//		return false;
-//	// a21
-//	p0 = v0.x * v1.y - v0.x * v2.y - v0.y * v1.x + v0.y * v2.x;
-//	p1 = -v1.x * v2.y + v1.y * v2.x;
-//	r = e0 * abs(f1.y) + e1 * abs(f1.x);
-//	if (std::max(-std::max(p0, p1), std::min(p0, p1)) > r)
-//		return false;
-//	// a22
-//	p0 = v0.x * v2.y - v0.y * v2.x;
-//	p1 = v0.x * v1.y - v0.y * v1.x + v1.x * v2.y - v1.y * v2.x;
-//	r = e0 * abs(f2.y) + e1 * abs(f2.x);
-//	if (std::max(-std::max(p0, p1), std::min(p0, p1)) > r)
-//		return false;
-//
-//
-//	// Test the three axes corresponding to the face normals of AABB b (category 1).
-//	// ... [-e0, e0] and [min(v0.x, v1.x, v2.x), max(v0.x, v1.x, v2.x)] do not overlap
-//	if (std::max(std::max(v0.x, v1.x), v2.x) < -e0 || std::min(std::min(v0.x, v1.x), v2.x) > e0) return false;
-//	// ... [-e1, e1] and [min(v0.y, v1.y, v2.y), max(v0.y, v1.y, v2.y)] do not overlap
-//	if (std::max(std::max(v0.y, v1.y), v2.y) < -e1 || std::min(std::min(v0.y, v1.y), v2.y) > e1) return false;
-//	// ... [-e2, e2] and [min(v0.z, v1.z, v2.z), max(v0.z, v1.z, v2.z)] do not overlap
-//	if (std::max(std::max(v0.z, v1.z), v2.z) < -e2 || std::min(std::min(v0.z, v1.z), v2.z) > e2) return false;
-//
-//
-//	// Test separating axis corresponding to triangle face normal (category 2)
-//	vec3 vNormal = cross(f0, f1);
-//	_float dotValue = dot(vNormal, v0);
-//
-//	//r = e0 * abs(vNormal.x) + e1 * vNormal.y + e2 * vNormal.z;
-//	//_float s = vNormal.x * center.x + vNormal.y * center.y + vNormal.z * center.z - dotValue;
-//
-//	//return abs(s) <= r;
-//
-//	//Plane p;
-//	//p.n = Cross(f0, f1);
-//	//p.d = Dot(p.n, v0);
-//
-//
-//	//return TestAABBPlane();
-//
-//	//return _int();
-//	return true;
-//}
-//
+// Triangle vs AABB separating axis test (Akenine-Moller), box given as center/half extents
+_bool CCollisionMaster::TestTriangleAABB(const vec3& p0, const vec3& p1, const vec3& p2, const vec3& vCenter, const vec3& vHalf)
+{
+	// Translate triangle as conceptually moving AABB to origin
+	vec3 v0 = p0 - vCenter;
+	vec3 v1 = p1 - vCenter;
+	vec3 v2 = p2 - vCenter;
+
+	// Box face normals (category 1)
+	vec3 triMin = glm::min(glm::min(v0, v1), v2);
+	vec3 triMax = glm::max(glm::max(v0, v1), v2);
+	if (any(lessThan(triMax, -vHalf)) || any(greaterThan(triMin, vHalf)))
+		return false;
+
+	// Triangle face normal (category 2)
+	vec3 f0 = v1 - v0;
+	vec3 f1 = v2 - v1;
+	vec3 f2 = v0 - v2;
+	vec3 vNormal = cross(f0, f1);
+	if (abs(dot(vNormal, v0)) > dot(vHalf, abs(vNormal)))
+		return false;
+
+	// Box edges x triangle edges (category 3)
+	const vec3* edges[3] = { &f0, &f1, &f2 };
+	for (_uint i = 0; i < 3; ++i)
+	{
+		const vec3& f = *edges[i];
+		if (SeparatedOnAxis(vec3(0.f, -f.z, f.y), v0, v1, v2, vHalf)) return false;
+		if (SeparatedOnAxis(vec3(f.z, 0.f, -f.x), v0, v1, v2, vHalf)) return false;
+		if (SeparatedOnAxis(vec3(-f.y, f.x, 0.f), v0, v1, v2, vHalf)) return false;
+	}
+
+	return true;
+}
+
+_bool CCollisionMaster::SeparatedOnAxis(const vec3& axis, const vec3& v0, const vec3& v1, const vec3& v2, const vec3& vHalf)
+{
+	_float d0 = dot(v0, axis);
+	_float d1 = dot(v1, axis);
+	_float d2 = dot(v2, axis);
+	_float r = dot(vHalf, abs(axis));
+	return glm::max(-glm::max(glm::max(d0, d1), d2), glm::min(glm::min(d0, d1), d2)) > r;
+}
+
+static inline __m128 Abs4(__m128 v)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.f), v);
+}
+
+// SeparatedOnAxis for 4 triangles (one per lane), returns one bit per separated triangle
+static inline _int SeparatedOnAxis4(__m128 ax, __m128 ay, __m128 az, const __m128 v[9], __m128 hx, __m128 hy, __m128 hz)
+{
+	__m128 d0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v[0], ax), _mm_mul_ps(v[1], ay)), _mm_mul_ps(v[2], az));
+	__m128 d1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v[3], ax), _mm_mul_ps(v[4], ay)), _mm_mul_ps(v[5], az));
+	__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v[6], ax), _mm_mul_ps(v[7], ay)), _mm_mul_ps(v[8], az));
+	__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(hx, Abs4(ax)), _mm_mul_ps(hy, Abs4(ay))), _mm_mul_ps(hz, Abs4(az)));
+	__m128 dMax = _mm_max_ps(_mm_max_ps(d0, d1), d2);
+	__m128 dMin = _mm_min_ps(_mm_min_ps(d0, d1), d2);
+	__m128 gap = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), dMax), dMin);
+	return _mm_movemask_ps(_mm_cmpgt_ps(gap, r));
+}
+
+// Same axes as TestTriangleAABB, 4 triangles per pass, stops once every lane is separated
+_uint CCollisionMaster::TestTrianglesAABB(const TRIANGLE* pTriangles, const _uint* pIndices, _uint count, const vec3& vCenter, const vec3& vHalf, _bool* pResults)
+{
+	if (nullptr == pTriangles || nullptr == pResults)
+		return 0;
+
+	__m128 hx = _mm_set1_ps(vHalf.x);
+	__m128 hy = _mm_set1_ps(vHalf.y);
+	__m128 hz = _mm_set1_ps(vHalf.z);
+	__m128 zero = _mm_setzero_ps();
+
+	_uint hitCount = 0;
+	_uint i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		// Triangles relative to the box center, SoA : v[0..2] = p0, v[3..5] = p1, v[6..8] = p2
+		_float soa[9][4];
+		for (_uint lane = 0; lane < 4; ++lane)
+		{
+			const TRIANGLE& tri = pTriangles[nullptr == pIndices ? i + lane : pIndices[i + lane]];
+			soa[0][lane] = tri.p0.x - vCenter.x; soa[1][lane] = tri.p0.y - vCenter.y; soa[2][lane] = tri.p0.z - vCenter.z;
+			soa[3][lane] = tri.p1.x - vCenter.x; soa[4][lane] = tri.p1.y - vCenter.y; soa[5][lane] = tri.p1.z - vCenter.z;
+			soa[6][lane] = tri.p2.x - vCenter.x; soa[7][lane] = tri.p2.y - vCenter.y; soa[8][lane] = tri.p2.z - vCenter.z;
+		}
+		__m128 v[9];
+		for (_uint k = 0; k < 9; ++k)
+			v[k] = _mm_loadu_ps(soa[k]);
+
+		// Box face normals (category 1)
+		__m128 h[3] = { hx, hy, hz };
+		_int separated = 0;
+		for (_uint axis = 0; axis < 3; ++axis)
+		{
+			__m128 vMin = _mm_min_ps(_mm_min_ps(v[axis], v[3 + axis]), v[6 + axis]);
+			__m128 vMax = _mm_max_ps(_mm_max_ps(v[axis], v[3 + axis]), v[6 + axis]);
+			separated |= _mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(vMax, _mm_sub_ps(zero, h[axis])), _mm_cmpgt_ps(vMin, h[axis])));
+		}
+
+		// Triangle edges
+		__m128 f[9];
+		for (_uint k = 0; k < 3; ++k)
+		{
+			f[k] = _mm_sub_ps(v[3 + k], v[k]);			// f0 = v1 - v0
+			f[3 + k] = _mm_sub_ps(v[6 + k], v[3 + k]);	// f1 = v2 - v1
+			f[6 + k] = _mm_sub_ps(v[k], v[6 + k]);		// f2 = v0 - v2
+		}
+
+		// Triangle face normal (category 2)
+		if (0xF != separated)
+		{
+			__m128 nx = _mm_sub_ps(_mm_mul_ps(f[1], f[5]), _mm_mul_ps(f[2], f[4]));
+			__m128 ny = _mm_sub_ps(_mm_mul_ps(f[2], f[3]), _mm_mul_ps(f[0], f[5]));
+			__m128 nz = _mm_sub_ps(_mm_mul_ps(f[0], f[4]), _mm_mul_ps(f[1], f[3]));
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, v[0]), _mm_mul_ps(ny, v[1])), _mm_mul_ps(nz, v[2]));
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(hx, Abs4(nx)), _mm_mul_ps(hy, Abs4(ny))), _mm_mul_ps(hz, Abs4(nz)));
+			separated |= _mm_movemask_ps(_mm_cmpgt_ps(Abs4(d), r));
+		}
+
+		// Box edges x triangle edges (category 3)
+		for (_uint e = 0; e < 3 && 0xF != separated; ++e)
+		{
+			__m128 fx = f[3 * e], fy = f[3 * e + 1], fz = f[3 * e + 2];
+			separated |= SeparatedOnAxis4(zero, _mm_sub_ps(zero, fz), fy, v, hx, hy, hz);
+			if (0xF == separated) break;
+			separated |= SeparatedOnAxis4(fz, zero, _mm_sub_ps(zero, fx), v, hx, hy, hz);
+			if (0xF == separated) break;
+			separated |= SeparatedOnAxis4(_mm_sub_ps(zero, fy), fx, zero, v, hx, hy, hz);
+		}
+
+		for (_uint lane = 0; lane < 4; ++lane)
+		{
+			pResults[i + lane] = 0 == (separated & (1 << lane));
+			if (pResults[i + lane])
+				++hitCount;
+		}
+	}
+
+	// Remainder
+	for (; i < count; ++i)
+	{
+		const TRIANGLE& tri = pTriangles[nullptr == pIndices ? i : pIndices[i]];
+		pResults[i] = TestTriangleAABB(tri.p0, tri.p1, tri.p2, vCenter, vHalf);
+		if (pResults[i])
+			++hitCount;
+	}
+
+	return hitCount;
+}
+
+// Triangle moved into the box frame, then the AABB test
+_bool CCollisionMaster::TestTriangleOBB(const vec3& p0, const vec3& p1, const vec3& p2, const OBB& obb)
+{
+	vec3 d0 = p0 - obb.vCenter;
+	vec3 d1 = p1 - obb.vCenter;
+	vec3 d2 = p2 - obb.vCenter;
+	vec3 v0(dot(d0, obb.vAxis[0]), dot(d0, obb.vAxis[1]), dot(d0, obb.vAxis[2]));
+	vec3 v1(dot(d1, obb.vAxis[0]), dot(d1, obb.vAxis[1]), dot(d1, obb.vAxis[2]));
+	vec3 v2(dot(d2, obb.vAxis[0]), dot(d2, obb.vAxis[1]), dot(d2, obb.vAxis[2]));
+
+	return TestTriangleAABB(v0, v1, v2, vec3(0.f), obb.vHalf);
+}
+
+// OBB vs AABB, 15 axes (Gottschalk), the AABB axes are the world axes
+_bool CCollisionMaster::TestOBBAABB(const OBB& obb, const vec3& vCenter, const vec3& vHalf)
+{
+	const _float epsilon = 1e-6f;
+	const vec3& a = obb.vHalf;
+	const vec3& b = vHalf;
+
+	// R[i][j] = OBB axis i . world axis j, epsilon keeps near-parallel edge axes from false separations
+	_float R[3][3], AbsR[3][3];
+	for (_uint i = 0; i < 3; ++i)
+	{
+		for (_uint j = 0; j < 3; ++j)
+		{
+			R[i][j] = obb.vAxis[i][j];
+			AbsR[i][j] = abs(R[i][j]) + epsilon;
+		}
+	}
+
+	// Center offset in the OBB frame
+	vec3 vOffset = vCenter - obb.vCenter;
+	_float t[3] = { dot(vOffset, obb.vAxis[0]), dot(vOffset, obb.vAxis[1]), dot(vOffset, obb.vAxis[2]) };
+
+	// OBB axes
+	for (_uint i = 0; i < 3; ++i)
+	{
+		if (abs(t[i]) > a[i] + b[0] * AbsR[i][0] + b[1] * AbsR[i][1] + b[2] * AbsR[i][2])
+			return false;
+	}
+
+	// World axes
+	for (_uint j = 0; j < 3; ++j)
+	{
+		_float tj = t[0] * R[0][j] + t[1] * R[1][j] + t[2] * R[2][j];
+		if (abs(tj) > a[0] * AbsR[0][j] + a[1] * AbsR[1][j] + a[2] * AbsR[2][j] + b[j])
+			return false;
+	}
+
+	// OBB axis i x world axis j
+	for (_uint i = 0; i < 3; ++i)
+	{
+		_uint i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+		for (_uint j = 0; j < 3; ++j)
+		{
+			_uint j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+			_float ra = a[i1] * AbsR[i2][j] + a[i2] * AbsR[i1][j];
+			_float rb = b[j1] * AbsR[i][j2] + b[j2] * AbsR[i][j1];
+			if (abs(t[i2] * R[i1][j] - t[i1] * R[i2][j]) > ra + rb)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void CCollisionMaster::GetOrientedBox(CBoundingBox* boundingBox, OBB& obb)
+{
+	vec3 vLocalCenter = (boundingBox->m_vMin + boundingBox->m_vMax) * 0.5f;
+	vec3 vLocalHalf = (boundingBox->m_vMax - boundingBox->m_vMin) * 0.5f;
+
+	if (nullptr == boundingBox->m_pParentTransform)
+	{
+		obb.vCenter = vLocalCenter;
+		obb.vHalf = vLocalHalf;
+		obb.vAxis[0] = vec3(1.f, 0.f, 0.f);
+		obb.vAxis[1] = vec3(0.f, 1.f, 0.f);
+		obb.vAxis[2] = vec3(0.f, 0.f, 1.f);
+		return;
+	}
+
+	// Scale moves from the matrix columns into the half extents
+	const mat4x4& matWorld = *boundingBox->m_pParentTransform->GetWorldMatrix();
+	obb.vCenter = vec3(matWorld * vec4(vLocalCenter, 1.f));
+	for (_uint i = 0; i < 3; ++i)
+	{
+		vec3 vColumn = vec3(matWorld[i]);
+		_float fLength = length(vColumn);
+		if (fLength > 0.f)
+			obb.vAxis[i] = vColumn / fLength;
+		else
+		{
+			obb.vAxis[i] = vec3(0.f);
+			obb.vAxis[i][i] = 1.f;
+		}
+		obb.vHalf[i] = vLocalHalf[i] * fLength;
+	}
+}
+
 //_bool CCollisionMaster::IntersectTriangleInAABB(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, CBoundingBox* aabb)
 //{
 //	vec3 vMax = aabb->m_vMax;
@@ -467,385 +739,29 @@ _bool CCollisionMaster::IntersectRaySphere(vec3& vOrigin, vec3& vDir, vec3& cent
 
 _bool CCollisionMaster::IntersectTriangleToAABB(TRIANGLE* triangle, CBoundingBox* boundingBox)
 {
-	_float tri_min, tri_max;
-
-	vec3 bbMin = boundingBox->m_vMin;
-	vec3 bbMax = boundingBox->m_vMax;
-
-	vec3 vNormalX = vec3(1.f, 0.f, 0.f);
-	vec3 vNormalY = vec3(0.f, 1.f, 0.f);
-	vec3 vNormalZ = vec3(0.f, 0.f, 1.f);
-
-	ProjectTriangle(triangle, vNormalX, tri_min, tri_max);
-	if (tri_max < bbMin.x || tri_min > bbMax.x)
-		return false;
-
-	ProjectTriangle(triangle, vNormalY, tri_min, tri_max);
-	if (tri_max < bbMin.y || tri_min > bbMax.y)
-		return false;
-
-	ProjectTriangle(triangle, vNormalZ, tri_min, tri_max);
-	if (tri_max < bbMin.z || tri_min > bbMax.z)
-		return false;
-
-	_float box_min, box_max;
-	vec3 triNormal = cross(triangle->p1 - triangle->p0, triangle->p2 - triangle->p0);
-	_float triangleOffset = dot(triNormal, triangle->p0);
-	ProjectBox(bbMin, bbMax, triNormal, box_min, box_max);
-	if (box_max < triangleOffset || box_min > triangleOffset)
-		return false;
-
-	vec3 tri_edgesX = triangle->p0 - triangle->p1;
-	vec3 tri_edgesY = triangle->p1 - triangle->p2;
-	vec3 tri_edgesZ = triangle->p2 - triangle->p0;
-
-	vec3 axis = cross(tri_edgesX, vNormalX);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-	axis = cross(tri_edgesX, vNormalY);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-	axis = cross(tri_edgesX, vNormalZ);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-
-	axis = cross(tri_edgesY, vNormalX);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-	axis = cross(tri_edgesY, vNormalY);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-	axis = cross(tri_edgesY, vNormalZ);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-
-	axis = cross(tri_edgesZ, vNormalX);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-	axis = cross(tri_edgesZ, vNormalY);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-	axis = cross(tri_edgesZ, vNormalZ);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-
-	return true;
+	return IntersectTriangleToAABB(triangle, boundingBox->m_vMin, boundingBox->m_vMax);
 }
 
-_bool CCollisionMaster::IntersectTriangleToOBB(TRIANGLE* triangle, CBoundingBox* boundingBox)
+_bool CCollisionMaster::IntersectTriangleToAABB(TRIANGLE* triangle, vec3 bbMin, vec3 bbMax)
 {
-	_float tri_min, tri_max;
-	_float box_min, box_max;
-
-	vec3 bbMin = boundingBox->m_vMin;
-	vec3 bbMax = boundingBox->m_vMax;
-
-	vec3 vNormalLook = vec3(1.f, 0.f, 0.f);
-	vec3 vNormalUp = vec3(0.f, 1.f, 0.f);
-	vec3 vNormalRight = vec3(0.f, 0.f, 1.f);
-
-	if (nullptr != boundingBox->m_pParentTransform)
-	{
-		vNormalLook = boundingBox->m_pParentTransform->GetLookVector();
-		vNormalUp = boundingBox->m_pParentTransform->GetUpVector();
-		vNormalRight = boundingBox->m_pParentTransform->GetRightVector();
-	}
-
-	ProjectBox(bbMin, bbMax, vNormalLook, box_min, box_max);
-	ProjectTriangle(triangle, vNormalLook, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-
-	ProjectBox(bbMin, bbMax, vNormalUp, box_min, box_max);
-	ProjectTriangle(triangle, vNormalUp, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-
-	ProjectBox(bbMin, bbMax, vNormalRight, box_min, box_max);
-	ProjectTriangle(triangle, vNormalRight, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-
-
-	vec3 triNormal = cross(triangle->p1 - triangle->p0, triangle->p2 - triangle->p0);
-	_float triangleOffset = dot(triNormal, triangle->p0);
-	ProjectBox(bbMin, bbMax, triNormal, box_min, box_max);
-	if (box_max < triangleOffset || box_min > triangleOffset)
-		return false;
-
-
-	vec3 tri_edgesX = triangle->p0 - triangle->p1;
-	vec3 tri_edgesY = triangle->p1 - triangle->p2;
-	vec3 tri_edgesZ = triangle->p2 - triangle->p0;
-
-	vec3 axis = cross(tri_edgesX, vNormalLook);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-	axis = cross(tri_edgesX, vNormalUp);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-	axis = cross(tri_edgesX, vNormalRight);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-
-	axis = cross(tri_edgesY, vNormalLook);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-	axis = cross(tri_edgesY, vNormalUp);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-	axis = cross(tri_edgesY, vNormalRight);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-
-	axis = cross(tri_edgesZ, vNormalLook);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-	axis = cross(tri_edgesZ, vNormalUp);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-	axis = cross(tri_edgesZ, vNormalRight);
-	ProjectBox(bbMin, bbMax, axis, box_min, box_max);
-	ProjectTriangle(triangle, axis, tri_min, tri_max);
-	if (box_max < tri_min || box_min > tri_max)
-		return false;
-
-	return true;
+	return TestTriangleAABB(triangle->p0, triangle->p1, triangle->p2, (bbMin + bbMax) * 0.5f, (bbMax - bbMin) * 0.5f);
 }
 
-_bool CCollisionMaster::IntersectOBBToAABB(CBoundingBox* obb, CBoundingBox* aabb)
-{
-	_float box1_min, box1_max;
-	_float box2_min, box2_max;
-
-	vec3 bbMin1 = obb->m_vMin;
-	vec3 bbMax1 = obb->m_vMax;
-	vec3 bbMin2 = aabb->m_vMin;
-	vec3 bbMax2 = aabb->m_vMax;
-
-	vec3 vRight1 = vec3(1.f, 0.f, 0.f);
-	vec3 vUp1 = vec3(0.f, 1.f, 0.f);
-	vec3 vLook1 = vec3(0.f, 0.f, 1.f);
-
-	vec3 vRight2 = vec3(1.f, 0.f, 0.f);
-	vec3 vUp2 = vec3(0.f, 1.f, 0.f);
-	vec3 vLook2 = vec3(0.f, 0.f, 1.f);
-	
-	_bool fix = false;
-	if (nullptr != obb->m_pParentTransform)
-	{
-		vLook1 = obb->m_pParentTransform->GetLookVector();
-		vUp1 = obb->m_pParentTransform->GetUpVector();
-		vRight1 = obb->m_pParentTransform->GetRightVector();
-
-		_float angle = obb->m_pParentTransform->GetRotationY();
-		if (angle < 90.f || (angle > 180.f && angle < 270.f))
-			fix = true;
-	}
-
-	ProjectBox(bbMin1, bbMax1, vLook1, box1_min, box1_max);
-	ProjectBox(bbMin2, bbMax2, vLook1, box2_min, box2_max);
-	if (box2_max < box1_min || box2_min > box1_max)
-		return false;
-	ProjectBox(bbMin1, bbMax1, vUp1, box1_min, box1_max);
-	ProjectBox(bbMin2, bbMax2, vUp1, box2_min, box2_max);
-	if (box2_max < box1_min || box2_min > box1_max)
-		return false;
-	ProjectBox(bbMin1, bbMax1, vRight1, box1_min, box1_max);
-	ProjectBox(bbMin2, bbMax2, vRight1, box2_min, box2_max);
-	if (box2_max < box1_min || box2_min > box1_max)
-		return false;
-
-	ProjectBox(bbMin1, bbMax1, vLook2, box1_min, box1_max);
-	if (bbMax2.z < box1_min || bbMin2.z > box1_max)
-		return false;
-	ProjectBox(bbMin1, bbMax1, vUp2, box1_min, box1_max);
-	if (bbMax2.y < box1_min || bbMin2.y > box1_max)
-		return false;
-	ProjectBox(bbMin1, bbMax1, vRight2, box1_min, box1_max);
-	if (bbMax2.x < box1_min || bbMin2.x > box1_max)
-		return false;
-
-	vec3 axis = cross(vLook1, vLook2);
-	ProjectBox(bbMin1, bbMax1, axis, box1_min, box1_max);
-	ProjectBox(bbMin2, bbMax2, axis, box2_min, box2_max);
-	if (box2_max < box1_min || box2_min > box1_max)
-		return false;
-	axis = cross(vLook1, vUp2);
-	ProjectBox(bbMin1, bbMax1, axis, box1_min, box1_max);
-	ProjectBox(bbMin2, bbMax2, axis, box2_min, box2_max);
-	if (box2_max < box1_min || box2_min > box1_max)
-		return false;
-	axis = cross(vLook1, vRight2);
-	ProjectBox(bbMin1, bbMax1, axis, box1_min, box1_max);
-	ProjectBox(bbMin2, bbMax2, axis, box2_min, box2_max);
-	if (box2_max < box1_min || box2_min > box1_max)
-		return false;
-
-	axis = cross(vUp1, vLook2);
-	ProjectBox(bbMin1, bbMax1, axis, box1_min, box1_max);
-	ProjectBox(bbMin2, bbMax2, axis, box2_min, box2_max);
-	if (box2_max < box1_min || box2_min > box1_max)
-		return false;
-	axis = cross(vUp1, vUp2);
-	ProjectBox(bbMin1, bbMax1, axis, box1_min, box1_max);
-	ProjectBox(bbMin2, bbMax2, axis, box2_min, box2_max);
-	if (box2_max < box1_min || box2_min > box1_max)
-		return false;
-	axis = cross(vUp1, vRight2);
-	ProjectBox(bbMin1, bbMax1, axis, box1_min, box1_max);
-	ProjectBox(bbMin2, bbMax2, axis, box2_min, box2_max);
-	if (box2_max < box1_min || box2_min > box1_max)
-		return false;
-
-	axis = cross(vRight1, vLook2);
-	ProjectBox(bbMin1, bbMax1, axis, box1_min, box1_max);
-	ProjectBox(bbMin2, bbMax2, axis, box2_min, box2_max);
-	if (box2_max < box1_min || box2_min > box1_max)
-		return false;
-	axis = cross(vRight1, vUp2);
-	ProjectBox(bbMin1, bbMax1, axis, box1_min, box1_max);
-	ProjectBox(bbMin2, bbMax2, axis, box2_min, box2_max);
-	if (box2_max < box1_min || box2_min > box1_max)
-		return false;
-	axis = cross(vRight1, vRight2);
-	ProjectBox(bbMin1, bbMax1, axis, box1_min, box1_max);
-	ProjectBox(bbMin2, bbMax2, axis, box2_min, box2_max);
-	if (box2_max < box1_min || box2_min > box1_max)
-		return false;
-
-	return true;
-}
-
-void CCollisionMaster::ProjectTriangle(TRIANGLE* triangle, vec3& axis, _float& fMin, _float& fMax)
+_bool CCollisionMaster::IntersectTriangleToOBB(TRIANGLE* triangle, CBoundingBox* boundingBox)
 {
-	fMin = 100000.f;
-	fMax = -100000.f;
-
-	Project(axis, triangle->p0, fMin, fMax);
-	Project(axis, triangle->p1, fMin, fMax);
-	Project(axis, triangle->p2, fMin, fMax);
+	OBB obb;
+	GetOrientedBox(boundingBox, obb);
+	return TestTriangleOBB(triangle->p0, triangle->p1, triangle->p2, obb);
 }
 
-void CCollisionMaster::ProjectBox(vec3& bbMin, vec3& bbMax, vec3& axis, _float& fMin, _float& fMax)
+_bool CCollisionMaster::IntersectOBBToAABB(CBoundingBox* obb, CBoundingBox* aabb)
 {
-	fMin = 100000.f;
-	fMax = -100000.f;
-
-	Project(axis, vec3(bbMin.x, bbMin.y, bbMin.z), fMin, fMax);
-	Project(axis, vec3(bbMax.x, bbMin.y, bbMin.z), fMin, fMax);
-	Project(axis, vec3(bbMin.x, bbMax.y, bbMin.z), fMin, fMax);
-	Project(axis, vec3(bbMax.x, bbMax.y, bbMin.z), fMin, fMax);
-
-	Project(axis, vec3(bbMin.x, bbMin.y, bbMax.z), fMin, fMax);
-	Project(axis, vec3(bbMax.x, bbMin.y, bbMax.z), fMin, fMax);
-	Project(axis, vec3(bbMin.x, bbMax.y, bbMax.z), fMin, fMax);
-	Project(axis, vec3(bbMax.x, bbMax.y, bbMax.z), fMin, fMax);
+	return IntersectOBBToAABB(obb, aabb->m_vMin, aabb->m_vMax);
 }
 
-void CCollisionMaster::Project(vec3& axis, vec3 vertex, _float& fMin, _float& fMax)
+_bool CCollisionMaster::IntersectOBBToAABB(CBoundingBox* obb, vec3 bbMin2, vec3 bbMax2)
 {
-	_float val = dot(axis, vertex);
-	if (val < fMin)
-		fMin = val;
-	if (val > fMax)
-		fMax = val;
+	OBB box;
+	GetOrientedBox(obb, box);
+	return TestOBBAABB(box, (bbMin2 + bbMax2) * 0.5f, (bbMax2 - bbMin2) * 0.5f);
 }
-
-//int TestTriangleAABB(Point v0, Point v1, Point v2, AABB b)
-//{
-//	float p0, p1, p2, r;
-//
-//	// compute box center and extents (if not already given in that format)
-//	// AABBڽ  ũ 
-//	Vector c = (b.min + b.max) * 0.5f;			// AABB center
-//	float e0 = (b.max.x - b.min.x) * 0.5f;		// x half length
-//	float e1 = (b.max.y - b.min.y) * 0.5f;		// y half length
-//	float e2 = (b.max.z - b.min.z) * 0.5f;		// z half length
-//
-//	// Translate triangle as conceptually moving AABB to origin
-//	// ﰢ ġ AABB  ̵
-//	v0 = v0 - c;
-//	v1 = v1 - c;
-//	v2 = v2 - c;
-//
-//	// Compute edge vectors for triangle
-//	//  Ű ﰢ   
-//	Vector f0 = v1 - v0;
-//	Vector f1 = v2 - v1;
-//	Vector f2 = v0 - v2;
-//	
-//	// Test axes a00..a22 (category 3)
-//	// Test axis a00
-//	p0 = v0.z * v1.y - v0.y * v1.z;
-//	p2 = v2.z * (v1.y - v0.y) - v2.y * (v1.z - v0.z);
-//	r = e1 * Abs(f0.z) + e2 * Abs(f0.y);
-//	if (Max(-Max(p0, p2), Min(p0, p2)) > r)
-//		return 0; // axis is a separating axis
-//
-//	// Repeat similar tests for remaining axes a01..a22
-//	....;
-//
-//	// Test the three axes corresponding to the face normals of AABB b (category 1).
-//	// Exit if ...
-//	// ... [-e0, e0] and [min(v0.x, v1.x, v2.x), max(v0.x, v1.x, v2.x)] do not overlap
-//	if (Max(v0.x, v1.x, v2.x) < -e0 || Min(v0.x, v1.x, v2.x) > e0) return 0;
-//	// ... [-e1, e1] and [min(v0.y, v1.y, v2.y), max(v0.y, v1.y, v2.y)] do not overlap
-//	if (Max(v0.y, v1.y, v2.y) < -e1 || Min(v0.y, v1.y, v2.y) > e1) return 0;
-//	// ... [-e2, e2] and [min(v0.z, v1.z, v2.z), max(v0.z, v1.z, v2.z)] do not overlap
-//	if (Max(v0.z, v1.z, v2.z) < -e2 || Min(v0.z, v1.z, v2.z) > e2) return 0;
-//
-//
-//	// Test separating axis corresponding to triangle face normal (category 2)
-//	Plane p;
-//	p.n = Cross(f0, f1);
-//	p.d = Dot(p.n, v0);
-//	return TestAABBPlane(b, p);
-//}
-//
-//int TestAABBPlane(AABB b, Plane p)
-//{
-//	// These two lines not necessary with a (Center, extents) AABB representation
-//	Point c = (b.max + b.min) * 0.5f; // Compute AABB center
-//	Point e = b.max - c; // Compute positive extents
-//	// Compute the projection interval radius of b onto L(t) = b.c + t * p.n
-//	float r = e[0] * Abs(p.n[0]) + e[1] * Abs(p.n[1]) + e[2](Abs(p.n[2]);
-//	// Compute distance of box center from plane
-//	float s = Dot(p.n, c) - p.d;
-//	// Intersection occurs when distance s falls within [-r, +r] interval
-//	return Abs(s) <= r;
-//}
\ No newline at end of file
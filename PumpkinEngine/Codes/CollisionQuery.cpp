@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "..\Headers\CollisionQuery.h"
+#include "..\Headers\TriangleBVH.h"
+#include "..\Headers\Octree.h"
+#include "glm\geometric.hpp"
+
+
+USING(Engine)
+USING(glm)
+USING(std)
+
+CCollisionQueryContext::CCollisionQueryContext()
+	: m_iRayCount(0), m_iOverlapCount(0)
+{
+	m_vecLeaves.clear();
+	m_vecOrigins.clear();
+	m_vecTargets.clear();
+}
+
+CCollisionQueryContext::~CCollisionQueryContext()
+{
+}
+
+// Call instead of destructor to manage class internal data
+void CCollisionQueryContext::Destroy()
+{
+	m_vecLeaves.clear();
+	m_vecOrigins.clear();
+	m_vecTargets.clear();
+}
+
+void CCollisionQueryContext::RayClosest(CTriangleBVH* pBVH, const RAYQUERY& query, RAYRESULT& result)
+{
+	result.bHit = false;
+	result.fDistance = 0.f;
+	result.iTriangle = 0;
+	result.vPoint = query.vTarget;
+
+	_float fDist = distance(query.vTarget, query.vOrigin);
+	if (nullptr == pBVH || fDist <= 0.f)
+		return;
+
+	++m_iRayCount;
+	CTriangleBVH::RAYHIT hit;
+	if (pBVH->IntersectClosest(query.vOrigin, (query.vTarget - query.vOrigin) / fDist, fDist, hit))
+	{
+		result.bHit = true;
+		result.fDistance = hit.fDistance;
+		result.iTriangle = hit.iTriangle;
+		result.vPoint = hit.vPoint;
+	}
+}
+
+void CCollisionQueryContext::SegmentsBlocked(CTriangleBVH* pBVH, const RAYQUERY* pQueries, _uint count, _bool* pBlocked)
+{
+	if (nullptr == pBVH || nullptr == pQueries || nullptr == pBlocked || 0 == count)
+		return;
+
+	// Reused between calls, only grows
+	m_vecOrigins.resize(count);
+	m_vecTargets.resize(count);
+	for (_uint i = 0; i < count; ++i)
+	{
+		m_vecOrigins[i] = pQueries[i].vOrigin;
+		m_vecTargets[i] = pQueries[i].vTarget;
+	}
+
+	m_iRayCount += count;
+	pBVH->IntersectAnyBatch(m_vecOrigins.data(), m_vecTargets.data(), count, pBlocked);
+}
+
+const vector<_uint>& CCollisionQueryContext::OverlapOctree(COctree* pOctree, CBoundingBox* bbox)
+{
+	m_vecLeaves.clear();
+	if (nullptr == pOctree || nullptr == bbox)
+		return m_vecLeaves;
+
+	++m_iOverlapCount;
+	pOctree->CheckBoundingBox(bbox, m_vecLeaves);
+
+	return m_vecLeaves;
+}
+
+// Initialize
+RESULT CCollisionQueryContext::Ready()
+{
+	// Enough for a packet batch and a typical overlap without growing
+	m_vecLeaves.reserve(64);
+	m_vecOrigins.reserve(256);
+	m_vecTargets.reserve(256);
+
+	return PK_NOERROR;
+}
+
+// Create an instance
+CCollisionQueryContext* CCollisionQueryContext::Create()
+{
+	CCollisionQueryContext* pInstance = new CCollisionQueryContext();
+	if (PK_NOERROR != pInstance->Ready())
+	{
+		pInstance->Destroy();
+		pInstance = nullptr;
+	}
+
+	return pInstance;
+}
@@ -0,0 +1,276 @@
+#include "pch.h"
+#include "..\Headers\FrustumCuller.h"
+#include "glm\common.hpp"
+#include "glm\geometric.hpp"
+#include <limits>
+#include <xmmintrin.h>
+
+
+USING(Engine)
+USING(glm)
+USING(std)
+
+#define CULL_STACK_SIZE		64
+
+// Spread the low 10 bits so there are 2 zero bits between each of them
+static _uint ExpandBits(_uint value)
+{
+	value = (value * 0x00010001u) & 0xFF0000FFu;
+	value = (value * 0x00000101u) & 0x0F00F00Fu;
+	value = (value * 0x00000011u) & 0xC30C30C3u;
+	value = (value * 0x00000005u) & 0x49249249u;
+	return value;
+}
+
+// 4 boxes against the 6 planes, one bit per box in each mask
+static void TestPlanes4(const CFrustumCuller::NODE& node, const vec4 vPlanes[6], _int& outside, _int& inside)
+{
+	__m128 minX = _mm_loadu_ps(node.vMinX), maxX = _mm_loadu_ps(node.vMaxX);
+	__m128 minY = _mm_loadu_ps(node.vMinY), maxY = _mm_loadu_ps(node.vMaxY);
+	__m128 minZ = _mm_loadu_ps(node.vMinZ), maxZ = _mm_loadu_ps(node.vMaxZ);
+	__m128 zero = _mm_setzero_ps();
+	__m128 out = zero;
+	__m128 cross = zero;
+
+	for (_uint p = 0; p < 6; ++p)
+	{
+		const vec4& plane = vPlanes[p];
+		__m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z);
+
+		// The corner furthest along the normal decides outside, the nearest one decides fully inside
+		__m128 farX = plane.x >= 0.f ? maxX : minX, nearX = plane.x >= 0.f ? minX : maxX;
+		__m128 farY = plane.y >= 0.f ? maxY : minY, nearY = plane.y >= 0.f ? minY : maxY;
+		__m128 farZ = plane.z >= 0.f ? maxZ : minZ, nearZ = plane.z >= 0.f ? minZ : maxZ;
+
+		__m128 dFar = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, farX), _mm_mul_ps(ny, farY)), _mm_add_ps(_mm_mul_ps(nz, farZ), _mm_set1_ps(plane.w)));
+		__m128 dNear = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nearX), _mm_mul_ps(ny, nearY)), _mm_add_ps(_mm_mul_ps(nz, nearZ), _mm_set1_ps(plane.w)));
+
+		out = _mm_or_ps(out, _mm_cmplt_ps(dFar, zero));
+		cross = _mm_or_ps(cross, _mm_cmplt_ps(dNear, zero));
+	}
+
+	outside = _mm_movemask_ps(out);
+	inside = ~_mm_movemask_ps(cross) & 0xF;
+}
+
+CFrustumCuller::CFrustumCuller()
+	: m_iLeafNodeCount(0), m_iVisibleCount(0), m_iCulledCount(0), m_iNodeTestCount(0)
+{
+	for (_uint i = 0; i < 6; ++i)
+		m_vPlanes[i] = vec4(0.f, 0.f, 0.f, 1.f);
+	m_vecNodes.clear();
+	m_vecOrder.clear();
+	m_vecVisible.clear();
+}
+
+CFrustumCuller::~CFrustumCuller()
+{
+}
+
+// Call instead of destructor to manage class internal data
+void CFrustumCuller::Destroy()
+{
+	m_vecNodes.clear();
+	m_vecOrder.clear();
+	m_vecVisible.clear();
+}
+
+// Extract the 6 planes from a projection * view matrix (OpenGL clip space, -w <= z <= w)
+void CFrustumCuller::SetViewProjMatrix(const mat4x4& matViewProj)
+{
+	vec4 row[4];
+	for (_uint i = 0; i < 4; ++i)
+		row[i] = vec4(matViewProj[0][i], matViewProj[1][i], matViewProj[2][i], matViewProj[3][i]);
+
+	m_vPlanes[0] = row[3] + row[0];
+	m_vPlanes[1] = row[3] - row[0];
+	m_vPlanes[2] = row[3] + row[1];
+	m_vPlanes[3] = row[3] - row[1];
+	m_vPlanes[4] = row[3] + row[2];
+	m_vPlanes[5] = row[3] - row[2];
+
+	for (_uint i = 0; i < 6; ++i)
+	{
+		_float length = glm::length(vec3(m_vPlanes[i]));
+		if (length > 0.f)
+			m_vPlanes[i] /= length;
+	}
+}
+
+// Rebuild the tree over count boxes (pMin[i], pMax[i])
+void CFrustumCuller::Build(const vec3* pMin, const vec3* pMax, _uint count)
+{
+	m_vecNodes.clear();
+	m_vecOrder.resize(count);
+	m_vecVisible.assign(count, 0);
+	m_iLeafNodeCount = 0;
+	if (nullptr == pMin || nullptr == pMax || 0 == count)
+		return;
+
+	// Sort by the Morton code of the centers so neighbouring boxes share nodes
+	vec3 vCenterMin(numeric_limits<_float>::max());
+	vec3 vCenterMax(-numeric_limits<_float>::max());
+	for (_uint i = 0; i < count; ++i)
+	{
+		vec3 vCenter = (pMin[i] + pMax[i]) * 0.5f;
+		vCenterMin = glm::min(vCenterMin, vCenter);
+		vCenterMax = glm::max(vCenterMax, vCenter);
+	}
+
+	vec3 vExtent = vCenterMax - vCenterMin;
+	vec3 vScale(vExtent.x > 0.f ? 1023.f / vExtent.x : 0.f,
+		vExtent.y > 0.f ? 1023.f / vExtent.y : 0.f,
+		vExtent.z > 0.f ? 1023.f / vExtent.z : 0.f);
+
+	vector<pair<_uint, _uint>> vecCodes(count);
+	for (_uint i = 0; i < count; ++i)
+	{
+		vec3 vCell = ((pMin[i] + pMax[i]) * 0.5f - vCenterMin) * vScale;
+		vecCodes[i].first = ExpandBits((_uint)vCell.x) | (ExpandBits((_uint)vCell.y) << 1) | (ExpandBits((_uint)vCell.z) << 2);
+		vecCodes[i].second = i;
+	}
+	sort(vecCodes.begin(), vecCodes.end());
+	for (_uint i = 0; i < count; ++i)
+		m_vecOrder[i] = vecCodes[i].second;
+
+	// Bottom level : 4 boxes per node
+	m_iLeafNodeCount = (count + 3) / 4;
+	m_vecNodes.reserve(m_iLeafNodeCount * 2);
+	for (_uint n = 0; n < m_iLeafNodeCount; ++n)
+	{
+		NODE node;
+		for (_uint s = 0; s < 4; ++s)
+		{
+			_uint sorted = 4 * n + s;
+			vec3 vMin(0.f), vMax(0.f);
+			if (sorted < count)
+			{
+				vMin = pMin[m_vecOrder[sorted]];
+				vMax = pMax[m_vecOrder[sorted]];
+			}
+			node.vMinX[s] = vMin.x; node.vMinY[s] = vMin.y; node.vMinZ[s] = vMin.z;
+			node.vMaxX[s] = vMax.x; node.vMaxY[s] = vMax.y; node.vMaxZ[s] = vMax.z;
+			node.iChild[s] = 0;
+			node.iFirst[s] = sorted;
+			node.iCount[s] = sorted < count ? 1 : 0;
+		}
+		m_vecNodes.push_back(node);
+	}
+
+	// Upper levels : 4 nodes per node until only the root is left
+	_uint levelStart = 0;
+	_uint levelCount = m_iLeafNodeCount;
+	while (1 < levelCount)
+	{
+		_uint nextStart = (_uint)m_vecNodes.size();
+		_uint nextCount = (levelCount + 3) / 4;
+		for (_uint n = 0; n < nextCount; ++n)
+		{
+			NODE node;
+			for (_uint s = 0; s < 4; ++s)
+			{
+				_uint child = 4 * n + s;
+				vec3 vMin(numeric_limits<_float>::max());
+				vec3 vMax(-numeric_limits<_float>::max());
+				node.iChild[s] = levelStart + child;
+				node.iFirst[s] = 0;
+				node.iCount[s] = 0;
+
+				if (child < levelCount)
+				{
+					const NODE& src = m_vecNodes[levelStart + child];
+					node.iFirst[s] = src.iFirst[0];
+					for (_uint c = 0; c < 4; ++c)
+					{
+						if (0 == src.iCount[c])
+							continue;
+						vMin = glm::min(vMin, vec3(src.vMinX[c], src.vMinY[c], src.vMinZ[c]));
+						vMax = glm::max(vMax, vec3(src.vMaxX[c], src.vMaxY[c], src.vMaxZ[c]));
+						node.iCount[s] += src.iCount[c];
+					}
+				}
+				else
+					vMin = vMax = vec3(0.f);
+
+				node.vMinX[s] = vMin.x; node.vMinY[s] = vMin.y; node.vMinZ[s] = vMin.z;
+				node.vMaxX[s] = vMax.x; node.vMaxY[s] = vMax.y; node.vMaxZ[s] = vMax.z;
+			}
+			m_vecNodes.push_back(node);
+		}
+
+		levelStart = nextStart;
+		levelCount = nextCount;
+	}
+}
+
+// Test the built boxes against the current planes, return the number of visible boxes
+_uint CFrustumCuller::Cull()
+{
+	_uint count = (_uint)m_vecOrder.size();
+	m_vecVisible.assign(count, 0);
+	m_iVisibleCount = 0;
+	m_iCulledCount = 0;
+	m_iNodeTestCount = 0;
+	if (m_vecNodes.empty())
+		return 0;
+
+	_uint stack[CULL_STACK_SIZE];
+	_uint stackSize = 0;
+	stack[stackSize++] = (_uint)m_vecNodes.size() - 1;
+
+	while (0 < stackSize)
+	{
+		_uint index = stack[--stackSize];
+		const NODE& node = m_vecNodes[index];
+		++m_iNodeTestCount;
+
+		_int outside = 0, inside = 0;
+		TestPlanes4(node, m_vPlanes, outside, inside);
+
+		for (_uint c = 0; c < 4; ++c)
+		{
+			if (0 == node.iCount[c] || (outside & (1 << c)))
+				continue;
+
+			// Whole subtree inside, or a single box that is at least partly inside
+			if ((inside & (1 << c)) || index < m_iLeafNodeCount)
+				MarkVisible(node.iFirst[c], node.iCount[c]);
+			else if (stackSize < CULL_STACK_SIZE)
+				stack[stackSize++] = node.iChild[c];
+		}
+	}
+
+	m_iCulledCount = count - m_iVisibleCount;
+
+	return m_iVisibleCount;
+}
+
+void CFrustumCuller::MarkVisible(_uint first, _uint count)
+{
+	for (_uint i = first; i < first + count; ++i)
+		m_vecVisible[m_vecOrder[i]] = 1;
+	m_iVisibleCount += count;
+}
+
+// Initialize
+RESULT CFrustumCuller::Ready()
+{
+	m_vecNodes.reserve(64);
+	m_vecOrder.reserve(128);
+	m_vecVisible.reserve(128);
+
+	return PK_NOERROR;
+}
+
+// Create an instance
+CFrustumCuller* CFrustumCuller::Create()
+{
+	CFrustumCuller* pInstance = new CFrustumCuller();
+	if (PK_NOERROR != pInstance->Ready())
+	{
+		pInstance->Destroy();
+		pInstance = nullptr;
+	}
+
+	return pInstance;
+}
@@ -12,6 +12,7 @@
 #include "..\Headers\CollisionMaster.h"
 #include "..\Headers\LightMaster.h"
 #include "..\Headers\AnimationData.h"
+#include "..\Headers\TextureStreamer.h"
 
 #include "..\Headers\Scene.h"
 
@@ -41,6 +42,9 @@ void CGameMaster::Update(const _float& dt)
 // Basic Render Function, render renderer (and scene if needed)
 void CGameMaster::Render()
 {
+	// Streamed textures are uploaded before anything is drawn with them
+	CTextureStreamer::GetInstance()->Update();
+
 	if (nullptr != m_pRenderer)
 		m_pRenderer->Render();
 
@@ -53,6 +57,7 @@ void CGameMaster::Destroy()
 {
 	SafeDestroy(m_pCurrentScene);
 
+	SafeDestroy(CTextureStreamer::GetInstance());
 	SafeDestroy(CXMLParser::GetInstance());
 	SafeDestroy(CJsonParser::GetInstance());
 	SafeDestroy(CComponentMaster::GetInstance());
@@ -2,7 +2,11 @@
 #include "..\Headers\JsonParser.h"
 #include "..\Headers\ComponentMaster.h"
 #include "..\Headers\Mesh.h"
+#include "..\Headers\MeshGeometry.h"
 #include "..\Headers\Texture.h"
+#include "..\Headers\AssetLoader.h"
+#include "..\Headers\TextureCooker.h"
+#include "..\Headers\ParallelFor.h"
 #include "glm\vec3.hpp"
 
 #include "rapidjson\document.h"
@@ -75,7 +79,7 @@ void CJsonParser::LoadCharacterList(std::string assetFolderPath, std::string fil
 }
 
 // Load Textures from file
-void CJsonParser::LoadTextureData(std::string assetFolderPath, std::string fileName)
+void CJsonParser::LoadTextureData(std::string assetFolderPath, std::string fileName, CAssetLoader* pLoader)
 {
 	Document doc;
 	FILE* file;
@@ -92,24 +96,33 @@ void CJsonParser::LoadTextureData(std::string assetFolderPath, std::string fileN
 
 		stringstream ss;
 		ss << assetFolderPath << data.PATH << data.FILENAME;
-		CComponent* pComp = CTexture::Create(data.ID, ss.str());
+		if (nullptr != pLoader)
+		{
+			AddTextureJob(pLoader, data, ss.str());
+			continue;
+		}
+
+		// Streamed : the placeholder is usable right away, the file is decoded in the background
+		CComponent* pComp = CTexture::CreateAsync(data.ID, ss.str());
 
 		if (nullptr != pComp)
 			m_pCompMaster->AddNewComponent(data.ID, pComp);
 
-		cout << "Texture Loading... " << data.ID << " Loaded" << endl;
+		cout << "Texture Loading... " << data.ID << " Queued" << endl;
 	}
 
 	std::fclose(file);
 }
 
 // Load Meshes from file
-void CJsonParser::LoadMeshData(std::string assetFolderPath, std::string fileName, _bool saveMeshList)
+void CJsonParser::LoadMeshData(std::string assetFolderPath, std::string fileName, _bool saveMeshList, CAssetLoader* pLoader)
 {
 	Document doc;
 	FILE* file;
 	LoadDataFromFile(doc, file, assetFolderPath, fileName);
 
+	// A file listed twice would be loaded (and its cache written) twice at the same time
+	MESHLOAD_MAP mapLoads;
 	for (unsigned int i = 0; i < doc.Size(); ++i)
 	{
 		sMeshData data;
@@ -128,6 +141,12 @@ void CJsonParser::LoadMeshData(std::string assetFolderPath, std::string fileName
 
 		stringstream ss;
 		ss << assetFolderPath << data.PATH;
+		if (nullptr != pLoader)
+		{
+			AddMeshJob(pLoader, data, ss.str(), saveMeshList, mapLoads);
+			continue;
+		}
+
 		CComponent* pComp = CMesh::Create(data.ID, ss.str(), data.FILENAME,
 			(eModelType)data.DATATYPE, data.SHADER_ID, data.INITSIZE, data.MESHTYPE,
 			data.TEXTURE_ID_DIFF, data.TEXTURE_ID_NORMAL);
@@ -145,6 +164,212 @@ void CJsonParser::LoadMeshData(std::string assetFolderPath, std::string fileName
 	std::fclose(file);
 }
 
+// Read the mesh list only, nothing is loaded
+void CJsonParser::LoadMeshList(std::string assetFolderPath, std::string fileName, std::vector<sMeshData>& vec)
+{
+	Document doc;
+	FILE* file;
+	LoadDataFromFile(doc, file, assetFolderPath, fileName);
+
+	for (unsigned int i = 0; i < doc.Size(); ++i)
+	{
+		sMeshData data;
+
+		const Value& curData = doc[i];
+
+		data.ID = curData["ID"].GetString();
+		data.PATH = curData["Path"].GetString();
+		data.FILENAME = curData["FileName"].GetString();
+		data.DATATYPE = curData["DataType"].GetInt();
+		data.SHADER_ID = curData["Shader_ID"].GetString();
+		data.INITSIZE = to_string(curData["InitSize"].GetFloat());
+		data.MESHTYPE = curData["MeshType"].GetString();
+		data.TEXTURE_ID_DIFF = curData["Texture_ID_Diff"].GetString();
+		data.TEXTURE_ID_NORMAL = curData["Texture_ID_Normal"].GetString();
+
+		vec.push_back(data);
+	}
+
+	std::fclose(file);
+}
+
+// Decode the image on a worker, create the texture on the loading thread
+void CJsonParser::AddTextureJob(CAssetLoader* pLoader, const sTexturedata& data, string filePath)
+{
+	CTexture::TEXTUREFILEDATA* pFileData = new CTexture::TEXTUREFILEDATA();
+	CComponentMaster* pMaster = m_pCompMaster;
+	string ID = data.ID;
+
+	pLoader->AddJob(
+		[pFileData, filePath]()
+		{
+			CTexture::LoadImageFile(filePath, *pFileData);
+		},
+		[pFileData, pMaster, ID]()
+		{
+			CComponent* pComp = CTexture::Create(ID, *pFileData);
+			if (nullptr != pComp)
+				pMaster->AddNewComponent(ID, pComp);
+
+			cout << "Texture Loading... " << ID << " Loaded" << endl;
+		},
+		[pFileData]()
+		{
+			CTexture::ReleaseImageFile(*pFileData);
+			delete pFileData;
+		});
+}
+
+struct CJsonParser::sMeshLoad
+{
+	CMesh::MESHFILEDATA data;
+	CMeshGeometry* pGeometry;
+	_uint iJobNum;
+};
+
+// Read the mesh (cache or PLY) on a worker, create the buffers on the loading thread
+// Only the first entry of a file reads it, the later ones share its geometry
+void CJsonParser::AddMeshJob(CAssetLoader* pLoader, const sMeshData& data, string filePath, _bool saveMeshList, MESHLOAD_MAP& mapLoads)
+{
+	CComponentMaster* pMaster = m_pCompMaster;
+
+	// The model type picks the vertex layout, so it is part of the key
+	string key = filePath + data.FILENAME + "|" + to_string(data.DATATYPE);
+	MESHLOAD_MAP::iterator iter = mapLoads.find(key);
+	_bool first = mapLoads.end() == iter;
+	sMeshLoad* pLoad = nullptr;
+	if (first)
+	{
+		pLoad = new sMeshLoad();
+		pLoad->pGeometry = nullptr;
+		pLoad->iJobNum = 0;
+		mapLoads.insert(MESHLOAD_MAP::value_type(key, pLoad));
+	}
+	else
+		pLoad = iter->second;
+	++pLoad->iJobNum;
+
+	pLoader->AddJob(
+		[pLoad, data, filePath, first]()
+		{
+			if (first)
+				CMesh::LoadMeshFile((eModelType)data.DATATYPE, filePath, data.FILENAME, pLoad->data);
+		},
+		[pLoad, pMaster, data, saveMeshList, first]()
+		{
+			// Uploads run in list order, so the first entry has created the geometry by now
+			CMesh* pMesh = nullptr;
+			if (first)
+			{
+				pMesh = CMesh::Create(data.ID, pLoad->data,
+					(eModelType)data.DATATYPE, data.SHADER_ID, data.INITSIZE, data.MESHTYPE,
+					data.TEXTURE_ID_DIFF, data.TEXTURE_ID_NORMAL);
+
+				if (nullptr != pMesh && nullptr != pMesh->GetGeometry())
+				{
+					pLoad->pGeometry = pMesh->GetGeometry();
+					pLoad->pGeometry->AddRefCnt();
+				}
+			}
+			else if (nullptr != pLoad->pGeometry)
+			{
+				pMesh = CMesh::Create(data.ID, pLoad->pGeometry,
+					data.SHADER_ID, data.INITSIZE, data.MESHTYPE,
+					data.TEXTURE_ID_DIFF, data.TEXTURE_ID_NORMAL);
+			}
+
+			if (nullptr != pMesh)
+			{
+				pMaster->AddNewComponent(data.ID, pMesh);
+				if (saveMeshList)
+					pMaster->AddNewMeshInfo(data.ID);
+			}
+
+			cout << "Mesh Loading... " << data.ID << " Loaded" << endl;
+		},
+		[pLoad]()
+		{
+			// The last entry of the file frees the load
+			if (0 < --pLoad->iJobNum)
+				return;
+
+			CMesh::ReleaseMeshFile(pLoad->data);
+			SafeDestroy(pLoad->pGeometry);
+			delete pLoad;
+		});
+}
+
+// Write the binary cache of every mesh in the list without loading them
+void CJsonParser::ConvertMeshData(std::string assetFolderPath, std::string fileName)
+{
+	Document doc;
+	FILE* file;
+	LoadDataFromFile(doc, file, assetFolderPath, fileName);
+
+	for (unsigned int i = 0; i < doc.Size(); ++i)
+	{
+		const Value& curData = doc[i];
+
+		stringstream ss;
+		ss << assetFolderPath << curData["Path"].GetString();
+		_float acmr[2] = { 0.f, 0.f };
+		RESULT result = CMesh::ConvertMeshFile(ss.str(), curData["FileName"].GetString(), (eModelType)curData["DataType"].GetInt(), acmr);
+
+		cout << "Mesh Converting... " << curData["ID"].GetString();
+		if (PK_NOERROR == result)
+			cout << " Done (ACMR " << acmr[0] << " -> " << acmr[1] << ")" << endl;
+		else
+			cout << " Failed" << endl;
+	}
+
+	std::fclose(file);
+}
+
+// Cook the compressed cache of every texture in the list, textures run in parallel
+void CJsonParser::CookTextureData(std::string assetFolderPath, std::string fileName)
+{
+	Document doc;
+	FILE* file;
+	LoadDataFromFile(doc, file, assetFolderPath, fileName);
+
+	vector<string> vecID;
+	vector<string> vecPath;
+	for (unsigned int i = 0; i < doc.Size(); ++i)
+	{
+		const Value& curData = doc[i];
+
+		stringstream ss;
+		ss << assetFolderPath << curData["Path"].GetString() << curData["FileName"].GetString();
+		vecID.push_back(curData["ID"].GetString());
+		vecPath.push_back(ss.str());
+	}
+	std::fclose(file);
+
+	_uint count = (_uint)vecPath.size();
+	vector<RESULT> vecResult(count, PK_ERROR);
+	vector<CTextureCooker::COOKRESULT> vecCooked(count);
+	ParallelFor(count, 1, [&](_uint begin, _uint end, _uint worker)
+	{
+		for (_uint i = begin; i < end; ++i)
+			vecResult[i] = CTextureCooker::CookTextureFile(vecPath[i], &vecCooked[i]);
+	});
+
+	for (_uint i = 0; i < count; ++i)
+	{
+		const CTextureCooker::COOKRESULT& cooked = vecCooked[i];
+
+		cout << "Texture Cooking... " << vecID[i];
+		if (PK_NOERROR == vecResult[i])
+		{
+			cout << " Done (" << cooked.iWidth << "x" << cooked.iHeight
+				<< (TEXTURE_BC3_BLOCK_SIZE == cooked.iBlockSize ? " BC3, " : " BC1, ") << cooked.iLevelNum << " levels, "
+				<< cooked.iRawSize << " -> " << cooked.iCookedSize << " bytes, checksum " << hex << cooked.iChecksum << dec << ")" << endl;
+		}
+		else
+			cout << " Failed" << endl;
+	}
+}
+
 // Load Objects from file
 void CJsonParser::LoadObjectList(string assetFolderPath, string fileName, vector<sObjectData>& vec, sObjectData& cameraData)
 {
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "..\Headers\MappedFile.h"
+
+
+USING(Engine)
+USING(std)
+
+CMappedFile::CMappedFile()
+	: m_hFile(INVALID_HANDLE_VALUE), m_hMapping(nullptr), m_pData(nullptr), m_iSize(0)
+{
+}
+
+CMappedFile::~CMappedFile()
+{
+}
+
+// Call instead of destructor to manage class internal data
+void CMappedFile::Destroy()
+{
+	if (nullptr != m_pData)
+		UnmapViewOfFile(m_pData);
+	if (nullptr != m_hMapping)
+		CloseHandle(m_hMapping);
+	if (INVALID_HANDLE_VALUE != m_hFile)
+		CloseHandle(m_hFile);
+
+	m_pData = nullptr;
+	m_hMapping = nullptr;
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_iSize = 0;
+}
+
+_ulonglong CMappedFile::HashBytes(const void* pData, size_t size, _ulonglong seed)
+{
+	const _uchar* pBytes = static_cast<const _uchar*>(pData);
+	_ulonglong hash = seed;
+
+	// 8 bytes per step, source files can be tens of MB
+	size_t wordCount = size / sizeof(_ulonglong);
+	for (size_t i = 0; i < wordCount; ++i)
+	{
+		_ulonglong word;
+		memcpy(&word, pBytes + i * sizeof(_ulonglong), sizeof(_ulonglong));
+		hash ^= word;
+		hash *= 1099511628211ULL;
+		hash ^= hash >> 32;
+	}
+
+	for (size_t i = wordCount * sizeof(_ulonglong); i < size; ++i)
+	{
+		hash ^= pBytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+// Initialize
+RESULT CMappedFile::Ready(const string& path)
+{
+	m_hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (INVALID_HANDLE_VALUE == m_hFile)
+		return PK_ERROR_MESHFILE_OPEN;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_hFile, &fileSize) || 0 == fileSize.QuadPart)
+		return PK_ERROR;
+	m_iSize = (size_t)fileSize.QuadPart;
+
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (nullptr == m_hMapping)
+		return PK_ERROR;
+
+	m_pData = static_cast<const _uchar*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+	if (nullptr == m_pData)
+		return PK_ERROR;
+
+	return PK_NOERROR;
+}
+
+// Create an instance
+CMappedFile* CMappedFile::Create(const string& path)
+{
+	CMappedFile* pInstance = new CMappedFile();
+	if (PK_NOERROR != pInstance->Ready(path))
+	{
+		pInstance->Destroy();
+		pInstance = nullptr;
+	}
+
+	return pInstance;
+}
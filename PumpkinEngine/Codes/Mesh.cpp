@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "../Headers/Mesh.h"
+#include "../Headers/MeshGeometry.h"
 #include "../Headers/VIBuffer.h"
 #include "../Headers/Component.h"
 #include "../Headers/ComponentMaster.h"
@@ -9,6 +10,9 @@
 #include "../Headers/Transform.h"
 #include "../Headers/BoundingBox.h"
 #include "../Headers/AnimController.h"
+#include "../Headers/TriangleBVH.h"
+#include "../Headers/MappedFile.h"
+#include "../Headers/MeshOptimizer.h"
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
@@ -18,6 +22,39 @@ USING(Engine)
 USING(std)
 USING(glm)
 
+#define MESH_CACHE_MAGIC        0x48534D50      // "PMSH"
+#define MESH_CACHE_VERSION      5
+#define MESH_CACHE_ALIGN        16
+
+// Binary mesh cache header, every section starts at a 16 byte aligned offset so it can be used in place when mapped
+typedef struct sMeshCacheHeader
+{
+    _uint           iMagic;
+    _uint           iVersion;
+    _ulonglong      iSourceHash;        // Hash of the PLY file and the vertex layout
+    _uint           iVertexNum;
+    _uint           iVertexSize;        // Compact layout of the model type
+    _uint           iIndexNum;
+    _uint           iIndexSize;         // 2 or 4 bytes
+    _uint           iTriNum;
+    _uint           iTextureNameLength;
+    _float          vMin[3];
+    _float          vMax[3];
+    _float          vColour[4];         // Mesh colour for layouts without one
+    _uint           iLODNum;
+    MESHLOD         LODs[MESH_MAX_LOD]; // Ranges of the index section
+    _uint           iVertexOffset;
+    _uint           iIndexOffset;
+    _uint           iTriangleOffset;
+    _uint           iTextureNameOffset;
+    _uint           iFileSize;
+}MESHCACHEHEADER;
+
+static _uint AlignCacheOffset(size_t offset)
+{
+    return (_uint)((offset + MESH_CACHE_ALIGN - 1) & ~(size_t)(MESH_CACHE_ALIGN - 1));
+}
+
 static int GetRandNum(int min, int max)
 {
     return (rand() % (max - min + 1)) + min;
@@ -25,7 +62,7 @@ static int GetRandNum(int min, int max)
 
 CMesh::CMesh()
     : m_pOpenGLDevice(COpenGLDevice::GetInstance())
-    , m_pVIBuffer(nullptr)
+    , m_pGeometry(nullptr)
     , m_pBoundingBox(nullptr)
     , m_pDiffTexture(nullptr)
     , m_pNormalTexture(nullptr)
@@ -36,9 +73,8 @@ CMesh::CMesh()
     , m_bDebug(false)
     , m_bTransparency(false)
     , m_bBiilboard(false)
-    , m_textureFileName("")
-    , m_iTriNum(0)
-    , m_pTriangles(nullptr)
+    , m_fLODPixelError(MESH_LOD_PIXEL_ERROR)
+    , m_iLastLOD(0)
     , m_pAnimController(nullptr)
     , m_initSize("")
     , m_meshType("")
@@ -46,9 +82,11 @@ CMesh::CMesh()
     m_pOpenGLDevice->AddRefCnt();
 }
 
+// Clones share the geometry and the resources, only the render state is copied
 CMesh::CMesh(const CMesh& rhs)
     : m_pOpenGLDevice(rhs.m_pOpenGLDevice)
-    , m_pVIBuffer(rhs.m_pVIBuffer)
+    , m_pGeometry(rhs.m_pGeometry)
+    , m_pBoundingBox(nullptr)
     , m_pDiffTexture(rhs.m_pDiffTexture)
     , m_pNormalTexture(rhs.m_pNormalTexture)
     , m_pShader(rhs.m_pShader)
@@ -58,27 +96,23 @@ CMesh::CMesh(const CMesh& rhs)
     , m_bDebug(rhs.m_bDebug)
     , m_bBiilboard(rhs.m_bBiilboard)
     , m_bTransparency(rhs.m_bTransparency)
-    , m_textureFileName(rhs.m_textureFileName)
-    , m_iTriNum(rhs.m_iTriNum)
+    , m_fLODPixelError(rhs.m_fLODPixelError)
+    , m_iLastLOD(0)
     , m_pAnimController(nullptr)
     , m_initSize(rhs.m_initSize)
     , m_meshType(rhs.m_meshType)
 {
     m_tag = rhs.m_tag;
     m_pOpenGLDevice->AddRefCnt();
-    if (nullptr != m_pVIBuffer) m_pVIBuffer->AddRefCnt();
+    if (nullptr != m_pGeometry) m_pGeometry->AddRefCnt();
     if (nullptr != m_pDiffTexture) m_pDiffTexture->AddRefCnt();
     if (nullptr != m_pNormalTexture) m_pNormalTexture->AddRefCnt();
     if (nullptr != m_pShader) m_pShader->AddRefCnt();
 
-    m_pBoundingBox = CBoundingBox::Create(
-        rhs.m_pBoundingBox->m_vMin
-        , rhs.m_pBoundingBox->m_vMax
-        , rhs.m_pBoundingBox->m_shaderID);
-
-    m_pTriangles = new TRIANGLE[rhs.m_iTriNum];
-    memcpy(m_pTriangles, rhs.m_pTriangles, sizeof(TRIANGLE) * rhs.m_iTriNum);
-;}
+    // The box keeps its own transform and world bounds, its buffers are shared
+    if (nullptr != rhs.m_pBoundingBox)
+        m_pBoundingBox = dynamic_cast<CBoundingBox*>(rhs.m_pBoundingBox->Clone());
+}
 
 CMesh::~CMesh()
 {
@@ -146,14 +180,21 @@ void CMesh::Render()
         glBindTexture(GL_TEXTURE_2D, m_pNormalTexture->GetTextureID());
     }
 
-	if (nullptr != m_pVIBuffer)
+	if (nullptr != m_pGeometry)
     {
         if (m_bTransparency)
             glDepthMask(GL_FALSE);
         else
             glDepthMask(GL_TRUE);
-        m_pVIBuffer->SetWireFrame(m_bWireFrame);
-        m_pVIBuffer->Render();
+
+        // Level of detail from the projected size of the bounding sphere
+        m_iLastLOD = 0;
+        if (0.f < m_fLODPixelError)
+        {
+            m_iLastLOD = SelectLOD(m_pGeometry->GetLODs(), m_pGeometry->GetLODNumber(), matView * matWorld, matProj,
+                m_pGeometry->GetCenter(), m_pGeometry->GetRadius(), (_float)m_pOpenGLDevice->GetHeightSize(), m_fLODPixelError);
+        }
+        m_pGeometry->Render(m_iLastLOD, m_bWireFrame);
 
         glDepthMask(GL_TRUE);
     }
@@ -166,18 +207,74 @@ void CMesh::Render()
 void CMesh::Destroy()
 {
     SafeDestroy(m_pOpenGLDevice);
-    SafeDestroy(m_pVIBuffer);
+    SafeDestroy(m_pGeometry);
     SafeDestroy(m_pBoundingBox);
     SafeDestroy(m_pDiffTexture);
     SafeDestroy(m_pNormalTexture);
     SafeDestroy(m_pShader);
     m_pParentTransform = nullptr;
-    if (nullptr != m_pTriangles)
-        delete m_pTriangles;
 
 	CComponent::Destroy();
 }
 
+// Coarsest level whose deviation, projected on screen, stays within pixelError pixels
+// The distance is taken to the nearest point of the bounding sphere, so a level never pops in while the camera closes in on it
+_uint CMesh::SelectLOD(const MESHLOD* pLODs, _uint lodNum, const mat4x4& matWorldView, const mat4x4& matProj,
+    const vec3& vCenter, _float fRadius, _float viewportHeight, _float pixelError)
+{
+    if (lodNum < 2)
+        return 0;
+
+    // Largest axis scale of the transform
+    vec3 vAxisX = vec3(matWorldView[0]);
+    vec3 vAxisY = vec3(matWorldView[1]);
+    vec3 vAxisZ = vec3(matWorldView[2]);
+    _float scale = sqrt(glm::max(glm::max(dot(vAxisX, vAxisX), dot(vAxisY, vAxisY)), dot(vAxisZ, vAxisZ)));
+    _float distance = length(vec3(matWorldView * vec4(vCenter, 1.f))) - fRadius * scale;
+    if (0.f >= distance)
+        return 0;
+
+    // Pixels per world unit at that distance (matProj[1][1] = 1 / tan(fovy / 2))
+    _float pixelsPerUnit = matProj[1][1] * 0.5f * viewportHeight / distance;
+
+    _uint lod = 0;
+    for (_uint i = 1; i < lodNum; ++i)
+    {
+        if (pLODs[i].fError * scale * pixelsPerUnit > pixelError)
+            break;
+        lod = i;
+    }
+
+    return lod;
+}
+
+const TRIANGLE* CMesh::GetTriangleArray()
+{
+    return nullptr != m_pGeometry ? m_pGeometry->GetTriangleArray() : nullptr;
+}
+
+_uint CMesh::GetTriangleNumber()
+{
+    return nullptr != m_pGeometry ? m_pGeometry->GetTriangleNumber() : 0;
+}
+
+// BVH over the local-space triangles for ray queries, built once for all clones
+CTriangleBVH* CMesh::GetTriangleBVH()
+{
+    return nullptr != m_pGeometry ? m_pGeometry->GetTriangleBVH() : nullptr;
+}
+
+// Octree over the local-space triangles for box queries, built (or mapped from its cache) once for all clones
+COctree* CMesh::GetOctree()
+{
+    return nullptr != m_pGeometry ? m_pGeometry->GetOctree() : nullptr;
+}
+
+string CMesh::GetTexName()
+{
+    return nullptr != m_pGeometry ? m_pGeometry->GetTexName() : "";
+}
+
 // Set diffuse texture
 void CMesh::SetTexture(std::string texID_diff)
 {
@@ -191,22 +288,45 @@ void CMesh::SetTexture(std::string texID_diff)
 // Initialize Mesh
 RESULT CMesh::Ready(string ID, string filePath, string fileName, eModelType type,
     string shaderID, string initSize, string meshType, string texID_Diff, string texID_Normal)
+{
+    MESHFILEDATA data;
+    LoadMeshFile(type, filePath, fileName, data);
+
+    RESULT result = Ready(ID, data, type, shaderID, initSize, meshType, texID_Diff, texID_Normal);
+    ReleaseMeshFile(data);
+
+    return result;
+}
+
+// Initialize Mesh from loaded mesh data
+RESULT CMesh::Ready(string ID, MESHFILEDATA& data, eModelType type,
+    string shaderID, string initSize, string meshType, string texID_Diff, string texID_Normal)
 {
     m_tag = ID;
     m_initSize = initSize;
     m_meshType = meshType;
 
-    VTX* pVertices = nullptr;
-    _uint* pIndices = nullptr;
-    _uint vertexNum = 0;
-    _uint indexNum = 0;
+    Ready_Geometry(type, data);
+
+    Ready_Texture_Diff(texID_Diff);
+    Ready_Texture_Normal(texID_Normal);
+    Ready_Shader(shaderID);
 
-    Ready_VIBuffer(type, filePath, fileName, &pVertices, &pIndices, vertexNum, indexNum);
+    if (nullptr != m_pShader)
+        m_pShader->SetTextureInfo();
 
-    m_pVIBuffer = CVIBuffer::Create(vertexNum, pVertices, indexNum, pIndices, type);
-    
-    delete[] pVertices;
-    delete[] pIndices;
+	return PK_NOERROR;
+}
+
+// Create the shared geometry from loaded mesh data
+RESULT CMesh::Ready(string ID, CMeshGeometry* pGeometry,
+    string shaderID, string initSize, string meshType, string texID_Diff, string texID_Normal)
+{
+    m_tag = ID;
+    m_initSize = initSize;
+    m_meshType = meshType;
+
+    Ready_Geometry(pGeometry);
 
     Ready_Texture_Diff(texID_Diff);
     Ready_Texture_Normal(texID_Normal);
@@ -215,18 +335,83 @@ RESULT CMesh::Ready(string ID, string filePath, string fileName, eModelType type
     if (nullptr != m_pShader)
         m_pShader->SetTextureInfo();
 
-	return PK_NOERROR;
+    return PK_NOERROR;
+}
+
+RESULT CMesh::Ready_Geometry(eModelType type, MESHFILEDATA& data)
+{
+    m_pGeometry = CMeshGeometry::Create(type, data);
+    if (nullptr == m_pGeometry)
+        return PK_ERROR_MESHFILE_OPEN;
+
+    m_pBoundingBox = CBoundingBox::Create(data.vMin, data.vMax, "DebugBoxShader");
+
+    return PK_NOERROR;
+}
+
+// Take a reference on geometry already created for another mesh
+RESULT CMesh::Ready_Geometry(CMeshGeometry* pGeometry)
+{
+    if (nullptr == pGeometry)
+        return PK_ERROR_MESHFILE_OPEN;
+
+    m_pGeometry = pGeometry;
+    m_pGeometry->AddRefCnt();
+
+    m_pBoundingBox = CBoundingBox::Create(m_pGeometry->GetMin(), m_pGeometry->GetMax(), "DebugBoxShader");
+
+    return PK_NOERROR;
+}
+
+// Read a mesh from its binary cache or its PLY file (no GL context needed, safe on any thread)
+// The cache next to the mesh is mapped when it was made from the same file, otherwise the PLY is parsed and cached
+RESULT CMesh::LoadMeshFile(eModelType type, string filePath, string fileName, MESHFILEDATA& data)
+{
+    data.sourcePath = filePath + fileName;
+    string cachePath = data.sourcePath + ".mesh";
+
+    _ulonglong sourceHash = 0;
+    if (!HashMeshFile(data.sourcePath, type, sourceHash))
+        return PK_ERROR_MESHFILE_OPEN;
+
+    if (PK_NOERROR == MapMeshCache(type, cachePath, sourceHash, data))
+        return PK_NOERROR;
+
+    RESULT result = LoadPLY(type, data.sourcePath, data);
+    if (PK_NOERROR != result)
+        return result;
+
+    SaveMeshCache(cachePath, sourceHash, data);
+
+    return PK_NOERROR;
 }
 
-// Load mesh information from file
-RESULT CMesh::Ready_VIBuffer(eModelType type, string filePath, string fileName, VTX** pVertices, _uint** pIndices, _uint& vertexNum, _uint& indexNum)
+// Free whatever a mesh created from the data did not take over
+void CMesh::ReleaseMeshFile(MESHFILEDATA& data)
 {
-    stringstream ss;
-    ss << filePath << fileName;
-    ifstream file(ss.str());
+    // Mapped arrays go away with the mapping
+    if (nullptr == data.pMappedFile)
+    {
+        delete[] data.pVertices;
+        delete[] data.pIndices;
+        delete[] data.pTriangles;
+    }
+    SafeDestroy(data.pMappedFile);
+
+    data.pMappedFile = nullptr;
+    data.pVertices = nullptr;
+    data.pIndices = nullptr;
+    data.pTriangles = nullptr;
+}
+
+// Parse an ASCII PLY file
+RESULT CMesh::LoadPLY(eModelType type, const string& path, MESHFILEDATA& data)
+{
+    ifstream file(path);
     if (!file.is_open())
         return PK_ERROR_MESHFILE_OPEN;
 
+    _uint vertexNum = 0;
     _uint triangleNum = 0;
     const _uint bufSize = 10000;
     char buffer[bufSize];
@@ -245,7 +430,7 @@ RESULT CMesh::Ready_VIBuffer(eModelType type, string filePath, string fileName,
             file >> triangleNum;
 
         if (next == "TextureFile")
-            file >> m_textureFileName;
+            file >> data.textureFileName;
     }
 
     vec3 vMin = vec3(FLT_MAX);
@@ -255,11 +440,14 @@ RESULT CMesh::Ready_VIBuffer(eModelType type, string filePath, string fileName,
     _int b = GetRandNum(0, 170);
     vec3 rbg = vec3(r / 255.f, g / 255.f, b / 255.f);
 
-    *pVertices = new VTX[vertexNum];
-    memset(*pVertices, 0, sizeof(**pVertices));
+    // Each vertex is read in full, then packed into the compact layout of the model type
+    _uint vertexSize = CVIBuffer::GetVertexSize(type);
+    _uchar* pVertices = new _uchar[vertexSize * vertexNum];
+    VTX vtx;
     for (_uint i = 0; i < vertexNum; ++i)
     {
-        vec4& vPos = (*pVertices)[i].vPos;
+        memset(&vtx, 0, sizeof(VTX));
+        vec4& vPos = vtx.vPos;
         file >> vPos.x;
         file >> vPos.y;
         file >> vPos.z;
@@ -268,41 +456,41 @@ RESULT CMesh::Ready_VIBuffer(eModelType type, string filePath, string fileName,
         switch (type)
         {
         case xyz_index:
-            (*pVertices)[i].vNormal = vec4(0.f, 1.f, 0.f, 1.f);
+            vtx.vNormal = vec4(0.f, 1.f, 0.f, 1.f);
             break;
 
         case xyz_normal_index:
         case xyz_normal_color_index:
-            file >> (*pVertices)[i].vNormal.x;
-            file >> (*pVertices)[i].vNormal.y;
-            file >> (*pVertices)[i].vNormal.z;
-            (*pVertices)[i].vNormal.w = 1.f;
+            file >> vtx.vNormal.x;
+            file >> vtx.vNormal.y;
+            file >> vtx.vNormal.z;
+            vtx.vNormal.w = 1.f;
             break;
 
         case xyz_normal_texUV_index:
         case xyz_normal_texUV_index_texNum:
-            file >> (*pVertices)[i].vNormal.x;
-            file >> (*pVertices)[i].vNormal.y;
-            file >> (*pVertices)[i].vNormal.z;
-            (*pVertices)[i].vNormal.w = 1.f;
-            file >> (*pVertices)[i].vTexUV.x;
-            file >> (*pVertices)[i].vTexUV.y;
+            file >> vtx.vNormal.x;
+            file >> vtx.vNormal.y;
+            file >> vtx.vNormal.z;
+            vtx.vNormal.w = 1.f;
+            file >> vtx.vTexUV.x;
+            file >> vtx.vTexUV.y;
             break;
         }
 
         if (type == xyz_normal_color_index)
         {
-            file >> (*pVertices)[i].vColour.x; (*pVertices)[i].vColour.x = (*pVertices)[i].vColour.x / 255.f;
-            file >> (*pVertices)[i].vColour.y; (*pVertices)[i].vColour.y = (*pVertices)[i].vColour.y / 255.f;
-            file >> (*pVertices)[i].vColour.z; (*pVertices)[i].vColour.z = (*pVertices)[i].vColour.z / 255.f;
-            file >> (*pVertices)[i].vColour.w; (*pVertices)[i].vColour.w = (*pVertices)[i].vColour.w / 255.f;
+            file >> vtx.vColour.x; vtx.vColour.x = vtx.vColour.x / 255.f;
+            file >> vtx.vColour.y; vtx.vColour.y = vtx.vColour.y / 255.f;
+            file >> vtx.vColour.z; vtx.vColour.z = vtx.vColour.z / 255.f;
+            file >> vtx.vColour.w; vtx.vColour.w = vtx.vColour.w / 255.f;
         }
         else
         {
-            (*pVertices)[i].vColour.r = rbg.r;
-            (*pVertices)[i].vColour.g = rbg.g;
-            (*pVertices)[i].vColour.b = rbg.b;
-            (*pVertices)[i].vColour.a = 1.0f;
+            vtx.vColour.r = rbg.r;
+            vtx.vColour.g = rbg.g;
+            vtx.vColour.b = rbg.b;
+            vtx.vColour.a = 1.0f;
         }
 
         if (vMin.x > vPos.x)
@@ -317,50 +505,265 @@ RESULT CMesh::Ready_VIBuffer(eModelType type, string filePath, string fileName,
             vMax.y = vPos.y;
         if (vMax.z < vPos.z)
             vMax.z = vPos.z;
-    }
-    
-    m_pBoundingBox = CBoundingBox::Create(vMin, vMax, "DebugBoxShader");
 
-    m_iTriNum = triangleNum;
-    m_pTriangles = new TRIANGLE[triangleNum];
-    memset(m_pTriangles, 0, sizeof(*m_pTriangles));
+        CVIBuffer::PackVertices(&vtx, 1, type, pVertices + vertexSize * i);
+    }
 
-    IDX* pTriangles = new IDX[triangleNum];
-    memset(pTriangles, 0, sizeof(*pTriangles));
+    // Faces go straight into the index buffer
+    _uint indexNum = triangleNum * 3;
+    _uint* pIndices = new _uint[indexNum];
     int discard = 0;
     for (_uint i = 0; i < triangleNum; ++i)
     {
+        _uint* pFace = pIndices + i * 3;
         file >> discard;
-        file >> pTriangles[i]._0;
-        file >> pTriangles[i]._1;
-        file >> pTriangles[i]._2;
+        file >> pFace[0];
+        file >> pFace[1];
+        file >> pFace[2];
         if (type == xyz_normal_texUV_index_texNum)
             file >> discard;
-
-        m_pTriangles[i].p0 = (*pVertices)[pTriangles[i]._0].vPos;
-        m_pTriangles[i].p1 = (*pVertices)[pTriangles[i]._1].vPos;
-        m_pTriangles[i].p2 = (*pVertices)[pTriangles[i]._2].vPos;
     }
     file.close();
 
-    indexNum = triangleNum * 3;
-    *pIndices = new _uint[indexNum];
-    memset(*pIndices, 0, sizeof(**pIndices));
-    _uint indexCount = 0;
+    // Import-time optimization, the mesh cache stores the result
+    data.fSourceACMR = CMeshOptimizer::SimulateACMR(pIndices, indexNum, vertexNum);
+    CMeshOptimizer::DeduplicateVertices(pVertices, vertexNum, vertexSize, pIndices, indexNum);
+    vector<_uint> vecClusters;
+    CMeshOptimizer::OptimizeVertexCache(pIndices, indexNum, vertexNum, &vecClusters);
+    CMeshOptimizer::OptimizeOverdraw(pIndices, indexNum, pVertices, vertexSize, vecClusters);
+    vertexNum = CMeshOptimizer::OptimizeVertexFetch(pVertices, vertexNum, vertexSize, pIndices, indexNum);
+    data.fACMR = CMeshOptimizer::SimulateACMR(pIndices, indexNum, vertexNum);
+
+    // Simplified levels go behind the full index list
+    vector<_uint> vecIndices(pIndices, pIndices + indexNum);
+    delete[] pIndices;
+    GenerateLODs(vecIndices, pVertices, vertexNum, vertexSize, data);
+
+    // Collisions always use the full mesh, every layout starts with the position
+    TRIANGLE* pTriangles = new TRIANGLE[triangleNum];
     for (_uint i = 0; i < triangleNum; ++i)
     {
-        (*pIndices)[indexCount + 0] = pTriangles[i]._0;
-        (*pIndices)[indexCount + 1] = pTriangles[i]._1;
-        (*pIndices)[indexCount + 2] = pTriangles[i]._2;
+        pTriangles[i].p0 = *reinterpret_cast<const vec3*>(pVertices + vertexSize * vecIndices[i * 3]);
+        pTriangles[i].p1 = *reinterpret_cast<const vec3*>(pVertices + vertexSize * vecIndices[i * 3 + 1]);
+        pTriangles[i].p2 = *reinterpret_cast<const vec3*>(pVertices + vertexSize * vecIndices[i * 3 + 2]);
+    }
+
+    // 16 bit indices when every vertex can be reached with them
+    indexNum = (_uint)vecIndices.size();
+    _uint indexSize = vertexNum <= 0x10000 ? sizeof(_ushort) : sizeof(_uint);
+    _uchar* pIndexData = new _uchar[indexSize * indexNum];
+    if (sizeof(_ushort) == indexSize)
+    {
+        _ushort* pShortIndices = reinterpret_cast<_ushort*>(pIndexData);
+        for (_uint i = 0; i < indexNum; ++i)
+            pShortIndices[i] = (_ushort)vecIndices[i];
+    }
+    else
+        memcpy(pIndexData, vecIndices.data(), sizeof(_uint) * indexNum);
+
+    data.pVertices = pVertices;
+    data.pIndices = pIndexData;
+    data.iIndexSize = indexSize;
+    data.pTriangles = pTriangles;
+    data.iVertexNum = vertexNum;
+    data.iVertexSize = vertexSize;
+    data.vColour = vec4(rbg, 1.f);
+    data.iIndexNum = indexNum;
+    data.iTriNum = triangleNum;
+    data.vMin = vMin;
+    data.vMax = vMax;
+
+    return PK_NOERROR;
+}
+
+// Append simplified levels behind the full index list, each with about half the triangles of the one before
+// Stops early on small meshes and when the simplifier cannot go much further (flat or heavily seamed meshes)
+void CMesh::GenerateLODs(vector<_uint>& vecIndices, const _uchar* pVertices, _uint vertexNum, _uint vertexSize, MESHFILEDATA& data)
+{
+    data.iLODNum = 1;
+    data.LODs[0].iIndexStart = 0;
+    data.LODs[0].iIndexCount = (_uint)vecIndices.size();
+    data.LODs[0].fError = 0.f;
+
+    vector<_uint> vecLevel(vecIndices);
+    while (MESH_MAX_LOD > data.iLODNum)
+    {
+        const MESHLOD& prev = data.LODs[data.iLODNum - 1];
+        _uint targetNum = prev.iIndexCount / 6 * 3;
+        if (MESH_LOD_MIN_TRIANGLES * 3 > targetNum)
+            break;
+
+        _float error = 0.f;
+        _uint indexNum = CMeshOptimizer::SimplifyMesh(vecLevel.data(), prev.iIndexCount, pVertices, vertexNum, vertexSize, targetNum, &error);
+        if (indexNum > prev.iIndexCount / 4 * 3)
+            break;
+        CMeshOptimizer::OptimizeVertexCache(vecLevel.data(), indexNum, vertexNum);
+
+        // Errors add up since every level is simplified from the previous one
+        MESHLOD& lod = data.LODs[data.iLODNum++];
+        lod.iIndexStart = (_uint)vecIndices.size();
+        lod.iIndexCount = indexNum;
+        lod.fError = prev.fError + error;
+        vecIndices.insert(vecIndices.end(), vecLevel.begin(), vecLevel.begin() + indexNum);
+    }
+}
+
+// Hash of the source file contents and the vertex layout it is parsed with
+_bool CMesh::HashMeshFile(const string& path, eModelType type, _ulonglong& hash)
+{
+    CMappedFile* pFile = CMappedFile::Create(path);
+    if (nullptr == pFile)
+        return false;
+
+    _uint layout = (_uint)type;
+    hash = CMappedFile::HashBytes(&layout, sizeof(layout));
+    hash = CMappedFile::HashBytes(pFile->GetData(), pFile->GetSize(), hash);
+    SafeDestroy(pFile);
+
+    return true;
+}
+
+// Map a binary mesh cache, the arrays point into the mapping
+// Fails when it is missing, from another version, made from another source or not in the vertex layout of type
+RESULT CMesh::MapMeshCache(eModelType type, const string& path, _ulonglong sourceHash, MESHFILEDATA& data)
+{
+    CMappedFile* pFile = CMappedFile::Create(path);
+    if (nullptr == pFile)
+        return PK_ERROR_MESHFILE_OPEN;
+
+    const _uchar* pData = pFile->GetData();
+    size_t size = pFile->GetSize();
+    const MESHCACHEHEADER* pHeader = reinterpret_cast<const MESHCACHEHEADER*>(pData);
+    _bool valid = size >= sizeof(MESHCACHEHEADER)
+        && MESH_CACHE_MAGIC == pHeader->iMagic && MESH_CACHE_VERSION == pHeader->iVersion
+        && sourceHash == pHeader->iSourceHash && size == pHeader->iFileSize;
+
+    if (valid)
+    {
+        // Sections in bounds, in order and aligned
+        size_t vertexEnd = (size_t)pHeader->iVertexOffset + (size_t)pHeader->iVertexSize * pHeader->iVertexNum;
+        size_t indexEnd = (size_t)pHeader->iIndexOffset + (size_t)pHeader->iIndexSize * pHeader->iIndexNum;
+        size_t triangleEnd = (size_t)pHeader->iTriangleOffset + sizeof(TRIANGLE) * pHeader->iTriNum;
+        size_t nameEnd = (size_t)pHeader->iTextureNameOffset + pHeader->iTextureNameLength;
+        valid = CVIBuffer::GetVertexSize(type) == pHeader->iVertexSize
+            && (sizeof(_ushort) == pHeader->iIndexSize || sizeof(_uint) == pHeader->iIndexSize)
+            && 0 < pHeader->iLODNum && MESH_MAX_LOD >= pHeader->iLODNum
+            && pHeader->iVertexOffset >= sizeof(MESHCACHEHEADER) && pHeader->iIndexOffset >= vertexEnd
+            && pHeader->iTriangleOffset >= indexEnd && pHeader->iTextureNameOffset >= triangleEnd && nameEnd <= size
+            && 0 == (pHeader->iVertexOffset | pHeader->iIndexOffset | pHeader->iTriangleOffset) % MESH_CACHE_ALIGN;
+    }
 
-        indexCount += 3;
+    for (_uint i = 0; valid && i < pHeader->iLODNum; ++i)
+        valid = (size_t)pHeader->LODs[i].iIndexStart + pHeader->LODs[i].iIndexCount <= pHeader->iIndexNum;
+
+    // The buffers are drawn and read without checks, so every index must stay inside the vertices
+    if (valid && sizeof(_ushort) == pHeader->iIndexSize)
+    {
+        const _ushort* pIndices = reinterpret_cast<const _ushort*>(pData + pHeader->iIndexOffset);
+        for (_uint i = 0; valid && i < pHeader->iIndexNum; ++i)
+            valid = pIndices[i] < pHeader->iVertexNum;
+    }
+    else if (valid)
+    {
+        const _uint* pIndices = reinterpret_cast<const _uint*>(pData + pHeader->iIndexOffset);
+        for (_uint i = 0; valid && i < pHeader->iIndexNum; ++i)
+            valid = pIndices[i] < pHeader->iVertexNum;
     }
 
-    delete[] pTriangles;
+    if (!valid)
+    {
+        SafeDestroy(pFile);
+        return PK_ERROR;
+    }
+
+    data.pMappedFile = pFile;
+    data.pVertices = pData + pHeader->iVertexOffset;
+    data.pIndices = pData + pHeader->iIndexOffset;
+    data.pTriangles = reinterpret_cast<const TRIANGLE*>(pData + pHeader->iTriangleOffset);
+    data.iVertexNum = pHeader->iVertexNum;
+    data.iVertexSize = pHeader->iVertexSize;
+    data.iIndexNum = pHeader->iIndexNum;
+    data.iIndexSize = pHeader->iIndexSize;
+    data.iTriNum = pHeader->iTriNum;
+    data.vMin = vec3(pHeader->vMin[0], pHeader->vMin[1], pHeader->vMin[2]);
+    data.vMax = vec3(pHeader->vMax[0], pHeader->vMax[1], pHeader->vMax[2]);
+    data.vColour = vec4(pHeader->vColour[0], pHeader->vColour[1], pHeader->vColour[2], pHeader->vColour[3]);
+    data.textureFileName.assign(reinterpret_cast<const char*>(pData + pHeader->iTextureNameOffset), pHeader->iTextureNameLength);
+    data.iLODNum = pHeader->iLODNum;
+    memcpy(data.LODs, pHeader->LODs, sizeof(data.LODs));
 
     return PK_NOERROR;
 }
 
+// Write a binary mesh cache : header (with the level of detail table), vertices in the VIBuffer layout, indices, collision triangles, texture file name
+_bool CMesh::SaveMeshCache(const string& path, _ulonglong sourceHash, const MESHFILEDATA& data)
+{
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    MESHCACHEHEADER header;
+    header.iMagic = MESH_CACHE_MAGIC;
+    header.iVersion = MESH_CACHE_VERSION;
+    header.iSourceHash = sourceHash;
+    header.iVertexNum = data.iVertexNum;
+    header.iVertexSize = data.iVertexSize;
+    header.iIndexNum = data.iIndexNum;
+    header.iIndexSize = data.iIndexSize;
+    header.iTriNum = data.iTriNum;
+    header.iTextureNameLength = (_uint)data.textureFileName.size();
+    header.vMin[0] = data.vMin.x; header.vMin[1] = data.vMin.y; header.vMin[2] = data.vMin.z;
+    header.vMax[0] = data.vMax.x; header.vMax[1] = data.vMax.y; header.vMax[2] = data.vMax.z;
+    header.vColour[0] = data.vColour.r; header.vColour[1] = data.vColour.g; header.vColour[2] = data.vColour.b; header.vColour[3] = data.vColour.a;
+    header.iLODNum = data.iLODNum;
+    memcpy(header.LODs, data.LODs, sizeof(header.LODs));
+
+    header.iVertexOffset = AlignCacheOffset(sizeof(MESHCACHEHEADER));
+    header.iIndexOffset = AlignCacheOffset(header.iVertexOffset + data.iVertexSize * data.iVertexNum);
+    header.iTriangleOffset = AlignCacheOffset(header.iIndexOffset + data.iIndexSize * data.iIndexNum);
+    header.iTextureNameOffset = AlignCacheOffset(header.iTriangleOffset + sizeof(TRIANGLE) * data.iTriNum);
+    header.iFileSize = header.iTextureNameOffset + header.iTextureNameLength;
+
+    const char padding[MESH_CACHE_ALIGN] = { 0 };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(MESHCACHEHEADER));
+    file.write(padding, header.iVertexOffset - sizeof(MESHCACHEHEADER));
+    file.write(reinterpret_cast<const char*>(data.pVertices), data.iVertexSize * data.iVertexNum);
+    file.write(padding, header.iIndexOffset - (header.iVertexOffset + data.iVertexSize * data.iVertexNum));
+    file.write(reinterpret_cast<const char*>(data.pIndices), data.iIndexSize * data.iIndexNum);
+    file.write(padding, header.iTriangleOffset - (header.iIndexOffset + data.iIndexSize * data.iIndexNum));
+    file.write(reinterpret_cast<const char*>(data.pTriangles), sizeof(TRIANGLE) * data.iTriNum);
+    file.write(padding, header.iTextureNameOffset - (header.iTriangleOffset + sizeof(TRIANGLE) * data.iTriNum));
+    file.write(data.textureFileName.c_str(), data.textureFileName.size());
+
+    return file.good();
+}
+
+// Offline conversion : parse the PLY and write its binary cache without creating any GPU resource
+// pACMR receives the simulated cache miss ratio before and after the optimization
+RESULT CMesh::ConvertMeshFile(string filePath, string fileName, eModelType type, _float* pACMR)
+{
+    string sourcePath = filePath + fileName;
+    _ulonglong sourceHash = 0;
+    if (!HashMeshFile(sourcePath, type, sourceHash))
+        return PK_ERROR_MESHFILE_OPEN;
+
+    MESHFILEDATA data;
+    RESULT result = LoadPLY(type, sourcePath, data);
+    if (PK_NOERROR != result)
+        return result;
+
+    if (nullptr != pACMR)
+    {
+        pACMR[0] = data.fSourceACMR;
+        pACMR[1] = data.fACMR;
+    }
+
+    _bool saved = SaveMeshCache(sourcePath + ".mesh", sourceHash, data);
+    ReleaseMeshFile(data);
+
+    return saved ? PK_NOERROR : PK_ERROR;
+}
+
 // Initialize diffuse texture
 void CMesh::Ready_Texture_Diff(string texID)
 {
@@ -416,11 +819,11 @@ void CMesh::Ready_Shader(string shaderID)
 //    if (nullptr == m_pOctree)
 //        return;
 //
-//    _uint missed = 0;
 //    for (_uint i = 0; i < m_iTriNum; ++i)
 //    {
-//        m_pOctree->AddTriangle(m_pTriangles[i], missed);
+//        m_pOctree->AddTriangle(m_pTriangles[i]);
 //    }
+//    _uint missed = m_pOctree->Build();
 //}
 
 // Clone component
@@ -445,3 +848,33 @@ CMesh* CMesh::Create(string ID, string filePath, string fileName, eModelType typ
 	return pInstance;
 }
 
+// Create an instance from loaded mesh data
+CMesh* CMesh::Create(string ID, MESHFILEDATA& data, eModelType type,
+    string shaderID, string initSize, string meshType, string texID_Diff, string texID_Normal)
+{
+    CMesh* pInstance = new CMesh();
+    if (PK_NOERROR != pInstance->Ready(ID, data, type,
+        shaderID, initSize, meshType,
+        texID_Diff, texID_Normal))
+    {
+        pInstance->Destroy();
+        pInstance = nullptr;
+    }
+
+    return pInstance;
+}
+
+CMesh* CMesh::Create(string ID, CMeshGeometry* pGeometry,
+    string shaderID, string initSize, string meshType, string texID_Diff, string texID_Normal)
+{
+    CMesh* pInstance = new CMesh();
+    if (PK_NOERROR != pInstance->Ready(ID, pGeometry,
+        shaderID, initSize, meshType,
+        texID_Diff, texID_Normal))
+    {
+        pInstance->Destroy();
+        pInstance = nullptr;
+    }
+
+    return pInstance;
+}
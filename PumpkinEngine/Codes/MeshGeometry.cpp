@@ -0,0 +1,159 @@
+#include "pch.h"
+#include "..\Headers\MeshGeometry.h"
+#include "..\Headers\VIBuffer.h"
+#include "..\Headers\TriangleBVH.h"
+#include "..\Headers\Octree.h"
+#include "..\Headers\MappedFile.h"
+#include "glm\geometric.hpp"
+
+
+USING(Engine)
+USING(glm)
+USING(std)
+
+CMeshGeometry::CMeshGeometry()
+	: m_pVIBuffer(nullptr), m_pTriangles(nullptr), m_iTriNum(0), m_pMeshFile(nullptr), m_pTriangleBVH(nullptr)
+	, m_pOctree(nullptr), m_cacheFilePath(""), m_octreeFilePath(""), m_textureFileName(""), m_iLODNum(0)
+	, m_vMin(0.f), m_vMax(0.f), m_vCenter(0.f), m_fRadius(0.f)
+{
+	memset(m_LODs, 0, sizeof(m_LODs));
+}
+
+CMeshGeometry::~CMeshGeometry()
+{
+}
+
+// Call instead of destructor to manage class internal data
+void CMeshGeometry::Destroy()
+{
+	SafeDestroy(m_pVIBuffer);
+	SafeDestroy(m_pTriangleBVH);
+	SafeDestroy(m_pOctree);
+	// Mapped triangles belong to the mesh file
+	if (nullptr == m_pMeshFile && nullptr != m_pTriangles)
+		delete[] m_pTriangles;
+	m_pTriangles = nullptr;
+	SafeDestroy(m_pMeshFile);
+}
+
+// Draw one level of detail
+void CMeshGeometry::Render(_uint lod, _bool wireFrame)
+{
+	if (nullptr == m_pVIBuffer || lod >= m_iLODNum)
+		return;
+
+	m_pVIBuffer->SetWireFrame(wireFrame);
+	m_pVIBuffer->RenderRange(m_LODs[lod].iIndexStart, m_LODs[lod].iIndexCount);
+}
+
+// BVH over the local-space triangles for ray queries
+// Mapped from the cache file next to the mesh when it matches the triangles, otherwise built and saved there
+CTriangleBVH* CMeshGeometry::GetTriangleBVH()
+{
+	call_once(m_onceBVH, [this]()
+	{
+		if (nullptr == m_pTriangles)
+			return;
+
+		_ulonglong hash = CMappedFile::HashBytes(m_pTriangles, m_iTriNum * sizeof(TRIANGLE));
+		if (!m_cacheFilePath.empty())
+			m_pTriangleBVH = CTriangleBVH::CreateFromFile(m_cacheFilePath, hash);
+
+		if (nullptr == m_pTriangleBVH)
+		{
+			m_pTriangleBVH = CTriangleBVH::Create(m_pTriangles, m_iTriNum);
+			if (nullptr != m_pTriangleBVH && !m_cacheFilePath.empty())
+				m_pTriangleBVH->Save(m_cacheFilePath, hash);
+		}
+	});
+
+	return m_pTriangleBVH;
+}
+
+// Octree over the local-space triangles for box queries
+// The leaves are mapped from the cache file next to the mesh when it matches the triangles and depth, otherwise built and saved there
+COctree* CMeshGeometry::GetOctree(_uint depth)
+{
+	call_once(m_onceOctree, [this, depth]()
+	{
+		if (nullptr == m_pTriangles)
+			return;
+
+		COctree* pOctree = COctree::Create(m_vMax, m_vMin, depth);
+		if (nullptr == pOctree)
+			return;
+
+		for (_uint i = 0; i < m_iTriNum; ++i)
+			pOctree->AddTriangle(m_pTriangles[i]);
+
+		_ulonglong hash = CMappedFile::HashBytes(m_pTriangles, m_iTriNum * sizeof(TRIANGLE));
+		if (m_octreeFilePath.empty() || !pOctree->Load(m_octreeFilePath, hash))
+		{
+			pOctree->Build();
+			if (!m_octreeFilePath.empty())
+				pOctree->Save(m_octreeFilePath, hash);
+		}
+
+		m_pOctree = pOctree;
+	});
+
+	return m_pOctree;
+}
+
+// Initialize from loaded mesh data
+RESULT CMeshGeometry::Ready(eModelType type, CMesh::MESHFILEDATA& data)
+{
+	if (nullptr == data.pVertices)
+		return PK_ERROR_MESHFILE_OPEN;
+
+	// Uploaded straight from the mapping (or the parse buffers), no intermediate copy
+	m_pVIBuffer = CVIBuffer::Create(data.iVertexNum, data.pVertices, data.iIndexNum, data.pIndices, data.iIndexSize, type, data.vColour);
+	if (nullptr == m_pVIBuffer)
+		return PK_ERROR;
+
+	m_cacheFilePath = data.sourcePath + ".bvh";
+	m_octreeFilePath = data.sourcePath + ".oct";
+	m_textureFileName = data.textureFileName;
+	m_vMin = data.vMin;
+	m_vMax = data.vMax;
+	m_vCenter = (m_vMin + m_vMax) * 0.5f;
+	m_fRadius = length(m_vMax - m_vMin) * 0.5f;
+
+	// Every level draws from the same buffers, a mesh without a table has only the full one
+	m_iLODNum = data.iLODNum;
+	memcpy(m_LODs, data.LODs, sizeof(m_LODs));
+	if (0 == m_iLODNum)
+	{
+		m_iLODNum = 1;
+		m_LODs[0].iIndexStart = 0;
+		m_LODs[0].iIndexCount = data.iIndexNum;
+		m_LODs[0].fError = 0.f;
+	}
+
+	// The collision triangles are kept, together with the mapping they point into
+	m_iTriNum = data.iTriNum;
+	m_pTriangles = data.pTriangles;
+	m_pMeshFile = data.pMappedFile;
+	data.pTriangles = nullptr;
+	data.pMappedFile = nullptr;
+	if (nullptr != m_pMeshFile)
+	{
+		data.pVertices = nullptr;
+		data.pIndices = nullptr;
+	}
+
+	return PK_NOERROR;
+}
+
+// Create an instance
+CMeshGeometry* CMeshGeometry::Create(eModelType type, CMesh::MESHFILEDATA& data)
+{
+	CMeshGeometry* pInstance = new CMeshGeometry();
+	if (PK_NOERROR != pInstance->Ready(type, data))
+	{
+		pInstance->Destroy();
+		pInstance = nullptr;
+	}
+
+	return pInstance;
+}
@@ -0,0 +1,527 @@
+#include "pch.h"
+#include "..\Headers\MeshOptimizer.h"
+#include "..\Headers\MappedFile.h"
+#include "glm\vec3.hpp"
+#include "glm\geometric.hpp"
+#include <climits>
+#include <cfloat>
+
+
+USING(Engine)
+USING(glm)
+USING(std)
+
+// Sum of squared distances to a set of planes, symmetric 4x4 matrix stored as its upper triangle
+typedef struct sQuadric
+{
+	_double a00, a01, a02, a03;
+	_double a11, a12, a13;
+	_double a22, a23;
+	_double a33;
+	_double w;			// Number of planes
+}QUADRIC;
+
+static void AddPlaneQuadric(QUADRIC& q, const vec3& vNormal, _float d)
+{
+	_double x = vNormal.x, y = vNormal.y, z = vNormal.z, w = d;
+	q.a00 += x * x; q.a01 += x * y; q.a02 += x * z; q.a03 += x * w;
+	q.a11 += y * y; q.a12 += y * z; q.a13 += y * w;
+	q.a22 += z * z; q.a23 += z * w;
+	q.a33 += w * w;
+	q.w += 1.0;
+}
+
+static void AddQuadric(QUADRIC& q, const QUADRIC& rhs)
+{
+	q.a00 += rhs.a00; q.a01 += rhs.a01; q.a02 += rhs.a02; q.a03 += rhs.a03;
+	q.a11 += rhs.a11; q.a12 += rhs.a12; q.a13 += rhs.a13;
+	q.a22 += rhs.a22; q.a23 += rhs.a23;
+	q.a33 += rhs.a33;
+	q.w += rhs.w;
+}
+
+static _double EvaluateQuadric(const QUADRIC& q, const vec3& vPos)
+{
+	_double x = vPos.x, y = vPos.y, z = vPos.z;
+	_double result = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z + q.a33
+		+ 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z + q.a03 * x + q.a13 * y + q.a23 * z);
+	return 0.0 < result ? result : 0.0;
+}
+
+// Point duplicated vertices (byte-identical records) at their first copy, returns the number of unique vertices
+_uint CMeshOptimizer::DeduplicateVertices(const _uchar* pVertices, _uint vertexNum, _uint vertexSize, _uint* pIndices, _uint indexNum)
+{
+	if (0 == vertexNum)
+		return 0;
+
+	// Open addressing table of first copies, at most half full
+	_uint tableSize = 1;
+	while (tableSize < vertexNum * 2)
+		tableSize <<= 1;
+	vector<_uint> vecTable(tableSize, UINT_MAX);
+	vector<_uint> vecRemap(vertexNum);
+
+	_uint uniqueNum = 0;
+	for (_uint i = 0; i < vertexNum; ++i)
+	{
+		const _uchar* pVertex = pVertices + (size_t)vertexSize * i;
+		_uint slot = (_uint)CMappedFile::HashBytes(pVertex, vertexSize) & (tableSize - 1);
+		while (UINT_MAX != vecTable[slot] && 0 != memcmp(pVertices + (size_t)vertexSize * vecTable[slot], pVertex, vertexSize))
+			slot = (slot + 1) & (tableSize - 1);
+
+		if (UINT_MAX == vecTable[slot])
+		{
+			vecTable[slot] = i;
+			++uniqueNum;
+		}
+		vecRemap[i] = vecTable[slot];
+	}
+
+	for (_uint i = 0; i < indexNum; ++i)
+		pIndices[i] = vecRemap[pIndices[i]];
+
+	return uniqueNum;
+}
+
+// Reorder triangles for post-transform cache locality (Tipsify)
+// Fans around the vertex that stays in the cache the longest, jumps to a recent dead end when none is left
+void CMeshOptimizer::OptimizeVertexCache(_uint* pIndices, _uint indexNum, _uint vertexNum, vector<_uint>* pClusters, _uint cacheSize)
+{
+	_uint triNum = indexNum / 3;
+	if (0 == triNum || 0 == vertexNum)
+		return;
+
+	// Triangles around each vertex
+	vector<_uint> vecLive(vertexNum, 0);
+	for (_uint i = 0; i < triNum * 3; ++i)
+		++vecLive[pIndices[i]];
+
+	vector<_uint> vecOffset(vertexNum + 1, 0);
+	for (_uint v = 0; v < vertexNum; ++v)
+		vecOffset[v + 1] = vecOffset[v] + vecLive[v];
+
+	vector<_uint> vecAdjacency(triNum * 3);
+	vector<_uint> vecFill(vecOffset.begin(), vecOffset.end() - 1);
+	for (_uint i = 0; i < triNum * 3; ++i)
+		vecAdjacency[vecFill[pIndices[i]]++] = i / 3;
+
+	vector<_uint> vecCacheTime(vertexNum, 0);
+	vector<_uchar> vecEmitted(triNum, 0);
+	vector<_uint> vecDeadEnd;
+	vector<_uint> vecCandidates;
+	vector<_uint> vecOutput;
+	vecDeadEnd.reserve(triNum * 3);
+	vecOutput.reserve(triNum * 3);
+
+	if (nullptr != pClusters)
+		pClusters->clear();
+
+	_uint time = cacheSize + 1;
+	_uint cursor = 1;
+	_int fanning = 0;
+	_bool coldStart = true;
+	while (0 <= fanning)
+	{
+		if (coldStart && nullptr != pClusters && (pClusters->empty() || pClusters->back() != vecOutput.size()))
+			pClusters->push_back((_uint)vecOutput.size());
+
+		// Emit every remaining triangle around the fanning vertex
+		vecCandidates.clear();
+		for (_uint a = vecOffset[fanning]; a < vecOffset[fanning + 1]; ++a)
+		{
+			_uint tri = vecAdjacency[a];
+			if (0 != vecEmitted[tri])
+				continue;
+
+			for (_uint k = 0; k < 3; ++k)
+			{
+				_uint v = pIndices[tri * 3 + k];
+				vecOutput.push_back(v);
+				vecDeadEnd.push_back(v);
+				vecCandidates.push_back(v);
+				--vecLive[v];
+				if (time - vecCacheTime[v] > cacheSize)
+					vecCacheTime[v] = time++;
+			}
+			vecEmitted[tri] = 1;
+		}
+
+		// Next fanning vertex : one of the candidates that will still be cached after its own triangles, the oldest first
+		_int next = -1;
+		_int best = -1;
+		for (size_t c = 0; c < vecCandidates.size(); ++c)
+		{
+			_uint v = vecCandidates[c];
+			if (0 == vecLive[v])
+				continue;
+
+			_int priority = 0;
+			if (time - vecCacheTime[v] + 2 * vecLive[v] <= cacheSize)
+				priority = time - vecCacheTime[v];
+			if (priority > best)
+			{
+				best = priority;
+				next = v;
+			}
+		}
+
+		coldStart = -1 == next;
+		if (coldStart)
+			next = SkipDeadEnd(vecDeadEnd, vecLive, cursor, vertexNum);
+		fanning = next;
+	}
+
+	memcpy(pIndices, vecOutput.data(), sizeof(_uint) * vecOutput.size());
+}
+
+// Reorder the clusters found by OptimizeVertexCache so outward facing ones are drawn first
+// Clusters start where the fan had to jump, so moving them around costs little cache efficiency
+void CMeshOptimizer::OptimizeOverdraw(_uint* pIndices, _uint indexNum, const _uchar* pVertices, _uint vertexSize, const vector<_uint>& clusters)
+{
+	if (clusters.size() < 2)
+		return;
+
+	auto GetPosition = [&](_uint index) -> const vec3&
+	{
+		return *reinterpret_cast<const vec3*>(pVertices + (size_t)vertexSize * index);
+	};
+
+	// Area weighted centroid and normal of each cluster, and of the whole mesh
+	_uint clusterNum = (_uint)clusters.size();
+	vector<vec3> vecCentroid(clusterNum, vec3(0.f));
+	vector<vec3> vecNormal(clusterNum, vec3(0.f));
+	vec3 vMeshCentroid(0.f);
+	_float meshArea = 0.f;
+	for (_uint c = 0; c < clusterNum; ++c)
+	{
+		_uint end = c + 1 < clusterNum ? clusters[c + 1] : indexNum;
+		_float clusterArea = 0.f;
+		for (_uint i = clusters[c]; i + 2 < end; i += 3)
+		{
+			const vec3& p0 = GetPosition(pIndices[i]);
+			const vec3& p1 = GetPosition(pIndices[i + 1]);
+			const vec3& p2 = GetPosition(pIndices[i + 2]);
+			vec3 vCross = cross(p1 - p0, p2 - p0);
+			_float area = length(vCross);
+
+			vecCentroid[c] += (p0 + p1 + p2) * (area / 3.f);
+			vecNormal[c] += vCross;
+			clusterArea += area;
+		}
+
+		vMeshCentroid += vecCentroid[c];
+		meshArea += clusterArea;
+		if (0.f < clusterArea)
+			vecCentroid[c] /= clusterArea;
+	}
+	if (0.f < meshArea)
+		vMeshCentroid /= meshArea;
+
+	// Clusters far out along their own normal occlude the rest of the mesh
+	vector<_float> vecKey(clusterNum);
+	vector<_uint> vecOrder(clusterNum);
+	for (_uint c = 0; c < clusterNum; ++c)
+	{
+		_float normalLength = length(vecNormal[c]);
+		vecKey[c] = 0.f < normalLength ? dot(vecCentroid[c] - vMeshCentroid, vecNormal[c] / normalLength) : 0.f;
+		vecOrder[c] = c;
+	}
+	stable_sort(vecOrder.begin(), vecOrder.end(), [&](_uint a, _uint b) { return vecKey[a] > vecKey[b]; });
+
+	vector<_uint> vecOutput;
+	vecOutput.reserve(indexNum);
+	for (_uint c = 0; c < clusterNum; ++c)
+	{
+		_uint cluster = vecOrder[c];
+		_uint end = cluster + 1 < clusterNum ? clusters[cluster + 1] : indexNum;
+		vecOutput.insert(vecOutput.end(), pIndices + clusters[cluster], pIndices + end);
+	}
+
+	memcpy(pIndices, vecOutput.data(), sizeof(_uint) * vecOutput.size());
+}
+
+// Reorder vertices by first use and drop unreferenced ones, returns the new vertex count
+_uint CMeshOptimizer::OptimizeVertexFetch(_uchar* pVertices, _uint vertexNum, _uint vertexSize, _uint* pIndices, _uint indexNum)
+{
+	vector<_uint> vecRemap(vertexNum, UINT_MAX);
+	_uint newNum = 0;
+	for (_uint i = 0; i < indexNum; ++i)
+	{
+		_uint& index = pIndices[i];
+		if (UINT_MAX == vecRemap[index])
+			vecRemap[index] = newNum++;
+		index = vecRemap[index];
+	}
+
+	vector<_uchar> vecVertices((size_t)vertexSize * newNum);
+	for (_uint v = 0; v < vertexNum; ++v)
+	{
+		if (UINT_MAX != vecRemap[v])
+			memcpy(vecVertices.data() + (size_t)vertexSize * vecRemap[v], pVertices + (size_t)vertexSize * v, vertexSize);
+	}
+	memcpy(pVertices, vecVertices.data(), vecVertices.size());
+
+	return newNum;
+}
+
+// Average cache miss ratio (transformed vertices per triangle) on a simulated FIFO cache
+_float CMeshOptimizer::SimulateACMR(const _uint* pIndices, _uint indexNum, _uint vertexNum, _uint cacheSize)
+{
+	if (indexNum < 3)
+		return 0.f;
+
+	// A vertex is still cached while fewer than cacheSize misses happened since it was loaded
+	vector<_uint> vecCacheTime(vertexNum, 0);
+	_uint time = cacheSize + 1;
+	_uint missNum = 0;
+	for (_uint i = 0; i < indexNum; ++i)
+	{
+		_uint v = pIndices[i];
+		if (time - vecCacheTime[v] > cacheSize)
+		{
+			vecCacheTime[v] = time++;
+			++missNum;
+		}
+	}
+
+	return (_float)missNum / (indexNum / 3);
+}
+
+// Collapse edges by quadric error until at most targetIndexNum indices are left, returns the new index count
+// Works in passes : every free vertex finds its cheapest neighbour, then the cheapest collapses that do not touch each other are made
+// Vertices on open borders and on seams (same position, other attributes) never move, so outlines and UV charts stay intact
+_uint CMeshOptimizer::SimplifyMesh(_uint* pIndices, _uint indexNum, const _uchar* pVertices, _uint vertexNum, _uint vertexSize,
+	_uint targetIndexNum, _float* pError)
+{
+	if (nullptr != pError)
+		*pError = 0.f;
+	indexNum = indexNum / 3 * 3;
+	if (indexNum <= targetIndexNum || 0 == vertexNum)
+		return indexNum;
+
+	auto GetPosition = [&](_uint index) -> const vec3&
+	{
+		return *reinterpret_cast<const vec3*>(pVertices + (size_t)vertexSize * index);
+	};
+
+	// Weld vertices by position, the topology is looked at through the welded ids
+	_uint tableSize = 1;
+	while (tableSize < vertexNum * 2)
+		tableSize <<= 1;
+	vector<_uint> vecTable(tableSize, UINT_MAX);
+	vector<_uint> vecWeld(vertexNum);
+	vector<_uchar> vecLocked(vertexNum, 0);
+	for (_uint v = 0; v < vertexNum; ++v)
+	{
+		const vec3& vPos = GetPosition(v);
+		_uint slot = (_uint)CMappedFile::HashBytes(&vPos, sizeof(vec3)) & (tableSize - 1);
+		while (UINT_MAX != vecTable[slot] && 0 != memcmp(&GetPosition(vecTable[slot]), &vPos, sizeof(vec3)))
+			slot = (slot + 1) & (tableSize - 1);
+
+		if (UINT_MAX == vecTable[slot])
+			vecTable[slot] = v;
+		vecWeld[v] = vecTable[slot];
+
+		// Seam : more than one vertex at this position
+		if (vecWeld[v] != v)
+			vecLocked[v] = vecLocked[vecWeld[v]] = 1;
+	}
+
+	// Border and non-manifold edges : welded edges that are not shared by exactly two triangles
+	vector<_ulonglong> vecEdges;
+	vecEdges.reserve(indexNum);
+	for (_uint i = 0; i < indexNum; i += 3)
+	{
+		for (_uint k = 0; k < 3; ++k)
+		{
+			_uint a = vecWeld[pIndices[i + k]];
+			_uint b = vecWeld[pIndices[i + (k + 1) % 3]];
+			vecEdges.push_back(a < b ? ((_ulonglong)a << 32 | b) : ((_ulonglong)b << 32 | a));
+		}
+	}
+	sort(vecEdges.begin(), vecEdges.end());
+	for (size_t i = 0; i < vecEdges.size();)
+	{
+		size_t end = i + 1;
+		while (end < vecEdges.size() && vecEdges[end] == vecEdges[i])
+			++end;
+		if (2 != end - i)
+			vecLocked[(_uint)(vecEdges[i] >> 32)] = vecLocked[(_uint)(vecEdges[i] & UINT_MAX)] = 1;
+		i = end;
+	}
+	for (_uint v = 0; v < vertexNum; ++v)
+	{
+		if (0 != vecLocked[vecWeld[v]])
+			vecLocked[v] = 1;
+	}
+
+	// Planes of the triangles around each vertex
+	vector<QUADRIC> vecQuadric(vertexNum);
+	for (_uint i = 0; i < indexNum; i += 3)
+	{
+		const vec3& p0 = GetPosition(pIndices[i]);
+		vec3 vNormal = cross(GetPosition(pIndices[i + 1]) - p0, GetPosition(pIndices[i + 2]) - p0);
+		_float normalLength = length(vNormal);
+		if (0.f >= normalLength)
+			continue;
+
+		vNormal /= normalLength;
+		for (_uint k = 0; k < 3; ++k)
+			AddPlaneQuadric(vecQuadric[pIndices[i + k]], vNormal, -dot(vNormal, p0));
+	}
+
+	typedef struct sCollapse
+	{
+		_double		fCost;
+		_uint		iFrom;
+		_uint		iTo;
+	}COLLAPSE;
+
+	vector<_uint> vecLive(vertexNum);
+	vector<_uint> vecOffset(vertexNum + 1);
+	vector<_uint> vecAdjacency;
+	vector<_uchar> vecTouched(vertexNum);
+	vector<COLLAPSE> vecCollapses;
+	_double maxCost = 0.0;
+
+	// Merging from into to must not turn any of the remaining triangles of from upside down
+	auto IsFlipped = [&](_uint from, _uint to) -> _bool
+	{
+		for (_uint a = vecOffset[from]; a < vecOffset[from + 1]; ++a)
+		{
+			const _uint* pFace = pIndices + vecAdjacency[a] * 3;
+			if (to == pFace[0] || to == pFace[1] || to == pFace[2])
+				continue;
+
+			const vec3& p0 = GetPosition(pFace[0]);
+			const vec3& p1 = GetPosition(pFace[1]);
+			const vec3& p2 = GetPosition(pFace[2]);
+			const vec3& n0 = GetPosition(from == pFace[0] ? to : pFace[0]);
+			const vec3& n1 = GetPosition(from == pFace[1] ? to : pFace[1]);
+			const vec3& n2 = GetPosition(from == pFace[2] ? to : pFace[2]);
+			if (0.f >= dot(cross(p1 - p0, p2 - p0), cross(n1 - n0, n2 - n0)))
+				return true;
+		}
+		return false;
+	};
+
+	while (indexNum > targetIndexNum)
+	{
+		// Triangles around each vertex
+		_uint triNum = indexNum / 3;
+		fill(vecLive.begin(), vecLive.end(), 0);
+		for (_uint i = 0; i < indexNum; ++i)
+			++vecLive[pIndices[i]];
+		for (_uint v = 0; v < vertexNum; ++v)
+			vecOffset[v + 1] = vecOffset[v] + vecLive[v];
+		vecAdjacency.resize(indexNum);
+		for (_uint v = 0; v < vertexNum; ++v)
+			vecLive[v] = vecOffset[v];
+		for (_uint i = 0; i < indexNum; ++i)
+			vecAdjacency[vecLive[pIndices[i]]++] = i / 3;
+
+		// Cheapest valid collapse of every free vertex into one of its neighbours
+		vecCollapses.clear();
+		for (_uint v = 0; v < vertexNum; ++v)
+		{
+			if (0 != vecLocked[v] || vecOffset[v] == vecOffset[v + 1])
+				continue;
+
+			COLLAPSE collapse = { DBL_MAX, v, UINT_MAX };
+			for (_uint a = vecOffset[v]; a < vecOffset[v + 1]; ++a)
+			{
+				for (_uint k = 0; k < 3; ++k)
+				{
+					_uint to = pIndices[vecAdjacency[a] * 3 + k];
+					if (v == to)
+						continue;
+
+					// Mean squared distance to the planes of both vertices
+					const vec3& vTarget = GetPosition(to);
+					_double weight = vecQuadric[v].w + vecQuadric[to].w;
+					_double cost = EvaluateQuadric(vecQuadric[v], vTarget) + EvaluateQuadric(vecQuadric[to], vTarget);
+					if (0.0 < weight)
+						cost /= weight;
+					if (cost >= collapse.fCost || IsFlipped(v, to))
+						continue;
+
+					collapse.fCost = cost;
+					collapse.iTo = to;
+				}
+			}
+
+			if (UINT_MAX != collapse.iTo)
+				vecCollapses.push_back(collapse);
+		}
+		if (vecCollapses.empty())
+			break;
+
+		sort(vecCollapses.begin(), vecCollapses.end(), [](const COLLAPSE& a, const COLLAPSE& b) { return a.fCost < b.fCost; });
+
+		// A collapse changes the one-ring of its vertex, anything in that ring waits for the next pass
+		fill(vecTouched.begin(), vecTouched.end(), 0);
+		_uint removeNum = (indexNum - targetIndexNum + 2) / 3;
+		_uint removedNum = 0;
+		for (size_t c = 0; c < vecCollapses.size() && removedNum < removeNum; ++c)
+		{
+			const COLLAPSE& collapse = vecCollapses[c];
+			if (0 != vecTouched[collapse.iFrom] || 0 != vecTouched[collapse.iTo])
+				continue;
+
+			for (_uint a = vecOffset[collapse.iFrom]; a < vecOffset[collapse.iFrom + 1]; ++a)
+			{
+				_uint* pFace = pIndices + vecAdjacency[a] * 3;
+				for (_uint k = 0; k < 3; ++k)
+				{
+					vecTouched[pFace[k]] = 1;
+					if (collapse.iTo == pFace[k])
+						++removedNum;
+					else if (collapse.iFrom == pFace[k])
+						pFace[k] = collapse.iTo;
+				}
+			}
+
+			AddQuadric(vecQuadric[collapse.iTo], vecQuadric[collapse.iFrom]);
+			if (maxCost < collapse.fCost)
+				maxCost = collapse.fCost;
+		}
+
+		// Drop the triangles that collapsed to a line
+		_uint keepNum = 0;
+		for (_uint t = 0; t < triNum; ++t)
+		{
+			const _uint* pFace = pIndices + t * 3;
+			if (pFace[0] == pFace[1] || pFace[1] == pFace[2] || pFace[0] == pFace[2])
+				continue;
+
+			memmove(pIndices + keepNum, pFace, sizeof(_uint) * 3);
+			keepNum += 3;
+		}
+		indexNum = keepNum;
+	}
+
+	if (nullptr != pError)
+		*pError = (_float)sqrt(maxCost);
+
+	return indexNum;
+}
+
+// Most recent dead end vertex that still has triangles, otherwise the next one in input order
+_int CMeshOptimizer::SkipDeadEnd(vector<_uint>& vecDeadEnd, const vector<_uint>& vecLive, _uint& cursor, _uint vertexNum)
+{
+	while (!vecDeadEnd.empty())
+	{
+		_uint v = vecDeadEnd.back();
+		vecDeadEnd.pop_back();
+		if (0 < vecLive[v])
+			return v;
+	}
+
+	for (; cursor < vertexNum; ++cursor)
+	{
+		if (0 < vecLive[cursor])
+			return cursor;
+	}
+
+	return -1;
+}
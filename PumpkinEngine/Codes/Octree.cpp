@@ -4,16 +4,46 @@
 #include "..\Headers\CollisionMaster.h"
 #include "..\Headers\BoundingBox.h"
 #include "..\Headers\Transform.h"
+#include "..\Headers\MappedFile.h"
+#include "..\Headers\ParallelFor.h"
+#include "glm\gtc\matrix_transform.hpp"
+#include <fstream>
+#include <algorithm>
 
 
 USING(Engine)
 USING(glm)
 USING(std)
 
+#define OCTREE_FILE_MAGIC		0x54434F50		// "POCT"
+#define OCTREE_FILE_VERSION		1
+#define OCTREE_FILE_ALIGN		16
+#define OCTREE_BUILD_BLOCK		4096		// Triangles per parallel partition block
+#define OCTREE_PARALLEL_MIN		4096		// Smaller lists are built on the calling thread
+
+// Cache file header, the node and index sections are stored at 16 byte aligned offsets
+typedef struct sOctreeFileHeader
+{
+	_uint		iMagic;
+	_uint		iVersion;
+	_ulonglong	iSourceHash;		// Hash of the source triangles the leaves were built from
+	_uint		iDepth;
+	_uint		iNodeCount;
+	_uint		iIndexCount;
+	_uint		iNodeOffset;
+	_uint		iIndexOffset;
+	_uint		iFileSize;
+}FILEHEADER;
+
 COctree::COctree()
-	: m_pParentTransform(nullptr), m_bDebug(false)
+	: m_pMappedFile(nullptr), m_pNodes(nullptr), m_pTriIndices(nullptr), m_iNodeCount(0)
+	, m_iDepth(0), m_iFirstLeaf(0)
+	, m_pParentTransform(nullptr), m_pDebugBox(nullptr), m_bDebug(false)
 {
-	m_vecNodeInfo.clear();
+	m_vecNodes.clear();
+	m_vecTriIndices.clear();
+	m_vecTriangles.clear();
+	m_vecHighlight.clear();
 }
 
 COctree::~COctree()
@@ -23,202 +53,443 @@ COctree::~COctree()
 // Call instead of destructor to manage class internal data
 void COctree::Destroy()
 {
-	for (int i = 0; i < m_vecNodeInfo.size(); ++i)
-	{
-		for (int j = 0; j < m_vecNodeInfo[i]->vecTriangles.size(); ++j)
-		{
-			delete m_vecNodeInfo[i]->vecTriangles[j];
-		}
-		m_vecNodeInfo[i]->vecTriangles.clear();
-		SafeDestroy(m_vecNodeInfo[i]->BBox);
-		delete m_vecNodeInfo[i];
-	}
-	m_vecNodeInfo.clear();
+	m_vecNodes.clear();
+	m_vecTriIndices.clear();
+	m_vecTriangles.clear();
+	m_vecHighlight.clear();
+	SafeDestroy(m_pDebugBox);
+	SafeDestroy(m_pMappedFile);
+
+	m_pNodes = nullptr;
+	m_pTriIndices = nullptr;
+	m_iNodeCount = 0;
 }
 
 // Basic Render Function, render bounding box of node
 void COctree::Render()
 {
-	for (int i = 0; i < m_vecNodeInfo.size(); ++i)
+	if (nullptr == m_pDebugBox)
+	{
+		m_pDebugBox = CBoundingBox::Create(vec3(-0.5f), vec3(0.5f), "DebugBoxShader");
+		if (nullptr == m_pDebugBox)
+			return;
+	}
+
+	for (_uint i = m_iFirstLeaf; i < m_iNodeCount; ++i)
 	{
-		if (m_vecNodeInfo[i]->vecTriangles.size() <= 0)
+		const NODE& node = m_pNodes[i];
+		if (node.iTriCount <= 0)
 			continue;
-		
-		if (m_vecNodeInfo[i]->BBox_Render)
-		{
-			m_vecNodeInfo[i]->BBox->SetColor(vec3(1.f, 0.f, 0.f));
-			m_vecNodeInfo[i]->BBox->RenderWithoutParent();
-		}
-		else
+
+		_bool highlight = m_vecHighlight[i - m_iFirstLeaf];
+		if (!highlight && !m_bDebug)
+			continue;
+
+		vec3 vMin(node.vMin[0], node.vMin[1], node.vMin[2]);
+		vec3 vMax(node.vMax[0], node.vMax[1], node.vMax[2]);
+		mat4x4 matWorld = translate(mat4x4(1.f), (vMin + vMax) * 0.5f);
+		matWorld = scale(matWorld, vMax - vMin);
+
+		m_pDebugBox->SetColor(highlight ? vec3(1.f, 0.f, 0.f) : vec3(0.f, 1.f, 0.f));
+		m_pDebugBox->RenderWithMatrix(matWorld);
+	}
+}
+
+// Add triangles for collision checking (distributed to the leaves by Build)
+void COctree::AddTriangle(const TRIANGLE& t)
+{
+	m_vecTriangles.push_back(t);
+}
+
+// Distribute the added triangles to the leaves, return the number of triangles outside of the tree
+// Top-down : each node splits its triangle list between its 8 children, on up to workerCount workers (0 : one per core)
+// The top levels are opened until there are enough subtrees for every worker, the subtrees are then built in parallel
+// The leaf lists come out the same whatever the worker count
+_uint COctree::Build(_uint workerCount)
+{
+	if (0 == workerCount)
+		workerCount = GetParallelWorkerCount();
+
+	_uint leafCount = (_uint)m_vecNodes.size() - m_iFirstLeaf;
+	vector<vector<_uint>> vecLeafTris(leafCount);
+
+	// Triangles that miss the root can't reach any leaf
+	const NODE& root = m_vecNodes[0];
+	vec3 vRootMin(root.vMin[0], root.vMin[1], root.vMin[2]);
+	vec3 vRootMax(root.vMax[0], root.vMax[1], root.vMax[2]);
+	vec3 vRootCenter = (vRootMin + vRootMax) * 0.5f;
+	vec3 vRootHalf = (vRootMax - vRootMin) * 0.5f;
+
+	_uint triCount = (_uint)m_vecTriangles.size();
+	_bool* pInside = new _bool[triCount];
+	CCollisionMaster* pCollision = CCollisionMaster::GetInstance();
+	ParallelFor(triCount, OCTREE_BUILD_BLOCK, [&](_uint begin, _uint end, _uint worker)
+	{
+		pCollision->TestTrianglesAABB(m_vecTriangles.data() + begin, nullptr, end - begin, vRootCenter, vRootHalf, pInside + begin);
+	}, workerCount);
+
+	vector<_uint> vecTris;
+	vecTris.reserve(triCount);
+	for (_uint i = 0; i < triCount; ++i)
+	{
+		if (pInside[i])
+			vecTris.push_back(i);
+	}
+	delete[] pInside;
+	_uint missed = (_uint)(m_vecTriangles.size() - vecTris.size());
+
+	// Each level splits the lists of its nodes in blocks that run in parallel, empty subtrees are dropped
+	_bool parallel = 1 < workerCount && OCTREE_PARALLEL_MIN <= vecTris.size();
+	vector<_uint> vecSubtrees(1, 0);
+	vector<vector<_uint>> vecSubtreeTris(1);
+	vecSubtreeTris[0].swap(vecTris);
+	while (parallel && !vecSubtrees.empty() && vecSubtrees.size() < workerCount * 4 && vecSubtrees[0] < m_iFirstLeaf)
+	{
+		vector<_uint> vecNext;
+		vector<vector<_uint>> vecNextTris;
+		for (size_t i = 0; i < vecSubtrees.size(); ++i)
 		{
-			if (m_bDebug)
+			vector<_uint> vecChildTris[8];
+			PartitionParallel(vecSubtrees[i], vecSubtreeTris[i], vecChildTris, workerCount);
+			vector<_uint>().swap(vecSubtreeTris[i]);
+
+			for (_uint c = 0; c < 8; ++c)
 			{
-				m_vecNodeInfo[i]->BBox->SetColor(vec3(0.f, 1.f, 0.f));
-				m_vecNodeInfo[i]->BBox->RenderWithoutParent();
+				if (vecChildTris[c].empty())
+					continue;
+				vecNext.push_back(8 * vecSubtrees[i] + 1 + c);
+				vecNextTris.push_back(move(vecChildTris[c]));
 			}
 		}
+		vecSubtrees.swap(vecNext);
+		vecSubtreeTris.swap(vecNextTris);
+	}
+
+	// Every subtree writes only to its own leaves
+	ParallelFor((_uint)vecSubtrees.size(), 1, [&](_uint begin, _uint end, _uint worker)
+	{
+		for (_uint i = begin; i < end; ++i)
+			BuildNode(vecSubtrees[i], vecSubtreeTris[i], vecLeafTris);
+	}, workerCount);
+
+	// Pack the leaf lists in Morton order : one index buffer, per-leaf offset/count
+	size_t total = 0;
+	for (_uint i = 0; i < leafCount; ++i)
+		total += vecLeafTris[i].size();
+
+	m_vecTriIndices.clear();
+	m_vecTriIndices.reserve(total);
+	for (_uint i = 0; i < leafCount; ++i)
+	{
+		NODE& leaf = m_vecNodes[m_iFirstLeaf + i];
+		leaf.iTriStart = (_uint)m_vecTriIndices.size();
+		leaf.iTriCount = (_uint)vecLeafTris[i].size();
+		m_vecTriIndices.insert(m_vecTriIndices.end(), vecLeafTris[i].begin(), vecLeafTris[i].end());
+	}
+
+	// Leaves of a subtree are contiguous in Morton order, so a branch covers one range
+	for (_int i = (_int)m_iFirstLeaf - 1; i >= 0; --i)
+	{
+		NODE& node = m_vecNodes[i];
+		node.iTriStart = m_vecNodes[8 * i + 1].iTriStart;
+		node.iTriCount = 0;
+		for (_uint c = 1; c <= 8; ++c)
+			node.iTriCount += m_vecNodes[8 * i + c].iTriCount;
 	}
+
+	m_vecHighlight.assign(leafCount, false);
+
+	// Back to the built arrays if a cache file was loaded before
+	SafeDestroy(m_pMappedFile);
+	m_pNodes = m_vecNodes.data();
+	m_pTriIndices = m_vecTriIndices.data();
+
+	return missed;
 }
 
-// Add triangles for collision checking
-void COctree::AddTriangle(TRIANGLE t, _uint& count)
+// Write the built leaves to a cache file tagged with the hash of the source triangles
+_bool COctree::Save(const string& path, _ulonglong sourceHash)
 {
-	_bool flag = false;
-	for (int i = 0; i < m_vecNodeInfo.size(); ++i)
-	{
-		if (!m_vecNodeInfo[i]->isLeaf)
-			continue;
+	if (0 == m_iNodeCount || path.empty())
+		return false;
+
+	// The root covers every leaf list
+	_uint indexCount = m_pNodes[0].iTriCount;
+
+	FILEHEADER header;
+	header.iMagic = OCTREE_FILE_MAGIC;
+	header.iVersion = OCTREE_FILE_VERSION;
+	header.iSourceHash = sourceHash;
+	header.iDepth = m_iDepth;
+	header.iNodeCount = m_iNodeCount;
+	header.iIndexCount = indexCount;
+	header.iNodeOffset = (_uint)(sizeof(FILEHEADER) + OCTREE_FILE_ALIGN - 1) & ~(OCTREE_FILE_ALIGN - 1);
+	header.iIndexOffset = (_uint)(header.iNodeOffset + m_iNodeCount * sizeof(NODE) + OCTREE_FILE_ALIGN - 1) & ~(OCTREE_FILE_ALIGN - 1);
+	header.iFileSize = (_uint)(header.iIndexOffset + indexCount * sizeof(_uint));
+
+	ofstream file(path, ios::binary | ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	const char padding[OCTREE_FILE_ALIGN] = { 0 };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(FILEHEADER));
+	file.write(padding, header.iNodeOffset - sizeof(FILEHEADER));
+	file.write(reinterpret_cast<const char*>(m_pNodes), m_iNodeCount * sizeof(NODE));
+	file.write(padding, header.iIndexOffset - (header.iNodeOffset + m_iNodeCount * sizeof(NODE)));
+	file.write(reinterpret_cast<const char*>(m_pTriIndices), indexCount * sizeof(_uint));
+
+	return file.good();
+}
 
-		if (CCollisionMaster::GetInstance()->IntersectTriangleToOBB(&t, m_vecNodeInfo[i]->BBox))
+// Use a cache file in place of Build, false if it is missing, stale or damaged (the tree is left as it was)
+// The file must come from a tree with the same bounds and depth, triangles are added with AddTriangle first
+_bool COctree::Load(const string& path, _ulonglong sourceHash)
+{
+	CMappedFile* pMappedFile = CMappedFile::Create(path);
+	if (nullptr == pMappedFile)
+		return false;
+
+	const _uchar* pData = pMappedFile->GetData();
+	size_t size = pMappedFile->GetSize();
+	const FILEHEADER* pHeader = reinterpret_cast<const FILEHEADER*>(pData);
+	_bool valid = size >= sizeof(FILEHEADER)
+		&& OCTREE_FILE_MAGIC == pHeader->iMagic && OCTREE_FILE_VERSION == pHeader->iVersion
+		&& sourceHash == pHeader->iSourceHash && m_iDepth == pHeader->iDepth
+		&& m_iNodeCount == pHeader->iNodeCount && size == pHeader->iFileSize
+		&& pHeader->iNodeOffset >= sizeof(FILEHEADER)
+		&& pHeader->iIndexOffset >= pHeader->iNodeOffset + (size_t)m_iNodeCount * sizeof(NODE)
+		&& size >= pHeader->iIndexOffset + (size_t)pHeader->iIndexCount * sizeof(_uint)
+		&& 0 == (pHeader->iNodeOffset | pHeader->iIndexOffset) % OCTREE_FILE_ALIGN;
+
+	if (valid)
+	{
+		// Same root bounds, otherwise the cells don't line up with this tree
+		const NODE& root = *reinterpret_cast<const NODE*>(pData + pHeader->iNodeOffset);
+		for (_uint i = 0; i < 3; ++i)
 		{
-			TRIANGLE* tri = new TRIANGLE();
-			tri->p0 = t.p0;
-			tri->p1 = t.p1;
-			tri->p2 = t.p2;
-			m_vecNodeInfo[i]->vecTriangles.push_back(tri);
-			flag = true;
+			if (root.vMin[i] != m_vecNodes[0].vMin[i] || root.vMax[i] != m_vecNodes[0].vMax[i])
+				valid = false;
 		}
 	}
 
-	if (!flag)
+	// Queries read the sections without checks, so every range and index must stay inside them
+	const NODE* pNodes = reinterpret_cast<const NODE*>(pData + pHeader->iNodeOffset);
+	for (_uint i = 0; valid && i < m_iNodeCount; ++i)
+		valid = pNodes[i].iTriCount <= pHeader->iIndexCount && pNodes[i].iTriStart <= pHeader->iIndexCount - pNodes[i].iTriCount;
+
+	const _uint* pTriIndices = reinterpret_cast<const _uint*>(pData + pHeader->iIndexOffset);
+	for (_uint i = 0; valid && i < pHeader->iIndexCount; ++i)
+		valid = pTriIndices[i] < m_vecTriangles.size();
+
+	if (!valid)
 	{
-		++count;
+		SafeDestroy(pMappedFile);
+		return false;
 	}
+
+	SafeDestroy(m_pMappedFile);
+	m_pMappedFile = pMappedFile;
+	m_pNodes = pNodes;
+	m_pTriIndices = pTriIndices;
+	m_vecHighlight.assign(m_iNodeCount - m_iFirstLeaf, false);
+
+	return true;
 }
 
-void COctree::CheckBoundingBox(CBoundingBox* bbox, vector<COctreeNode*>& vecNode)
+void COctree::BuildNode(_uint index, vector<_uint>& vecTris, vector<vector<_uint>>& vecLeafTris)
 {
-	if (nullptr == bbox)
+	if (index >= m_iFirstLeaf)
+	{
+		vecLeafTris[index - m_iFirstLeaf].swap(vecTris);
+		return;
+	}
+
+	if (vecTris.empty())
 		return;
 
-	for (int i = 0; i < m_vecNodeInfo.size(); ++i)
+	vector<_uint> vecChildTris[8];
+	PartitionToChildren(index, vecTris.data(), (_uint)vecTris.size(), vecChildTris);
+	vecTris.clear();
+	vecTris.shrink_to_fit();
+
+	for (_uint c = 0; c < 8; ++c)
+		BuildNode(8 * index + 1 + c, vecChildTris[c], vecLeafTris);
+}
+
+// Split a large list in blocks on several workers, the block results are joined in order so they match one PartitionToChildren
+void COctree::PartitionParallel(_uint index, const vector<_uint>& vecTris, vector<_uint> vecChildTris[8], _uint workerCount)
+{
+	_uint blockCount = (_uint)((vecTris.size() + OCTREE_BUILD_BLOCK - 1) / OCTREE_BUILD_BLOCK);
+	vector<vector<_uint>> vecBlockTris((size_t)blockCount * 8);
+	ParallelFor(blockCount, 1, [&](_uint begin, _uint end, _uint worker)
 	{
-		m_vecNodeInfo[i]->BBox_Render = false;
+		for (_uint block = begin; block < end; ++block)
+		{
+			size_t start = (size_t)block * OCTREE_BUILD_BLOCK;
+			_uint count = (_uint)glm::min(vecTris.size() - start, (size_t)OCTREE_BUILD_BLOCK);
+			PartitionToChildren(index, vecTris.data() + start, count, &vecBlockTris[(size_t)block * 8]);
+		}
+	}, workerCount);
+
+	for (_uint c = 0; c < 8; ++c)
+	{
+		size_t total = 0;
+		for (_uint block = 0; block < blockCount; ++block)
+			total += vecBlockTris[(size_t)block * 8 + c].size();
+
+		vecChildTris[c].reserve(total);
+		for (_uint block = 0; block < blockCount; ++block)
+		{
+			const vector<_uint>& vecBlock = vecBlockTris[(size_t)block * 8 + c];
+			vecChildTris[c].insert(vecChildTris[c].end(), vecBlock.begin(), vecBlock.end());
+		}
 	}
-	
-	CheckNodeBoundingBox(0, bbox, vecNode);
 }
 
-void COctree::CheckNodeBoundingBox(_int index, CBoundingBox* bbox, vector<COctreeNode*>& vecNode)
+// Split a node's triangles between its children (triangles may go to several)
+// The lists keep increasing triangle order, so every leaf ends up sorted
+void COctree::PartitionToChildren(_uint index, const _uint* pTris, _uint count, vector<_uint> vecChildTris[8])
 {
-	COctreeNode* pNode = m_vecNodeInfo[index];
-	CBoundingBox* nodeBBBox = pNode->BBox;
+	const NODE& node = m_vecNodes[index];
+	vec3 vMin(node.vMin[0], node.vMin[1], node.vMin[2]);
+	vec3 vMax(node.vMax[0], node.vMax[1], node.vMax[2]);
+	vec3 vSplit = (vMin + vMax) * 0.5f;
+	vec3 vChildHalf = (vMax - vMin) * 0.25f;
+
+	// Bounds inside one octant need no SAT test, straddlers are tested per octant in one batch
+	vector<_uint> vecCandidates[8];
+	for (_uint i = 0; i < count; ++i)
+	{
+		const TRIANGLE& tri = m_vecTriangles[pTris[i]];
+		vec3 triMin = glm::min(glm::min(tri.p0, tri.p1), tri.p2);
+		vec3 triMax = glm::max(glm::max(tri.p0, tri.p1), tri.p2);
 
-	if (pNode->isLeaf && pNode->vecTriangles.size() == 0)
-		return;
+		// Octants touched by the triangle's bounds (lo/hi side per axis)
+		_uint loMask = (triMin.x < vSplit.x ? 1 : 0) | (triMin.y < vSplit.y ? 2 : 0) | (triMin.z < vSplit.z ? 4 : 0);
+		_uint hiMask = (triMax.x >= vSplit.x ? 1 : 0) | (triMax.y >= vSplit.y ? 2 : 0) | (triMax.z >= vSplit.z ? 4 : 0);
+		_uint straddle = loMask & hiMask;
 
-	if (CCollisionMaster::GetInstance()->IntersectOBBToAABB(bbox, nodeBBBox))
-	{
-		if (pNode->isLeaf)
+		for (_uint octant = 0; octant < 8; ++octant)
 		{
-			pNode->BBox_Render = true;
-			vecNode.push_back(pNode);
+			// Octant bit set = upper half on that axis
+			if ((octant & ~hiMask & 7) || (~octant & ~loMask & 7))
+				continue;
+
+			if (0 == straddle)
+				vecChildTris[octant].push_back(pTris[i]);
+			else
+				vecCandidates[octant].push_back(pTris[i]);
 		}
-		else
+	}
+
+	size_t maxCandidates = 0;
+	for (_uint octant = 0; octant < 8; ++octant)
+		maxCandidates = glm::max(maxCandidates, vecCandidates[octant].size());
+	if (0 == maxCandidates)
+		return;
+
+	CCollisionMaster* pCollision = CCollisionMaster::GetInstance();
+	_bool* pResults = new _bool[maxCandidates];
+	for (_uint octant = 0; octant < 8; ++octant)
+	{
+		const vector<_uint>& vecCandidate = vecCandidates[octant];
+		if (vecCandidate.empty())
+			continue;
+
+		vec3 vChildCenter = vSplit + vec3((octant & 1) ? vChildHalf.x : -vChildHalf.x,
+			(octant & 2) ? vChildHalf.y : -vChildHalf.y,
+			(octant & 4) ? vChildHalf.z : -vChildHalf.z);
+
+		pCollision->TestTrianglesAABB(m_vecTriangles.data(), vecCandidate.data(), (_uint)vecCandidate.size(), vChildCenter, vChildHalf, pResults);
+		size_t middle = vecChildTris[octant].size();
+		for (size_t i = 0; i < vecCandidate.size(); ++i)
 		{
-			CheckNodeBoundingBox(pNode->childIndex[0], bbox, vecNode);
-			CheckNodeBoundingBox(pNode->childIndex[1], bbox, vecNode);
-			CheckNodeBoundingBox(pNode->childIndex[2], bbox, vecNode);
-			CheckNodeBoundingBox(pNode->childIndex[3], bbox, vecNode);
-			CheckNodeBoundingBox(pNode->childIndex[4], bbox, vecNode);
-			CheckNodeBoundingBox(pNode->childIndex[5], bbox, vecNode);
-			CheckNodeBoundingBox(pNode->childIndex[6], bbox, vecNode);
-			CheckNodeBoundingBox(pNode->childIndex[7], bbox, vecNode);
+			if (pResults[i])
+				vecChildTris[octant].push_back(vecCandidate[i]);
 		}
+
+		// Both parts are in increasing order, merged the result does not depend on how the list was split
+		inplace_merge(vecChildTris[octant].begin(), vecChildTris[octant].begin() + middle, vecChildTris[octant].end());
 	}
+	delete[] pResults;
+}
+
+void COctree::CheckBoundingBox(CBoundingBox* bbox, vector<_uint>& vecLeaf) const
+{
+	VisitLeafNodes(bbox, [&vecLeaf](_uint index, const NODE& node)
+	{
+		vecLeaf.push_back(index);
+		return true;
+	});
 }
 
-_bool Compare(COctree::COctreeNode* t1, COctree::COctreeNode* t2)
+void COctree::HighlightLeafNodes(const vector<_uint>& vecLeaf)
 {
-	return t1->myIndex < t2->myIndex;
+	m_vecHighlight.assign(m_iNodeCount - m_iFirstLeaf, false);
+	for (size_t i = 0; i < vecLeaf.size(); ++i)
+	{
+		if (vecLeaf[i] >= m_iFirstLeaf && vecLeaf[i] < m_iNodeCount)
+			m_vecHighlight[vecLeaf[i] - m_iFirstLeaf] = true;
+	}
+}
+
+// Non-empty node overlapping the box
+_bool COctree::TestNode(_uint index, CBoundingBox* bbox) const
+{
+	const NODE& node = m_pNodes[index];
+	if (0 == node.iTriCount)
+		return false;
+
+	vec3 vMin(node.vMin[0], node.vMin[1], node.vMin[2]);
+	vec3 vMax(node.vMax[0], node.vMax[1], node.vMax[2]);
+	return CCollisionMaster::GetInstance()->IntersectOBBToAABB(bbox, vMin, vMax);
 }
 
 // Initialize
 RESULT COctree::Ready(vec3 vMax, vec3 vMin, _uint depth)
 {
-	_uint nodeCount = (pow(8, depth) - 1) / 7;
-	m_vecNodeInfo.resize(nodeCount);
+	if (0 == depth)
+		return PK_ERROR;
+
+	m_iDepth = depth;
+	m_iFirstLeaf = ((_uint)pow(8, depth - 1) - 1) / 7;
+
+	_uint nodeCount = ((_uint)pow(8, depth) - 1) / 7;
+	m_vecNodes.resize(nodeCount);
+	m_vecHighlight.assign(nodeCount - m_iFirstLeaf, false);
+
+	ReadyOctree(0, vMin, vMax, 1, depth);
 
-	vec3 vHalf = (vMax - vMin) / 2.f;
-	ReadyOctree(0, vMin + vHalf, vHalf, 1, depth);
-	sort(m_vecNodeInfo.begin(), m_vecNodeInfo.end(), Compare);
+	m_pNodes = m_vecNodes.data();
+	m_pTriIndices = m_vecTriIndices.data();
+	m_iNodeCount = nodeCount;
 
 	return PK_NOERROR;
 }
 
 // Initialize Octree
-void COctree::ReadyOctree(_uint index, glm::vec3 vCenter, vec3 vHalf, _uint depth, _uint maxDepth)
+void COctree::ReadyOctree(_uint index, vec3 vMin, vec3 vMax, _uint depth, _uint maxDepth)
 {
-	COctreeNode* pNode = new COctreeNode();
-	pNode->myIndex = index;
-	pNode->vMin = vCenter - vHalf;
-	pNode->vMax = vCenter + vHalf;
-	pNode->vHalf = vHalf;
-	pNode->vCenter = vCenter;
-	pNode->BBox = CBoundingBox::Create(pNode->vMin, pNode->vMax, "DebugBoxShader");
-	pNode->BBox_Render = false;
+	NODE& node = m_vecNodes[index];
+	node.vMin[0] = vMin.x; node.vMin[1] = vMin.y; node.vMin[2] = vMin.z;
+	node.vMax[0] = vMax.x; node.vMax[1] = vMax.y; node.vMax[2] = vMax.z;
+	node.iTriStart = 0;
+	node.iTriCount = 0;
 
 	if (depth == maxDepth)
+		return;
+
+	vec3 vCenter = (vMin + vMax) * 0.5f;
+	for (_uint octant = 0; octant < 8; ++octant)
 	{
-		pNode->isLeaf = true;
-	}
-	else
-	{
-		pNode->isLeaf = false;
-
-		pNode->childIndex[0] = 1 + (8 * index);
-		pNode->childIndex[1] = 2 + (8 * index);
-		pNode->childIndex[2] = 3 + (8 * index);
-		pNode->childIndex[3] = 4 + (8 * index);
-		pNode->childIndex[4] = 5 + (8 * index);
-		pNode->childIndex[5] = 6 + (8 * index);
-		pNode->childIndex[6] = 7 + (8 * index);
-		pNode->childIndex[7] = 8 + (8 * index);
-
-		vec3 childHalf = vHalf / 2.f;
-		vec3 childCenter = vec3(0.f);
-		childCenter.x = pNode->vCenter.x - childHalf.x;
-		childCenter.y = pNode->vCenter.y - childHalf.y;
-		childCenter.z = pNode->vCenter.z + childHalf.z;
-		ReadyOctree(pNode->childIndex[0], childCenter, childHalf, depth + 1, maxDepth);
-
-		childCenter.x = pNode->vCenter.x + childHalf.x;
-		childCenter.y = pNode->vCenter.y - childHalf.y;
-		childCenter.z = pNode->vCenter.z + childHalf.z;
-		ReadyOctree(pNode->childIndex[1], childCenter, childHalf, depth + 1, maxDepth);
-
-		childCenter.x = pNode->vCenter.x - childHalf.x;
-		childCenter.y = pNode->vCenter.y - childHalf.y;
-		childCenter.z = pNode->vCenter.z - childHalf.z;
-		ReadyOctree(pNode->childIndex[2], childCenter, childHalf, depth + 1, maxDepth);
-
-		childCenter.x = pNode->vCenter.x + childHalf.x;
-		childCenter.y = pNode->vCenter.y - childHalf.y;
-		childCenter.z = pNode->vCenter.z - childHalf.z;
-		ReadyOctree(pNode->childIndex[3], childCenter, childHalf, depth + 1, maxDepth);
-
-		childCenter.x = pNode->vCenter.x - childHalf.x;
-		childCenter.y = pNode->vCenter.y + childHalf.y;
-		childCenter.z = pNode->vCenter.z + childHalf.z;
-		ReadyOctree(pNode->childIndex[4], childCenter, childHalf, depth + 1, maxDepth);
-
-		childCenter.x = pNode->vCenter.x + childHalf.x;
-		childCenter.y = pNode->vCenter.y + childHalf.y;
-		childCenter.z = pNode->vCenter.z + childHalf.z;
-		ReadyOctree(pNode->childIndex[5], childCenter, childHalf, depth + 1, maxDepth);
-
-		childCenter.x = pNode->vCenter.x - childHalf.x;
-		childCenter.y = pNode->vCenter.y + childHalf.y;
-		childCenter.z = pNode->vCenter.z - childHalf.z;
-		ReadyOctree(pNode->childIndex[6], childCenter, childHalf, depth + 1, maxDepth);
-
-		childCenter.x = pNode->vCenter.x + childHalf.x;
-		childCenter.y = pNode->vCenter.y + childHalf.y;
-		childCenter.z = pNode->vCenter.z - childHalf.z;
-		ReadyOctree(pNode->childIndex[7], childCenter, childHalf, depth + 1, maxDepth);
-	}
+		vec3 childMin = vMin;
+		vec3 childMax = vCenter;
+		if (octant & 1) { childMin.x = vCenter.x; childMax.x = vMax.x; }
+		if (octant & 2) { childMin.y = vCenter.y; childMax.y = vMax.y; }
+		if (octant & 4) { childMin.z = vCenter.z; childMax.z = vMax.z; }
 
-	m_vecNodeInfo[pNode->myIndex] = pNode;
+		ReadyOctree(8 * index + 1 + octant, childMin, childMax, depth + 1, maxDepth);
+	}
 }
 
 // Create an instance
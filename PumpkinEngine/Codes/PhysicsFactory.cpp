@@ -3,9 +3,13 @@
 #include "../Headers/PhysicsWorld.h"
 #include "../Headers/RigidBody.h"
 #include "../Headers/RigidBodyDesc.h"
+#include "../Headers/SphereShape.h"
+#include "../Headers/PlaneShape.h"
+#include "../Headers/BoxShape.h"
 
 USING(Engine)
 USING(std)
+USING(glm)
 
 CPhysicsFactory::CPhysicsFactory()
 	: iPhysicsFactory()
@@ -18,6 +22,18 @@ CPhysicsFactory::~CPhysicsFactory()
 
 void CPhysicsFactory::Destroy()
 {
+	// Bodies still holding a shape keep it alive
+	for (_uint i = 0; i < m_vecSphereShapes.size(); ++i)
+		SafeDestroy(m_vecSphereShapes[i]);
+	m_vecSphereShapes.clear();
+
+	for (_uint i = 0; i < m_vecPlaneShapes.size(); ++i)
+		SafeDestroy(m_vecPlaneShapes[i]);
+	m_vecPlaneShapes.clear();
+
+	for (_uint i = 0; i < m_vecBoxShapes.size(); ++i)
+		SafeDestroy(m_vecBoxShapes[i]);
+	m_vecBoxShapes.clear();
 }
 
 iPhysicsWorld* CPhysicsFactory::CreateWorld(function<void(void)> callback)
@@ -30,6 +46,52 @@ iRigidBody* CPhysicsFactory::CreateRigidBody(const CRigidBodyDesc& desc, iShape*
 	return CRigidBody::Create(desc, shape);
 }
 
+iShape* CPhysicsFactory::CreateSphereShape(_float radius)
+{
+	for (_uint i = 0; i < m_vecSphereShapes.size(); ++i)
+	{
+		if (radius == m_vecSphereShapes[i]->GetRadius())
+			return m_vecSphereShapes[i];
+	}
+
+	CSphereShape* pShape = CSphereShape::Create(eShapeType::Sphere, radius);
+	if (nullptr != pShape)
+		m_vecSphereShapes.push_back(pShape);
+
+	return pShape;
+}
+
+iShape* CPhysicsFactory::CreatePlaneShape(const vec3& normal, _float dot)
+{
+	for (_uint i = 0; i < m_vecPlaneShapes.size(); ++i)
+	{
+		if (normal == m_vecPlaneShapes[i]->GetNormal() &&
+			dot == m_vecPlaneShapes[i]->GetDotProduct())
+			return m_vecPlaneShapes[i];
+	}
+
+	CPlaneShape* pShape = CPlaneShape::Create(eShapeType::Plane, normal, dot);
+	if (nullptr != pShape)
+		m_vecPlaneShapes.push_back(pShape);
+
+	return pShape;
+}
+
+iShape* CPhysicsFactory::CreateBoxShape(const vec3& halfExtents)
+{
+	for (_uint i = 0; i < m_vecBoxShapes.size(); ++i)
+	{
+		if (halfExtents == m_vecBoxShapes[i]->GetHalfExtents())
+			return m_vecBoxShapes[i];
+	}
+
+	CBoxShape* pShape = CBoxShape::Create(eShapeType::Box, halfExtents);
+	if (nullptr != pShape)
+		m_vecBoxShapes.push_back(pShape);
+
+	return pShape;
+}
+
 RESULT CPhysicsFactory::Ready()
 {
 	return PK_NOERROR;
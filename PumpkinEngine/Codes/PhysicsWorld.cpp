@@ -30,44 +30,79 @@ void CPhysicsWorld::Destroy()
 
 void CPhysicsWorld::Update(const _float& dt)
 {
-	for (int i = 0; i < m_vecRigidBodies.size(); ++i)
-		m_vecRigidBodies[i]->Update(dt);
+#if PK_PHYSICS_PROFILE
+	m_profile.Reset();
+	m_profile.iBodyCount = (_uint)m_vecRigidBodies.size();
+#endif
+	PHYSICS_PROFILE_TIMER(totalTimer, m_profile.fTotalTime);
 
-	for (int i = 0; i < m_vecRigidBodies.size(); ++i)
 	{
-		m_vecRigidBodies[i]->SetGravityAcceleration(m_vGravity);
-		m_vecRigidBodies[i]->UpdateAcceleration();
-	}
+		PHYSICS_PROFILE_TIMER(integrateTimer, m_profile.fIntegrateTime);
 
-	for (int i = 0; i < m_vecRigidBodies.size(); ++i)
-	{
-		m_vecRigidBodies[i]->VerletStep3(dt);
-		m_vecRigidBodies[i]->ApplyDamping(dt / 2.f);
-	}
+		for (int i = 0; i < m_vecRigidBodies.size(); ++i)
+			m_vecRigidBodies[i]->Update(dt);
 
-	for (int i = 0; i < m_vecRigidBodies.size(); ++i)
-		m_vecRigidBodies[i]->VerletStep1(dt);
+		for (int i = 0; i < m_vecRigidBodies.size(); ++i)
+		{
+			m_vecRigidBodies[i]->SetGravityAcceleration(m_vGravity);
+			m_vecRigidBodies[i]->UpdateAcceleration();
+		}
+
+		for (int i = 0; i < m_vecRigidBodies.size(); ++i)
+		{
+			m_vecRigidBodies[i]->VerletStep3(dt);
+			m_vecRigidBodies[i]->ApplyDamping(dt / 2.f);
+		}
+
+		for (int i = 0; i < m_vecRigidBodies.size(); ++i)
+		{
+			m_vecRigidBodies[i]->UpdateKinematic(dt);
+			m_vecRigidBodies[i]->VerletStep1(dt);
+			PHYSICS_PROFILE_COUNT(m_profile.iBodiesAwake,
+				(m_vecRigidBodies[i]->GetPosition() != m_vecRigidBodies[i]->GetPreviousPosition()) ? 1 : 0);
+		}
+	}
 
 	// Collision
 	vector<CCollisionHandler::sColPair> vecPairs;
-	m_pColHandler->Collide(dt, m_vecRigidBodies, vecPairs);
+	{
+		PHYSICS_PROFILE_TIMER(sweepTimer, m_profile.fSweepTime);
+		m_pColHandler->SweepFastBodies(m_vecRigidBodies);
+	}
+	{
+		PHYSICS_PROFILE_TIMER(narrowphaseTimer, m_profile.fNarrowphaseTime);
+		m_pColHandler->Collide(dt, m_vecRigidBodies, vecPairs);
+	}
+#if PK_PHYSICS_PROFILE
+	m_profile.iFastBodies = m_pColHandler->GetFastBodies();
+	m_profile.iPairsTested = m_pColHandler->GetPairsTested();
+	m_profile.iPairsColliding = (_uint)vecPairs.size();
+#endif
 
-	for (int i = 0; i < vecPairs.size(); ++i)
 	{
-		CCollisionHandler::sColPair pair = vecPairs[i];
-		if (eShapeType::Plane == pair.pBodyA->GetShape()->GetShapeType() ||
-			eShapeType::Plane == pair.pBodyB->GetShape()->GetShapeType())
-			continue;
+		PHYSICS_PROFILE_TIMER(callbackTimer, m_profile.fCallbackTime);
 
-		if (nullptr != m_collisionCallback)
-			m_collisionCallback();
+		for (int i = 0; i < vecPairs.size(); ++i)
+		{
+			CCollisionHandler::sColPair pair = vecPairs[i];
+			if (eShapeType::Plane == pair.pBodyA->GetShape()->GetShapeType() ||
+				eShapeType::Plane == pair.pBodyB->GetShape()->GetShapeType())
+				continue;
+
+			if (nullptr != m_collisionCallback)
+				m_collisionCallback();
+		}
 	}
 
-	for (int i = 0; i < m_vecRigidBodies.size(); ++i)
 	{
-		m_vecRigidBodies[i]->VerletStep2(dt);
-		m_vecRigidBodies[i]->ApplyDamping(dt / 2.f);
-		m_vecRigidBodies[i]->KillForces();
+		PHYSICS_PROFILE_TIMER(integrateTimer, m_profile.fIntegrateTime);
+
+		for (int i = 0; i < m_vecRigidBodies.size(); ++i)
+		{
+			m_vecRigidBodies[i]->VerletStep2(dt);
+			m_vecRigidBodies[i]->ApplyDamping(dt / 2.f);
+			m_vecRigidBodies[i]->KillForces();
+		}
 	}
 }
 
@@ -5,6 +5,8 @@ USING(Engine)
 USING(std)
 USING(glm)
 
+POOLED_FUNCTION(CPlaneShape)
+
 CPlaneShape::CPlaneShape()
     : m_vNormal(vec3(0.f)), m_fDotProduct(0.f)
 {
@@ -18,6 +20,12 @@ void CPlaneShape::Destroy()
 {
 }
 
+vec3 CPlaneShape::GetLocalInertia(_float mass)
+{
+    // Planes are infinite and only used for static bodies
+    return vec3(0.f);
+}
+
 RESULT CPlaneShape::Ready(eShapeType type, vec3 vNormal, _float dot)
 {
     m_shapeType = type;
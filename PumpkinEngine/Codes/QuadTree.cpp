@@ -1,8 +1,8 @@
 #include "pch.h"
 #include "..\Headers\QuadTree.h"
 #include "..\Headers\OpenGLDefines.h"
-#include "..\Headers\CollisionMaster.h"
 #include "..\Headers\BoundingBox.h"
+#include <limits>
 
 
 USING(Engine)
@@ -75,61 +75,68 @@ void CQuadTree::AddTriangleToTreeNode(_int hashKey, TRIANGLE triangle)
 	}
 }
 
-void CQuadTree::GetLeafNodes(vec3 vMain, vec3 vTarget, vector<CQuadTreeNode*>& vecNode)
+void CQuadTree::GetLeafNodes(vec3 vMain, vec3 vTarget, vector<CQuadTreeNode*>& vecNode) const
 {
-	vec3 vMax(0.f);
-	vec3 vMin(0.f);
-
-	if (vMain.x > vTarget.x) { vMax.x = vMain.x; vMin.x = vTarget.x; }
-	else					 { vMax.x = vTarget.x; vMin.x = vMain.x; }
-
-	if (vMain.y > vTarget.y) { vMax.y = vMain.y; vMin.y = vTarget.y; }
-	else					 { vMax.y = vTarget.y; vMin.y = vMain.y; }
-
-	if (vMain.z > vTarget.z) { vMax.z = vMain.z; vMin.z = vTarget.z; }
-	else					 { vMax.z = vTarget.z; vMin.z = vMain.z; }
-
-	vec3 vHalf = (vMax - vMin) / 2.f;
-	vec3 vCenter = vMin + vHalf;
-	_float fRadius = distance(vCenter, vMax);
-
-	vec3 vDir = vTarget - vMain;
-	vDir = normalize(vDir);
+	VisitLeafNodes(vMain, vTarget, [&vecNode](const CQuadTreeNode* pNode)
+	{
+		vecNode.push_back(const_cast<CQuadTreeNode*>(pNode));
+		return true;
+	});
+}
 
+void CQuadTree::HighlightLeafNodes(vec3 vMain, vec3 vTarget)
+{
 	for (int i = 0; i < m_vecNodeInfo.size(); ++i)
 	{
 		m_vecNodeInfo[i]->BBox_Render = false;
 	}
 
-	CheckDistanceQuadTree(0, vCenter, fRadius, vMain, vDir, vecNode);
+	VisitLeafNodes(vMain, vTarget, [](const CQuadTreeNode* pNode)
+	{
+		const_cast<CQuadTreeNode*>(pNode)->BBox_Render = true;
+		return true;
+	});
 }
 
-void CQuadTree::CheckDistanceQuadTree(_int index, vec3 vCenter, _float fRadius
-	, vec3 vMain, vec3 vDir, vector<CQuadTreeNode*>& vecNode)
+void CQuadTree::MakeQuery(const vec3& vMain, const vec3& vTarget, QUERY& query) const
 {
-	CQuadTreeNode* pNode = m_vecNodeInfo[index];
-	_float fCenterDist = distance(vCenter, pNode->vCenter);
+	vec3 vMax = glm::max(vMain, vTarget);
+	vec3 vMin = glm::min(vMain, vTarget);
+	vec3 vHalf = (vMax - vMin) / 2.f;
 
-	if (fCenterDist <= fRadius + pNode->fRadius + 5.0f)
+	query.vMain = vMain;
+	query.vDir = normalize(vTarget - vMain);
+	query.vCenter = vMin + vHalf;
+	query.fRadius = distance(query.vCenter, vMax);
+}
+
+// Node near the segment and crossed by its line
+_bool CQuadTree::TestNode(_uint index, const QUERY& query) const
+{
+	const CQuadTreeNode* pNode = m_vecNodeInfo[index];
+	_float fCenterDist = distance(query.vCenter, pNode->vCenter);
+	if (fCenterDist > query.fRadius + pNode->fRadius + 5.0f)
+		return false;
+
+	// Slab test on the node bounds, the line is unbounded in both directions
+	_float tEnter = -numeric_limits<_float>::max();
+	_float tExit = numeric_limits<_float>::max();
+	for (_int i = 0; i < 3; ++i)
 	{
-		_bool check = CCollisionMaster::GetInstance()->IntersectRayToBoundingBox(pNode->BBox, nullptr, vMain, vDir);
-		if (check)
+		if (0.f == query.vDir[i])
 		{
-			if (pNode->isLeaf)
-			{
- 				pNode->BBox_Render = true;
-				vecNode.push_back(pNode);
-			}
-			else
-			{
-				CheckDistanceQuadTree(pNode->childIndex[0], vCenter, fRadius, vMain, vDir, vecNode);
-				CheckDistanceQuadTree(pNode->childIndex[1], vCenter, fRadius, vMain, vDir, vecNode);
-				CheckDistanceQuadTree(pNode->childIndex[2], vCenter, fRadius, vMain, vDir, vecNode);
-				CheckDistanceQuadTree(pNode->childIndex[3], vCenter, fRadius, vMain, vDir, vecNode);
-			}
+			if (query.vMain[i] < pNode->vMin[i] || query.vMain[i] > pNode->vMax[i])
+				return false;
+			continue;
 		}
+
+		_float t0 = (pNode->vMin[i] - query.vMain[i]) / query.vDir[i];
+		_float t1 = (pNode->vMax[i] - query.vMain[i]) / query.vDir[i];
+		tEnter = glm::max(tEnter, glm::min(t0, t1));
+		tExit = glm::min(tExit, glm::max(t0, t1));
 	}
 
+	return tEnter <= tExit;
 }
 
 _bool Compare(CQuadTree::CQuadTreeNode* t1, CQuadTree::CQuadTreeNode* t2)
@@ -1,13 +1,18 @@
 #include "pch.h"
 #include "..\Headers\Renderer.h"
 #include "..\Headers\GameObject.h"
+#include "..\Headers\BoundingBox.h"
+#include "..\Headers\OpenGLDevice.h"
+#include "..\Headers\FrustumCuller.h"
 
 
 USING(Engine)
+USING(glm)
 USING(std)
 SINGLETON_FUNCTION(CRenderer)
 
 CRenderer::CRenderer()
+	: m_pCuller(nullptr), m_bCulling(true), m_iVisibleCount(0), m_iCulledCount(0)
 {
 }
 
@@ -18,22 +23,28 @@ CRenderer::~CRenderer()
 void CRenderer::Destroy()
 {
 	ClearAllRenderObjList();
+	SafeDestroy(m_pCuller);
+	m_vecBoxMin.clear();
+	m_vecBoxMax.clear();
 }
 
 // Basic Render Function, translucent objects are rendered later than other objects
 void CRenderer::Render()
 {
-	vector<CGameObject*>::iterator iter;
-	for (iter = m_vecRenderObj.begin(); iter != m_vecRenderObj.end(); ++iter)
-	{
-		if (nullptr != *iter)
-			(*iter)->Render();
-	}
-	for (iter = m_vecTRenderObj.begin(); iter != m_vecTRenderObj.end(); ++iter)
+	if (nullptr == m_pCuller)
+		m_pCuller = CFrustumCuller::Create();
+
+	// The camera pushes its matrices to the device every update
+	if (nullptr != m_pCuller)
 	{
-		if (nullptr != *iter)
-			(*iter)->Render();
+		COpenGLDevice* pDevice = COpenGLDevice::GetInstance();
+		m_pCuller->SetViewProjMatrix(pDevice->GetProjMatrix() * pDevice->GetViewMatrix());
 	}
+
+	m_iVisibleCount = 0;
+	m_iCulledCount = 0;
+	RenderList(m_vecRenderObj);
+	RenderList(m_vecTRenderObj);
 	ClearAllRenderObjList();
 }
 
@@ -49,6 +60,54 @@ void CRenderer::AddRenderObj(CGameObject* pInstance, _bool isTransparent)
 		m_vecTRenderObj.push_back(pInstance);
 }
 
+// Render the objects of one list that are inside the view frustum
+// Objects without a bounding box or transform (sky box etc.) are always rendered, the list order is kept
+void CRenderer::RenderList(vector<CGameObject*>& vecObj)
+{
+	_bool culling = m_bCulling && nullptr != m_pCuller;
+
+	m_vecBoxMin.clear();
+	m_vecBoxMax.clear();
+	if (culling)
+	{
+		for (size_t i = 0; i < vecObj.size(); ++i)
+		{
+			if (nullptr == vecObj[i])
+				continue;
+
+			CBoundingBox* pBox = vecObj[i]->GetBoundingBox();
+			const mat4x4* pWorld = vecObj[i]->GetWorldMatrix();
+			if (nullptr == pBox || nullptr == pWorld)
+				continue;
+
+			pBox->UpdateWorldBounds(*pWorld);
+			m_vecBoxMin.push_back(pBox->m_vMinWorld);
+			m_vecBoxMax.push_back(pBox->m_vMaxWorld);
+		}
+
+		m_pCuller->Build(m_vecBoxMin.data(), m_vecBoxMax.data(), (_uint)m_vecBoxMin.size());
+		m_pCuller->Cull();
+		m_iCulledCount += m_pCuller->GetCulledCount();
+	}
+
+	// Same walk as above, so the n-th boxed object is box n
+	_uint box = 0;
+	for (size_t i = 0; i < vecObj.size(); ++i)
+	{
+		if (nullptr == vecObj[i])
+			continue;
+
+		if (culling && nullptr != vecObj[i]->GetBoundingBox() && nullptr != vecObj[i]->GetWorldMatrix())
+		{
+			if (!m_pCuller->IsVisible(box++))
+				continue;
+		}
+
+		vecObj[i]->Render();
+		++m_iVisibleCount;
+	}
+}
+
 // Empty container
 void CRenderer::ClearAllRenderObjList()
 {
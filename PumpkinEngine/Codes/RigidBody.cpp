@@ -8,8 +8,10 @@ USING(Engine)
 USING(std)
 USING(glm)
 
+POOLED_FUNCTION(CRigidBody)
+
 CRigidBody::CRigidBody()
-	: m_pDesc(nullptr)
+	: m_pShape(nullptr), m_bIsKinematic(false), m_bHasKinematicTarget(false)
 {
 }
 
@@ -19,8 +21,7 @@ CRigidBody::~CRigidBody()
 
 void CRigidBody::Destroy()
 {
-	if (nullptr != m_pDesc)
-		delete m_pDesc;
+	SafeDestroy(m_pShape);
 }
 
 void CRigidBody::Update(const _float& dt)
@@ -34,11 +35,24 @@ void CRigidBody::SetGravityAcceleration(const vec3& gravity)
 
 void CRigidBody::UpdateAcceleration()
 {
-	if (m_bIsStatic)
+	if (!IsDynamic())
 		return;
 
+	UpdateInertiaTensor();
+
 	m_vLinearAcceleration = m_vForce * m_fInvMass + m_vGravity;
-	m_vAngularAcceleration = m_vTorque * m_fInvMass * m_fInvMass;
+	m_vAngularAcceleration = m_matInvInertiaWorld * m_vTorque;
+}
+
+// Rotate the cached inverse inertia into world space for the current orientation
+void CRigidBody::UpdateInertiaTensor()
+{
+	mat3 matRot = mat3_cast(m_qRotation);
+	mat3 matScaled = matRot;
+	matScaled[0] *= m_vInvInertiaLocal.x;
+	matScaled[1] *= m_vInvInertiaLocal.y;
+	matScaled[2] *= m_vInvInertiaLocal.z;
+	m_matInvInertiaWorld = matScaled * transpose(matRot);
 }
 
 void CRigidBody::VerletStep1(const _float& dt)
@@ -46,25 +60,31 @@ void CRigidBody::VerletStep1(const _float& dt)
 	if (m_bIsStatic)
 		return;
 
+	if (m_bIsKinematic)
+	{
+		KinematicStep(dt);
+		return;
+	}
+
 	m_vPreviousPosition = m_vPosition;
 	m_vPosition += (m_vLinearVelocity + m_vLinearAcceleration * (dt/* * 0.5f*/)) * dt;
 
-	if (-10.f > m_vPosition.y)
-		m_vPosition.y = 5.f;
-
-	vec3 axis = m_vAngularVelocity + m_vAngularAcceleration * dt;
-	_float angle = length(axis);
-	axis = normalize(axis);
-	if (angle != 0.f)
+	vec3 omega = m_vAngularVelocity + m_vAngularAcceleration * dt;
+	if (vec3(0.f) != omega)
 	{
-		quat rot = angleAxis(angle, axis);
-		m_qRotation *= rot;
+		// dq/dt = 0.5 * w * q (world space angular velocity)
+		quat spin(0.f, omega.x, omega.y, omega.z);
+		m_qRotation = m_qRotation + (spin * m_qRotation) * (0.5f * dt);
+
+		// Cheap renormalize : one Newton step of 1/sqrt(x) around x = 1
+		_float lenSq = dot(m_qRotation, m_qRotation);
+		m_qRotation = m_qRotation * ((3.f - lenSq) * 0.5f);
 	}
 }
 
 void CRigidBody::VerletStep2(const _float& dt)
 {
-	if (m_bIsStatic) 
+	if (!IsDynamic())
 		return;
 
 	m_vLinearVelocity += m_vLinearAcceleration * (dt * 0.5f);
@@ -84,8 +104,11 @@ void CRigidBody::KillForces()
 
 void CRigidBody::ApplyDamping(_float dt)
 {
+	if (!IsDynamic())
+		return;
+
 	m_vLinearVelocity *= pow(1.f - m_fLinearDamping, dt);
-	m_vAngularVelocity *= m_fAngularDamping;// pow(1.f - m_fAngularDamping, dt);
+	m_vAngularVelocity *= pow(1.f - m_fAngularDamping, dt);
 
 	if (0.001f > length(m_vLinearVelocity))
 		m_vLinearVelocity = vec3(0.f);
@@ -93,6 +116,52 @@ void CRigidBody::ApplyDamping(_float dt)
 		m_vAngularVelocity = vec3(0.f);
 }
 
+// Derive the velocity that carries a kinematic body onto its target in one step
+void CRigidBody::UpdateKinematic(const _float& dt)
+{
+	if (!m_bIsKinematic)
+		return;
+
+	if (!m_bHasKinematicTarget || 0.f >= dt)
+	{
+		// Idle : no motion, so the sweep tests see a body at rest
+		m_vLinearVelocity = vec3(0.f);
+		m_vAngularVelocity = vec3(0.f);
+		m_vPreviousPosition = m_vPosition;
+		return;
+	}
+	m_bHasKinematicTarget = false;
+
+	_float invDt = 1.f / dt;
+	m_vLinearVelocity = (m_vKinematicPosition - m_vPosition) * invDt;
+
+	quat qDelta = m_qKinematicRotation * inverse(m_qRotation);
+	if (0.f > qDelta.w)
+		qDelta = -qDelta; // Shortest arc
+	_float angle = glm::angle(qDelta);
+	if (numeric_limits<_float>::epsilon() < angle)
+		m_vAngularVelocity = glm::axis(qDelta) * (angle * invDt);
+	else
+		m_vAngularVelocity = vec3(0.f);
+}
+
+// Move along the derived velocity (negative dt rewinds, as the collision handler expects)
+void CRigidBody::KinematicStep(const _float& dt)
+{
+	if (vec3(0.f) == m_vLinearVelocity && vec3(0.f) == m_vAngularVelocity)
+		return;
+
+	m_vPreviousPosition = m_vPosition;
+	m_vPosition += m_vLinearVelocity * dt;
+
+	_float angularSpeed = length(m_vAngularVelocity);
+	if (0.f != angularSpeed)
+	{
+		quat rot = angleAxis(angularSpeed * dt, m_vAngularVelocity / angularSpeed);
+		m_qRotation = normalize(rot * m_qRotation);
+	}
+}
+
 vec3 CRigidBody::GetPosition()
 {
 	return m_vPosition;
@@ -141,21 +210,67 @@ void CRigidBody::ApplyTorque(const vec3& torque)
 
 void CRigidBody::ApplyTorqueImpulse(const glm::vec3& torqueImpulse)
 {
-	m_vAngularVelocity += torqueImpulse;
+	if (!IsDynamic())
+		return;
+
+	m_vAngularVelocity += m_matInvInertiaWorld * torqueImpulse;
+}
+
+void CRigidBody::SetKinematicTarget(const vec3& position, const quat& rotation)
+{
+	if (!m_bIsKinematic)
+		return;
+
+	m_vKinematicPosition = position;
+	m_qKinematicRotation = rotation;
+	m_bHasKinematicTarget = true;
 }
 
 void CRigidBody::ResetAll()
 {
-	SetRigidBodyDesc(*m_pDesc);
+	m_vPosition = m_vInitPosition;
+	m_vPreviousPosition = m_vInitPosition;
+	m_vLinearVelocity = m_vInitLinearVelocity;
+	m_vAngularVelocity = m_vInitAngularVelocity;
+	m_qRotation = m_qInitRotation;
+	m_bHasKinematicTarget = false;
+
+	KillForces();
 }
 
 RESULT CRigidBody::Ready(const CRigidBodyDesc& desc, iShape* shape)
 {
-	m_pDesc = new CRigidBodyDesc(desc);
+	if (nullptr == shape)
+		return PK_ERROR_NULLPTR;
 
 	SetRigidBodyDesc(desc);
 
+	m_vInitPosition = desc.position;
+	m_vInitLinearVelocity = desc.linearVelocity;
+	m_vInitAngularVelocity = desc.angularVelocity;
+	m_qInitRotation = desc.rotation;
+
+	m_vInvInertiaLocal = vec3(0.f);
+	if (IsDynamic())
+	{
+		vec3 inertia = shape->GetLocalInertia(m_fMass);
+		m_vInvInertiaLocal.x = (0.f < inertia.x) ? 1.f / inertia.x : 0.f;
+		m_vInvInertiaLocal.y = (0.f < inertia.y) ? 1.f / inertia.y : 0.f;
+		m_vInvInertiaLocal.z = (0.f < inertia.z) ? 1.f / inertia.z : 0.f;
+	}
+
+	m_vPreviousPosition = desc.position;
+	m_vForce = vec3(0.f);
+	m_vTorque = vec3(0.f);
+	m_vGravity = vec3(0.f);
+	m_vLinearAcceleration = vec3(0.f);
+	m_vAngularAcceleration = vec3(0.f);
+
+	// Shapes can be shared between bodies
 	m_pShape = shape;
+	m_pShape->AddRefCnt();
+
+	UpdateInertiaTensor();
 
 	return PK_NOERROR;
 }
@@ -164,8 +279,15 @@ void CRigidBody::SetRigidBodyDesc(const CRigidBodyDesc& desc)
 {
 	m_bIsStatic = desc.isStatic;
 	m_bIsGround = desc.isGround;
+	m_bIsKinematic = !desc.isStatic && desc.isKinematic;
 
-	if (m_bIsStatic || desc.mass <= 0.f)
+	// Kinematic bodies are driven by their target and never react to contacts
+	if (m_bIsKinematic)
+	{
+		m_fMass = 0.f;
+		m_fInvMass = 0.f;
+	}
+	else if (m_bIsStatic || desc.mass <= 0.f)
 	{
 		m_fMass = 0.f;
 		m_fInvMass = 0.f;
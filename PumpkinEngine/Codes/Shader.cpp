@@ -59,13 +59,11 @@ RESULT CShader::CreateShaderProgram()
 	return PK_NOERROR;
 }
 
-// Create new shader from file
-RESULT CShader::AddShader(const char* vertexPath, const char* fragPath)
+// Create new shader from source code
+RESULT CShader::AddShader(const SHADERFILEDATA& data)
 {
-	string vertex_shader_code = ReadShader(vertexPath);
-	string fragment_shader_code = ReadShader(fragPath);
-	_uint vertexShader = CreateShader(GL_VERTEX_SHADER, vertex_shader_code);
-	_uint fragmentShader = CreateShader(GL_FRAGMENT_SHADER, fragment_shader_code);
+	_uint vertexShader = CreateShader(GL_VERTEX_SHADER, data.vertexCode);
+	_uint fragmentShader = CreateShader(GL_FRAGMENT_SHADER, data.fragmentCode);
 
 	int link_result = 0;
 	glAttachShader(m_ShaderProgram, vertexShader);
@@ -104,6 +102,13 @@ string CShader::ReadShader(const char* fileName)
 	return shaderCode;
 }
 
+// Read both shader files (no GL context needed, safe on any thread)
+void CShader::LoadShaderFiles(const char* vertexPath, const char* fragPath, SHADERFILEDATA& data)
+{
+	data.vertexCode = ReadShader(vertexPath);
+	data.fragmentCode = ReadShader(fragPath);
+}
+
 // Compile shader
 _uint CShader::CreateShader(_uint shaderType, string source)
 {
@@ -198,6 +203,15 @@ void CShader::SetFrameIndex(_uint index)
 
 // Initialize Shader
 RESULT CShader::Ready(string ID, const char* vertexPath, const char* fragPath)
+{
+	SHADERFILEDATA data;
+	LoadShaderFiles(vertexPath, fragPath, data);
+
+	return Ready(ID, data);
+}
+
+// Compile and link shader source code
+RESULT CShader::Ready(string ID, const SHADERFILEDATA& data)
 {
 	m_tag = ID;
 
@@ -206,7 +220,7 @@ RESULT CShader::Ready(string ID, const char* vertexPath, const char* fragPath)
 	if (PK_NOERROR != result)
 		return result;
 
-	result = AddShader(vertexPath, fragPath);
+	result = AddShader(data);
 	if (PK_NOERROR != result)
 		return result;
 
@@ -230,4 +244,17 @@ CShader* CShader::Create(string ID, const char* vertexPath, const char* fragPath
 	}
 
 	return pInstance;
-}
\ No newline at end of file
+}
+
+// Create an instance from source code
+CShader* CShader::Create(string ID, const SHADERFILEDATA& data)
+{
+	CShader* pInstance = new CShader;
+	if (PK_NOERROR != pInstance->Ready(ID, data))
+	{
+		pInstance->Destroy();
+		pInstance = nullptr;
+	}
+
+	return pInstance;
+}
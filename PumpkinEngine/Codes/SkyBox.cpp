@@ -3,12 +3,11 @@
 #include "../Headers/OpenGLDevice.h"
 #include "../Headers/Shader.h"
 #include "../Headers/Transform.h"
+#include "../Headers/TextureStreamer.h"
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
 
-#include "stb_image.h"
-
 
 USING(Engine)
 USING(std)
@@ -76,17 +75,14 @@ RESULT CSkyBox::Ready_Texture(vector<string>& faces)
     glGenTextures(1, &m_iTextureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, m_iTextureID);
 
-    int nrChannels;
+    // Faces start as a black placeholder, the images are decoded and uploaded by the texture streamer
+    // (the cube map samples black until every face has the same size again)
+    const _uchar placeholder[3] = { 0, 0, 0 };
     for (int i = 0; i < faces.size(); ++i)
     {
-        int width, height;
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        }
-        stbi_image_free(data);
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+            0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, placeholder);
+        CTextureStreamer::GetInstance()->Request(this, m_iTextureID, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, faces[i], false);
     }
 
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -0,0 +1,257 @@
+#include "pch.h"
+#include "..\Headers\SpatialIndex.h"
+#include "..\Headers\GameObject.h"
+#include "..\Headers\ParallelFor.h"
+#include "glm\common.hpp"
+
+
+USING(Engine)
+USING(glm)
+USING(std)
+
+#define SPATIAL_BATCH_GRAIN		64
+
+CSpatialIndex::CSpatialIndex()
+{
+	m_vecNodes.clear();
+	m_vecObjects.clear();
+	m_vecPositions.clear();
+}
+
+CSpatialIndex::~CSpatialIndex()
+{
+}
+
+// Call instead of destructor to manage class internal data
+void CSpatialIndex::Destroy()
+{
+	m_vecNodes.clear();
+	m_vecObjects.clear();
+	m_vecPositions.clear();
+}
+
+// Rebuild over raw positions, query results are indices into pPositions
+void CSpatialIndex::Build(const vec3* pPositions, _uint count)
+{
+	m_vecObjects.clear();
+	m_vecPositions.clear();
+	if (nullptr != pPositions)
+		m_vecPositions.assign(pPositions, pPositions + count);
+
+	BuildTree();
+}
+
+// Rebuild over the enabled, living objects of a list, query results are indices for GetGameObject
+void CSpatialIndex::Build(const list<CGameObject*>& listObj)
+{
+	m_vecObjects.clear();
+	m_vecPositions.clear();
+	list<CGameObject*>::const_iterator iter;
+	for (iter = listObj.begin(); iter != listObj.end(); ++iter)
+	{
+		CGameObject* pObj = *iter;
+		if (nullptr == pObj || !pObj->GetEnable() || pObj->GetDead())
+			continue;
+
+		m_vecObjects.push_back(pObj);
+		m_vecPositions.push_back(pObj->GetPosition());
+	}
+
+	BuildTree();
+}
+
+_uint CSpatialIndex::QueryRadius(const vec3& vCenter, _float fRadius, vector<_uint>& vecResult) const
+{
+	size_t before = vecResult.size();
+	if (!m_vecNodes.empty() && fRadius >= 0.f)
+		SearchRadius(0, (_uint)m_vecNodes.size(), vCenter, fRadius * fRadius, vecResult);
+
+	return (_uint)(vecResult.size() - before);
+}
+
+_uint CSpatialIndex::QueryNearest(const vec3& vCenter, _uint k, vector<_uint>& vecResult, _float fMaxDistance) const
+{
+	vector<pair<_float, _uint>> vecHeap;
+	return Nearest(vCenter, k, fMaxDistance, vecHeap, vecResult);
+}
+
+void CSpatialIndex::QueryRadiusBatch(const vec3* pCenters, _uint count, _float fRadius, vector<vector<_uint>>& vecResults, _uint workerCount) const
+{
+	vecResults.resize(count);
+	if (nullptr == pCenters)
+		return;
+
+	// Every query writes only its own result vector
+	ParallelFor(count, SPATIAL_BATCH_GRAIN, [&](_uint begin, _uint end, _uint worker)
+	{
+		for (_uint i = begin; i < end; ++i)
+		{
+			vecResults[i].clear();
+			QueryRadius(pCenters[i], fRadius, vecResults[i]);
+		}
+	}, workerCount);
+}
+
+void CSpatialIndex::QueryNearestBatch(const vec3* pCenters, _uint count, _uint k, vector<vector<_uint>>& vecResults, _uint workerCount) const
+{
+	vecResults.resize(count);
+	if (nullptr == pCenters)
+		return;
+
+	// One heap per worker, reused by all of its queries
+	vector<vector<pair<_float, _uint>>> vecHeaps(GetParallelWorkerCount());
+	ParallelFor(count, SPATIAL_BATCH_GRAIN, [&](_uint begin, _uint end, _uint worker)
+	{
+		for (_uint i = begin; i < end; ++i)
+		{
+			vecResults[i].clear();
+			Nearest(pCenters[i], k, FLT_MAX, vecHeaps[worker], vecResults[i]);
+		}
+	}, workerCount);
+}
+
+void CSpatialIndex::BuildTree()
+{
+	m_vecNodes.resize(m_vecPositions.size());
+	for (_uint i = 0; i < m_vecNodes.size(); ++i)
+	{
+		m_vecNodes[i].vPos = m_vecPositions[i];
+		m_vecNodes[i].iIndex = i;
+		m_vecNodes[i].iAxis = 0;
+	}
+	BuildRange(0, (_uint)m_vecNodes.size());
+}
+
+// Split [begin, end) at its middle on the widest axis, then build both halves
+void CSpatialIndex::BuildRange(_uint begin, _uint end)
+{
+	if (end - begin <= 1)
+		return;
+
+	vec3 vMin = m_vecNodes[begin].vPos;
+	vec3 vMax = vMin;
+	for (_uint i = begin + 1; i < end; ++i)
+	{
+		vMin = glm::min(vMin, m_vecNodes[i].vPos);
+		vMax = glm::max(vMax, m_vecNodes[i].vPos);
+	}
+
+	vec3 vExtent = vMax - vMin;
+	_uint axis = 0;
+	if (vExtent.y > vExtent[axis]) axis = 1;
+	if (vExtent.z > vExtent[axis]) axis = 2;
+
+	_uint mid = begin + (end - begin) / 2;
+	nth_element(m_vecNodes.begin() + begin, m_vecNodes.begin() + mid, m_vecNodes.begin() + end,
+		[axis](const NODE& lhs, const NODE& rhs) { return lhs.vPos[axis] < rhs.vPos[axis]; });
+	m_vecNodes[mid].iAxis = axis;
+
+	BuildRange(begin, mid);
+	BuildRange(mid + 1, end);
+}
+
+void CSpatialIndex::SearchRadius(_uint begin, _uint end, const vec3& vCenter, _float fRadiusSq, vector<_uint>& vecResult) const
+{
+	while (begin < end)
+	{
+		_uint mid = begin + (end - begin) / 2;
+		const NODE& node = m_vecNodes[mid];
+		vec3 vDiff = node.vPos - vCenter;
+		if (dot(vDiff, vDiff) <= fRadiusSq)
+			vecResult.push_back(node.iIndex);
+
+		if (end - begin == 1)
+			return;
+
+		// Recurse into the side only reachable across the split, loop on the other
+		_float fSplit = vDiff[node.iAxis];
+		_bool bLeft = fSplit * fSplit <= fRadiusSq || fSplit > 0.f;
+		_bool bRight = fSplit * fSplit <= fRadiusSq || fSplit <= 0.f;
+		if (bLeft && bRight)
+		{
+			SearchRadius(begin, mid, vCenter, fRadiusSq, vecResult);
+			begin = mid + 1;
+		}
+		else if (bLeft)
+			end = mid;
+		else
+			begin = mid + 1;
+	}
+}
+
+void CSpatialIndex::SearchNearest(_uint begin, _uint end, const vec3& vCenter, _uint k, vector<pair<_float, _uint>>& vecHeap, _float& fBoundSq) const
+{
+	if (begin >= end)
+		return;
+
+	_uint mid = begin + (end - begin) / 2;
+	const NODE& node = m_vecNodes[mid];
+	vec3 vDiff = node.vPos - vCenter;
+	_float fDistSq = dot(vDiff, vDiff);
+	if (fDistSq < fBoundSq)
+	{
+		// Max-heap of the best k so far, the root is the current k-th distance
+		if (vecHeap.size() == k)
+		{
+			pop_heap(vecHeap.begin(), vecHeap.end());
+			vecHeap.pop_back();
+		}
+		vecHeap.push_back(make_pair(fDistSq, node.iIndex));
+		push_heap(vecHeap.begin(), vecHeap.end());
+		if (vecHeap.size() == k)
+			fBoundSq = vecHeap.front().first;
+	}
+
+	if (end - begin == 1)
+		return;
+
+	// Near side first so the bound shrinks before the far side is considered
+	_float fSplit = vDiff[node.iAxis];
+	if (fSplit > 0.f)
+	{
+		SearchNearest(begin, mid, vCenter, k, vecHeap, fBoundSq);
+		if (fSplit * fSplit < fBoundSq)
+			SearchNearest(mid + 1, end, vCenter, k, vecHeap, fBoundSq);
+	}
+	else
+	{
+		SearchNearest(mid + 1, end, vCenter, k, vecHeap, fBoundSq);
+		if (fSplit * fSplit < fBoundSq)
+			SearchNearest(begin, mid, vCenter, k, vecHeap, fBoundSq);
+	}
+}
+
+_uint CSpatialIndex::Nearest(const vec3& vCenter, _uint k, _float fMaxDistance, vector<pair<_float, _uint>>& vecHeap, vector<_uint>& vecResult) const
+{
+	vecHeap.clear();
+	if (m_vecNodes.empty() || 0 == k)
+		return 0;
+
+	_float fBoundSq = FLT_MAX == fMaxDistance ? FLT_MAX : fMaxDistance * fMaxDistance;
+	SearchNearest(0, (_uint)m_vecNodes.size(), vCenter, k, vecHeap, fBoundSq);
+
+	sort_heap(vecHeap.begin(), vecHeap.end());
+	for (size_t i = 0; i < vecHeap.size(); ++i)
+		vecResult.push_back(vecHeap[i].second);
+
+	return (_uint)vecHeap.size();
+}
+
+// Initialize
+RESULT CSpatialIndex::Ready()
+{
+	return PK_NOERROR;
+}
+
+// Create an instance
+CSpatialIndex* CSpatialIndex::Create()
+{
+	CSpatialIndex* pInstance = new CSpatialIndex();
+	if (PK_NOERROR != pInstance->Ready())
+	{
+		pInstance->Destroy();
+		pInstance = nullptr;
+	}
+
+	return pInstance;
+}
@@ -3,6 +3,9 @@
 
 USING(Engine)
 USING(std)
+USING(glm)
+
+POOLED_FUNCTION(CSphereShape)
 
 CSphereShape::CSphereShape()
     : m_fRadius(0.f)
@@ -17,6 +20,12 @@ void CSphereShape::Destroy()
 {
 }
 
+vec3 CSphereShape::GetLocalInertia(_float mass)
+{
+    _float inertia = 0.4f * mass * m_fRadius * m_fRadius;
+    return vec3(inertia);
+}
+
 RESULT CSphereShape::Ready(eShapeType type, _float radius)
 {
     m_shapeType = type;
@@ -1,6 +1,9 @@
 #include "pch.h"
 #include "../Headers/Texture.h"
 #include "../Headers/OpenGLDefines.h"
+#include "../Headers/TextureStreamer.h"
+#include "../Headers/TextureCooker.h"
+#include "../Headers/MappedFile.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include <fstream>
@@ -33,8 +36,22 @@ void CTexture::Destroy()
 
 // Load texture information from file
 RESULT CTexture::Ready(string ID, string filePath)
+{
+    TEXTUREFILEDATA data;
+    LoadImageFile(filePath, data);
+
+    RESULT result = Ready(ID, data);
+    ReleaseImageFile(data);
+
+    return result;
+}
+
+// Upload a decoded image
+RESULT CTexture::Ready(string ID, const TEXTUREFILEDATA& data)
 {
     m_tag = ID;
+    m_iWidth = data.iWidth;
+    m_iHeight = data.iHeight;
 
     glGenTextures(1, &m_iTextureID);
     glBindTexture(GL_TEXTURE_2D, m_iTextureID);
@@ -44,22 +61,85 @@ RESULT CTexture::Ready(string ID, string filePath)
     //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    int nrChannels;
-    unsigned char* data = stbi_load(filePath.c_str(), &m_iWidth, &m_iHeight, &nrChannels, 0);
-
-    if (data)
+    // Cooked : every level is in the cache, nothing left for the driver to generate
+    if (nullptr != data.pMappedFile)
+        UploadCompressed(GL_TEXTURE_2D, data, data.pMappedFile->GetData());
+    else if (data.pPixels)
     {
         if (!strcmp("cemetery_halloween_Tex", ID.c_str()))
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_iWidth, m_iHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_iWidth, m_iHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.pPixels);
         else
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_iWidth, m_iHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_iWidth, m_iHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, data.pPixels);
         glGenerateMipmap(GL_TEXTURE_2D);
     }
-    stbi_image_free(data);
     
     return PK_NOERROR;
 }
 
+// Create the texture with a placeholder image and queue the file on the texture streamer
+RESULT CTexture::Ready_Async(string ID, string filePath)
+{
+    m_tag = ID;
+    m_iWidth = 1;
+    m_iHeight = 1;
+
+    // Mid grey until the real image arrives
+    const _uchar placeholder[4] = { 128, 128, 128, 255 };
+
+    glGenTextures(1, &m_iTextureID);
+    glBindTexture(GL_TEXTURE_2D, m_iTextureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    CTextureStreamer::GetInstance()->Request(this, m_iTextureID, GL_TEXTURE_2D, filePath);
+
+    return PK_NOERROR;
+}
+
+// Read an image from its compressed cache or decode the image file (no GL context needed, safe on any thread)
+// A missing or stale cache is not cooked here (see -texcook), the image file is decoded instead
+RESULT CTexture::LoadImageFile(string filePath, TEXTUREFILEDATA& data)
+{
+    if (PK_NOERROR == CTextureCooker::LoadTextureFile(filePath, data))
+        return PK_NOERROR;
+
+    data.pPixels = stbi_load(filePath.c_str(), &data.iWidth, &data.iHeight, &data.iChannels, 0);
+    if (nullptr == data.pPixels)
+        return PK_ERROR;
+
+    return PK_NOERROR;
+}
+
+void CTexture::ReleaseImageFile(TEXTUREFILEDATA& data)
+{
+    stbi_image_free(data.pPixels);
+    data.pPixels = nullptr;
+    SafeDestroy(data.pMappedFile);
+    data.pMappedFile = nullptr;
+}
+
+// Bytes the image takes on upload
+size_t CTexture::GetImageSize(const TEXTUREFILEDATA& data)
+{
+    if (nullptr != data.pMappedFile)
+        return data.pMappedFile->GetSize();
+
+    return (size_t)data.iWidth * data.iHeight * data.iChannels;
+}
+
+// Specify every level of a compressed image
+// pBase is the start of the cache file, nullptr when it has been copied to the bound pixel unpack buffer
+void CTexture::UploadCompressed(_uint target, const TEXTUREFILEDATA& data, const _uchar* pBase)
+{
+    for (_uint i = 0; i < data.iLevelNum; ++i)
+    {
+        _int width = data.iWidth >> i;
+        _int height = data.iHeight >> i;
+        glCompressedTexImage2D(target, i, data.iFormat, 0 < width ? width : 1, 0 < height ? height : 1, 0,
+            data.Levels[i].iSize, pBase + data.Levels[i].iOffset);
+    }
+}
+
 // Clone component
 CComponent* CTexture::Clone()
 {
@@ -78,3 +158,29 @@ CTexture* CTexture::Create(string ID, string filePath)
 
     return pInstance;
 }
+
+// Create an instance from a decoded image
+CTexture* CTexture::Create(string ID, const TEXTUREFILEDATA& data)
+{
+    CTexture* pInstance = new CTexture();
+    if (PK_NOERROR != pInstance->Ready(ID, data))
+    {
+        pInstance->Destroy();
+        pInstance = nullptr;
+    }
+
+    return pInstance;
+}
+
+// Create an instance that streams its image in
+CTexture* CTexture::CreateAsync(string ID, string filePath)
+{
+    CTexture* pInstance = new CTexture();
+    if (PK_NOERROR != pInstance->Ready_Async(ID, filePath))
+    {
+        pInstance->Destroy();
+        pInstance = nullptr;
+    }
+
+    return pInstance;
+}
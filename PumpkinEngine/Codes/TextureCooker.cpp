@@ -0,0 +1,472 @@
+#include "pch.h"
+#include "..\Headers\TextureCooker.h"
+#include "..\Headers\MappedFile.h"
+#include "..\Headers\ParallelFor.h"
+#include "..\Headers\OpenGLDefines.h"
+#include "stb_image.h"
+#include <fstream>
+#include <cfloat>
+
+
+USING(Engine)
+USING(glm)
+USING(std)
+
+#define TEXTURE_CACHE_MAGIC         0x58455450      // "PTEX"
+#define TEXTURE_CACHE_VERSION       1
+#define TEXTURE_CACHE_ALIGN         16
+
+// Cooked texture header, KTX2 style : description of the image followed by the level index (largest level first)
+// Every level starts at a 16 byte aligned offset and is uploaded straight from the mapping
+typedef struct sTextureCacheHeader
+{
+	_uint						iMagic;
+	_uint						iVersion;
+	_ulonglong					iSourceHash;		// Hash of the image file
+	_uint						iFormat;			// GL compressed internal format
+	_uint						iBlockSize;			// Bytes per 4x4 block
+	_uint						iWidth;
+	_uint						iHeight;
+	_uint						iLevelNum;
+	CTexture::TEXTURELEVEL		Levels[TEXTURE_MAX_LEVEL];
+	_uint						iFileSize;
+}TEXTURECACHEHEADER;
+
+static _uint AlignTextureOffset(size_t offset)
+{
+	return (_uint)((offset + TEXTURE_CACHE_ALIGN - 1) & ~(size_t)(TEXTURE_CACHE_ALIGN - 1));
+}
+
+static _uint GetLevelSize(_uint width, _uint height, _uint level, _uint blockSize)
+{
+	_uint levelWidth = glm::max(1u, width >> level);
+	_uint levelHeight = glm::max(1u, height >> level);
+
+	return ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockSize;
+}
+
+static _ushort PackRGB565(const vec3& colour)
+{
+	vec3 c = clamp(colour, 0.f, 255.f);
+	_uint r = (_uint)(c.r * 31.f / 255.f + 0.5f);
+	_uint g = (_uint)(c.g * 63.f / 255.f + 0.5f);
+	_uint b = (_uint)(c.b * 31.f / 255.f + 0.5f);
+
+	return (_ushort)((r << 11) | (g << 5) | b);
+}
+
+static vec3 UnpackRGB565(_ushort colour)
+{
+	_uint r = (colour >> 11) & 31;
+	_uint g = (colour >> 5) & 63;
+	_uint b = colour & 31;
+
+	return vec3((_float)((r << 3) | (r >> 2)), (_float)((g << 2) | (g >> 4)), (_float)((b << 3) | (b >> 2)));
+}
+
+// 2 bit palette index of every pixel for a pair of endpoints (4 colour mode), returns the squared error
+static _float FitColourIndices(const vec3* pColours, _ushort colour0, _ushort colour1, _uint& indices)
+{
+	vec3 palette[4];
+	palette[0] = UnpackRGB565(colour0);
+	palette[1] = UnpackRGB565(colour1);
+	palette[2] = (palette[0] * 2.f + palette[1]) / 3.f;
+	palette[3] = (palette[0] + palette[1] * 2.f) / 3.f;
+
+	indices = 0;
+	_float error = 0.f;
+	for (_uint i = 0; i < 16; ++i)
+	{
+		_uint best = 0;
+		_float bestDist = FLT_MAX;
+		for (_uint k = 0; k < 4; ++k)
+		{
+			vec3 d = pColours[i] - palette[k];
+			_float dist = dot(d, d);
+			if (dist < bestDist)
+			{
+				bestDist = dist;
+				best = k;
+			}
+		}
+		indices |= best << (i * 2);
+		error += bestDist;
+	}
+
+	return error;
+}
+
+// Map the cooked cache of an image, fails when it is missing or made from another file
+// Caches are only written by CookTextureFile (-texcook), a load never compresses anything
+RESULT CTextureCooker::LoadTextureFile(const string& sourcePath, CTexture::TEXTUREFILEDATA& data)
+{
+	CMappedFile* pSource = CMappedFile::Create(sourcePath);
+	if (nullptr == pSource)
+		return PK_ERROR;
+
+	_ulonglong sourceHash = CMappedFile::HashBytes(pSource->GetData(), pSource->GetSize());
+	RESULT result = MapTextureCache(sourcePath + ".tex", sourceHash, data);
+	SafeDestroy(pSource);
+
+	return result;
+}
+
+// Cook an image and write its cache whether or not it is up to date
+RESULT CTextureCooker::CookTextureFile(const string& sourcePath, COOKRESULT* pResult)
+{
+	CMappedFile* pSource = CMappedFile::Create(sourcePath);
+	if (nullptr == pSource)
+		return PK_ERROR;
+
+	_ulonglong sourceHash = CMappedFile::HashBytes(pSource->GetData(), pSource->GetSize());
+	RESULT result = Cook(pSource->GetData(), pSource->GetSize(), sourceHash, sourcePath + ".tex", pResult);
+	SafeDestroy(pSource);
+
+	return result;
+}
+
+// Half size level of an RGBA8 image (2x2 box filter, odd edges are repeated)
+void CTextureCooker::GenerateMip(const _uchar* pSource, _uint width, _uint height, _uchar* pDest)
+{
+	_uint destWidth = glm::max(1u, width / 2);
+	_uint destHeight = glm::max(1u, height / 2);
+
+	for (_uint y = 0; y < destHeight; ++y)
+	{
+		const _uchar* pRow0 = pSource + glm::min(y * 2, height - 1) * width * 4;
+		const _uchar* pRow1 = pSource + glm::min(y * 2 + 1, height - 1) * width * 4;
+		for (_uint x = 0; x < destWidth; ++x)
+		{
+			_uint x0 = glm::min(x * 2, width - 1) * 4;
+			_uint x1 = glm::min(x * 2 + 1, width - 1) * 4;
+			for (_uint c = 0; c < 4; ++c)
+				pDest[(y * destWidth + x) * 4 + c] = (_uchar)((pRow0[x0 + c] + pRow0[x1 + c] + pRow1[x0 + c] + pRow1[x1 + c] + 2) / 4);
+		}
+	}
+}
+
+// Compress an RGBA8 image into 4x4 blocks, rows of blocks run in parallel
+void CTextureCooker::CompressBC1(const _uchar* pSource, _uint width, _uint height, _uchar* pBlocks)
+{
+	_uint blockWidth = (width + 3) / 4;
+	_uint blockHeight = (height + 3) / 4;
+
+	ParallelFor(blockHeight, 4, [&](_uint begin, _uint end, _uint worker)
+	{
+		_uchar block[64];
+		for (_uint blockY = begin; blockY < end; ++blockY)
+		{
+			for (_uint blockX = 0; blockX < blockWidth; ++blockX)
+			{
+				FetchBlock(pSource, width, height, blockX, blockY, block);
+				CompressColourBlock(block, pBlocks + (blockY * blockWidth + blockX) * TEXTURE_BC1_BLOCK_SIZE);
+			}
+		}
+	});
+}
+
+// BC3 block : BC4 style alpha block followed by a BC1 colour block
+void CTextureCooker::CompressBC3(const _uchar* pSource, _uint width, _uint height, _uchar* pBlocks)
+{
+	_uint blockWidth = (width + 3) / 4;
+	_uint blockHeight = (height + 3) / 4;
+
+	ParallelFor(blockHeight, 4, [&](_uint begin, _uint end, _uint worker)
+	{
+		_uchar block[64];
+		for (_uint blockY = begin; blockY < end; ++blockY)
+		{
+			for (_uint blockX = 0; blockX < blockWidth; ++blockX)
+			{
+				_uchar* pOut = pBlocks + (blockY * blockWidth + blockX) * TEXTURE_BC3_BLOCK_SIZE;
+				FetchBlock(pSource, width, height, blockX, blockY, block);
+				CompressAlphaBlock(block, pOut);
+				CompressColourBlock(block, pOut + 8);
+			}
+		}
+	});
+}
+
+// 4x4 RGBA8 pixels of one block, pixels past the edges repeat the last row or column
+void CTextureCooker::FetchBlock(const _uchar* pSource, _uint width, _uint height, _uint blockX, _uint blockY, _uchar* pBlock)
+{
+	for (_uint y = 0; y < 4; ++y)
+	{
+		_uint sourceY = glm::min(blockY * 4 + y, height - 1);
+		for (_uint x = 0; x < 4; ++x)
+		{
+			_uint sourceX = glm::min(blockX * 4 + x, width - 1);
+			memcpy(pBlock + (y * 4 + x) * 4, pSource + (sourceY * width + sourceX) * 4, 4);
+		}
+	}
+}
+
+// Endpoints at the extremes of the colours along their principal axis, then one least squares pass for the chosen indices
+void CTextureCooker::CompressColourBlock(const _uchar* pBlock, _uchar* pOut)
+{
+	vec3 colours[16];
+	vec3 vMean(0.f);
+	for (_uint i = 0; i < 16; ++i)
+	{
+		colours[i] = vec3(pBlock[i * 4], pBlock[i * 4 + 1], pBlock[i * 4 + 2]);
+		vMean += colours[i];
+	}
+	vMean /= 16.f;
+
+	// Covariance (upper triangle) and its dominant eigenvector by power iteration
+	_float cov[6] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+	for (_uint i = 0; i < 16; ++i)
+	{
+		vec3 d = colours[i] - vMean;
+		cov[0] += d.x * d.x; cov[1] += d.x * d.y; cov[2] += d.x * d.z;
+		cov[3] += d.y * d.y; cov[4] += d.y * d.z; cov[5] += d.z * d.z;
+	}
+
+	vec3 vAxis(1.f, 1.f, 1.f);
+	for (_uint iteration = 0; iteration < 8; ++iteration)
+	{
+		vec3 vNext(cov[0] * vAxis.x + cov[1] * vAxis.y + cov[2] * vAxis.z,
+			cov[1] * vAxis.x + cov[3] * vAxis.y + cov[4] * vAxis.z,
+			cov[2] * vAxis.x + cov[4] * vAxis.y + cov[5] * vAxis.z);
+		_float scale = glm::max(glm::max(abs(vNext.x), abs(vNext.y)), abs(vNext.z));
+		if (scale < FLT_EPSILON)
+			break;
+		vAxis = vNext / scale;
+	}
+	vAxis = normalize(vAxis);
+
+	_float minT = FLT_MAX;
+	_float maxT = -FLT_MAX;
+	for (_uint i = 0; i < 16; ++i)
+	{
+		_float t = dot(colours[i] - vMean, vAxis);
+		minT = glm::min(minT, t);
+		maxT = glm::max(maxT, t);
+	}
+
+	// The first endpoint is kept the larger one so decoders stay in 4 colour mode
+	_ushort colour0 = PackRGB565(vMean + vAxis * maxT);
+	_ushort colour1 = PackRGB565(vMean + vAxis * minT);
+	if (colour0 < colour1)
+		swap(colour0, colour1);
+	_uint indices = 0;
+	_float error = FitColourIndices(colours, colour0, colour1, indices);
+
+	const _float weights[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+	_float a = 0.f, b = 0.f, c = 0.f;
+	vec3 x(0.f), y(0.f);
+	for (_uint i = 0; i < 16; ++i)
+	{
+		_float w0 = weights[(indices >> (i * 2)) & 3];
+		_float w1 = 1.f - w0;
+		a += w0 * w0; b += w0 * w1; c += w1 * w1;
+		x += colours[i] * w0;
+		y += colours[i] * w1;
+	}
+	_float det = a * c - b * b;
+	if (abs(det) > FLT_EPSILON)
+	{
+		_ushort refined0 = PackRGB565((x * c - y * b) / det);
+		_ushort refined1 = PackRGB565((y * a - x * b) / det);
+		if (refined0 < refined1)
+			swap(refined0, refined1);
+
+		_uint refinedIndices = 0;
+		_float refinedError = FitColourIndices(colours, refined0, refined1, refinedIndices);
+		if (refinedError < error)
+		{
+			colour0 = refined0;
+			colour1 = refined1;
+			indices = refinedIndices;
+		}
+	}
+
+	// Equal endpoints would select 3 colour mode, every index then has to stay 0
+	if (colour0 == colour1)
+		indices = 0;
+
+	pOut[0] = (_uchar)(colour0 & 0xFF);
+	pOut[1] = (_uchar)(colour0 >> 8);
+	pOut[2] = (_uchar)(colour1 & 0xFF);
+	pOut[3] = (_uchar)(colour1 >> 8);
+	for (_uint i = 0; i < 4; ++i)
+		pOut[4 + i] = (_uchar)((indices >> (i * 8)) & 0xFF);
+}
+
+// Endpoints at the alpha range (8 value mode), 3 bit index of the nearest value for every pixel
+void CTextureCooker::CompressAlphaBlock(const _uchar* pBlock, _uchar* pOut)
+{
+	_uchar alpha0 = 0;
+	_uchar alpha1 = 255;
+	for (_uint i = 0; i < 16; ++i)
+	{
+		alpha0 = glm::max(alpha0, pBlock[i * 4 + 3]);
+		alpha1 = glm::min(alpha1, pBlock[i * 4 + 3]);
+	}
+
+	_uint values[8];
+	values[0] = alpha0;
+	values[1] = alpha1;
+	for (_uint k = 2; k < 8; ++k)
+		values[k] = ((8 - k) * alpha0 + (k - 1) * alpha1 + 3) / 7;
+
+	_ulonglong bits = 0;
+	if (alpha0 != alpha1)
+	{
+		for (_uint i = 0; i < 16; ++i)
+		{
+			_uint best = 0;
+			_uint bestDist = UINT_MAX;
+			for (_uint k = 0; k < 8; ++k)
+			{
+				_uint dist = (_uint)abs((_int)pBlock[i * 4 + 3] - (_int)values[k]);
+				if (dist < bestDist)
+				{
+					bestDist = dist;
+					best = k;
+				}
+			}
+			bits |= (_ulonglong)best << (i * 3);
+		}
+	}
+
+	pOut[0] = alpha0;
+	pOut[1] = alpha1;
+	for (_uint i = 0; i < 6; ++i)
+		pOut[2 + i] = (_uchar)((bits >> (i * 8)) & 0xFF);
+}
+
+// Decode the image, compress every level of its mip chain and write the cache
+RESULT CTextureCooker::Cook(const _uchar* pSource, size_t sourceSize, _ulonglong sourceHash, const string& cachePath, COOKRESULT* pResult)
+{
+	_int width = 0, height = 0, channels = 0;
+	_uchar* pPixels = stbi_load_from_memory(pSource, (_int)sourceSize, &width, &height, &channels, 4);
+	if (nullptr == pPixels)
+		return PK_ERROR;
+
+	_bool alpha = false;
+	if (2 == channels || 4 == channels)
+	{
+		for (size_t i = 0; !alpha && i < (size_t)width * height; ++i)
+			alpha = 255 != pPixels[i * 4 + 3];
+	}
+
+	TEXTURECACHEHEADER header;
+	memset(&header, 0, sizeof(TEXTURECACHEHEADER));
+	header.iMagic = TEXTURE_CACHE_MAGIC;
+	header.iVersion = TEXTURE_CACHE_VERSION;
+	header.iSourceHash = sourceHash;
+	header.iFormat = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	header.iBlockSize = alpha ? TEXTURE_BC3_BLOCK_SIZE : TEXTURE_BC1_BLOCK_SIZE;
+	header.iWidth = (_uint)width;
+	header.iHeight = (_uint)height;
+
+	// Full chain down to 1x1
+	header.iLevelNum = 1;
+	for (_uint size = glm::max(header.iWidth, header.iHeight); size > 1 && header.iLevelNum < TEXTURE_MAX_LEVEL; size >>= 1)
+		++header.iLevelNum;
+
+	_uint offset = AlignTextureOffset(sizeof(TEXTURECACHEHEADER));
+	for (_uint i = 0; i < header.iLevelNum; ++i)
+	{
+		header.Levels[i].iOffset = offset;
+		header.Levels[i].iSize = GetLevelSize(header.iWidth, header.iHeight, i, header.iBlockSize);
+		header.iFileSize = offset + header.Levels[i].iSize;
+		offset = AlignTextureOffset(header.iFileSize);
+	}
+
+	vector<_uchar> vecFile(header.iFileSize, 0);
+	memcpy(vecFile.data(), &header, sizeof(TEXTURECACHEHEADER));
+
+	vector<_uchar> vecLevel(pPixels, pPixels + (size_t)width * height * 4);
+	vector<_uchar> vecNext;
+	stbi_image_free(pPixels);
+
+	size_t rawSize = 0;
+	for (_uint i = 0; i < header.iLevelNum; ++i)
+	{
+		_uint levelWidth = glm::max(1u, header.iWidth >> i);
+		_uint levelHeight = glm::max(1u, header.iHeight >> i);
+		_uchar* pBlocks = vecFile.data() + header.Levels[i].iOffset;
+		if (alpha)
+			CompressBC3(vecLevel.data(), levelWidth, levelHeight, pBlocks);
+		else
+			CompressBC1(vecLevel.data(), levelWidth, levelHeight, pBlocks);
+		rawSize += (size_t)levelWidth * levelHeight * 4;
+
+		if (i + 1 < header.iLevelNum)
+		{
+			vecNext.resize((size_t)glm::max(1u, levelWidth / 2) * glm::max(1u, levelHeight / 2) * 4);
+			GenerateMip(vecLevel.data(), levelWidth, levelHeight, vecNext.data());
+			vecLevel.swap(vecNext);
+		}
+	}
+
+	ofstream file(cachePath, ios::binary | ios::trunc);
+	if (!file.is_open())
+		return PK_ERROR;
+	file.write(reinterpret_cast<const char*>(vecFile.data()), vecFile.size());
+	if (!file.good())
+		return PK_ERROR;
+
+	if (nullptr != pResult)
+	{
+		pResult->iWidth = header.iWidth;
+		pResult->iHeight = header.iHeight;
+		pResult->iFormat = header.iFormat;
+		pResult->iBlockSize = header.iBlockSize;
+		pResult->iLevelNum = header.iLevelNum;
+		pResult->iRawSize = rawSize;
+		pResult->iCookedSize = header.iFileSize - header.Levels[0].iOffset;
+		pResult->iChecksum = CMappedFile::HashBytes(vecFile.data() + header.Levels[0].iOffset, pResult->iCookedSize);
+	}
+
+	return PK_NOERROR;
+}
+
+// Map a cooked cache, the levels point into the mapping
+// Fails when it is missing, from another version or cooked from another image
+RESULT CTextureCooker::MapTextureCache(const string& path, _ulonglong sourceHash, CTexture::TEXTUREFILEDATA& data)
+{
+	CMappedFile* pFile = CMappedFile::Create(path);
+	if (nullptr == pFile)
+		return PK_ERROR;
+
+	size_t size = pFile->GetSize();
+	const TEXTURECACHEHEADER* pHeader = reinterpret_cast<const TEXTURECACHEHEADER*>(pFile->GetData());
+	_bool valid = size >= sizeof(TEXTURECACHEHEADER)
+		&& TEXTURE_CACHE_MAGIC == pHeader->iMagic && TEXTURE_CACHE_VERSION == pHeader->iVersion
+		&& sourceHash == pHeader->iSourceHash && size == pHeader->iFileSize
+		&& 0 < pHeader->iLevelNum && TEXTURE_MAX_LEVEL >= pHeader->iLevelNum && 0 < pHeader->iWidth && 0 < pHeader->iHeight;
+
+	if (valid)
+	{
+		valid = (GL_COMPRESSED_RGB_S3TC_DXT1_EXT == pHeader->iFormat && TEXTURE_BC1_BLOCK_SIZE == pHeader->iBlockSize)
+			|| (GL_COMPRESSED_RGBA_S3TC_DXT5_EXT == pHeader->iFormat && TEXTURE_BC3_BLOCK_SIZE == pHeader->iBlockSize);
+	}
+
+	// Levels in bounds, aligned and of the size their dimensions call for
+	for (_uint i = 0; valid && i < pHeader->iLevelNum; ++i)
+	{
+		const CTexture::TEXTURELEVEL& level = pHeader->Levels[i];
+		valid = level.iOffset >= sizeof(TEXTURECACHEHEADER) && (size_t)level.iOffset + level.iSize <= size
+			&& 0 == level.iOffset % TEXTURE_CACHE_ALIGN
+			&& GetLevelSize(pHeader->iWidth, pHeader->iHeight, i, pHeader->iBlockSize) == level.iSize;
+	}
+
+	if (!valid)
+	{
+		SafeDestroy(pFile);
+		return PK_ERROR;
+	}
+
+	data.pMappedFile = pFile;
+	data.iWidth = (_int)pHeader->iWidth;
+	data.iHeight = (_int)pHeader->iHeight;
+	data.iChannels = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT == pHeader->iFormat ? 4 : 3;
+	data.iFormat = pHeader->iFormat;
+	data.iLevelNum = pHeader->iLevelNum;
+	memcpy(data.Levels, pHeader->Levels, sizeof(data.Levels));
+
+	return PK_NOERROR;
+}
@@ -0,0 +1,224 @@
+#include "pch.h"
+#include "..\Headers\TextureStreamer.h"
+#include "..\Headers\OpenGLDefines.h"
+#include "..\Headers\ParallelFor.h"
+#include "..\Headers\MappedFile.h"
+
+
+USING(Engine)
+USING(std)
+SINGLETON_FUNCTION(CTextureStreamer)
+
+CTextureStreamer::CTextureStreamer()
+	: m_iPendingNum(0), m_bQuit(false)
+	, m_iUploadBudget(TEXTURE_UPLOAD_BUDGET), m_iUploadedBytes(0), m_iNextStaging(0)
+{
+	memset(m_StagingBuffers, 0, sizeof(m_StagingBuffers));
+}
+
+CTextureStreamer::~CTextureStreamer()
+{
+}
+
+// Call instead of destructor to manage class internal data
+void CTextureStreamer::Destroy()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_bQuit = true;
+	}
+	m_cvDecode.notify_all();
+	for (size_t i = 0; i < m_vecWorkers.size(); ++i)
+		m_vecWorkers[i].join();
+	m_vecWorkers.clear();
+
+	// Whatever did not make it to the GPU is dropped, the textures keep their placeholder
+	for (size_t i = 0; i < m_queueDecode.size(); ++i)
+		ReleaseRequest(m_queueDecode[i]);
+	m_queueDecode.clear();
+	for (size_t i = 0; i < m_queueUpload.size(); ++i)
+		ReleaseRequest(m_queueUpload[i]);
+	m_queueUpload.clear();
+
+	if (0 != m_StagingBuffers[0])
+		glDeleteBuffers(TEXTURE_STAGING_BUFFER_NUM, m_StagingBuffers);
+	memset(m_StagingBuffers, 0, sizeof(m_StagingBuffers));
+}
+
+// Queue an image file for one level 0 image of a texture, returns at once
+void CTextureStreamer::Request(CBase* pOwner, _uint textureID, _uint target, string filePath, _bool mipmap)
+{
+	if (m_vecWorkers.empty())
+		StartWorkers();
+
+	if (nullptr != pOwner)
+		pOwner->AddRefCnt();
+
+	TEXTUREREQUEST* pRequest = new TEXTUREREQUEST();
+	pRequest->pOwner = pOwner;
+	pRequest->iTextureID = textureID;
+	pRequest->iTarget = target;
+	pRequest->bMipmap = mipmap;
+	pRequest->filePath = filePath;
+	++m_iPendingNum;
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_queueDecode.push_back(pRequest);
+	}
+	m_cvDecode.notify_one();
+}
+
+// Upload decoded images until the budget of this frame is used, at least one per call
+void CTextureStreamer::Update()
+{
+	m_iUploadedBytes = 0;
+	if (0 == m_iPendingNum)
+		return;
+
+	UploadDecoded(m_iUploadBudget);
+}
+
+// Block until every request so far has been uploaded
+void CTextureStreamer::Flush()
+{
+	while (0 != m_iPendingNum)
+	{
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_cvDecoded.wait(lock, [this]() { return !m_queueUpload.empty(); });
+		}
+		m_iUploadedBytes = 0;
+		UploadDecoded(UINT_MAX);
+	}
+}
+
+// One worker less than there are cores, the main thread keeps rendering
+void CTextureStreamer::StartWorkers()
+{
+	_uint workerCount = GetParallelWorkerCount();
+	if (workerCount > 1)
+		--workerCount;
+
+	m_vecWorkers.reserve(workerCount);
+	for (_uint i = 0; i < workerCount; ++i)
+		m_vecWorkers.push_back(thread(&CTextureStreamer::WorkerLoop, this));
+}
+
+void CTextureStreamer::WorkerLoop()
+{
+	while (true)
+	{
+		TEXTUREREQUEST* pRequest = nullptr;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_cvDecode.wait(lock, [this]() { return m_bQuit || !m_queueDecode.empty(); });
+			if (m_bQuit)
+				return;
+			pRequest = m_queueDecode.front();
+			m_queueDecode.pop_front();
+		}
+
+		// A failed decode still goes through the upload queue so its owner is released on the main thread
+		CTexture::LoadImageFile(pRequest->filePath, pRequest->data);
+
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_queueUpload.push_back(pRequest);
+		}
+		m_cvDecoded.notify_all();
+	}
+}
+
+// Upload in decode order until the budget is used
+void CTextureStreamer::UploadDecoded(_uint budget)
+{
+	while (true)
+	{
+		TEXTUREREQUEST* pRequest = nullptr;
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (m_queueUpload.empty())
+				return;
+
+			// A texture bigger than the whole budget still goes alone in its frame
+			pRequest = m_queueUpload.front();
+			_uint size = (_uint)CTexture::GetImageSize(pRequest->data);
+			if (0 != m_iUploadedBytes && m_iUploadedBytes + size > budget)
+				return;
+			m_queueUpload.pop_front();
+			m_iUploadedBytes += size;
+		}
+
+		Upload(pRequest);
+		ReleaseRequest(pRequest);
+		--m_iPendingNum;
+	}
+}
+
+// Copy the image into a staging buffer and specify the texture image from it
+void CTextureStreamer::Upload(TEXTUREREQUEST* pRequest)
+{
+	const CTexture::TEXTUREFILEDATA& data = pRequest->data;
+	const _uchar* pImage = nullptr != data.pMappedFile ? data.pMappedFile->GetData() : data.pPixels;
+	if (nullptr == pImage)
+		return;
+
+	GLenum bindTarget = GL_TEXTURE_2D == pRequest->iTarget ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP;
+	GLsizeiptr size = (GLsizeiptr)CTexture::GetImageSize(data);
+
+	if (0 == m_StagingBuffers[0])
+		glGenBuffers(TEXTURE_STAGING_BUFFER_NUM, m_StagingBuffers);
+
+	// Buffers are used in turn and orphaned before mapping, so the copy never waits on a transfer still in flight
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_StagingBuffers[m_iNextStaging]);
+	m_iNextStaging = (m_iNextStaging + 1) % TEXTURE_STAGING_BUFFER_NUM;
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+
+	// The source is read at offsets from the start of the buffer (or of the image when staging failed)
+	const _uchar* pSource = pImage;
+	void* pStaging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (nullptr != pStaging)
+	{
+		memcpy(pStaging, pImage, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		pSource = nullptr;
+	}
+	else
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glBindTexture(bindTarget, pRequest->iTextureID);
+	if (nullptr != data.pMappedFile)
+	{
+		// Cooked images bring their whole mip chain, the cache file is staged as it is
+		CTexture::UploadCompressed(pRequest->iTarget, data, pSource);
+	}
+	else
+	{
+		GLenum format = GL_RGB;
+		switch (data.iChannels)
+		{
+		case 1: format = GL_RED; break;
+		case 2: format = GL_RG; break;
+		case 4: format = GL_RGBA; break;
+		}
+		GLenum internalFormat = GL_TEXTURE_2D == pRequest->iTarget ? GL_RGBA : GL_RGB;
+
+		// Rows of decoded images are tightly packed
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(pRequest->iTarget, 0, internalFormat, data.iWidth, data.iHeight, 0, format, GL_UNSIGNED_BYTE, pSource);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		if (pRequest->bMipmap)
+			glGenerateMipmap(bindTarget);
+	}
+	glBindTexture(bindTarget, 0);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void CTextureStreamer::ReleaseRequest(TEXTUREREQUEST* pRequest)
+{
+	CTexture::ReleaseImageFile(pRequest->data);
+	SafeDestroy(pRequest->pOwner);
+	delete pRequest;
+}
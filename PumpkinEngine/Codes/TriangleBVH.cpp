@@ -0,0 +1,819 @@
+#include "pch.h"
+#include "..\Headers\TriangleBVH.h"
+#include "..\Headers\MappedFile.h"
+#include "glm\common.hpp"
+#include "glm\geometric.hpp"
+#include <fstream>
+#include <limits>
+#include <emmintrin.h>
+
+
+USING(Engine)
+USING(glm)
+USING(std)
+
+#define BVH_BIN_COUNT		12
+#define BVH_LEAF_SIZE		4
+#define BVH_STACK_SIZE		256
+#define BVH_MAX_DEPTH		64				// Deeper ranges become leaves so the traversal stack can not overflow
+#define BVH_INVALID			0xFFFFFFFF
+#define BVH_SLAB_SCALE		1.0000008f		// Exit distances are pushed out a few ulps so a hit on a box face is never culled
+#define BVH_FILE_MAGIC		0x48564250		// "PBVH"
+#define BVH_FILE_VERSION	1
+#define BVH_FILE_ALIGN		16
+
+// Traversal stack entry, iCount > 0 means a leaf range instead of a wide node
+typedef struct sBVHStackEntry
+{
+	_uint		iIndex;
+	_uint		iCount;
+	_float		fEnter;
+}STACKENTRY;
+
+// Cache file header, every section is stored at a 16 byte aligned offset from the start of the file
+typedef struct sBVHFileHeader
+{
+	_uint		iMagic;
+	_uint		iVersion;
+	_ulonglong	iSourceHash;		// Hash of the source triangles the tree was built from
+	_uint		iNodeCount;
+	_uint		iTriangleCount;
+	_uint		iNodeOffset;
+	_uint		iTriangleOffset;
+	_uint		iIndexOffset;
+	_uint		iFileSize;
+}FILEHEADER;
+
+// Every popped node pushes at most 4 children, 3 more than it took
+static_assert(4 + 3 * BVH_MAX_DEPTH <= BVH_STACK_SIZE, "the traversal stack must hold the deepest tree");
+
+static _uint AlignOffset(_uint offset)
+{
+	return (offset + BVH_FILE_ALIGN - 1) & ~(_uint)(BVH_FILE_ALIGN - 1);
+}
+
+// Near and far distances of one slab folded into the running ones, the bounds are picked by the sign of the direction
+// A ray running inside a face of the box gives 0 * inf = NaN, max and min return their second operand on NaN so the
+// slab is skipped and the ray stays inside the closed box instead of being culled
+static void FoldSlab(__m128 vNear, __m128 vFar, __m128 vOrigin, __m128 vInvDir, __m128& tNear, __m128& tFar)
+{
+	tNear = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(vNear, vOrigin), vInvDir), tNear);
+	tFar = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(vFar, vOrigin), vInvDir), tFar);
+}
+
+// One ray against the 4 children of a wide node, returns one bit per child hit
+static _int SlabTest4(const CTriangleBVH::WIDENODE& node, const __m128 vOrigin[3], const __m128 vInvDir[3], __m128 tMax, __m128& tEnter)
+{
+	const _float* pMin[3] = { node.vMinX, node.vMinY, node.vMinZ };
+	const _float* pMax[3] = { node.vMaxX, node.vMaxY, node.vMaxZ };
+	__m128 tNear = _mm_setzero_ps();
+	__m128 tFar = _mm_set1_ps(numeric_limits<_float>::infinity());
+	for (_uint axis = 0; axis < 3; ++axis)
+	{
+		_bool negative = 0 != (_mm_movemask_ps(vInvDir[axis]) & 1);
+		FoldSlab(_mm_loadu_ps(negative ? pMax[axis] : pMin[axis]), _mm_loadu_ps(negative ? pMin[axis] : pMax[axis]),
+			vOrigin[axis], vInvDir[axis], tNear, tFar);
+	}
+
+	tEnter = tNear;
+	tFar = _mm_min_ps(_mm_mul_ps(tFar, _mm_set1_ps(BVH_SLAB_SCALE)), tMax);
+
+	return _mm_movemask_ps(_mm_cmple_ps(tEnter, tFar));
+}
+
+// 4 rays (one per lane) against one box, returns one bit per ray hit
+static _int SlabTestPacket(const CTriangleBVH::WIDENODE& node, _uint child, const __m128 vOrigin[3], const __m128 vInvDir[3], __m128 tMax)
+{
+	const _float fMin[3] = { node.vMinX[child], node.vMinY[child], node.vMinZ[child] };
+	const _float fMax[3] = { node.vMaxX[child], node.vMaxY[child], node.vMaxZ[child] };
+	__m128 tNear = _mm_setzero_ps();
+	__m128 tFar = _mm_set1_ps(numeric_limits<_float>::infinity());
+	for (_uint axis = 0; axis < 3; ++axis)
+	{
+		// Lanes going down the axis swap the bounds
+		__m128 negative = _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(vInvDir[axis]), 31));
+		__m128 vMin = _mm_set1_ps(fMin[axis]);
+		__m128 vMax = _mm_set1_ps(fMax[axis]);
+		FoldSlab(_mm_or_ps(_mm_and_ps(negative, vMax), _mm_andnot_ps(negative, vMin)),
+			_mm_or_ps(_mm_and_ps(negative, vMin), _mm_andnot_ps(negative, vMax)),
+			vOrigin[axis], vInvDir[axis], tNear, tFar);
+	}
+
+	tFar = _mm_min_ps(_mm_mul_ps(tFar, _mm_set1_ps(BVH_SLAB_SCALE)), tMax);
+
+	return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+}
+
+// Shared edge rule : a ray exactly on an edge belongs to the triangle walking it from the smaller vertex
+// The dominant axis of the ray is compared last, so for a ray along an axis the order is a 2D one in the plane
+// it looks at, and a ray exactly through a vertex also lands in a single triangle of the fan
+static _bool OwnsEdge(const vec3& a, const vec3& b, _uint axis)
+{
+	for (_uint i = 1; i <= 3; ++i)
+	{
+		_uint k = (axis + i) % 3;
+		if (a[k] != b[k])
+			return a[k] < b[k];
+	}
+	return false;
+}
+
+static _uint DominantAxis(_float x, _float y, _float z)
+{
+	x = fabs(x); y = fabs(y); z = fabs(z);
+	return x >= y && x >= z ? 0 : y >= z ? 1 : 2;
+}
+
+static vec3 FaceNormal(const TRIANGLE& tri)
+{
+	vec3 e1 = tri.p1 - tri.p0;
+	vec3 e2 = tri.p2 - tri.p0;
+	return vec3(e1.y * e2.z - e2.y * e1.z, e1.z * e2.x - e2.z * e1.x, e1.x * e2.y - e2.x * e1.y);
+}
+
+// Lanes (one bit each) for which the edge a -> b is owned, laneAxis[k] holds the lanes whose dominant axis is k
+static __m128 OwnsEdgePacket(const vec3& a, const vec3& b, const _int laneAxis[3])
+{
+	_int lanes = 0;
+	for (_uint k = 0; k < 3; ++k)
+	{
+		if (OwnsEdge(a, b, k))
+			lanes |= laneAxis[k];
+	}
+
+	return _mm_castsi128_ps(_mm_set_epi32(lanes & 8 ? -1 : 0, lanes & 4 ? -1 : 0, lanes & 2 ? -1 : 0, lanes & 1 ? -1 : 0));
+}
+
+// Edge functions for 4 rays (one per lane) against one triangle, returns one bit per ray hit
+// Same arithmetic as IntersectRayTriangle, see there
+static _int TriangleTestPacket(const TRIANGLE& tri, const __m128 vOrigin[3], const __m128 vDir[3], __m128 tMax, const _int laneAxis[3])
+{
+	// Vertices relative to the origin
+	__m128 ax = _mm_sub_ps(_mm_set1_ps(tri.p0.x), vOrigin[0]);
+	__m128 ay = _mm_sub_ps(_mm_set1_ps(tri.p0.y), vOrigin[1]);
+	__m128 az = _mm_sub_ps(_mm_set1_ps(tri.p0.z), vOrigin[2]);
+	__m128 bx = _mm_sub_ps(_mm_set1_ps(tri.p1.x), vOrigin[0]);
+	__m128 by = _mm_sub_ps(_mm_set1_ps(tri.p1.y), vOrigin[1]);
+	__m128 bz = _mm_sub_ps(_mm_set1_ps(tri.p1.z), vOrigin[2]);
+	__m128 cx = _mm_sub_ps(_mm_set1_ps(tri.p2.x), vOrigin[0]);
+	__m128 cy = _mm_sub_ps(_mm_set1_ps(tri.p2.y), vOrigin[1]);
+	__m128 cz = _mm_sub_ps(_mm_set1_ps(tri.p2.z), vOrigin[2]);
+
+	// n0 = b x c, n1 = c x a, n2 = a x b
+	__m128 n0x = _mm_sub_ps(_mm_mul_ps(by, cz), _mm_mul_ps(cy, bz));
+	__m128 n0y = _mm_sub_ps(_mm_mul_ps(bz, cx), _mm_mul_ps(cz, bx));
+	__m128 n0z = _mm_sub_ps(_mm_mul_ps(bx, cy), _mm_mul_ps(cx, by));
+	__m128 n1x = _mm_sub_ps(_mm_mul_ps(cy, az), _mm_mul_ps(ay, cz));
+	__m128 n1y = _mm_sub_ps(_mm_mul_ps(cz, ax), _mm_mul_ps(az, cx));
+	__m128 n1z = _mm_sub_ps(_mm_mul_ps(cx, ay), _mm_mul_ps(ax, cy));
+	__m128 n2x = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(by, az));
+	__m128 n2y = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(bz, ax));
+	__m128 n2z = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(bx, ay));
+
+	__m128 e0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vDir[0], n0x), _mm_mul_ps(vDir[1], n0y)), _mm_mul_ps(vDir[2], n0z));
+	__m128 e1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vDir[0], n1x), _mm_mul_ps(vDir[1], n1y)), _mm_mul_ps(vDir[2], n1z));
+	__m128 e2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vDir[0], n2x), _mm_mul_ps(vDir[1], n2y)), _mm_mul_ps(vDir[2], n2z));
+
+	// A zero edge function counts on the side its edge owner gives it
+	__m128 zero = _mm_setzero_ps();
+	__m128 own0 = OwnsEdgePacket(tri.p1, tri.p2, laneAxis);
+	__m128 own1 = OwnsEdgePacket(tri.p2, tri.p0, laneAxis);
+	__m128 own2 = OwnsEdgePacket(tri.p0, tri.p1, laneAxis);
+	__m128 pos = _mm_and_ps(_mm_and_ps(
+		_mm_or_ps(_mm_cmpgt_ps(e0, zero), _mm_and_ps(_mm_cmpeq_ps(e0, zero), own0)),
+		_mm_or_ps(_mm_cmpgt_ps(e1, zero), _mm_and_ps(_mm_cmpeq_ps(e1, zero), own1))),
+		_mm_or_ps(_mm_cmpgt_ps(e2, zero), _mm_and_ps(_mm_cmpeq_ps(e2, zero), own2)));
+	__m128 neg = _mm_and_ps(_mm_and_ps(
+		_mm_or_ps(_mm_cmplt_ps(e0, zero), _mm_andnot_ps(own0, _mm_cmpeq_ps(e0, zero))),
+		_mm_or_ps(_mm_cmplt_ps(e1, zero), _mm_andnot_ps(own1, _mm_cmpeq_ps(e1, zero)))),
+		_mm_or_ps(_mm_cmplt_ps(e2, zero), _mm_andnot_ps(own2, _mm_cmpeq_ps(e2, zero))));
+
+	// Distance to the plane from the face normal, the small edge vectors keep it precise far from the triangle
+	vec3 vNormal = FaceNormal(tri);
+	__m128 nx = _mm_set1_ps(vNormal.x);
+	__m128 ny = _mm_set1_ps(vNormal.y);
+	__m128 nz = _mm_set1_ps(vNormal.z);
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vDir[0], nx), _mm_mul_ps(vDir[1], ny)), _mm_mul_ps(vDir[2], nz));
+	__m128 t = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, nx), _mm_mul_ps(ay, ny)), _mm_mul_ps(az, nz)), det);
+
+	__m128 hit = _mm_and_ps(_mm_or_ps(pos, neg), _mm_cmpneq_ps(det, zero));
+	hit = _mm_and_ps(hit, _mm_cmpge_ps(t, zero));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(t, tMax));
+
+	return _mm_movemask_ps(hit);
+}
+
+CTriangleBVH::CTriangleBVH()
+	: m_pMappedFile(nullptr)
+	, m_pNodes(nullptr), m_pTriangles(nullptr), m_pOriginalIndex(nullptr)
+	, m_iNodeCount(0), m_iTriangleCount(0)
+{
+	m_vecNodes.clear();
+	m_vecTriangles.clear();
+	m_vecOriginalIndex.clear();
+}
+
+CTriangleBVH::~CTriangleBVH()
+{
+}
+
+// Call instead of destructor to manage class internal data
+void CTriangleBVH::Destroy()
+{
+	m_vecNodes.clear();
+	m_vecTriangles.clear();
+	m_vecOriginalIndex.clear();
+	SafeDestroy(m_pMappedFile);
+
+	m_pNodes = nullptr;
+	m_pTriangles = nullptr;
+	m_pOriginalIndex = nullptr;
+	m_iNodeCount = m_iTriangleCount = 0;
+}
+
+_bool CTriangleBVH::IntersectClosest(const vec3& vOrigin, const vec3& vDir, _float fMaxDistance, RAYHIT& hit)
+{
+	if (0 == m_iNodeCount)
+		return false;
+
+	__m128 origin[3] = { _mm_set1_ps(vOrigin.x), _mm_set1_ps(vOrigin.y), _mm_set1_ps(vOrigin.z) };
+	__m128 invDir[3] = { _mm_set1_ps(1.f / vDir.x), _mm_set1_ps(1.f / vDir.y), _mm_set1_ps(1.f / vDir.z) };
+
+	_bool found = false;
+	_float fClosest = fMaxDistance;
+	STACKENTRY stack[BVH_STACK_SIZE];
+	_uint stackSize = 0;
+	stack[stackSize++] = { 0, 0, 0.f };
+
+	while (0 < stackSize)
+	{
+		const STACKENTRY entry = stack[--stackSize];
+		if (entry.fEnter > fClosest)
+			continue;
+
+		if (0 < entry.iCount)
+		{
+			for (_uint i = entry.iIndex; i < entry.iIndex + entry.iCount; ++i)
+			{
+				_float fDistance = 0.f;
+				// A hit exactly at fMaxDistance counts, as it does for IntersectAny
+				if (IntersectRayTriangle(m_pTriangles[i], vOrigin, vDir, fDistance)
+					&& (fDistance < fClosest || (!found && fDistance == fClosest)))
+				{
+					fClosest = fDistance;
+					hit.iTriangle = m_pOriginalIndex[i];
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		const WIDENODE& node = m_pNodes[entry.iIndex];
+		__m128 tEnter;
+		_int mask = SlabTest4(node, origin, invDir, _mm_set1_ps(fClosest), tEnter);
+		if (0 == mask)
+			continue;
+
+		_float enter[4];
+		_mm_storeu_ps(enter, tEnter);
+
+		// Sort the hit children far to near so the nearest one is popped first
+		STACKENTRY children[4];
+		_uint childCount = 0;
+		for (_uint c = 0; c < 4; ++c)
+		{
+			if (0 == (mask & (1 << c)) || BVH_INVALID == node.iChild[c])
+				continue;
+
+			STACKENTRY child = { node.iChild[c], node.iCount[c], enter[c] };
+			_uint j = childCount++;
+			for (; 0 < j && children[j - 1].fEnter < child.fEnter; --j)
+				children[j] = children[j - 1];
+			children[j] = child;
+		}
+
+		for (_uint c = 0; c < childCount; ++c)
+			stack[stackSize++] = children[c];
+	}
+
+	if (found)
+	{
+		hit.fDistance = fClosest;
+		hit.vPoint = vOrigin + vDir * fClosest;
+	}
+
+	return found;
+}
+
+_bool CTriangleBVH::IntersectAny(const vec3& vOrigin, const vec3& vDir, _float fMaxDistance)
+{
+	if (0 == m_iNodeCount)
+		return false;
+
+	__m128 origin[3] = { _mm_set1_ps(vOrigin.x), _mm_set1_ps(vOrigin.y), _mm_set1_ps(vOrigin.z) };
+	__m128 invDir[3] = { _mm_set1_ps(1.f / vDir.x), _mm_set1_ps(1.f / vDir.y), _mm_set1_ps(1.f / vDir.z) };
+	__m128 tMax = _mm_set1_ps(fMaxDistance);
+
+	_uint stack[BVH_STACK_SIZE];
+	_uint stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (0 < stackSize)
+	{
+		const WIDENODE& node = m_pNodes[stack[--stackSize]];
+		__m128 tEnter;
+		_int mask = SlabTest4(node, origin, invDir, tMax, tEnter);
+
+		for (_uint c = 0; c < 4; ++c)
+		{
+			if (0 == (mask & (1 << c)) || BVH_INVALID == node.iChild[c])
+				continue;
+
+			if (0 == node.iCount[c])
+			{
+				stack[stackSize++] = node.iChild[c];
+				continue;
+			}
+
+			for (_uint i = node.iChild[c]; i < node.iChild[c] + node.iCount[c]; ++i)
+			{
+				_float fDistance = 0.f;
+				if (IntersectRayTriangle(m_pTriangles[i], vOrigin, vDir, fDistance) && fDistance <= fMaxDistance)
+					return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void CTriangleBVH::IntersectAnyBatch(const vec3* pOrigins, const vec3* pTargets, _uint count, _bool* pResults)
+{
+	if (nullptr == pOrigins || nullptr == pTargets || nullptr == pResults)
+		return;
+
+	for (_uint i = 0; i < count; i += 4)
+	{
+		_uint packetSize = count - i < 4 ? count - i : 4;
+		_uint mask = IntersectPacket(pOrigins + i, pTargets + i, packetSize);
+		for (_uint lane = 0; lane < packetSize; ++lane)
+			pResults[i + lane] = 0 != (mask & (1 << lane));
+	}
+}
+
+// Any-hit for up to 4 segments traversed together, returns one bit per blocked segment
+_uint CTriangleBVH::IntersectPacket(const vec3* pOrigins, const vec3* pTargets, _uint count)
+{
+	if (0 == m_iNodeCount || 0 == count)
+		return 0;
+
+	// Each lane is the ray IntersectAny would trace for the segment (unit direction, length as the limit),
+	// so both paths compute the same numbers. Unused lanes and empty segments start finished.
+	_float ox[4], oy[4], oz[4], dx[4], dy[4], dz[4], dist[4];
+	_int done = 0;
+	for (_uint lane = 0; lane < 4; ++lane)
+	{
+		_uint src = lane < count ? lane : 0;
+		vec3 vDir = pTargets[src] - pOrigins[src];
+		_float fDist = length(vDir);
+		if (lane >= count || fDist <= 0.f)
+		{
+			done |= 1 << lane;
+			vDir = vec3(0.f, 1.f, 0.f);
+			fDist = 0.f;
+		}
+		else
+			vDir = vDir / fDist;
+
+		ox[lane] = pOrigins[src].x; oy[lane] = pOrigins[src].y; oz[lane] = pOrigins[src].z;
+		dx[lane] = vDir.x; dy[lane] = vDir.y; dz[lane] = vDir.z;
+		dist[lane] = fDist;
+	}
+
+	__m128 origin[3] = { _mm_loadu_ps(ox), _mm_loadu_ps(oy), _mm_loadu_ps(oz) };
+	__m128 dir[3] = { _mm_loadu_ps(dx), _mm_loadu_ps(dy), _mm_loadu_ps(dz) };
+	__m128 tMax = _mm_loadu_ps(dist);
+	__m128 one = _mm_set1_ps(1.f);
+	__m128 invDir[3] = { _mm_div_ps(one, dir[0]), _mm_div_ps(one, dir[1]), _mm_div_ps(one, dir[2]) };
+	_int laneAxis[3] = { 0, 0, 0 };
+	for (_uint lane = 0; lane < 4; ++lane)
+		laneAxis[DominantAxis(dx[lane], dy[lane], dz[lane])] |= 1 << lane;
+
+	_int blocked = 0;
+
+	_uint stack[BVH_STACK_SIZE];
+	_uint stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (0 < stackSize && 0xF != done)
+	{
+		const WIDENODE& node = m_pNodes[stack[--stackSize]];
+
+		for (_uint c = 0; c < 4 && 0xF != done; ++c)
+		{
+			if (BVH_INVALID == node.iChild[c])
+				continue;
+
+			_int active = SlabTestPacket(node, c, origin, invDir, tMax) & ~done;
+			if (0 == active)
+				continue;
+
+			if (0 == node.iCount[c])
+			{
+				stack[stackSize++] = node.iChild[c];
+				continue;
+			}
+
+			for (_uint i = node.iChild[c]; i < node.iChild[c] + node.iCount[c]; ++i)
+			{
+				_int hit = TriangleTestPacket(m_pTriangles[i], origin, dir, tMax, laneAxis) & active;
+				blocked |= hit;
+				done |= hit;
+				active &= ~hit;
+				if (0 == active)
+					break;
+			}
+		}
+	}
+
+	return (_uint)blocked;
+}
+
+// Write the built tree to a cache file that CreateFromFile can map back in place
+_bool CTriangleBVH::Save(const string& path, _ulonglong sourceHash)
+{
+	if (0 == m_iNodeCount || path.empty())
+		return false;
+
+	FILEHEADER header;
+	header.iMagic = BVH_FILE_MAGIC;
+	header.iVersion = BVH_FILE_VERSION;
+	header.iSourceHash = sourceHash;
+	header.iNodeCount = m_iNodeCount;
+	header.iTriangleCount = m_iTriangleCount;
+	header.iNodeOffset = AlignOffset((_uint)sizeof(FILEHEADER));
+	header.iTriangleOffset = AlignOffset((_uint)(header.iNodeOffset + m_iNodeCount * sizeof(WIDENODE)));
+	header.iIndexOffset = AlignOffset((_uint)(header.iTriangleOffset + m_iTriangleCount * sizeof(TRIANGLE)));
+	header.iFileSize = (_uint)(header.iIndexOffset + m_iTriangleCount * sizeof(_uint));
+
+	ofstream file(path, ios::binary | ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	const char padding[BVH_FILE_ALIGN] = { 0 };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(FILEHEADER));
+	file.write(padding, header.iNodeOffset - sizeof(FILEHEADER));
+	file.write(reinterpret_cast<const char*>(m_pNodes), m_iNodeCount * sizeof(WIDENODE));
+	file.write(padding, header.iTriangleOffset - (header.iNodeOffset + m_iNodeCount * sizeof(WIDENODE)));
+	file.write(reinterpret_cast<const char*>(m_pTriangles), m_iTriangleCount * sizeof(TRIANGLE));
+	file.write(padding, header.iIndexOffset - (header.iTriangleOffset + m_iTriangleCount * sizeof(TRIANGLE)));
+	file.write(reinterpret_cast<const char*>(m_pOriginalIndex), m_iTriangleCount * sizeof(_uint));
+
+	return file.good();
+}
+
+// Fill the node at index over [start, start + count) of the triangle array, ranges at BVH_MAX_DEPTH stay leaves
+void CTriangleBVH::BuildNode(vector<NODE>& vecBuild, _uint index, _uint start, _uint count, vector<vec3>& vecCentroids, _uint depth)
+{
+	vec3 vMin(numeric_limits<_float>::max());
+	vec3 vMax(-numeric_limits<_float>::max());
+	vec3 vCentMin = vMin;
+	vec3 vCentMax = vMax;
+	for (_uint i = start; i < start + count; ++i)
+	{
+		const TRIANGLE& tri = m_vecTriangles[i];
+		vMin = glm::min(vMin, glm::min(glm::min(tri.p0, tri.p1), tri.p2));
+		vMax = glm::max(vMax, glm::max(glm::max(tri.p0, tri.p1), tri.p2));
+		vCentMin = glm::min(vCentMin, vecCentroids[i]);
+		vCentMax = glm::max(vCentMax, vecCentroids[i]);
+	}
+
+	vecBuild[index].vMin[0] = vMin.x; vecBuild[index].vMin[1] = vMin.y; vecBuild[index].vMin[2] = vMin.z;
+	vecBuild[index].vMax[0] = vMax.x; vecBuild[index].vMax[1] = vMax.y; vecBuild[index].vMax[2] = vMax.z;
+	vecBuild[index].iLeftOrStart = start;
+	vecBuild[index].iCount = count;
+
+	if (count <= BVH_LEAF_SIZE || depth >= BVH_MAX_DEPTH)
+		return;
+
+	// Binned SAH over the centroid bounds
+	_int bestAxis = -1;
+	_uint bestSplit = 0;
+	_float bestCost = numeric_limits<_float>::max();
+	vec3 vCentExtent = vCentMax - vCentMin;
+
+	for (_int axis = 0; axis < 3; ++axis)
+	{
+		if (vCentExtent[axis] <= 0.f)
+			continue;
+
+		vec3 binMin[BVH_BIN_COUNT], binMax[BVH_BIN_COUNT];
+		_uint binCount[BVH_BIN_COUNT] = { 0 };
+		for (_uint b = 0; b < BVH_BIN_COUNT; ++b)
+		{
+			binMin[b] = vec3(numeric_limits<_float>::max());
+			binMax[b] = vec3(-numeric_limits<_float>::max());
+		}
+
+		_float scale = BVH_BIN_COUNT / vCentExtent[axis];
+		for (_uint i = start; i < start + count; ++i)
+		{
+			_uint b = glm::min((_uint)((vecCentroids[i][axis] - vCentMin[axis]) * scale), (_uint)BVH_BIN_COUNT - 1);
+			const TRIANGLE& tri = m_vecTriangles[i];
+			binMin[b] = glm::min(binMin[b], glm::min(glm::min(tri.p0, tri.p1), tri.p2));
+			binMax[b] = glm::max(binMax[b], glm::max(glm::max(tri.p0, tri.p1), tri.p2));
+			++binCount[b];
+		}
+
+		// Sweep from the right to get the area/count of every right side
+		_float rightArea[BVH_BIN_COUNT];
+		_uint rightCount[BVH_BIN_COUNT];
+		vec3 accMin(numeric_limits<_float>::max()), accMax(-numeric_limits<_float>::max());
+		_uint accCount = 0;
+		for (_int b = BVH_BIN_COUNT - 1; b > 0; --b)
+		{
+			accMin = glm::min(accMin, binMin[b]);
+			accMax = glm::max(accMax, binMax[b]);
+			accCount += binCount[b];
+			vec3 e = glm::max(accMax - accMin, vec3(0.f));
+			rightArea[b] = 0 < accCount ? e.x * e.y + e.y * e.z + e.z * e.x : 0.f;
+			rightCount[b] = accCount;
+		}
+
+		accMin = vec3(numeric_limits<_float>::max());
+		accMax = vec3(-numeric_limits<_float>::max());
+		accCount = 0;
+		for (_uint b = 0; b < BVH_BIN_COUNT - 1; ++b)
+		{
+			accMin = glm::min(accMin, binMin[b]);
+			accMax = glm::max(accMax, binMax[b]);
+			accCount += binCount[b];
+			if (0 == accCount || 0 == rightCount[b + 1])
+				continue;
+
+			vec3 e = accMax - accMin;
+			_float leftArea = e.x * e.y + e.y * e.z + e.z * e.x;
+			_float cost = leftArea * accCount + rightArea[b + 1] * rightCount[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+
+	// Stop when splitting costs more than testing every triangle here
+	vec3 e = vMax - vMin;
+	_float leafCost = (e.x * e.y + e.y * e.z + e.z * e.x) * count;
+	if (-1 == bestAxis || bestCost >= leafCost)
+		return;
+
+	// Partition the triangle range in place
+	_float scale = BVH_BIN_COUNT / vCentExtent[bestAxis];
+	_uint mid = start;
+	for (_uint i = start; i < start + count; ++i)
+	{
+		_uint b = glm::min((_uint)((vecCentroids[i][bestAxis] - vCentMin[bestAxis]) * scale), (_uint)BVH_BIN_COUNT - 1);
+		if (b <= bestSplit)
+		{
+			swap(m_vecTriangles[i], m_vecTriangles[mid]);
+			swap(m_vecOriginalIndex[i], m_vecOriginalIndex[mid]);
+			swap(vecCentroids[i], vecCentroids[mid]);
+			++mid;
+		}
+	}
+
+	// Children are allocated as a pair so the right one is always left + 1
+	_uint leftCount = mid - start;
+	_uint left = (_uint)vecBuild.size();
+	vecBuild.push_back(NODE());
+	vecBuild.push_back(NODE());
+	vecBuild[index].iLeftOrStart = left;
+	vecBuild[index].iCount = 0;
+
+	BuildNode(vecBuild, left, start, leftCount, vecCentroids, depth + 1);
+	BuildNode(vecBuild, left + 1, mid, count - leftCount, vecCentroids, depth + 1);
+}
+
+
+// Collapse the binary subtree at index into 4-wide nodes, return the wide node index
+_uint CTriangleBVH::CollapseNode(const vector<NODE>& vecBuild, _uint index)
+{
+	_uint wideIndex = (_uint)m_vecNodes.size();
+	m_vecNodes.push_back(WIDENODE());
+
+	// Open the largest branch until 4 slots are filled or only leaves remain
+	_uint slots[4] = { index, 0, 0, 0 };
+	_uint slotCount = 1;
+	while (slotCount < 4)
+	{
+		_int best = -1;
+		_float bestArea = -1.f;
+		for (_uint s = 0; s < slotCount; ++s)
+		{
+			const NODE& node = vecBuild[slots[s]];
+			if (0 < node.iCount)
+				continue;
+
+			vec3 e(node.vMax[0] - node.vMin[0], node.vMax[1] - node.vMin[1], node.vMax[2] - node.vMin[2]);
+			_float area = e.x * e.y + e.y * e.z + e.z * e.x;
+			if (area > bestArea)
+			{
+				bestArea = area;
+				best = s;
+			}
+		}
+		if (-1 == best)
+			break;
+
+		_uint left = vecBuild[slots[best]].iLeftOrStart;
+		slots[best] = left;
+		slots[slotCount++] = left + 1;
+	}
+
+	WIDENODE wide;
+	for (_uint s = 0; s < 4; ++s)
+	{
+		if (s >= slotCount)
+		{
+			wide.vMinX[s] = wide.vMinY[s] = wide.vMinZ[s] = 0.f;
+			wide.vMaxX[s] = wide.vMaxY[s] = wide.vMaxZ[s] = 0.f;
+			wide.iChild[s] = BVH_INVALID;
+			wide.iCount[s] = 0;
+			continue;
+		}
+
+		const NODE& node = vecBuild[slots[s]];
+		wide.vMinX[s] = node.vMin[0]; wide.vMinY[s] = node.vMin[1]; wide.vMinZ[s] = node.vMin[2];
+		wide.vMaxX[s] = node.vMax[0]; wide.vMaxY[s] = node.vMax[1]; wide.vMaxZ[s] = node.vMax[2];
+		wide.iCount[s] = node.iCount;
+		wide.iChild[s] = 0 < node.iCount ? node.iLeftOrStart : CollapseNode(vecBuild, slots[s]);
+	}
+	m_vecNodes[wideIndex] = wide;
+
+	return wideIndex;
+}
+
+// Watertight edge function test, hits behind the origin are ignored
+// The vertices are taken relative to the origin, so an edge shared by two triangles gives them exactly opposite
+// values and no ray passes between them, a ray exactly on the edge goes to one of the two (OwnsEdge)
+// The operations are written out in the order TriangleTestPacket uses, so both paths give the same bits
+_bool CTriangleBVH::IntersectRayTriangle(const TRIANGLE& tri, const vec3& vOrigin, const vec3& vDir, _float& fDistance)
+{
+	vec3 a = tri.p0 - vOrigin;
+	vec3 b = tri.p1 - vOrigin;
+	vec3 c = tri.p2 - vOrigin;
+
+	vec3 n0(b.y * c.z - c.y * b.z, b.z * c.x - c.z * b.x, b.x * c.y - c.x * b.y);
+	vec3 n1(c.y * a.z - a.y * c.z, c.z * a.x - a.z * c.x, c.x * a.y - a.x * c.y);
+	vec3 n2(a.y * b.z - b.y * a.z, a.z * b.x - b.z * a.x, a.x * b.y - b.x * a.y);
+
+	_float e[3];
+	e[0] = vDir.x * n0.x + vDir.y * n0.y + vDir.z * n0.z;
+	e[1] = vDir.x * n1.x + vDir.y * n1.y + vDir.z * n1.z;
+	e[2] = vDir.x * n2.x + vDir.y * n2.y + vDir.z * n2.z;
+	_uint axis = DominantAxis(vDir.x, vDir.y, vDir.z);
+	_bool own[3] = { OwnsEdge(tri.p1, tri.p2, axis), OwnsEdge(tri.p2, tri.p0, axis), OwnsEdge(tri.p0, tri.p1, axis) };
+
+	// Every edge on the same side, either winding
+	_bool pos = true;
+	_bool neg = true;
+	for (_uint i = 0; i < 3; ++i)
+	{
+		pos = pos && (e[i] > 0.f || (0.f == e[i] && own[i]));
+		neg = neg && (e[i] < 0.f || (0.f == e[i] && !own[i]));
+	}
+
+	vec3 vNormal = FaceNormal(tri);
+	_float det = vDir.x * vNormal.x + vDir.y * vNormal.y + vDir.z * vNormal.z;
+	if ((!pos && !neg) || 0.f == det)
+		return false;
+
+	fDistance = (a.x * vNormal.x + a.y * vNormal.y + a.z * vNormal.z) / det;
+	return fDistance >= 0.f;
+}
+
+// Initialize
+RESULT CTriangleBVH::Ready(const TRIANGLE* pTriangles, _uint count)
+{
+	if (nullptr == pTriangles || 0 == count)
+		return PK_ERROR_NULLPTR;
+
+	m_vecTriangles.assign(pTriangles, pTriangles + count);
+	m_vecOriginalIndex.resize(count);
+	vector<vec3> vecCentroids(count);
+	for (_uint i = 0; i < count; ++i)
+	{
+		m_vecOriginalIndex[i] = i;
+		vecCentroids[i] = (pTriangles[i].p0 + pTriangles[i].p1 + pTriangles[i].p2) / 3.f;
+	}
+
+	vector<NODE> vecBuild;
+	vecBuild.reserve(count * 2);
+	vecBuild.push_back(NODE());
+	BuildNode(vecBuild, 0, 0, count, vecCentroids, 0);
+
+	m_vecNodes.reserve(vecBuild.size() / 2 + 1);
+	CollapseNode(vecBuild, 0);
+
+	m_pNodes = m_vecNodes.data();
+	m_pTriangles = m_vecTriangles.data();
+	m_pOriginalIndex = m_vecOriginalIndex.data();
+	m_iNodeCount = (_uint)m_vecNodes.size();
+	m_iTriangleCount = (_uint)m_vecTriangles.size();
+
+	return PK_NOERROR;
+}
+
+// Initialize from a cache file, the mapped sections are used in place
+RESULT CTriangleBVH::ReadyFromFile(const string& path, _ulonglong sourceHash)
+{
+	m_pMappedFile = CMappedFile::Create(path);
+	if (nullptr == m_pMappedFile)
+		return PK_ERROR_MESHFILE_OPEN;
+
+	const _uchar* pData = m_pMappedFile->GetData();
+	size_t size = m_pMappedFile->GetSize();
+	if (size < sizeof(FILEHEADER))
+		return PK_ERROR;
+
+	// Anything that does not match exactly is treated as stale, the caller rebuilds
+	const FILEHEADER& header = *reinterpret_cast<const FILEHEADER*>(pData);
+	if (BVH_FILE_MAGIC != header.iMagic || BVH_FILE_VERSION != header.iVersion || sourceHash != header.iSourceHash)
+		return PK_ERROR;
+	if (0 == header.iNodeCount || 0 == header.iTriangleCount || size != header.iFileSize)
+		return PK_ERROR;
+	if (header.iNodeOffset < sizeof(FILEHEADER)
+		|| header.iTriangleOffset < header.iNodeOffset + (size_t)header.iNodeCount * sizeof(WIDENODE)
+		|| header.iIndexOffset < header.iTriangleOffset + (size_t)header.iTriangleCount * sizeof(TRIANGLE)
+		|| size < header.iIndexOffset + (size_t)header.iTriangleCount * sizeof(_uint)
+		|| 0 != (header.iNodeOffset | header.iTriangleOffset | header.iIndexOffset) % BVH_FILE_ALIGN)
+		return PK_ERROR;
+
+	// Traversal follows the children without checks : leaves must stay inside the triangles, branches
+	// only point forward (as CollapseNode writes them) so a damaged file can't loop, and no node may be
+	// deeper than a built tree could be so the fixed traversal stack holds
+	const WIDENODE* pNodes = reinterpret_cast<const WIDENODE*>(pData + header.iNodeOffset);
+	vector<_uint> vecDepth(header.iNodeCount, 0);
+	for (_uint i = 0; i < header.iNodeCount; ++i)
+	{
+		if (vecDepth[i] > BVH_MAX_DEPTH)
+			return PK_ERROR;
+
+		for (_uint c = 0; c < 4; ++c)
+		{
+			_uint child = pNodes[i].iChild[c];
+			_uint count = pNodes[i].iCount[c];
+			_bool valid = BVH_INVALID == child ? 0 == count
+				: 0 < count ? count <= header.iTriangleCount && child <= header.iTriangleCount - count
+				: i < child && child < header.iNodeCount;
+			if (!valid)
+				return PK_ERROR;
+
+			if (BVH_INVALID != child && 0 == count)
+				vecDepth[child] = glm::max(vecDepth[child], vecDepth[i] + 1);
+		}
+	}
+
+	const _uint* pOriginalIndex = reinterpret_cast<const _uint*>(pData + header.iIndexOffset);
+	for (_uint i = 0; i < header.iTriangleCount; ++i)
+	{
+		if (pOriginalIndex[i] >= header.iTriangleCount)
+			return PK_ERROR;
+	}
+
+	m_pNodes = pNodes;
+	m_pTriangles = reinterpret_cast<const TRIANGLE*>(pData + header.iTriangleOffset);
+	m_pOriginalIndex = pOriginalIndex;
+	m_iNodeCount = header.iNodeCount;
+	m_iTriangleCount = header.iTriangleCount;
+
+	return PK_NOERROR;
+}
+
+// Create an instance
+CTriangleBVH* CTriangleBVH::Create(const TRIANGLE* pTriangles, _uint count)
+{
+	CTriangleBVH* pInstance = new CTriangleBVH();
+	if (PK_NOERROR != pInstance->Ready(pTriangles, count))
+	{
+		pInstance->Destroy();
+		pInstance = nullptr;
+	}
+
+	return pInstance;
+}
+
+// Create an instance from a cache file, nullptr if it is missing or was built from other triangles
+CTriangleBVH* CTriangleBVH::CreateFromFile(const string& path, _ulonglong sourceHash)
+{
+	CTriangleBVH* pInstance = new CTriangleBVH();
+	if (PK_NOERROR != pInstance->ReadyFromFile(path, sourceHash))
+	{
+		pInstance->Destroy();
+		pInstance = nullptr;
+	}
+
+	return pInstance;
+}
@@ -1,11 +1,16 @@
 #include "pch.h"
 #include "..\Headers\VIBuffer.h"
 #include "..\Headers\OpenGLDefines.h"
+#include "glm\packing.hpp"
+#include "glm\gtc\packing.hpp"
 
 USING(Engine)
+USING(glm)
+USING(std)
 
 CVIBuffer::CVIBuffer()
-	: m_strName(""), m_iVAO_ID(0), m_iVB_ID(0), m_iNumVtx(0), m_iIB_ID(0), m_iNumIdx(0)
+	: m_strName(""), m_iVAO_ID(0), m_iVB_ID(0), m_iNumVtx(0), m_iIB_ID(0), m_iNumIdx(0), m_iIndexType(GL_UNSIGNED_INT)
+	, m_iVertexSize(0), m_eType(xyz_index), m_vColour(1.f)
 	, m_bWireFrame(false)
 {
 }
@@ -17,13 +22,30 @@ CVIBuffer::~CVIBuffer()
 // Basic Render Function, actually print the mesh
 void CVIBuffer::Render()
 {
+	RenderRange(0, m_iNumIdx);
+}
+
+// Draw indexCount indices from indexStart on (one level of detail)
+void CVIBuffer::RenderRange(_uint indexStart, _uint indexCount)
+{
+	if (indexStart + indexCount > m_iNumIdx)
+		return;
+
 	glBindVertexArray(m_iVAO_ID);
+
+	// Attributes the layout does not have are read from constant values
+	if (xyz_normal_color_index != m_eType)
+		glVertexAttrib4fv(0, &m_vColour.x);
+	if (xyz_index == m_eType)
+		glVertexAttrib4f(2, 0.f, 1.f, 0.f, 1.f);
+
 	if (m_bWireFrame)
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	else
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-	glDrawElements(GL_TRIANGLES, m_iNumIdx, GL_UNSIGNED_INT, 0);
+	_uint indexSize = GL_UNSIGNED_SHORT == m_iIndexType ? sizeof(_ushort) : sizeof(_uint);
+	glDrawElements(GL_TRIANGLES, indexCount, m_iIndexType, (void*)((size_t)indexStart * indexSize));
 	glBindVertexArray(0);
 }
 
@@ -35,26 +57,30 @@ void CVIBuffer::Destroy()
 }
 
 // Initialize vertex/index information
-RESULT CVIBuffer::Ready(_uint numVTX, VTX* pVertices, _uint numIDX, _uint* pIndices, eModelType type)
+RESULT CVIBuffer::Ready(_uint numVTX, const void* pVertices, _uint numIDX, const void* pIndices, _uint indexSize, eModelType type, const vec4& vColour)
 {
 	if (nullptr == pVertices || nullptr == pIndices)
 		return PK_ERROR_NULLPTR;
 
 	m_iNumVtx = numVTX;
 	m_iNumIdx = numIDX;
+	m_iIndexType = sizeof(_ushort) == indexSize ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	m_eType = type;
+	m_iVertexSize = GetVertexSize(type);
+	m_vColour = vColour;
 
 	glGenVertexArrays(1, &m_iVAO_ID);
 	glBindVertexArray(m_iVAO_ID);
 
 	glGenBuffers(1, &m_iVB_ID);
 	glBindBuffer(GL_ARRAY_BUFFER, m_iVB_ID);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(VTX) * m_iNumVtx, pVertices, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, m_iVertexSize * m_iNumVtx, pVertices, GL_STATIC_DRAW);
 
 	Ready_Vertex_To_Shader();
 
 	glGenBuffers(1, &m_iIB_ID);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_iIB_ID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(_uint) * m_iNumIdx, pIndices, GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize * m_iNumIdx, pIndices, GL_STATIC_DRAW);
 
 	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -64,65 +90,139 @@ RESULT CVIBuffer::Ready(_uint numVTX, VTX* pVertices, _uint numIDX, _uint* pIndi
 }
 
 // Set up the vertex information to shader
+// Locations follow the shaders : 0 colour, 1 position, 2 normal, 3 UV (4 - 7 are never filled)
 void CVIBuffer::Ready_Vertex_To_Shader()
 {
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(VTX), (void*)offsetof(VTX, vColour.x));
-
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(VTX), (void*)offsetof(VTX, vPos.x));
-
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(VTX), (void*)offsetof(VTX, vNormal.x));
-
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(VTX), (void*)offsetof(VTX, vTexUV.x));
-
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(VTX), (void*)offsetof(VTX, vTangent.x));
-
-	glEnableVertexAttribArray(5);
-	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(VTX), (void*)offsetof(VTX, vBinormal.x));
-
-	glEnableVertexAttribArray(6);
-	glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(VTX), (void*)offsetof(VTX, vBoneID.x));
-
-	glEnableVertexAttribArray(7);
-	glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(VTX), (void*)offsetof(VTX, vBoneWeight.x));
+	switch (m_eType)
+	{
+	case xyz_index:
+		Ready_xyz();
+		break;
+
+	case xyz_normal_index:
+		Ready_xyz_normal();
+		break;
+
+	case xyz_normal_texUV_index:
+	case xyz_normal_texUV_index_texNum:
+		Ready_xyz_normal_texUV();
+		break;
+
+	case xyz_normal_color_index:
+		Ready_xyz_normal_color();
+		break;
+	}
 }
 
 // Setup function for xyz buffer
 void CVIBuffer::Ready_xyz()
 {
 	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(VTX), (void*)offsetof(VTX, vPos.x));
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VTX_XYZ), (void*)offsetof(VTX_XYZ, vPos.x));
 }
 
 // Setup function for xyz_normal buffer
 void CVIBuffer::Ready_xyz_normal()
 {
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VTX), 0);
 	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VTX), (void*)offsetof(VTX, vNormal.x));
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VTX_XYZ_N), (void*)offsetof(VTX_XYZ_N, vPos.x));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(VTX_XYZ_N), (void*)offsetof(VTX_XYZ_N, iNormal));
 }
 
 // Setup function for xyz_normal_texUV buffer
 void CVIBuffer::Ready_xyz_normal_texUV()
+{
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VTX_XYZ_N_UV), (void*)offsetof(VTX_XYZ_N_UV, vPos.x));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(VTX_XYZ_N_UV), (void*)offsetof(VTX_XYZ_N_UV, iNormal));
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(VTX_XYZ_N_UV), (void*)offsetof(VTX_XYZ_N_UV, vTexUV));
+}
+
+// Setup function for xyz_normal_color buffer
+void CVIBuffer::Ready_xyz_normal_color()
 {
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VTX), 0);
+	glVertexAttribPointer(0, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VTX_XYZ_N_RGBA), (void*)offsetof(VTX_XYZ_N_RGBA, iColour));
 	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VTX), (void*)offsetof(VTX, vNormal.x));
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VTX_XYZ_N_RGBA), (void*)offsetof(VTX_XYZ_N_RGBA, vPos.x));
 	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VTX), (void*)offsetof(VTX, vTexUV.x));
+	glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(VTX_XYZ_N_RGBA), (void*)offsetof(VTX_XYZ_N_RGBA, iNormal));
+}
+
+// Bytes per vertex of the compact layout used for the model type
+_uint CVIBuffer::GetVertexSize(eModelType type)
+{
+	switch (type)
+	{
+	case xyz_index:
+		return sizeof(VTX_XYZ);
+
+	case xyz_normal_index:
+		return sizeof(VTX_XYZ_N);
+
+	case xyz_normal_texUV_index:
+	case xyz_normal_texUV_index_texNum:
+		return sizeof(VTX_XYZ_N_UV);
+
+	case xyz_normal_color_index:
+		return sizeof(VTX_XYZ_N_RGBA);
+	}
+
+	return sizeof(VTX_XYZ);
+}
+
+// Pack full vertices into the compact layout used for the model type
+void CVIBuffer::PackVertices(const VTX* pVertices, _uint count, eModelType type, void* pOut)
+{
+	_uchar* pDest = reinterpret_cast<_uchar*>(pOut);
+	_uint size = GetVertexSize(type);
+
+	for (_uint i = 0; i < count; ++i, pDest += size)
+	{
+		const VTX& vtx = pVertices[i];
+		vec3 vPos = vec3(vtx.vPos);
+		if (xyz_index == type)
+		{
+			reinterpret_cast<VTX_XYZ*>(pDest)->vPos = vPos;
+			continue;
+		}
+
+		// Every other layout starts with position + normal
+		VTX_XYZ_N* pVertex = reinterpret_cast<VTX_XYZ_N*>(pDest);
+		pVertex->vPos = vPos;
+		pVertex->iNormal = packSnorm3x10_1x2(vec4(vec3(vtx.vNormal), 1.f));
+
+		if (xyz_normal_texUV_index == type || xyz_normal_texUV_index_texNum == type)
+		{
+			VTX_XYZ_N_UV* pUV = reinterpret_cast<VTX_XYZ_N_UV*>(pDest);
+			pUV->vTexUV[0] = packHalf1x16(vtx.vTexUV.x);
+			pUV->vTexUV[1] = packHalf1x16(vtx.vTexUV.y);
+		}
+		else if (xyz_normal_color_index == type)
+			reinterpret_cast<VTX_XYZ_N_RGBA*>(pDest)->iColour = packUnorm4x8(vtx.vColour);
+	}
 }
 
 // Create an instance
-CVIBuffer* CVIBuffer::Create(_uint numVTX, VTX* pVertices, _uint numIDX, _uint* pIndices, eModelType type)
+CVIBuffer* CVIBuffer::Create(_uint numVTX, const VTX* pVertices, _uint numIDX, const _uint* pIndices, eModelType type)
+{
+	if (nullptr == pVertices)
+		return nullptr;
+
+	vector<_uchar> vecPacked(GetVertexSize(type) * numVTX);
+	PackVertices(pVertices, numVTX, type, vecPacked.data());
+
+	return Create(numVTX, vecPacked.data(), numIDX, pIndices, sizeof(_uint), type, 0 < numVTX ? pVertices[0].vColour : vec4(1.f));
+}
+
+// Create an instance from vertices in the compact layout
+CVIBuffer* CVIBuffer::Create(_uint numVTX, const void* pVertices, _uint numIDX, const void* pIndices, _uint indexSize, eModelType type, const vec4& vColour)
 {
 	CVIBuffer* pInstance = new CVIBuffer();
-	if (PK_NOERROR != pInstance->Ready(numVTX, pVertices, numIDX, pIndices, type))
+	if (PK_NOERROR != pInstance->Ready(numVTX, pVertices, numIDX, pIndices, indexSize, type, vColour))
 	{
 		pInstance->Destroy();
 		pInstance = nullptr;
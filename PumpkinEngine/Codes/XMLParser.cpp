@@ -6,6 +6,7 @@
 #include "..\Headers\Shader.h"
 #include "..\Headers\Texture.h"
 #include "..\Headers\SoundMaster.h"
+#include "..\Headers\AssetLoader.h"
 #include <pugixml/pugixml.hpp>
 #include <sstream>
 
@@ -30,7 +31,7 @@ void CXMLParser::Destroy()
 }
 
 // Load Shaders from file
-void CXMLParser::LoadShaderData(string path, string fileName)
+void CXMLParser::LoadShaderData(string path, string fileName, CAssetLoader* pLoader)
 {
 	stringstream ss;
 	ss << path << m_xmlDataPath << fileName;
@@ -69,6 +70,12 @@ void CXMLParser::LoadShaderData(string path, string fileName)
 		ss << path << data.PATH_VERTEX;
 		stringstream ss2;
 		ss2 << path << data.PATH_FRAGMENT;
+		if (nullptr != pLoader)
+		{
+			AddShaderJob(pLoader, data, ss.str(), ss2.str());
+			continue;
+		}
+
 		pComponent = CShader::Create(data.ID, ss.str().c_str(), ss2.str().c_str());
 		if (nullptr != pComponent)
 			pMaster->AddNewComponent(data.ID, pComponent);
@@ -173,6 +180,29 @@ void CXMLParser::LoadMeshData(string path, string fileName)
 	}
 }
 
+// Read the shader files on a worker, compile them on the loading thread
+void CXMLParser::AddShaderJob(CAssetLoader* pLoader, const sShaderdata& data, string vertexPath, string fragPath)
+{
+	CShader::SHADERFILEDATA* pFileData = new CShader::SHADERFILEDATA();
+	string ID = data.ID;
+
+	pLoader->AddJob(
+		[pFileData, vertexPath, fragPath]()
+		{
+			CShader::LoadShaderFiles(vertexPath.c_str(), fragPath.c_str(), *pFileData);
+		},
+		[pFileData, ID]()
+		{
+			CComponent* pComponent = CShader::Create(ID, *pFileData);
+			if (nullptr != pComponent)
+				CComponentMaster::GetInstance()->AddNewComponent(ID, pComponent);
+		},
+		[pFileData]()
+		{
+			delete pFileData;
+		});
+}
+
 // Load Sounds from file
 void CXMLParser::LoadSoundData(string path, string fileName)
 {
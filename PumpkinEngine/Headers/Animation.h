@@ -4,19 +4,58 @@
 #include <functional>
 #include "Base.h"
 #include "glm\mat4x4.hpp"
+#include "glm\gtc\quaternion.hpp"
 
 NAMESPACE_BEGIN(Engine)
 
+// Largest distance a removed key may stray from the curve of the keys around it
+#define ANIMATION_TRANSLATION_TOLERANCE		0.0005f
+#define ANIMATION_ROTATION_TOLERANCE		0.0005f		// Radians
+#define ANIMATION_SCALE_TOLERANCE			0.0005f
+// Largest difference of a matrix column rebuilt from the tracks, relative to its length (at least 1)
+// A clip with any frame past it (shear, projection, or fitting and quantization adding up) keeps its source matrices
+#define ANIMATION_MATRIX_TOLERANCE			0.002f
+
+class CMappedFile;
+
 // Class containing animation data
+// The clip is read from a binary cache next to the .animation file (path + ".clip"), converted on first use :
+// translation, rotation and scale tracks with only the keys linear interpolation cannot rebuild, rotations quantized to 48 bits
+// The tracks are sampled straight from the mapped cache, clips they can not rebuild also carry the source matrices
 class ENGINE_API CAnimation : public CBase
 {
+public:
+	// Smallest three quaternion : the largest component is dropped (index in the low 2 bits), the others take 15 bits each
+	typedef struct sQuantizedQuat
+	{
+		_ushort						iPacked[3];
+	}QUANTQUAT;
+
+private:
+	enum eTrack
+	{
+		TRACK_TRANSLATION,
+		TRACK_ROTATION,
+		TRACK_SCALE,
+		TRACK_END
+	};
+
 private:
 	std::string						m_tag;
 
-	std::vector<glm::mat4x4>		m_vecMatrix;
+	CMappedFile*					m_pClipFile;
+	std::vector<_uchar>				m_vecClip;			// Only when the cache could not be written and mapped
 	_uint							m_iDuration;
 	_float							m_fTickPerSec;
 
+	// Key frames of each track, pointing into the clip
+	_uint							m_iKeyNum[TRACK_END];
+	const _ushort*					m_pKeyFrames[TRACK_END];
+	const glm::vec3*				m_pTranslations;
+	const QUANTQUAT*				m_pRotations;
+	const glm::vec3*				m_pScales;
+	const glm::mat4x4*				m_pMatrices;		// Source matrices, only in clips the tracks can not rebuild
+
 
 private:
 	explicit CAnimation();
@@ -27,11 +66,26 @@ private:
 
 public:
 	void FrameMove(_float& curTime, _uint& frameIdx, _bool reverse, std::function<void(void)> callback);
+	// Matrix of a frame : the source one when the clip kept them, otherwise rebuilt from the tracks,
+	// which is within ANIMATION_MATRIX_TOLERANCE of the source for every frame
 	glm::mat4x4 GetMatrix(_uint iFrameIndex);
+	// Pose at any point of the clip, frame may fall between two frames
+	glm::mat4x4 Sample(_float frame);
 	_uint GetAnimationLength()			{ return m_iDuration; }
+	_uint GetKeyNumber();
+
+public:
+	static QUANTQUAT QuantizeQuat(const glm::quat& q);
+	static glm::quat DequantizeQuat(const QUANTQUAT& q);
 
 private:
 	RESULT Ready(std::string tag, std::string filePath);
+	// Point the tracks into a clip, fails when it is from another version or converted from another file
+	RESULT BindClip(const _uchar* pData, size_t size, _ulonglong sourceHash);
+	// Whether every frame of the bound tracks is within ANIMATION_MATRIX_TOLERANCE of the source matrices
+	_bool RebuildsSource(const _uchar* pMatrices);
+	// Read the raw frames (duration, tick, one matrix per frame) and build the clip
+	static RESULT ConvertAnimation(const _uchar* pSource, size_t sourceSize, _ulonglong sourceHash, std::vector<_uchar>& vecClip);
 public:
 	static CAnimation* Create(std::string tag, std::string filePath);
 };
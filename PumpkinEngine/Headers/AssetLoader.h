@@ -0,0 +1,66 @@
+#ifndef _ASSETLOADER_H_
+#define _ASSETLOADER_H_
+
+#include "Base.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+NAMESPACE_BEGIN(Engine)
+
+// Loads a batch of assets in three stages
+// Load : file I/O and decoding, runs on worker threads
+// Upload : GL object creation, runs on the thread that calls Run (the one owning the context) in the order the jobs were added
+// Release : frees whatever the load stage left behind, runs right after the upload (also with the null backend)
+class ENGINE_API CAssetLoader : public CBase
+{
+public:
+	typedef std::function<void()> STAGE;
+
+private:
+	typedef struct sAssetJob
+	{
+		STAGE				load;
+		STAGE				upload;
+		STAGE				release;
+	}ASSETJOB;
+
+private:
+	std::vector<ASSETJOB>				m_vecJobs;
+	std::vector<_uchar>					m_vecLoaded;
+	std::atomic<_uint>					m_iNextLoad;
+	std::mutex							m_mutex;
+	std::condition_variable				m_cvLoaded;
+	_uint								m_iWorkerCount;		// 0 : one per core
+	_bool								m_bNullBackend;		// Skip the upload stage (benchmarks, no GL context)
+
+private:
+	explicit CAssetLoader();
+	virtual ~CAssetLoader();
+	virtual void Destroy();
+
+public:
+	void AddJob(STAGE load, STAGE upload, STAGE release);
+	// Load every job on the workers and upload them on the calling thread, returns when all of them are done
+	void Run();
+
+public:
+	_uint GetJobCount()								{ return (_uint)m_vecJobs.size(); }
+	void SetWorkerCount(_uint count)				{ m_iWorkerCount = count; }
+	void SetNullBackend(_bool value)				{ m_bNullBackend = value; }
+	_bool IsNullBackend()							{ return m_bNullBackend; }
+
+private:
+	_bool LoadNext();
+	_bool IsLoaded(_uint index);
+
+private:
+	RESULT Ready();
+public:
+	static CAssetLoader* Create();
+};
+
+NAMESPACE_END
+
+#endif //_ASSETLOADER_H_
\ No newline at end of file
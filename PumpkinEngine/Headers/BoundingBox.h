@@ -17,8 +17,7 @@ class CTransform;
 class ENGINE_API CBoundingBox : public CComponent
 {
 public:
-	CVIBuffer*			m_pVIBuffer;
-	VTX*				m_pVertices;
+	CVIBuffer*			m_pVIBuffer;			// Shared with clones
 	glm::vec3			m_vCenter;
 	glm::vec3			m_vHalfExtents;
 	glm::vec3			m_vMin;
@@ -43,13 +42,17 @@ public:
 	virtual void Render();
 	void RenderWithoutParent();
 	void RenderWithParent(CTransform* parent);
+	void RenderWithMatrix(const glm::mat4x4& matWorld);
 private:
 	virtual void Destroy();
 
 public:
-	VTX* GetVertices()							{ return m_pVertices; }
+	// The 8 corners of the original box, in the order the box buffer uses
+	void GetCorners(glm::vec3* pCorners);
 	void SetTransform(CTransform* transform)	{ m_pParentTransform = transform; }
 	void UpdateBoundingBox(glm::mat4x4& parentWorldMatrix);
+	// Refresh m_vMinWorld/m_vMaxWorld, the world-space box around the original box
+	void UpdateWorldBounds(const glm::mat4x4& matWorld);
 	void SetColor(glm::vec3 vColor);
 
 private:
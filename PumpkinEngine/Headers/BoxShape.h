@@ -2,6 +2,7 @@
 #define _BOXSHAPE_H_
 
 #include "iShape.h"
+#include "MemoryPool.h"
 #include "glm\vec3.hpp"
 
 NAMESPACE_BEGIN(Engine)
@@ -16,9 +17,14 @@ private:
 	virtual ~CBoxShape();
 	virtual void Destroy();
 
+	POOLED(CBoxShape)
+
 public:
 	glm::vec3 GetHalfExtents()	{ return m_vHalfExtents; }
 
+public:
+	virtual glm::vec3 GetLocalInertia(_float mass);
+
 private:
 	RESULT Ready(eShapeType type, glm::vec3 vHalf);
 public:
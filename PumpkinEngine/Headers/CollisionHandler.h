@@ -3,6 +3,7 @@
 
 #include "Base.h"
 #include "glm\vec3.hpp"
+#include "PhysicsProfile.h"
 
 NAMESPACE_BEGIN(Engine)
 
@@ -21,15 +22,28 @@ public:
 		CRigidBody* pBodyB;
 	};
 
+private:
+	_float				m_fCCDMotionRatio;
+	_uint				m_iPairsTested;
+	_uint				m_iFastBodies;
+
 private:
 	explicit CCollisionHandler();
 	virtual ~CCollisionHandler();
 	virtual void Destroy();
 
 public:
+	void SweepFastBodies(std::vector<CRigidBody*>& bodies);
 	void Collide(const _float& dt, std::vector<CRigidBody*>& bodies, std::vector<sColPair>& vecCols);
+	_uint GetPairsTested()						{ return m_iPairsTested; }
+	_uint GetFastBodies()						{ return m_iFastBodies; }
+	// Bodies moving more than (radius * ratio) in one step are swept against planes
+	void SetCCDMotionRatio(_float ratio)		{ m_fCCDMotionRatio = ratio; }
 
 private: // Helper Functions
+	_bool SweepSpherePlane(const glm::vec3& prevPosition, const glm::vec3& motion,
+		_float radius, const glm::vec3& normal, _float dotProduct, _float& toi);
+	_float GetPlaneDotProduct(CRigidBody* planeBody, CPlaneShape* planeShape);
 	_bool CollideSphereSphere(const _float& dt, CRigidBody* bodyA, CSphereShape* sphereA,
 		CRigidBody* bodyB, CSphereShape* sphereB);
 	_bool CollideSphereGroundPlane(const _float& dt, CRigidBody* sphereBody, CSphereShape* sphereShape,
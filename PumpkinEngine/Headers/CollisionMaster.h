@@ -3,6 +3,8 @@
 
 #include "Base.h"
 #include "EngineStruct.h"
+#include "CollisionQuery.h"
+#include <functional>
 
 NAMESPACE_BEGIN(Engine)
 
@@ -10,12 +12,17 @@ class CBoundingBox;
 class CTransform;
 class CQuadTree;
 class COctree;
+class CTriangleBVH;
 
 // Class that manages all collision checks
 class ENGINE_API CCollisionMaster : public CBase
 {
 	SINGLETON(CCollisionMaster)
 
+private:
+	std::vector<CCollisionQueryContext*>	m_vecContexts;		// One per ParallelFor worker
+	_uint									m_iWorkerCount;		// Batched queries, 0 : one per core
+
 private:
 	explicit CCollisionMaster();
 	virtual ~CCollisionMaster();
@@ -27,25 +34,48 @@ public:
 	_bool IntersectRayToBoundingBox(CBoundingBox* pBoundingBox, CTransform* pParentTransform, glm::vec3& vOrigin, glm::vec3& vDir);
 private:
 	_bool IntersectPointToTriangle(glm::vec3& p0, glm::vec3& p1, glm::vec3& p2, glm::vec3& vOrigin, glm::vec3& vDir, glm::vec3& vDest);
-	_bool PointInTriangle(glm::vec3 P, glm::vec3 A, glm::vec3 B, glm::vec3 C);
-	_bool PointInDotThree(glm::vec3 p1, glm::vec3 p2, glm::vec3 pA, glm::vec3 pB);
 
 public:
 	_bool IntersectRayToTriangles(CQuadTree* pQuadTree, glm::vec3& vMain, glm::vec3& vTarget, glm::vec3& vDest);
 	_bool IsRayBlockedByTriangles(CQuadTree* pQuadTree, glm::vec3& vMain, glm::vec3& vTarget, glm::vec3& vDest);
 	_bool IntersectCheckForProjectiles(CQuadTree* pQuadTree, glm::vec3& vMain, glm::vec3& vTarget, glm::vec3& vDest);
+	_bool IntersectRayToTriangles(CTriangleBVH* pBVH, glm::vec3& vMain, glm::vec3& vTarget, glm::vec3& vDest);
+	_bool IsRayBlockedByTriangles(CTriangleBVH* pBVH, glm::vec3& vMain, glm::vec3& vTarget);
+	_bool IntersectCheckForProjectiles(CTriangleBVH* pBVH, glm::vec3& vMain, glm::vec3& vTarget, glm::vec3& vDest);
+	void AreRaysBlockedByTriangles(CTriangleBVH* pBVH, glm::vec3& vMain, const glm::vec3* pTargets, _uint count, _bool* pBlocked);
+
+public:
+	// Batched queries spread over the workers (one per core unless SetWorkerCount), call from one thread at a time
+	// The query functions above keep no state and are safe to call from any thread
+	CCollisionQueryContext* GetQueryContext(_uint worker);
+	void SetWorkerCount(_uint count)				{ m_iWorkerCount = count; }
+	void RayClosestBatch(CTriangleBVH* pBVH, const RAYQUERY* pQueries, _uint count, RAYRESULT* pResults);
+	void SegmentBlockedBatch(CTriangleBVH* pBVH, const RAYQUERY* pQueries, _uint count, _bool* pBlocked);
+	void OverlapOctreeBatch(COctree* pOctree, CBoundingBox** ppBoxes, _uint count, std::function<void(_uint, const std::vector<_uint>&)> callback);
+private:
+	void ReadyQueryContexts();
 private:
 	void GetCenter(glm::vec3& p0, glm::vec3& p1, glm::vec3& p2, glm::vec3& center, _float& radius);
 	_bool IntersectRaySphere(glm::vec3& vOrigin, glm::vec3& vDir, glm::vec3& center, _float& radius);
 
 public:
 	_bool IntersectTriangleToAABB(TRIANGLE* triangle, CBoundingBox* boundingBox);
+	_bool IntersectTriangleToAABB(TRIANGLE* triangle, glm::vec3 bbMin, glm::vec3 bbMax);
 	_bool IntersectTriangleToOBB(TRIANGLE* triangle, CBoundingBox* boundingBox);
 	_bool IntersectOBBToAABB(CBoundingBox* obb, CBoundingBox* aabb);
+	_bool IntersectOBBToAABB(CBoundingBox* obb, glm::vec3 bbMin2, glm::vec3 bbMax2);
+
+public:
+	// SAT kernels, boxes given as center/half extents
+	_bool TestTriangleAABB(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& vCenter, const glm::vec3& vHalf);
+	// One box against count triangles (pTriangles[pIndices[i]], or pTriangles[i] without indices), 4 per SSE pass
+	_uint TestTrianglesAABB(const TRIANGLE* pTriangles, const _uint* pIndices, _uint count, const glm::vec3& vCenter, const glm::vec3& vHalf, _bool* pResults);
+	_bool TestTriangleOBB(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const OBB& obb);
+	_bool TestOBBAABB(const OBB& obb, const glm::vec3& vCenter, const glm::vec3& vHalf);
+	// Box of the bounding box placed by its parent transform
+	void GetOrientedBox(CBoundingBox* boundingBox, OBB& obb);
 private:
-	void ProjectTriangle(TRIANGLE* triangle, glm::vec3& axis, _float& fMin, _float& fMax);
-	void ProjectBox(glm::vec3& bbMin, glm::vec3& bbMax, glm::vec3& axis, _float& fMin, _float& fMax);
-	void Project(glm::vec3& axis, glm::vec3 vertex, _float& fMin, _float& fMax);
+	_bool SeparatedOnAxis(const glm::vec3& axis, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& vHalf);
 };
 
 NAMESPACE_END
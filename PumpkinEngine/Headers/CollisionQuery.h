@@ -0,0 +1,64 @@
+#ifndef _COLLISIONQUERY_H_
+#define _COLLISIONQUERY_H_
+
+#include "Base.h"
+#include "EngineStruct.h"
+
+NAMESPACE_BEGIN(Engine)
+
+class CTriangleBVH;
+class COctree;
+class CBoundingBox;
+
+typedef struct sRayQuery
+{
+	glm::vec3				vOrigin;
+	glm::vec3				vTarget;
+}RAYQUERY;
+
+typedef struct sRayResult
+{
+	_bool					bHit;
+	_float					fDistance;
+	_uint					iTriangle;
+	glm::vec3				vPoint;
+}RAYRESULT;
+
+// Scratch buffers and counters owned by one thread
+// Acceleration structures are only read, so any number of contexts can query them at once
+class ENGINE_API CCollisionQueryContext : public CBase
+{
+private:
+	std::vector<_uint>					m_vecLeaves;
+	std::vector<glm::vec3>				m_vecOrigins;
+	std::vector<glm::vec3>				m_vecTargets;
+	_uint								m_iRayCount;
+	_uint								m_iOverlapCount;
+
+private:
+	explicit CCollisionQueryContext();
+	virtual ~CCollisionQueryContext();
+	virtual void Destroy();
+
+public:
+	// Closest triangle on the segment vOrigin -> vTarget
+	void RayClosest(CTriangleBVH* pBVH, const RAYQUERY& query, RAYRESULT& result);
+	// Line of sight for a range of segments, traced as ray packets
+	void SegmentsBlocked(CTriangleBVH* pBVH, const RAYQUERY* pQueries, _uint count, _bool* pBlocked);
+	// Octree leaves touching the box, valid until the next call on this context
+	const std::vector<_uint>& OverlapOctree(COctree* pOctree, CBoundingBox* bbox);
+
+public:
+	_uint GetRayCount()				{ return m_iRayCount; }
+	_uint GetOverlapCount()			{ return m_iOverlapCount; }
+	void ResetCounters()			{ m_iRayCount = m_iOverlapCount = 0; }
+
+private:
+	RESULT Ready();
+public:
+	static CCollisionQueryContext* Create();
+};
+
+NAMESPACE_END
+
+#endif //_COLLISIONQUERY_H_
\ No newline at end of file
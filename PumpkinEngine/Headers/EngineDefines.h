@@ -63,6 +63,7 @@ typedef unsigned char		_uchar;
 typedef unsigned short		_ushort;
 typedef unsigned int		_uint;
 typedef unsigned long		_ulong;
+typedef unsigned long long	_ulonglong;
 
 typedef unsigned int		RESULT;
 
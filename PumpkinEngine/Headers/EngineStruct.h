@@ -20,6 +20,33 @@ namespace Engine
 		glm::vec4 vBoneWeight;
 	}VTX;
 
+	// Compact vertex layouts uploaded to the GPU, the one used by a mesh is chosen from its eModelType
+	// Every layout starts with the position, normals are signed normalized 10_10_10_2 and UVs are half floats
+	typedef struct sVertex_XYZ
+	{
+		glm::vec3 vPos;
+	}VTX_XYZ;
+
+	typedef struct sVertex_XYZ_N
+	{
+		glm::vec3 vPos;
+		unsigned int iNormal;
+	}VTX_XYZ_N;
+
+	typedef struct sVertex_XYZ_N_UV
+	{
+		glm::vec3 vPos;
+		unsigned int iNormal;
+		unsigned short vTexUV[2];
+	}VTX_XYZ_N_UV;
+
+	typedef struct sVertex_XYZ_N_RGBA
+	{
+		glm::vec3 vPos;
+		unsigned int iNormal;
+		unsigned int iColour;		// RGBA8
+	}VTX_XYZ_N_RGBA;
+
 	typedef struct sIndex
 	{
 		unsigned int _0;
@@ -34,6 +61,21 @@ namespace Engine
 		glm::vec3 p2;
 	}TRIANGLE;
 
+	// Index range of one level of detail, every level of a mesh draws from the same vertex buffer
+	typedef struct sMeshLOD
+	{
+		unsigned int iIndexStart;
+		unsigned int iIndexCount;
+		float fError;			// Object space distance the level may stray from the full mesh
+	}MESHLOD;
+
+	typedef struct sOrientedBox
+	{
+		glm::vec3 vCenter;
+		glm::vec3 vAxis[3];		// Unit axes
+		glm::vec3 vHalf;		// Half extents along each axis
+	}OBB;
+
 	enum eModelType
 	{
 		xyz_index,
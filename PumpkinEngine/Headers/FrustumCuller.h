@@ -0,0 +1,74 @@
+#ifndef _FRUSTUMCULLER_H_
+#define _FRUSTUMCULLER_H_
+
+#include "Base.h"
+#include "glm\vec3.hpp"
+#include "glm\vec4.hpp"
+#include "glm\mat4x4.hpp"
+
+NAMESPACE_BEGIN(Engine)
+
+// View frustum culling for world-space boxes
+// Boxes are sorted by the Morton code of their centers and grouped 4 at a time into a linear 4-wide tree,
+// so one SSE test checks 4 children against a plane and a subtree fully inside the frustum is accepted without going further.
+// Works on plain matrices and boxes, so it can be measured without a GL context.
+class ENGINE_API CFrustumCuller : public CBase
+{
+public:
+	// Children bounds in SoA order so each row loads into one SSE register
+	typedef struct sCullNode
+	{
+		_float				vMinX[4];
+		_float				vMinY[4];
+		_float				vMinZ[4];
+		_float				vMaxX[4];
+		_float				vMaxY[4];
+		_float				vMaxZ[4];
+		_uint				iChild[4];		// Child node index, unused in the bottom level
+		_uint				iFirst[4];		// First box of the subtree in sorted order
+		_uint				iCount[4];		// Boxes in the subtree, 0 for empty slots
+	}NODE;
+
+private:
+	glm::vec4							m_vPlanes[6];		// Left, right, bottom, top, near, far (normals point inside)
+	std::vector<NODE>					m_vecNodes;			// Bottom level first, root is the last node
+	std::vector<_uint>					m_vecOrder;			// Sorted position -> box index
+	std::vector<_uchar>					m_vecVisible;		// Per box, filled by Cull
+	_uint								m_iLeafNodeCount;
+	_uint								m_iVisibleCount;
+	_uint								m_iCulledCount;
+	_uint								m_iNodeTestCount;
+
+private:
+	explicit CFrustumCuller();
+	virtual ~CFrustumCuller();
+	virtual void Destroy();
+
+public:
+	// Extract the 6 planes from a projection * view matrix
+	void SetViewProjMatrix(const glm::mat4x4& matViewProj);
+	// Rebuild the tree over count boxes (pMin[i], pMax[i])
+	void Build(const glm::vec3* pMin, const glm::vec3* pMax, _uint count);
+	// Test the built boxes against the current planes, return the number of visible boxes
+	_uint Cull();
+
+public:
+	_bool IsVisible(_uint index)			{ return 0 != m_vecVisible[index]; }
+	_uint GetBoxCount()						{ return (_uint)m_vecOrder.size(); }
+	_uint GetVisibleCount()					{ return m_iVisibleCount; }
+	_uint GetCulledCount()					{ return m_iCulledCount; }
+	_uint GetNodeTestCount()				{ return m_iNodeTestCount; }
+	const glm::vec4& GetPlane(_uint index)	{ return m_vPlanes[index]; }
+
+private:
+	void MarkVisible(_uint first, _uint count);
+
+private:
+	RESULT Ready();
+public:
+	static CFrustumCuller* Create();
+};
+
+NAMESPACE_END
+
+#endif //_FRUSTUMCULLER_H_
@@ -10,6 +10,7 @@
 NAMESPACE_BEGIN(Engine)
 
 class CComponentMaster;
+class CAssetLoader;
 
 // Save/Load Json files
 class ENGINE_API CJsonParser : public CBase
@@ -71,12 +72,25 @@ private:
 
 public:
 	void LoadCharacterList(std::string assetFolderPath, std::string fileName, std::vector<sCharacterData>& vec);
-	void LoadTextureData(std::string assetFolderPath, std::string fileName);
-	void LoadMeshData(std::string assetFolderPath, std::string fileName, _bool saveMeshList = false);
+	// With a loader the files are only queued, they are loaded when the loader runs
+	// Without one the textures are created at once and their images streamed in (CTextureStreamer)
+	void LoadTextureData(std::string assetFolderPath, std::string fileName, CAssetLoader* pLoader = nullptr);
+	void LoadMeshData(std::string assetFolderPath, std::string fileName, _bool saveMeshList = false, CAssetLoader* pLoader = nullptr);
+	// Read the mesh list only, nothing is loaded
+	void LoadMeshList(std::string assetFolderPath, std::string fileName, std::vector<sMeshData>& vec);
+	// Write the binary cache of every mesh in the list without loading them
+	void ConvertMeshData(std::string assetFolderPath, std::string fileName);
+	// Cook the compressed cache of every texture in the list, textures run in parallel
+	void CookTextureData(std::string assetFolderPath, std::string fileName);
 	void LoadObjectList(std::string assetFolderPath, std::string fileName, std::vector<sObjectData>& vec, sObjectData& cameraData);
 	void SaveObjectList(std::string assetFolderPath, std::string fileName, std::vector<sObjectData>& vec, sObjectData& cameraData);
 
 private:
+	void AddTextureJob(CAssetLoader* pLoader, const sTexturedata& data, std::string filePath);
+	// Entries sharing a mesh file share one load and its geometry
+	struct sMeshLoad;
+	typedef std::unordered_map<std::string, sMeshLoad*> MESHLOAD_MAP;
+	void AddMeshJob(CAssetLoader* pLoader, const sMeshData& data, std::string filePath, _bool saveMeshList, MESHLOAD_MAP& mapLoads);
 	void LoadDataFromFile(rapidjson::Document& doc, FILE*& file, std::string assetFolderPath, std::string fileName);
 };
 
@@ -0,0 +1,39 @@
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include "Base.h"
+
+NAMESPACE_BEGIN(Engine)
+
+// Read-only view of a whole file mapped into memory
+// The data stays valid until the last reference is released
+class ENGINE_API CMappedFile : public CBase
+{
+private:
+	void*								m_hFile;
+	void*								m_hMapping;
+	const _uchar*						m_pData;
+	size_t								m_iSize;
+
+private:
+	explicit CMappedFile();
+	virtual ~CMappedFile();
+	virtual void Destroy();
+
+public:
+	const _uchar* GetData()				{ return m_pData; }
+	size_t GetSize()					{ return m_iSize; }
+
+public:
+	// FNV-1a style 64-bit hash (8 bytes per step), used to tie cache files to their source data
+	static _ulonglong HashBytes(const void* pData, size_t size, _ulonglong seed = 14695981039346656037ULL);
+
+private:
+	RESULT Ready(const std::string& path);
+public:
+	static CMappedFile* Create(const std::string& path);
+};
+
+NAMESPACE_END
+
+#endif //_MAPPEDFILE_H_
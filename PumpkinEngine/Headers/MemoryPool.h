@@ -0,0 +1,118 @@
+#ifndef _MEMORYPOOL_H_
+#define _MEMORYPOOL_H_
+
+#include "EngineDefines.h"
+#include <new>
+
+NAMESPACE_BEGIN(Engine)
+
+// Fixed-size pool allocator (single thread)
+// Objects are carved from blocks of BLOCK_COUNT slots and recycled through a free list,
+// so bulk spawn/despawn never touches the global heap once the pool is warmed up.
+template <typename T, _uint BLOCK_COUNT = 256>
+class CMemoryPool
+{
+private:
+	union uSlot
+	{
+		uSlot*					pNext;
+		alignas(T) _uchar		data[sizeof(T)];
+	};
+
+	std::vector<uSlot*>			m_vecBlocks;
+	uSlot*						m_pFreeList;
+	_uint						m_iUsedCount;
+
+public:
+	explicit CMemoryPool()
+		: m_pFreeList(nullptr), m_iUsedCount(0)
+	{
+		m_vecBlocks.clear();
+	}
+	~CMemoryPool()
+	{
+		for (size_t i = 0; i < m_vecBlocks.size(); ++i)
+			::operator delete(m_vecBlocks[i]);
+		m_vecBlocks.clear();
+		m_pFreeList = nullptr;
+	}
+	CMemoryPool(const CMemoryPool&) = delete;
+	CMemoryPool& operator=(const CMemoryPool&) = delete;
+
+public:
+	_uint GetUsedCount()			{ return m_iUsedCount; }
+	_uint GetCapacity()				{ return (_uint)m_vecBlocks.size() * BLOCK_COUNT; }
+
+	// Get raw storage for one object
+	void* Allocate()
+	{
+		if (nullptr == m_pFreeList)
+			AddBlock();
+
+		uSlot* pSlot = m_pFreeList;
+		m_pFreeList = pSlot->pNext;
+		++m_iUsedCount;
+		return pSlot->data;
+	}
+
+	// Give storage back to the pool
+	void Free(void* p)
+	{
+		if (nullptr == p)
+			return;
+
+		uSlot* pSlot = reinterpret_cast<uSlot*>(p);
+		pSlot->pNext = m_pFreeList;
+		m_pFreeList = pSlot;
+		--m_iUsedCount;
+	}
+
+	// Make sure that 'count' objects can be allocated without growing
+	void Reserve(_uint count)
+	{
+		while (GetCapacity() - m_iUsedCount < count)
+			AddBlock();
+	}
+
+private:
+	void AddBlock()
+	{
+		uSlot* pBlock = static_cast<uSlot*>(::operator new(sizeof(uSlot) * BLOCK_COUNT));
+		for (_uint i = 0; i < BLOCK_COUNT - 1; ++i)
+			pBlock[i].pNext = &pBlock[i + 1];
+		pBlock[BLOCK_COUNT - 1].pNext = m_pFreeList;
+		m_pFreeList = pBlock;
+		m_vecBlocks.push_back(pBlock);
+	}
+};
+
+NAMESPACE_END
+
+// Route class-specific new/delete through a CMemoryPool
+#define POOLED(CLASSNAME)												\
+		public:															\
+			static void* operator new(size_t size);						\
+			static void operator delete(void* p, size_t size);			\
+			static void ReservePool(_uint count);
+
+#define POOLED_FUNCTION(CLASSNAME)										\
+		static Engine::CMemoryPool<CLASSNAME> s_##CLASSNAME##Pool;		\
+		void* CLASSNAME::operator new(size_t size)						\
+		{																\
+			if (sizeof(CLASSNAME) != size)								\
+				return ::operator new(size);							\
+			return s_##CLASSNAME##Pool.Allocate();						\
+		}																\
+		void CLASSNAME::operator delete(void* p, size_t size)			\
+		{																\
+			if (sizeof(CLASSNAME) != size)								\
+				::operator delete(p);									\
+			else														\
+				s_##CLASSNAME##Pool.Free(p);							\
+		}																\
+		void CLASSNAME::ReservePool(_uint count)						\
+		{																\
+			s_##CLASSNAME##Pool.Reserve(count);							\
+		}
+
+#endif //_MEMORYPOOL_H_
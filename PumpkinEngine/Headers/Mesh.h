@@ -7,29 +7,66 @@
 
 NAMESPACE_BEGIN(Engine)
 
-class CVIBuffer;
+class CMeshGeometry;
 class CBoundingBox;
 class CTexture;
 class CShader;
 class CTransform;
 class COpenGLDevice;
 class CAnimController;
+class CTriangleBVH;
+class COctree;
+class CMappedFile;
+
+#define MESH_MAX_LOD				4
+#define MESH_LOD_MIN_TRIANGLES		64		// Smaller meshes (or levels) are not simplified any further
+#define MESH_LOD_PIXEL_ERROR		1.f		// Default on screen deviation allowed when choosing a level
 
 // Components with 3D mesh file information
+// The geometry is shared by every clone, a clone only holds its own render state
 class ENGINE_API CMesh : public CComponent
 {
+public:
+	// Everything read from a mesh file or its binary cache
+	// Arrays point into pMappedFile when it is set, otherwise they are allocated with new[]
+	typedef struct sMeshFileData
+	{
+		CMappedFile*				pMappedFile;
+		const _uchar*				pVertices;			// Compact layout of the model type (CVIBuffer::GetVertexSize)
+		const _uchar*				pIndices;			// iIndexSize bytes each
+		const TRIANGLE*				pTriangles;
+		_uint						iVertexNum;
+		_uint						iVertexSize;
+		_uint						iIndexNum;
+		_uint						iIndexSize;
+		_uint						iTriNum;
+		glm::vec3					vMin;
+		glm::vec3					vMax;
+		glm::vec4					vColour;			// Mesh colour for layouts without one
+		std::string					textureFileName;
+		std::string					sourcePath;
+		_float						fSourceACMR;		// Simulated cache miss ratio before and after the import optimization (parsed meshes only)
+		_float						fACMR;
+		_uint						iLODNum;
+		MESHLOD						LODs[MESH_MAX_LOD];	// Level 0 is the full mesh, the index list holds every level back to back
+
+		sMeshFileData()
+			: pMappedFile(nullptr), pVertices(nullptr), pIndices(nullptr), pTriangles(nullptr)
+			, iVertexNum(0), iVertexSize(0), iIndexNum(0), iIndexSize(0), iTriNum(0), vMin(0.f), vMax(0.f), vColour(1.f)
+			, fSourceACMR(0.f), fACMR(0.f), iLODNum(0), LODs() {}
+	}MESHFILEDATA;
+
 private:
 	COpenGLDevice*				m_pOpenGLDevice;
-	CVIBuffer*					m_pVIBuffer;
+	CMeshGeometry*				m_pGeometry;		// Shared with clones
 	CBoundingBox*				m_pBoundingBox;
 	CTexture*					m_pDiffTexture;
 	CTexture*					m_pNormalTexture;
 	CShader*					m_pShader;
 	CTransform*					m_pParentTransform;
 
-	std::string					m_textureFileName;
-	_uint						m_iTriNum;
-	TRIANGLE*					m_pTriangles;
+	_float						m_fLODPixelError;	// 0 : always draw the full mesh
+	_uint						m_iLastLOD;			// Level drawn by the last Render
 
 	_bool						m_bWireFrame;
 	_bool						m_bSelected;
@@ -55,12 +92,19 @@ private:
 
 public:
 	CBoundingBox* GetBoundingBox()							{ return m_pBoundingBox; }
-	TRIANGLE* GetTriangleArray()							{ return m_pTriangles; }
-	_uint GetTriangleNumber()								{ return m_iTriNum; }
+	CMeshGeometry* GetGeometry()							{ return m_pGeometry; }
+	const TRIANGLE* GetTriangleArray();
+	_uint GetTriangleNumber();
+	// BVH over the local-space triangles for ray queries
+	CTriangleBVH* GetTriangleBVH();
+	// Octree over the local-space triangles for box queries
+	COctree* GetOctree();
 	CShader* GetShader()									{ return m_pShader; }
-	std::string GetTexName()								{ return m_textureFileName; }
+	std::string GetTexName();
 	std::string GetInitSize()								{ return m_initSize; }
 	std::string GetMeshType()								{ return m_meshType; }
+	_uint GetLastLOD()										{ return m_iLastLOD; }
+	void SetLODPixelError(_float value)						{ m_fLODPixelError = value; }
 	void SetTransform(CTransform* transform)				{ m_pParentTransform = transform; }
 	void SetWireFrame(_bool wire)							{ m_bWireFrame = wire; }
 	void SetSelcted(_bool select)							{ m_bSelected = select; }
@@ -73,14 +117,37 @@ public:
 
 private:
 	RESULT Ready(std::string ID, std::string filePath, std::string fileName, eModelType type, std::string shaderID, std::string initSize, std::string meshType, std::string texID_Diff, std::string texID_Normal);
-	RESULT Ready_VIBuffer(eModelType type, std::string filePath, std::string fileName, VTX** pVertices, _uint** pIndices, _uint& vertexNum, _uint& indexNum);
+	RESULT Ready(std::string ID, MESHFILEDATA& data, eModelType type, std::string shaderID, std::string initSize, std::string meshType, std::string texID_Diff, std::string texID_Normal);
+	RESULT Ready(std::string ID, CMeshGeometry* pGeometry, std::string shaderID, std::string initSize, std::string meshType, std::string texID_Diff, std::string texID_Normal);
+	RESULT Ready_Geometry(eModelType type, MESHFILEDATA& data);
+	RESULT Ready_Geometry(CMeshGeometry* pGeometry);
 	void Ready_Texture_Diff(std::string texID);
 	void Ready_Texture_Normal(std::string texID);
 	void Ready_Shader(std::string shaderID);
+	static RESULT LoadPLY(eModelType type, const std::string& path, MESHFILEDATA& data);
+	static void GenerateLODs(std::vector<_uint>& vecIndices, const _uchar* pVertices, _uint vertexNum, _uint vertexSize, MESHFILEDATA& data);
+	static _bool HashMeshFile(const std::string& path, eModelType type, _ulonglong& hash);
+	static RESULT MapMeshCache(eModelType type, const std::string& path, _ulonglong sourceHash, MESHFILEDATA& data);
+	static _bool SaveMeshCache(const std::string& path, _ulonglong sourceHash, const MESHFILEDATA& data);
 
 public:
+	// Coarsest level whose deviation, projected on screen, stays within pixelError pixels
+	// vCenter and fRadius bound the mesh in object space, matProj is a perspective projection
+	static _uint SelectLOD(const MESHLOD* pLODs, _uint lodNum, const glm::mat4x4& matWorldView, const glm::mat4x4& matProj,
+		const glm::vec3& vCenter, _float fRadius, _float viewportHeight, _float pixelError);
+	// Read a mesh from its binary cache or its PLY file (no GL context needed, safe on any thread)
+	static RESULT LoadMeshFile(eModelType type, std::string filePath, std::string fileName, MESHFILEDATA& data);
+	// Free whatever a mesh created from the data did not take over
+	static void ReleaseMeshFile(MESHFILEDATA& data);
+	// Write the binary cache of a mesh file ahead of time (no GL context needed)
+	// pACMR (2 floats) receives the simulated cache miss ratio before and after the optimization
+	static RESULT ConvertMeshFile(std::string filePath, std::string fileName, eModelType type, _float* pACMR = nullptr);
 	virtual CComponent* Clone();
 	static CMesh* Create(std::string ID, std::string filePath, std::string fileName, eModelType type, std::string shaderID, std::string initSize, std::string meshType, std::string texID_Diff, std::string texID_Normal);
+	// Create from loaded mesh data, the collision triangles and the mapped cache are taken over by the shared geometry
+	static CMesh* Create(std::string ID, MESHFILEDATA& data, eModelType type, std::string shaderID, std::string initSize, std::string meshType, std::string texID_Diff, std::string texID_Normal);
+	// Create on the geometry of another mesh loaded from the same file, the geometry is shared
+	static CMesh* Create(std::string ID, CMeshGeometry* pGeometry, std::string shaderID, std::string initSize, std::string meshType, std::string texID_Diff, std::string texID_Normal);
 };
 
 NAMESPACE_END
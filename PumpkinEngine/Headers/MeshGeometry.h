@@ -0,0 +1,75 @@
+#ifndef _MESHGEOMETRY_H_
+#define _MESHGEOMETRY_H_
+
+#include "Base.h"
+#include "Mesh.h"
+#include <mutex>
+
+NAMESPACE_BEGIN(Engine)
+
+class CVIBuffer;
+class CTriangleBVH;
+class COctree;
+class CMappedFile;
+
+#define MESH_OCTREE_DEPTH		4		// 512 leaves
+
+// Immutable geometry of one mesh file : GPU buffers, level of detail table and collision triangles
+// Created once per mesh file and shared (reference counted) by the mesh and every one of its clones
+class ENGINE_API CMeshGeometry : public CBase
+{
+private:
+	CVIBuffer*					m_pVIBuffer;
+	const TRIANGLE*				m_pTriangles;		// Collision triangles, always the full mesh
+	_uint						m_iTriNum;
+	CMappedFile*				m_pMeshFile;		// Mesh cache m_pTriangles points into, nullptr when they are owned
+	CTriangleBVH*				m_pTriangleBVH;		// Built on first use
+	COctree*					m_pOctree;			// Built on first use
+	std::once_flag				m_onceBVH;			// Clones may ask for the trees from several threads
+	std::once_flag				m_onceOctree;
+	std::string					m_cacheFilePath;	// Acceleration structure cache next to the mesh file
+	std::string					m_octreeFilePath;
+	std::string					m_textureFileName;
+
+	_uint						m_iLODNum;
+	MESHLOD						m_LODs[MESH_MAX_LOD];
+	glm::vec3					m_vMin;
+	glm::vec3					m_vMax;
+	glm::vec3					m_vCenter;			// Bounding sphere used to choose the level of detail
+	_float						m_fRadius;
+
+private:
+	explicit CMeshGeometry();
+	virtual ~CMeshGeometry();
+	virtual void Destroy();
+
+public:
+	// Draw one level of detail
+	void Render(_uint lod, _bool wireFrame);
+
+public:
+	CVIBuffer* GetVIBuffer()					{ return m_pVIBuffer; }
+	const TRIANGLE* GetTriangleArray()			{ return m_pTriangles; }
+	_uint GetTriangleNumber()					{ return m_iTriNum; }
+	// BVH over the local-space triangles for ray queries, built once even when first asked from several threads
+	CTriangleBVH* GetTriangleBVH();
+	// Octree over the local-space triangles for box queries, the depth of the first call is kept
+	COctree* GetOctree(_uint depth = MESH_OCTREE_DEPTH);
+	const std::string& GetTexName()				{ return m_textureFileName; }
+	_uint GetLODNumber()						{ return m_iLODNum; }
+	const MESHLOD* GetLODs()					{ return m_LODs; }
+	const glm::vec3& GetMin()					{ return m_vMin; }
+	const glm::vec3& GetMax()					{ return m_vMax; }
+	const glm::vec3& GetCenter()				{ return m_vCenter; }
+	_float GetRadius()							{ return m_fRadius; }
+
+private:
+	RESULT Ready(eModelType type, CMesh::MESHFILEDATA& data);
+public:
+	// The collision triangles and the mapped cache are taken over from the data
+	static CMeshGeometry* Create(eModelType type, CMesh::MESHFILEDATA& data);
+};
+
+NAMESPACE_END
+
+#endif //_MESHGEOMETRY_H_
\ No newline at end of file
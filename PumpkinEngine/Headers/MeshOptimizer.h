@@ -0,0 +1,43 @@
+#ifndef _MESHOPTIMIZER_H_
+#define _MESHOPTIMIZER_H_
+
+#include "EngineDefines.h"
+
+NAMESPACE_BEGIN(Engine)
+
+#define MESH_OPTIMIZE_CACHE_SIZE		16
+
+// Import-time passes over indexed triangle lists (CPU only, no GL)
+// Vertices are opaque records of vertexSize bytes that start with a glm::vec3 position
+class ENGINE_API CMeshOptimizer
+{
+private:
+	explicit CMeshOptimizer() {}
+
+public:
+	// Point duplicated vertices (byte-identical records) at their first copy, returns the number of unique vertices
+	// The duplicates stay in the buffer unreferenced until OptimizeVertexFetch drops them
+	static _uint DeduplicateVertices(const _uchar* pVertices, _uint vertexNum, _uint vertexSize, _uint* pIndices, _uint indexNum);
+	// Reorder triangles for post-transform cache locality (Tipsify)
+	// pClusters receives the first index of every cluster, a new one starts each time the fan jumps to a dead end
+	static void OptimizeVertexCache(_uint* pIndices, _uint indexNum, _uint vertexNum, std::vector<_uint>* pClusters = nullptr,
+		_uint cacheSize = MESH_OPTIMIZE_CACHE_SIZE);
+	// Reorder the clusters found by OptimizeVertexCache so outward facing ones are drawn first
+	static void OptimizeOverdraw(_uint* pIndices, _uint indexNum, const _uchar* pVertices, _uint vertexSize, const std::vector<_uint>& clusters);
+	// Reorder vertices by first use and drop unreferenced ones, returns the new vertex count
+	static _uint OptimizeVertexFetch(_uchar* pVertices, _uint vertexNum, _uint vertexSize, _uint* pIndices, _uint indexNum);
+	// Average cache miss ratio (transformed vertices per triangle) on a simulated FIFO cache
+	static _float SimulateACMR(const _uint* pIndices, _uint indexNum, _uint vertexNum, _uint cacheSize = MESH_OPTIMIZE_CACHE_SIZE);
+	// Collapse edges by quadric error until at most targetIndexNum indices are left, returns the new index count
+	// Vertices are only merged into a neighbour, never moved, so the result still indexes the same vertex buffer
+	// pError receives the largest object space deviation of the collapses that were made
+	static _uint SimplifyMesh(_uint* pIndices, _uint indexNum, const _uchar* pVertices, _uint vertexNum, _uint vertexSize,
+		_uint targetIndexNum, _float* pError = nullptr);
+
+private:
+	static _int SkipDeadEnd(std::vector<_uint>& vecDeadEnd, const std::vector<_uint>& vecLive, _uint& cursor, _uint vertexNum);
+};
+
+NAMESPACE_END
+
+#endif //_MESHOPTIMIZER_H_
\ No newline at end of file
@@ -8,37 +8,37 @@ NAMESPACE_BEGIN(Engine)
 
 class CBoundingBox;
 class CTransform;
+class CMappedFile;
 
-// The Octree Class
+// The Octree Class (linear, complete tree)
+// Nodes live in one array in level order: the children of node i are 8*i+1 ... 8*i+8,
+// and the child slot is the octant bits (x | y << 1 | z << 2), so a leaf's offset inside
+// the last level is the Morton code of its cell.
+// Nodes and leaf lists only hold offsets, so Save/Load can map a built tree back from disk.
 class ENGINE_API COctree : public CBase
 {
 public:
-	class COctreeNode
+	typedef struct sOctreeNode
 	{
-	public:
-		_bool					isLeaf;
-		glm::vec3				vMin;
-		glm::vec3				vMax;
-		glm::vec3				vCenter;
-		glm::vec3				vHalf;
-		_uint					myIndex;
-		_uint					childIndex[8];
-		std::vector<TRIANGLE*>	vecTriangles;
-		CBoundingBox*			BBox;
-		_bool					BBox_Render;
-		explicit COctreeNode()
-			: isLeaf(false), myIndex(0), BBox(nullptr), BBox_Render(false)
-			, vMin(glm::vec3(0.f)), vMax(glm::vec3(0.f)), vCenter(glm::vec3(0.f)), vHalf(glm::vec3(0.f))
-		{
-			vecTriangles.clear();
-			memset(childIndex, 0, sizeof(_uint) * 4);
-		}
-		~COctreeNode() {}
-	};
+		_float					vMin[3];
+		_float					vMax[3];
+		_uint					iTriStart;		// Offset into the packed index buffer
+		_uint					iTriCount;		// Leaf : own triangles, branch : whole subtree
+	}NODE;
 
 private:
-	std::vector<COctreeNode*>			m_vecNodeInfo;
+	std::vector<NODE>					m_vecNodes;
+	std::vector<_uint>					m_vecTriIndices;	// Triangle indices grouped per leaf
+	std::vector<TRIANGLE>				m_vecTriangles;		// One copy of each triangle
+	std::vector<_bool>					m_vecHighlight;		// Leaves flagged by HighlightLeafNodes
+	CMappedFile*						m_pMappedFile;		// Loaded cache file, nullptr when built
+	const NODE*							m_pNodes;			// m_vecNodes or the mapped node section
+	const _uint*						m_pTriIndices;		// m_vecTriIndices or the mapped index section
+	_uint								m_iNodeCount;
+	_uint								m_iDepth;
+	_uint								m_iFirstLeaf;
 	CTransform*							m_pParentTransform;
+	CBoundingBox*						m_pDebugBox;		// Unit box shared by every node, created on first Render
 	_bool								m_bDebug;
 
 private:
@@ -51,16 +51,59 @@ public:
 public:
 	void SetParentTransform(CTransform* parent)		{ m_pParentTransform = parent; }
 	void SetDebug(_bool value)						{ m_bDebug = value; }
-	std::vector<COctreeNode*> GetNodeVector()		{ return m_vecNodeInfo; }
-	_bool GetDebug()							{ return m_bDebug; }
-	void AddTriangle(TRIANGLE t, _uint& count);
-	void CheckBoundingBox(CBoundingBox* bbox, std::vector<COctreeNode*>& vecNode);
+	_bool GetDebug()								{ return m_bDebug; }
+	_uint GetNodeCount()							{ return m_iNodeCount; }
+	_uint GetFirstLeaf()							{ return m_iFirstLeaf; }
+	const NODE& GetNode(_uint index)				{ return m_pNodes[index]; }
+	const TRIANGLE& GetTriangle(_uint index)		{ return m_vecTriangles[index]; }
+	const _uint* GetTriIndices(const NODE& node)	{ return m_pTriIndices + node.iTriStart; }
+	void AddTriangle(const TRIANGLE& t);
+	// workerCount 0 : one per core
+	_uint Build(_uint workerCount = 0);
+	_bool Save(const std::string& path, _ulonglong sourceHash);
+	_bool Load(const std::string& path, _ulonglong sourceHash);
+	void CheckBoundingBox(CBoundingBox* bbox, std::vector<_uint>& vecLeaf) const;
+	// Debug only : flag the given leaves for Render
+	void HighlightLeafNodes(const std::vector<_uint>& vecLeaf);
+
+	// Call func(_uint leafIndex, const NODE&) for each non-empty leaf touching the box, stop when it returns false
+	// Reads the nodes in place without allocating, so queries can run from several threads
+	template <typename FUNC>
+	void VisitLeafNodes(CBoundingBox* bbox, FUNC func) const
+	{
+		if (nullptr == bbox || 0 == m_iNodeCount)
+			return;
+
+		_uint stack[64];
+		_uint stackSize = 0;
+		stack[stackSize++] = 0;
+		while (0 < stackSize)
+		{
+			_uint index = stack[--stackSize];
+			if (!TestNode(index, bbox))
+				continue;
+
+			if (index >= m_iFirstLeaf)
+			{
+				if (!func(index, m_pNodes[index]))
+					return;
+			}
+			else
+			{
+				for (_uint c = 8; c >= 1 && stackSize < 64; --c)
+					stack[stackSize++] = 8 * index + c;
+			}
+		}
+	}
 private:
-	void CheckNodeBoundingBox(_int index, CBoundingBox* bbox, std::vector<COctreeNode*>& vecNode);
+	_bool TestNode(_uint index, CBoundingBox* bbox) const;
+	void BuildNode(_uint index, std::vector<_uint>& vecTris, std::vector<std::vector<_uint>>& vecLeafTris);
+	void PartitionToChildren(_uint index, const _uint* pTris, _uint count, std::vector<_uint> vecChildTris[8]);
+	void PartitionParallel(_uint index, const std::vector<_uint>& vecTris, std::vector<_uint> vecChildTris[8], _uint workerCount);
 
 private:
 	RESULT Ready(glm::vec3 vMax, glm::vec3 vMin, _uint depth);
-	void ReadyOctree(_uint index, glm::vec3 vCenter, glm::vec3 vHalf, _uint depth, _uint maxDepth);
+	void ReadyOctree(_uint index, glm::vec3 vMin, glm::vec3 vMax, _uint depth, _uint maxDepth);
 public:
 	static COctree* Create(glm::vec3 vMax, glm::vec3 vMin, _uint depth);
 };
@@ -0,0 +1,64 @@
+#ifndef _PARALLELFOR_H_
+#define _PARALLELFOR_H_
+
+#include "EngineDefines.h"
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+NAMESPACE_BEGIN(Engine)
+
+// Number of workers ParallelFor can use (worker indices are 0 ... count - 1)
+inline _uint GetParallelWorkerCount()
+{
+	_uint count = std::thread::hardware_concurrency();
+	return 0 == count ? 1 : count;
+}
+
+// Run func(begin, end, worker) over [0, count) in blocks of grainSize on at most workerCount workers (0 : one per core)
+// Workers pull blocks from a shared counter so uneven queries still balance, the calling thread is worker 0
+template <typename FUNC>
+void ParallelFor(_uint count, _uint grainSize, FUNC func, _uint workerCount = 0)
+{
+	if (0 == count)
+		return;
+	if (0 == grainSize)
+		grainSize = 1;
+
+	_uint blockCount = (count + grainSize - 1) / grainSize;
+	if (0 == workerCount || workerCount > GetParallelWorkerCount())
+		workerCount = GetParallelWorkerCount();
+	if (workerCount > blockCount)
+		workerCount = blockCount;
+
+	if (1 == workerCount)
+	{
+		func(0, count, 0);
+		return;
+	}
+
+	std::atomic<_uint> nextBlock(0);
+	auto work = [&](_uint worker)
+	{
+		for (_uint block = nextBlock++; block < blockCount; block = nextBlock++)
+		{
+			_uint begin = block * grainSize;
+			_uint end = begin + grainSize < count ? begin + grainSize : count;
+			func(begin, end, worker);
+		}
+	};
+
+	std::vector<std::future<void>> tasks;
+	tasks.reserve(workerCount - 1);
+	for (_uint worker = 1; worker < workerCount; ++worker)
+		tasks.push_back(std::async(std::launch::async, work, worker));
+
+	work(0);
+	for (size_t i = 0; i < tasks.size(); ++i)
+		tasks[i].get();
+}
+
+NAMESPACE_END
+
+#endif //_PARALLELFOR_H_
\ No newline at end of file
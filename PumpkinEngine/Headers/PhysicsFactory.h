@@ -5,8 +5,16 @@
 
 NAMESPACE_BEGIN(Engine)
 
+class CSphereShape;
+class CPlaneShape;
+class CBoxShape;
 class ENGINE_API CPhysicsFactory : public iPhysicsFactory
 {
+private:
+	std::vector<CSphereShape*>		m_vecSphereShapes;
+	std::vector<CPlaneShape*>		m_vecPlaneShapes;
+	std::vector<CBoxShape*>			m_vecBoxShapes;
+
 private:
 	explicit CPhysicsFactory();
 	virtual ~CPhysicsFactory();
@@ -16,6 +24,10 @@ public:
 	virtual iPhysicsWorld* CreateWorld(std::function<void(void)> callback);
 	virtual iRigidBody* CreateRigidBody(const CRigidBodyDesc& desc, iShape* shape);
 
+	virtual iShape* CreateSphereShape(_float radius);
+	virtual iShape* CreatePlaneShape(const glm::vec3& normal, _float dot);
+	virtual iShape* CreateBoxShape(const glm::vec3& halfExtents);
+
 private:
 	RESULT Ready();
 public:
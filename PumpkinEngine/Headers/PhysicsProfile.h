@@ -0,0 +1,65 @@
+#ifndef _PHYSICSPROFILE_H_
+#define _PHYSICSPROFILE_H_
+
+#include "EngineDefines.h"
+#include <chrono>
+
+// Set to 0 to compile the physics counters/timers out
+#ifndef PK_PHYSICS_PROFILE
+#define PK_PHYSICS_PROFILE 1
+#endif
+
+NAMESPACE_BEGIN(Engine)
+
+// Statistics of the last CPhysicsWorld::Update (times in milliseconds)
+struct ENGINE_API sPhysicsProfile
+{
+	_uint			iBodyCount;
+	_uint			iBodiesAwake;
+	_uint			iFastBodies;		// Swept by the CCD pass
+	_uint			iPairsTested;
+	_uint			iPairsColliding;
+
+	_float			fIntegrateTime;
+	_float			fSweepTime;
+	_float			fNarrowphaseTime;	// Pair tests + contact resolution
+	_float			fCallbackTime;
+	_float			fTotalTime;
+
+	sPhysicsProfile() { Reset(); }
+	void Reset()
+	{
+		iBodyCount = iBodiesAwake = iFastBodies = iPairsTested = iPairsColliding = 0;
+		fIntegrateTime = fSweepTime = fNarrowphaseTime = fCallbackTime = fTotalTime = 0.f;
+	}
+};
+
+// Adds the lifetime of the scope to a timer of sPhysicsProfile
+class CPhysicsProfileTimer
+{
+private:
+	_float&											m_fTarget;
+	std::chrono::high_resolution_clock::time_point	m_start;
+
+public:
+	explicit CPhysicsProfileTimer(_float& target)
+		: m_fTarget(target), m_start(std::chrono::high_resolution_clock::now())
+	{}
+	~CPhysicsProfileTimer()
+	{
+		std::chrono::duration<_float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - m_start;
+		m_fTarget += elapsed.count();
+	}
+};
+
+NAMESPACE_END
+
+#if PK_PHYSICS_PROFILE
+#define PHYSICS_PROFILE_TIMER(NAME, TARGET)		Engine::CPhysicsProfileTimer NAME(TARGET)
+#define PHYSICS_PROFILE_COUNT(TARGET, VALUE)	(TARGET) += (VALUE)
+#else
+#define PHYSICS_PROFILE_TIMER(NAME, TARGET)
+#define PHYSICS_PROFILE_COUNT(TARGET, VALUE)
+#endif
+
+#endif //_PHYSICSPROFILE_H_
@@ -17,6 +17,7 @@ private:
 	CCollisionHandler*				m_pColHandler;
 
 	std::function<void(void)>		m_collisionCallback;
+	sPhysicsProfile					m_profile;
 
 private:
 	explicit CPhysicsWorld();
@@ -32,6 +33,7 @@ public:
 	virtual void RemoveBody(iRigidBody* body);
 	virtual void ResetAllRigidBodies();
 	virtual void ApplyRandomForce();
+	virtual const sPhysicsProfile& GetProfile()		{ return m_profile; }
 
 private:
 	RESULT Ready(std::function<void(void)> callback);
@@ -2,6 +2,7 @@
 #define _PLANESHAPE_H_
 
 #include "iShape.h"
+#include "MemoryPool.h"
 #include "glm\vec3.hpp"
 
 NAMESPACE_BEGIN(Engine)
@@ -17,10 +18,15 @@ private:
 	virtual ~CPlaneShape();
 	virtual void Destroy();
 
+	POOLED(CPlaneShape)
+
 public:
 	glm::vec3 GetNormal()			{ return m_vNormal; }
 	_float GetDotProduct()			{ return m_fDotProduct; }
 
+public:
+	virtual glm::vec3 GetLocalInertia(_float mass);
+
 private:
 	RESULT Ready(eShapeType type, glm::vec3 vNormal, _float dot);
 public:
@@ -36,6 +36,15 @@ public:
 		~CQuadTreeNode() {}
 	};
 
+	// Segment prepared once per query
+	typedef struct sQuadTreeQuery
+	{
+		glm::vec3				vMain;
+		glm::vec3				vDir;
+		glm::vec3				vCenter;
+		_float					fRadius;
+	}QUERY;
+
 private:
 	std::vector<CQuadTreeNode*>							m_vecNodeInfo;
 	glm::vec3											m_vHashRange;
@@ -50,13 +59,50 @@ public:
 	void Render();
 
 public:
-	std::vector<CQuadTreeNode*> GetNodeVector()		{ return m_vecNodeInfo; }
+	const std::vector<CQuadTreeNode*>& GetNodeVector()	{ return m_vecNodeInfo; }
 	_int GetHashValue(_float x, _float z);
 	void AddTriangleToTreeNode(_int hashKey, TRIANGLE triangle);
-	void GetLeafNodes(glm::vec3 vMain, glm::vec3 vTarget, std::vector<CQuadTreeNode*>& vecNode);
+	void GetLeafNodes(glm::vec3 vMain, glm::vec3 vTarget, std::vector<CQuadTreeNode*>& vecNode) const;
+	// Debug only : flag the leaves on the segment for Render
+	void HighlightLeafNodes(glm::vec3 vMain, glm::vec3 vTarget);
+
+	// Call func(const CQuadTreeNode*) for each leaf on the segment, stop when it returns false
+	// Reads the nodes in place without allocating, so queries can run from several threads
+	template <typename FUNC>
+	void VisitLeafNodes(const glm::vec3& vMain, const glm::vec3& vTarget, FUNC func) const
+	{
+		if (m_vecNodeInfo.empty())
+			return;
+
+		QUERY query;
+		MakeQuery(vMain, vTarget, query);
+
+		_uint stack[64];
+		_uint stackSize = 0;
+		stack[stackSize++] = 0;
+		while (0 < stackSize)
+		{
+			_uint index = stack[--stackSize];
+			if (!TestNode(index, query))
+				continue;
+
+			const CQuadTreeNode* pNode = m_vecNodeInfo[index];
+			if (pNode->isLeaf)
+			{
+				if (!func(pNode))
+					return;
+			}
+			else
+			{
+				for (_int i = 3; i >= 0 && stackSize < 64; --i)
+					stack[stackSize++] = pNode->childIndex[i];
+			}
+		}
+	}
 
 private:
-	void CheckDistanceQuadTree(_int index, glm::vec3 vCenter, _float fRadius, glm::vec3 vMain, glm::vec3 vDir, std::vector<CQuadTreeNode*>& vecNode);
+	void MakeQuery(const glm::vec3& vMain, const glm::vec3& vTarget, QUERY& query) const;
+	_bool TestNode(_uint index, const QUERY& query) const;
 
 private:
 	RESULT Ready(glm::vec3 vMax, glm::vec3 vMin, _uint depth);
@@ -2,10 +2,12 @@
 #define _RENDERER_H_
 
 #include "Base.h"
+#include "glm\vec3.hpp"
 
 NAMESPACE_BEGIN(Engine)
 
 class CGameObject;
+class CFrustumCuller;
 
 // Only game objects registered here are rendered
 class ENGINE_API CRenderer : public CBase
@@ -16,6 +18,13 @@ private:
 	std::vector<CGameObject*>		m_vecRenderObj;
 	std::vector<CGameObject*>		m_vecTRenderObj;
 
+	CFrustumCuller*					m_pCuller;			// Created on first Render
+	std::vector<glm::vec3>			m_vecBoxMin;		// World boxes of the list being culled
+	std::vector<glm::vec3>			m_vecBoxMax;
+	_bool							m_bCulling;
+	_uint							m_iVisibleCount;	// Last frame, objects without a bounding box count as visible
+	_uint							m_iCulledCount;
+
 
 private:
 	explicit CRenderer();
@@ -28,7 +37,13 @@ public:
 public:
 	// Register objects that need to be rendered
 	void AddRenderObj(CGameObject* pInstance, _bool isTransparent = false);
+	void SetCulling(_bool value)					{ m_bCulling = value; }
+	_bool GetCulling()								{ return m_bCulling; }
+	_uint GetVisibleCount()							{ return m_iVisibleCount; }
+	_uint GetCulledCount()							{ return m_iCulledCount; }
 private:
+	// Render the objects of one list that are inside the view frustum
+	void RenderList(std::vector<CGameObject*>& vecObj);
 	// Empty container
 	void ClearAllRenderObjList();
 };
@@ -2,6 +2,8 @@
 #define _RIGIDBODY_H_
 
 #include "iRigidBody.h"
+#include "MemoryPool.h"
+#include "glm\mat3x3.hpp"
 
 NAMESPACE_BEGIN(Engine)
 
@@ -12,6 +14,7 @@ class ENGINE_API CRigidBody : public iRigidBody
 private: //From.Desc
 	_bool			m_bIsStatic;
 	_bool			m_bIsGround;
+	_bool			m_bIsKinematic;
 
 	_float			m_fMass;
 	_float			m_fRestitution;
@@ -36,8 +39,19 @@ private:
 	glm::vec3		m_vGravity;
 	glm::vec3		m_vLinearAcceleration;
 	glm::vec3		m_vAngularAcceleration;
+	glm::vec3		m_vInvInertiaLocal;		// Inverse of the diagonal local tensor
+	glm::mat3		m_matInvInertiaWorld;	// R * InvInertiaLocal * R^T, refreshed once per step
 
-	CRigidBodyDesc*	m_pDesc;
+private: //For.Kinematic
+	_bool			m_bHasKinematicTarget;
+	glm::vec3		m_vKinematicPosition;
+	glm::quat		m_qKinematicRotation;
+
+private: //For.Reset (only the state that changes at runtime)
+	glm::vec3		m_vInitPosition;
+	glm::vec3		m_vInitLinearVelocity;
+	glm::vec3		m_vInitAngularVelocity;
+	glm::quat		m_qInitRotation;
 
 
 private:
@@ -45,15 +59,19 @@ private:
 	virtual ~CRigidBody();
 	virtual void Destroy();
 
+	POOLED(CRigidBody)
+
 public:
 	void Update(const _float& dt);
 	void SetGravityAcceleration(const glm::vec3& gravity);
 	void UpdateAcceleration();
+	void UpdateInertiaTensor();
 	void VerletStep1(const _float& dt);
 	void VerletStep2(const _float& dt);
 	void VerletStep3(const _float& dt);
 	void KillForces();
 	void ApplyDamping(_float dt);
+	void UpdateKinematic(const _float& dt);
 
 public:
 	virtual glm::vec3 GetPosition();
@@ -71,6 +89,8 @@ public:
 	virtual void ApplyTorque(const glm::vec3& torque);
 	virtual void ApplyTorqueImpulse(const glm::vec3& torqueImpulse);
 
+	virtual void SetKinematicTarget(const glm::vec3& position, const glm::quat& rotation);
+
 public:
 	glm::vec3 GetPreviousPosition()			{ return m_vPreviousPosition; }
 	glm::vec3 GetLinearVelocity()			{ return m_vLinearVelocity; }
@@ -85,9 +105,12 @@ public:
 	iShape* GetShape()			{ return m_pShape; }
 	_bool IsStatic()			{ return m_bIsStatic; }
 	_bool IsGround()			{ return m_bIsGround; }
+	_bool IsKinematic()			{ return m_bIsKinematic; }
+	_bool IsDynamic()			{ return !m_bIsStatic && !m_bIsKinematic; }
 	void ResetAll();
 
 private:
+	void KinematicStep(const _float& dt);
 	RESULT Ready(const CRigidBodyDesc& desc, iShape* shape);
 	void SetRigidBodyDesc(const CRigidBodyDesc& desc);
 public:
@@ -12,6 +12,7 @@ class ENGINE_API CRigidBodyDesc
 public:
 	_bool isStatic;
 	_bool isGround;
+	_bool isKinematic;
 
 	_float mass;
 	_float restitution;
@@ -31,6 +32,7 @@ public:
 	explicit CRigidBodyDesc()
 		: isStatic(false)
 		, isGround(false)
+		, isKinematic(false)
 		, mass(1.f)
 		, restitution(0.6f)
 		, friction(0.4f)
@@ -47,6 +49,7 @@ public:
 	explicit CRigidBodyDesc(const CRigidBodyDesc& rhs)
 		: isStatic(rhs.isStatic)
 		, isGround(rhs.isGround)
+		, isKinematic(rhs.isKinematic)
 		, mass(rhs.mass)
 		, restitution(rhs.restitution)
 		, friction(rhs.friction)
@@ -9,6 +9,14 @@ NAMESPACE_BEGIN(Engine)
 // Component for shader data
 class ENGINE_API CShader : public CComponent
 {
+public:
+	// Shader source code read from file
+	typedef struct sShaderFileData
+	{
+		std::string			vertexCode;
+		std::string			fragmentCode;
+	}SHADERFILEDATA;
+
 protected:
 	_uint				m_ShaderProgram;
 	_uint				m_matWorldLocation;
@@ -32,16 +40,18 @@ private:
 private:
 	// Create shader Id
 	RESULT CreateShaderProgram();
-	// Create new shader from file
-	RESULT AddShader(const char* vertexPath, const char* fragPath);
+	// Create new shader from source code
+	RESULT AddShader(const SHADERFILEDATA& data);
 	// Read shader code from file
-	std::string ReadShader(const char* fileName);
+	static std::string ReadShader(const char* fileName);
 	// Compile shader
 	_uint CreateShader(_uint shaderType, std::string source);
 	// Set location to shader
 	void SetLocation();
 public:
 	_uint GetShaderProgram()		{ return m_ShaderProgram; }
+	// Read both shader files (no GL context needed, safe on any thread)
+	static void LoadShaderFiles(const char* vertexPath, const char* fragPath, SHADERFILEDATA& data);
 	// Set matrix information to shader
 	void SetMatrixInfo(const glm::mat4x4 world, const glm::mat4x4 view, const glm::mat4x4 proj);
 	// Set diffuse texture information to shader
@@ -62,11 +72,14 @@ public:
 private:
 	// Initialize Shader
 	RESULT Ready(std::string ID, const char* vertexPath, const char* fragPath);
+	// Compile and link shader source code
+	RESULT Ready(std::string ID, const SHADERFILEDATA& data);
 public:
 	// Clone component
 	virtual CComponent* Clone();
 	// Create an instance
 	static CShader* Create(std::string ID, const char* vertexPath, const char* fragPath);
+	static CShader* Create(std::string ID, const SHADERFILEDATA& data);
 };
 
 NAMESPACE_END
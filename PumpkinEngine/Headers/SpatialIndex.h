@@ -0,0 +1,70 @@
+#ifndef _SPATIALINDEX_H_
+#define _SPATIALINDEX_H_
+
+#include "Base.h"
+#include "glm\vec3.hpp"
+#include <cfloat>
+
+NAMESPACE_BEGIN(Engine)
+
+class CGameObject;
+
+// k-d tree over points (game object positions) for radius and nearest-K queries
+// Stored implicitly : the node of a range is its middle element, split on the widest axis of the range.
+// Meant to be rebuilt once per frame, queries only read it so batches run in parallel.
+class ENGINE_API CSpatialIndex : public CBase
+{
+public:
+	typedef struct sKDNode
+	{
+		glm::vec3			vPos;
+		_uint				iIndex;		// Index in the built set
+		_uint				iAxis;		// Split axis of the range this node is the middle of
+	}NODE;
+
+private:
+	std::vector<NODE>					m_vecNodes;
+	std::vector<CGameObject*>			m_vecObjects;		// Built set -> object, empty when built from positions
+	std::vector<glm::vec3>				m_vecPositions;		// Built set -> position
+
+private:
+	explicit CSpatialIndex();
+	virtual ~CSpatialIndex();
+	virtual void Destroy();
+
+public:
+	// Rebuild over raw positions, query results are indices into pPositions
+	void Build(const glm::vec3* pPositions, _uint count);
+	// Rebuild over the enabled, living objects of a list, query results are indices for GetGameObject
+	void Build(const std::list<CGameObject*>& listObj);
+
+	// Every point within fRadius of vCenter (unordered), returns the count added
+	_uint QueryRadius(const glm::vec3& vCenter, _float fRadius, std::vector<_uint>& vecResult) const;
+	// Up to k points nearest to vCenter within fMaxDistance, sorted near to far
+	_uint QueryNearest(const glm::vec3& vCenter, _uint k, std::vector<_uint>& vecResult, _float fMaxDistance = FLT_MAX) const;
+	// One query per center, vecResults[i] is filled for pCenters[i], spread over the worker threads
+	// workerCount 0 uses one worker per core
+	void QueryRadiusBatch(const glm::vec3* pCenters, _uint count, _float fRadius, std::vector<std::vector<_uint>>& vecResults, _uint workerCount = 0) const;
+	void QueryNearestBatch(const glm::vec3* pCenters, _uint count, _uint k, std::vector<std::vector<_uint>>& vecResults, _uint workerCount = 0) const;
+
+public:
+	_uint GetCount() const								{ return (_uint)m_vecNodes.size(); }
+	CGameObject* GetGameObject(_uint index) const		{ return index < m_vecObjects.size() ? m_vecObjects[index] : nullptr; }
+	const glm::vec3& GetPosition(_uint index) const		{ return m_vecPositions[index]; }
+
+private:
+	void BuildTree();
+	void BuildRange(_uint begin, _uint end);
+	void SearchRadius(_uint begin, _uint end, const glm::vec3& vCenter, _float fRadiusSq, std::vector<_uint>& vecResult) const;
+	void SearchNearest(_uint begin, _uint end, const glm::vec3& vCenter, _uint k, std::vector<std::pair<_float, _uint>>& vecHeap, _float& fBoundSq) const;
+	_uint Nearest(const glm::vec3& vCenter, _uint k, _float fMaxDistance, std::vector<std::pair<_float, _uint>>& vecHeap, std::vector<_uint>& vecResult) const;
+
+private:
+	RESULT Ready();
+public:
+	static CSpatialIndex* Create();
+};
+
+NAMESPACE_END
+
+#endif //_SPATIALINDEX_H_
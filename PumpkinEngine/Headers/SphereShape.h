@@ -2,6 +2,7 @@
 #define _SPHERESHAPE_H_
 
 #include "iShape.h"
+#include "MemoryPool.h"
 
 NAMESPACE_BEGIN(Engine)
 
@@ -15,9 +16,14 @@ private:
 	virtual ~CSphereShape();
 	virtual void Destroy();
 
+	POOLED(CSphereShape)
+
 public:
 	_float GetRadius()			{ return m_fRadius; }
 
+public:
+	virtual glm::vec3 GetLocalInertia(_float mass);
+
 private:
 	RESULT Ready(eShapeType type, _float radius);
 public:
@@ -5,9 +5,40 @@
 
 NAMESPACE_BEGIN(Engine)
 
+#define TEXTURE_MAX_LEVEL		16
+
+class CMappedFile;
+
 // Component for texture data
 class ENGINE_API CTexture : public CComponent
 {
+public:
+	// One mip level of a compressed image, offset from the start of the cache file
+	typedef struct sTextureLevel
+	{
+		_uint				iOffset;
+		_uint				iSize;
+	}TEXTURELEVEL;
+
+	// Decoded image, pPixels is owned by stb_image
+	// or compressed image with its whole mip chain, the levels are in pMappedFile (the cooked cache)
+	typedef struct sTextureFileData
+	{
+		_uchar*				pPixels;
+		_int				iWidth;
+		_int				iHeight;
+		_int				iChannels;
+
+		CMappedFile*		pMappedFile;
+		_uint				iFormat;		// GL compressed internal format
+		_uint				iLevelNum;
+		TEXTURELEVEL		Levels[TEXTURE_MAX_LEVEL];
+
+		sTextureFileData()
+			: pPixels(nullptr), iWidth(0), iHeight(0), iChannels(0)
+			, pMappedFile(nullptr), iFormat(0), iLevelNum(0) {}
+	}TEXTUREFILEDATA;
+
 private:
 	_uint				m_iTextureID;
 	_int				m_iWidth;
@@ -27,14 +58,32 @@ public:
 	_int GetWidth()				{ return m_iWidth; }
 	_int GetHeight()			{ return m_iHeight; }
 
+public:
+	// Read an image from its compressed cache or decode the image file (no GL context needed, safe on any thread)
+	// A missing or stale cache is not cooked here (see -texcook), the image file is decoded instead
+	static RESULT LoadImageFile(std::string filePath, TEXTUREFILEDATA& data);
+	static void ReleaseImageFile(TEXTUREFILEDATA& data);
+	// Bytes the image takes on upload
+	static size_t GetImageSize(const TEXTUREFILEDATA& data);
+	// Specify every level of a compressed image
+	// pBase is the start of the cache file, nullptr when it has been copied to the bound pixel unpack buffer
+	static void UploadCompressed(_uint target, const TEXTUREFILEDATA& data, const _uchar* pBase);
+
 private:
 	// Load texture information from file
 	RESULT Ready(std::string ID, std::string filePath);
+	// Upload a decoded image
+	RESULT Ready(std::string ID, const TEXTUREFILEDATA& data);
+	// Create the texture with a placeholder image and queue the file on the texture streamer
+	RESULT Ready_Async(std::string ID, std::string filePath);
 public:
 	// Clone component
 	virtual CComponent* Clone();
 	// Create an instance
 	static CTexture* Create(std::string ID, std::string filePath);
+	static CTexture* Create(std::string ID, const TEXTUREFILEDATA& data);
+	// Returns at once, the image replaces the placeholder once decoded and uploaded (clones included, they share the GL texture)
+	static CTexture* CreateAsync(std::string ID, std::string filePath);
 };
 
 NAMESPACE_END
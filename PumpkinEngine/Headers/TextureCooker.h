@@ -0,0 +1,56 @@
+#ifndef _TEXTURECOOKER_H_
+#define _TEXTURECOOKER_H_
+
+#include "Texture.h"
+
+NAMESPACE_BEGIN(Engine)
+
+#define TEXTURE_BC1_BLOCK_SIZE		8		// RGB, 4 bits a pixel
+#define TEXTURE_BC3_BLOCK_SIZE		16		// RGBA, 8 bits a pixel
+
+// Converts images to block compressed textures with their whole mip chain (CPU only, no GL)
+// The result is cached next to the image (image path + ".tex") and tied to it by a hash of the image file
+// Caches are written offline (-texcook), loads only map them
+// Opaque images are stored as BC1, images with any transparent pixel as BC3
+class ENGINE_API CTextureCooker
+{
+public:
+	typedef struct sCookResult
+	{
+		_uint				iWidth;
+		_uint				iHeight;
+		_uint				iFormat;		// GL compressed internal format
+		_uint				iBlockSize;		// Bytes per 4x4 block
+		_uint				iLevelNum;
+		size_t				iRawSize;		// The same mip chain as RGBA8
+		size_t				iCookedSize;	// Compressed levels
+		_ulonglong			iChecksum;		// Hash of the compressed levels
+	}COOKRESULT;
+
+private:
+	explicit CTextureCooker() {}
+
+public:
+	// Map the cooked cache of an image, fails when it is missing or made from another file (nothing is cooked)
+	static RESULT LoadTextureFile(const std::string& sourcePath, CTexture::TEXTUREFILEDATA& data);
+	// Cook an image and write its cache whether or not it is up to date
+	static RESULT CookTextureFile(const std::string& sourcePath, COOKRESULT* pResult = nullptr);
+
+public:
+	// Half size level of an RGBA8 image (2x2 box filter, odd edges are repeated)
+	static void GenerateMip(const _uchar* pSource, _uint width, _uint height, _uchar* pDest);
+	// Compress an RGBA8 image into 4x4 blocks, rows of blocks run in parallel
+	static void CompressBC1(const _uchar* pSource, _uint width, _uint height, _uchar* pBlocks);
+	static void CompressBC3(const _uchar* pSource, _uint width, _uint height, _uchar* pBlocks);
+
+private:
+	static void FetchBlock(const _uchar* pSource, _uint width, _uint height, _uint blockX, _uint blockY, _uchar* pBlock);
+	static void CompressColourBlock(const _uchar* pBlock, _uchar* pOut);
+	static void CompressAlphaBlock(const _uchar* pBlock, _uchar* pOut);
+	static RESULT Cook(const _uchar* pSource, size_t sourceSize, _ulonglong sourceHash, const std::string& cachePath, COOKRESULT* pResult);
+	static RESULT MapTextureCache(const std::string& path, _ulonglong sourceHash, CTexture::TEXTUREFILEDATA& data);
+};
+
+NAMESPACE_END
+
+#endif //_TEXTURECOOKER_H_
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef _TEXTURESTREAMER_H_
+#define _TEXTURESTREAMER_H_
+
+#include "Base.h"
+#include "Texture.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+NAMESPACE_BEGIN(Engine)
+
+#define TEXTURE_UPLOAD_BUDGET			(8 << 20)		// Bytes uploaded per frame
+#define TEXTURE_STAGING_BUFFER_NUM		3
+
+// Streams image files into existing GL textures
+// Decoding runs on a pool of worker threads, the upload runs in Update (once per frame, on the thread owning the context)
+// through pixel unpack buffers and is limited to a byte budget per frame
+// Until its image arrives a texture keeps whatever it was created with (a placeholder)
+class ENGINE_API CTextureStreamer : public CBase
+{
+	SINGLETON(CTextureStreamer)
+
+private:
+	typedef struct sTextureRequest
+	{
+		CBase*							pOwner;			// Kept alive (reference held) until the upload
+		_uint							iTextureID;
+		_uint							iTarget;		// GL_TEXTURE_2D or one cube map face
+		_bool							bMipmap;
+		std::string						filePath;
+		CTexture::TEXTUREFILEDATA		data;
+	}TEXTUREREQUEST;
+
+private:
+	std::vector<std::thread>			m_vecWorkers;
+	std::deque<TEXTUREREQUEST*>			m_queueDecode;
+	std::deque<TEXTUREREQUEST*>			m_queueUpload;
+	std::mutex							m_mutex;
+	std::condition_variable				m_cvDecode;
+	std::condition_variable				m_cvDecoded;
+	std::atomic<_uint>					m_iPendingNum;		// Requested and not uploaded yet
+	_bool								m_bQuit;
+
+	_uint								m_iUploadBudget;
+	_uint								m_iUploadedBytes;	// During the last Update
+	_uint								m_StagingBuffers[TEXTURE_STAGING_BUFFER_NUM];
+	_uint								m_iNextStaging;
+
+private:
+	explicit CTextureStreamer();
+	virtual ~CTextureStreamer();
+	// Call instead of destructor to manage class internal data
+	void Destroy();
+
+public:
+	// Queue an image file for one level 0 image of a texture, returns at once
+	// pOwner (may be nullptr) is referenced until the texture has been uploaded
+	void Request(CBase* pOwner, _uint textureID, _uint target, std::string filePath, _bool mipmap = true);
+	// Upload decoded images until the budget of this frame is used, at least one per call
+	void Update();
+	// Block until every request so far has been uploaded
+	void Flush();
+
+public:
+	_uint GetPendingNumber()						{ return m_iPendingNum; }
+	_uint GetUploadedBytes()						{ return m_iUploadedBytes; }
+	void SetUploadBudget(_uint bytes)				{ m_iUploadBudget = bytes; }
+
+private:
+	void StartWorkers();
+	void WorkerLoop();
+	void UploadDecoded(_uint budget);
+	void Upload(TEXTUREREQUEST* pRequest);
+	void ReleaseRequest(TEXTUREREQUEST* pRequest);
+};
+
+NAMESPACE_END
+
+#endif //_TEXTURESTREAMER_H_
\ No newline at end of file
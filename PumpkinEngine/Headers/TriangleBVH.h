@@ -0,0 +1,99 @@
+#ifndef _TRIANGLEBVH_H_
+#define _TRIANGLEBVH_H_
+
+#include "Base.h"
+#include "EngineStruct.h"
+
+NAMESPACE_BEGIN(Engine)
+
+class CMappedFile;
+
+// Bounding volume hierarchy over static triangles
+// Built as a binary SAH tree, then collapsed to 4-wide nodes that are tested with one SSE slab test
+// Nodes refer to each other by index only, so a saved tree can be mapped back from its cache file and used in place
+class ENGINE_API CTriangleBVH : public CBase
+{
+public:
+	// Children bounds in SoA order so each row loads into one SSE register (128 bytes)
+	typedef struct sBVHWideNode
+	{
+		_float				vMinX[4];
+		_float				vMinY[4];
+		_float				vMinZ[4];
+		_float				vMaxX[4];
+		_float				vMaxY[4];
+		_float				vMaxZ[4];
+		_uint				iChild[4];		// Branch : wide node index, leaf : first triangle
+		_uint				iCount[4];		// 0 for branches and empty slots
+	}WIDENODE;
+
+	typedef struct sRayHit
+	{
+		_float				fDistance;
+		_uint				iTriangle;
+		glm::vec3			vPoint;
+	}RAYHIT;
+
+private:
+	// Binary node, only used while building (32 bytes)
+	typedef struct sBVHNode
+	{
+		_float				vMin[3];
+		_uint				iLeftOrStart;	// Branch : left child (right = left + 1), leaf : first triangle
+		_float				vMax[3];
+		_uint				iCount;			// 0 for branches
+	}NODE;
+
+private:
+	std::vector<WIDENODE>				m_vecNodes;
+	std::vector<TRIANGLE>				m_vecTriangles;		// Reordered so every leaf is one range
+	std::vector<_uint>					m_vecOriginalIndex;	// Index of each triangle in the source array
+	CMappedFile*						m_pMappedFile;		// Cache file the arrays below point into, nullptr when built
+
+	// Arrays used by the queries, either the vectors above or sections of the mapped cache file
+	const WIDENODE*						m_pNodes;
+	const TRIANGLE*						m_pTriangles;
+	const _uint*						m_pOriginalIndex;
+	_uint								m_iNodeCount;
+	_uint								m_iTriangleCount;
+
+private:
+	explicit CTriangleBVH();
+	virtual ~CTriangleBVH();
+	virtual void Destroy();
+
+public:
+	// Nearest hit along the ray within fMaxDistance (vDir must be normalized)
+	_bool IntersectClosest(const glm::vec3& vOrigin, const glm::vec3& vDir, _float fMaxDistance, RAYHIT& hit);
+	// Any hit along the ray within fMaxDistance, stops at the first one found
+	_bool IntersectAny(const glm::vec3& vOrigin, const glm::vec3& vDir, _float fMaxDistance);
+	// Any hit on each segment pOrigins[i] -> pTargets[i], traced as packets of 4 coherent rays
+	void IntersectAnyBatch(const glm::vec3* pOrigins, const glm::vec3* pTargets, _uint count, _bool* pResults);
+
+public:
+	_uint GetNodeCount()						{ return m_iNodeCount; }
+	_uint GetTriangleCount()					{ return m_iTriangleCount; }
+	const WIDENODE& GetNode(_uint index)		{ return m_pNodes[index]; }
+	const TRIANGLE& GetTriangle(_uint index)	{ return m_pTriangles[index]; }
+	_uint GetOriginalIndex(_uint index)			{ return m_pOriginalIndex[index]; }
+	_bool IsMapped()							{ return nullptr != m_pMappedFile; }
+	// Write the tree to a cache file tagged with the hash of its source triangles
+	_bool Save(const std::string& path, _ulonglong sourceHash);
+
+private:
+	void BuildNode(std::vector<NODE>& vecBuild, _uint index, _uint start, _uint count, std::vector<glm::vec3>& vecCentroids, _uint depth);
+	_uint CollapseNode(const std::vector<NODE>& vecBuild, _uint index);
+	_bool IntersectRayTriangle(const TRIANGLE& tri, const glm::vec3& vOrigin, const glm::vec3& vDir, _float& fDistance);
+	_uint IntersectPacket(const glm::vec3* pOrigins, const glm::vec3* pTargets, _uint count);
+
+private:
+	RESULT Ready(const TRIANGLE* pTriangles, _uint count);
+	RESULT ReadyFromFile(const std::string& path, _ulonglong sourceHash);
+public:
+	static CTriangleBVH* Create(const TRIANGLE* pTriangles, _uint count);
+	static CTriangleBVH* CreateFromFile(const std::string& path, _ulonglong sourceHash);
+};
+
+NAMESPACE_END
+
+#endif //_TRIANGLEBVH_H_
\ No newline at end of file
@@ -17,6 +17,10 @@ private:
 	_uint				m_iNumVtx;
 	_uint				m_iIB_ID;
 	_uint				m_iNumIdx;
+	_uint				m_iIndexType;		// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	_uint				m_iVertexSize;
+	eModelType			m_eType;
+	glm::vec4			m_vColour;			// Constant colour for layouts without one
 private:
 	_bool				m_bWireFrame;
 
@@ -27,20 +31,35 @@ public:
 
 public:
 	virtual void Render();
+	// Draw indexCount indices from indexStart on (one level of detail)
+	void RenderRange(_uint indexStart, _uint indexCount);
 	virtual void Destroy();
 
 public:
 	void SetWireFrame(_bool wireFrame) { m_bWireFrame = wireFrame; }
+	_uint GetVertexSize()				{ return m_iVertexSize; }
+	_uint GetIndexNumber()				{ return m_iNumIdx; }
+
+public:
+	// Bytes per vertex of the compact layout used for the model type
+	static _uint GetVertexSize(eModelType type);
+	// Pack full vertices into the compact layout used for the model type
+	static void PackVertices(const VTX* pVertices, _uint count, eModelType type, void* pOut);
 
 private:
-	RESULT Ready(_uint numVTX, VTX* pVertices, _uint numIDX, _uint* pIndices, eModelType type);
+	RESULT Ready(_uint numVTX, const void* pVertices, _uint numIDX, const void* pIndices, _uint indexSize, eModelType type, const glm::vec4& vColour);
 	void Ready_Vertex_To_Shader();
 	void Ready_xyz();
 	void Ready_xyz_normal();
 	void Ready_xyz_normal_texUV();
+	void Ready_xyz_normal_color();
 
 public:
-	static CVIBuffer* Create(_uint numVTX, VTX* pVertices, _uint numIDX, _uint* pIndices, eModelType type);
+	// Full vertices, packed to the layout of the model type before the upload
+	static CVIBuffer* Create(_uint numVTX, const VTX* pVertices, _uint numIDX, const _uint* pIndices, eModelType type);
+	// Vertices already in the layout of the model type, vColour is used when the layout has no colour
+	// Indices are 16 or 32 bit (indexSize 2 or 4)
+	static CVIBuffer* Create(_uint numVTX, const void* pVertices, _uint numIDX, const void* pIndices, _uint indexSize, eModelType type, const glm::vec4& vColour);
 };
 
 NAMESPACE_END
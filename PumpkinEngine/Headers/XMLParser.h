@@ -8,6 +8,7 @@
 NAMESPACE_BEGIN(Engine)
 
 class CComponent;
+class CAssetLoader;
 
 // Save/Load XML files
 class ENGINE_API CXMLParser : public CBase
@@ -71,7 +72,8 @@ private:
 	void Destroy();
 
 public:
-	void LoadShaderData(std::string path, std::string fileName);
+	// With a loader the shader files are only queued, they are compiled when the loader runs
+	void LoadShaderData(std::string path, std::string fileName, CAssetLoader* pLoader = nullptr);
 	void LoadTextureData(std::string path, std::string fileName);
 	void LoadMeshData(std::string path, std::string fileName);
 	void LoadSoundData(std::string path, std::string fileName);
@@ -80,6 +82,9 @@ public:
 	void LoadLightData(std::string path, std::string fileName, std::vector<sLightData>& vec);
 	void SaveLightData(std::string path, std::string fileName, std::vector<sLightData>& vec);
 	void LoadLanguageData(std::string path, std::string fileName, std::unordered_map<std::string, std::string>& map);
+
+private:
+	void AddShaderJob(CAssetLoader* pLoader, const sShaderdata& data, std::string vertexPath, std::string fragPath);
 };
 
 NAMESPACE_END
@@ -3,6 +3,7 @@
 
 #include <functional>
 #include "Base.h"
+#include "glm\vec3.hpp"
 
 NAMESPACE_BEGIN(Engine)
 
@@ -20,6 +21,11 @@ protected:
 public:
 	virtual iPhysicsWorld* CreateWorld(std::function<void(void)> callback) = 0;
 	virtual iRigidBody* CreateRigidBody(const CRigidBodyDesc& desc, iShape* shape) = 0;
+
+	// Shapes are immutable, so equal shapes are shared between bodies
+	virtual iShape* CreateSphereShape(_float radius) = 0;
+	virtual iShape* CreatePlaneShape(const glm::vec3& normal, _float dot) = 0;
+	virtual iShape* CreateBoxShape(const glm::vec3& halfExtents) = 0;
 };
 
 NAMESPACE_END
@@ -3,6 +3,7 @@
 
 #include "Base.h"
 #include "glm\vec3.hpp"
+#include "PhysicsProfile.h"
 
 NAMESPACE_BEGIN(Engine)
 
@@ -23,6 +24,8 @@ public:
 	virtual void RemoveBody(iRigidBody* body) = 0;
 	virtual void ResetAllRigidBodies() = 0;
 	virtual void ApplyRandomForce() = 0;
+	// Counters and phase timers of the last Update (zero when PK_PHYSICS_PROFILE is 0)
+	virtual const sPhysicsProfile& GetProfile() = 0;
 };
 
 NAMESPACE_END
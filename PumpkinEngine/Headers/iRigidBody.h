@@ -36,6 +36,9 @@ public:
 	virtual void ApplyTorque(const glm::vec3& torque) = 0;
 	virtual void ApplyTorqueImpulse(const glm::vec3& torqueImpulse) = 0;
 
+	// Kinematic bodies only : transform to reach by the end of the next step
+	virtual void SetKinematicTarget(const glm::vec3& position, const glm::quat& rotation) = 0;
+
 };
 
 NAMESPACE_END
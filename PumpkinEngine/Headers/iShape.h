@@ -2,6 +2,7 @@
 #define _ISHAPE_H_
 
 #include "Base.h"
+#include "glm\vec3.hpp"
 
 NAMESPACE_BEGIN(Engine)
 
@@ -26,6 +27,8 @@ protected:
 
 public:
 	eShapeType GetShapeType()	{ return m_shapeType; }
+	// Diagonal of the inertia tensor around the center of mass (principal axes)
+	virtual glm::vec3 GetLocalInertia(_float mass) = 0;
 };
 
 NAMESPACE_END